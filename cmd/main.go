@@ -9,7 +9,9 @@ import (
 
 // main is the entry point of the application.
 func main() {
-	os.Exit(run(os.Args))
+	code := run(os.Args)
+	internal.FlushLog()
+	os.Exit(code)
 }
 
 // run parses arguments and dispatches commands.
@@ -31,6 +33,26 @@ func run(args []string) int {
 		return runJps(cmdArgs)
 	case "jattach":
 		return runJattach(cmdArgs)
+	case "jstat":
+		return runJstat(cmdArgs)
+	case "jcmd":
+		return runJcmd(cmdArgs)
+	case "threads":
+		return runThreads(cmdArgs)
+	case "histo":
+		return runHisto(cmdArgs)
+	case "profile":
+		return runProfile(cmdArgs)
+	case "serve":
+		return runServe(cmdArgs)
+	case "record":
+		return runRecord(cmdArgs)
+	case "replay":
+		return runReplay(cmdArgs)
+	case "flags":
+		return runFlags(cmdArgs)
+	case "fleet":
+		return runFleet(cmdArgs)
 	default:
 		printError(fmt.Sprintf("unknown command: %s", cmd))
 		printHelp()
@@ -58,6 +80,106 @@ func runJattach(args []string) int {
 	return internal.Jattach(opt)
 }
 
+// runJstat handles the "jstat" command.
+func runJstat(args []string) int {
+	opt, err := internal.ParseJstatFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Jstat(opt)
+}
+
+// runJcmd handles the "jcmd" command.
+func runJcmd(args []string) int {
+	opt, err := internal.ParseJcmdFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Jcmd(opt)
+}
+
+// runThreads handles the "threads" command.
+func runThreads(args []string) int {
+	opt, err := internal.ParseThreadsFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Threads(opt)
+}
+
+// runHisto handles the "histo" command.
+func runHisto(args []string) int {
+	opt, err := internal.ParseHistoFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Histo(opt)
+}
+
+// runProfile handles the "profile" command.
+func runProfile(args []string) int {
+	opt, err := internal.ParseProfileFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Profile(opt)
+}
+
+// runServe handles the "serve" command.
+func runServe(args []string) int {
+	opt, err := internal.ParseServeFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Serve(opt)
+}
+
+// runRecord handles the "record" command.
+func runRecord(args []string) int {
+	opt, err := internal.ParseRecordFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Record(opt)
+}
+
+// runReplay handles the "replay" command.
+func runReplay(args []string) int {
+	opt, err := internal.ParseReplayFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Replay(opt)
+}
+
+// runFlags handles the "flags" command.
+func runFlags(args []string) int {
+	opt, err := internal.ParseFlagsFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Flags(opt)
+}
+
+// runFleet handles the "fleet" command.
+func runFleet(args []string) int {
+	opt, err := internal.ParseFleetFlags(args)
+	if err != nil {
+		printError(fmt.Sprintf("failed to parse flags: %v", err))
+		return 1
+	}
+	return internal.Fleet(opt)
+}
+
 // printHelp prints the usage information for the command line tool.
 func printHelp() {
 	fmt.Print(`Usage: jvmtool <command> [options]
@@ -66,6 +188,16 @@ Commands:
   help                Show this help message.
   jps                 List Java processes for the current or specified user.
   jattach             Attach a Java agent to a running Java process.
+  jstat               Sample perfdata counters of a Java process without attaching.
+  jcmd                Send a diagnostic command to a running Java process.
+  threads             Group the threads of a Java process by stack, state and lock from its thread dumps.
+  histo               Show the classes taking the most heap of a Java process, or growing the most with -diff.
+  flags               Show the JVM arguments, flags and system properties of Java processes, cached per JVM.
+  profile             Profile a running Java process with async-profiler and print collapsed stacks.
+  serve               Serve jps, perfdata, jcmd, attach and Prometheus metrics over HTTP on a unix socket.
+  record              Record the perfdata counters of Java processes into compact files.
+  replay              Print a recording the way jstat does.
+  fleet               Run a jvmtool command on many hosts over ssh and merge their output.
 
 jps options:
   -user <username>        Specify the user to list Java processes for. If not provided, uses the current user.
@@ -73,19 +205,139 @@ jps options:
   -v                      Show JVM arguments.
   -m                      Show main method arguments.
   -q                      Only show process id.
+  -o <format>             Specify the output format: text, json, ndjson or tsv. Defaults to text.
+  -containers             Also list the Java processes of every user in every container, by host pid.
+  -all-users              List the Java processes of every user in one pass, showing the owner after the pid.
+  -watch                  Keep running and report Java processes as they start (+) and exit (-).
+                          Supports text and ndjson output.
 
 jattach options:
   -user <username>        Specify the user to attach to. If not provided, uses the current user.
-  -pid <pid>              Specify the pid of the Java process to attach to. (required)
-  -agentpath <path>       Specify the path to the Java agent jar. (required)
-  -agentparams <params>   Specify the parameters for the Java agent. (optional)
+  -pid <pid>[,<pid>...]   Specify the pid, or a comma separated list of pids, of the Java process to attach to.
+  -all                    Attach to every Java process of the user.
+  -main <name>            Attach to every Java process of the user whose main class or jar matches the name.
+  -concurrency <n>        Specify the maximum number of Java processes attached to at once on the host,
+                          shared by every jvmtool the user runs. Defaults to 16.
+  -jitter <duration>      Delay each attach by a random duration up to this, spreading the SIGQUITs. (optional)
+  -gc-gate <duration>     Wait up to this long for the target to finish a garbage collection before attaching. (optional)
+  -sensitive <name,...>   Attach to the Java processes whose main class or jar matches one of the names last,
+                          one at a time. (optional)
+  -trace                  Print how long each phase of the attach took.
+  -containers             With -all or -main, also attach to the Java processes running in containers.
+                          The agent jar is placed into each container from a cache keyed by its hash.
+  -agentpath <path>       Specify the path to the Java agent jar or native agent library (.so). (required)
+  -agentparams <params>   Specify the parameters for the Java agent, or the options of the native agent. (optional)
+  -o <format>             Specify the output format of the results: text or ndjson. Defaults to text.
+  One of -pid, -all or -main is required.
+
+jstat options:
+  -user <username>        Specify the user owning the Java process. If not provided, uses the current user.
+  -gcutil                 Show garbage collection statistics summary. (required)
+  -interval <duration>    Specify the sampling interval, e.g. 10ms. Defaults to 1s.
+  -count <n>              Specify the number of samples to take. Defaults to unlimited.
+  -buffer <n>             Specify the number of samples buffered between sampling and output. Defaults to 1024.
+  -t                      Show the JVM uptime as the first column.
+  <pid>                   The pid of the Java process to sample. (required)
+
+jcmd options:
+  -user <username>        Specify the user owning the Java process. If not provided, uses the current user.
+  <pid>                   The pid of the Java process. (required)
+  <command> [args...]     The diagnostic command and its arguments, e.g. VM.flags. (required)
+
+threads options:
+  -user <username>        Specify the user owning the Java process. If not provided, uses the current user.
+  -count <n>              Specify the number of thread dumps to take. Defaults to 1.
+  -interval <duration>    Specify the interval between thread dumps. Defaults to 1s.
+  -top <n>                Specify the number of stacks to show, 0 for all. Defaults to 10.
+  -depth <n>              Specify the number of frames to show per stack, 0 for all. Defaults to 16.
+  -l                      Also dump ownable synchronizers, which finds the owners of java.util.concurrent locks.
+  <pid>                   The pid of the Java process. (required)
+  With -count above 1, each stack shows how many dumps it was in and how many threads stayed on it in all of them.
+
+histo options:
+  -user <username>        Specify the user owning the Java process. If not provided, uses the current user.
+  -live                   Count only live objects. This triggers a full GC in the Java process.
+  -top <n>                Specify the number of classes to show. Defaults to 20.
+  -diff <duration>        Take two histograms this far apart and show the classes whose footprint grew the most.
+  <pid>                   The pid of the Java process. (required)
+
+flags options:
+  -user <username>        Specify the user owning the Java processes. If not provided, uses the current user.
+  -all                    Show every Java process of the user, queried concurrently.
+  -grep <text>            Only show the arguments, flags and properties containing the text.
+  -refresh                Attach even if the flags and properties of a Java process are cached.
+  -o <format>             Specify the output format: text or ndjson. Defaults to text.
+  <pid>                   The pid of the Java process, unless -all is given.
+  VM.flags and properties are cached by pid and start time, so a Java process is only attached to
+  the first time. Flags changed since with jcmd VM.set_flag are only shown with -refresh.
+
+profile options:
+  -user <username>        Specify the user owning the Java process. If not provided, uses the current user.
+  -lib <path>             Specify the path to libasyncProfiler.so. (required)
+  -event <event>          Specify the event to profile, e.g. cpu, alloc, lock or wall. Defaults to cpu.
+  -duration <duration>    Specify how long to profile for. Defaults to 30s; an interrupt stops early.
+  -interval <n>           Specify the sampling interval, in the event's units. (optional)
+  -o <file>               Write the collapsed stacks to the file instead of stdout.
+  <pid>                   The pid of the Java process. (required)
+
+serve options:
+  -socket <path>          Specify the unix socket to serve on, only accessible to the current user.
+                          Defaults to .jvmtool-serve-<uid>/jvmtool.sock in the temp directory.
+  Endpoints:
+    GET  /v1/jps?user=<username>
+    GET  /v1/perfdata/<pid>?user=<username>&prefix=<prefix>
+    POST /v1/jcmd/<pid>?user=<username>, with the command as the body
+    POST /v1/batch/<pid>?user=<username>, with one read-only attach command per line, e.g. "jcmd VM.flags" or "properties"
+    POST /v1/attach/<pid>?user=<username>&agentpath=<path>&agentparams=<params>
+    GET  /metrics, Prometheus metrics of every JVM on the host, in containers too, and of attach latencies
+
+record options:
+  -user <username>        Specify the user owning the Java processes. If not provided, uses the current user.
+  -all                    Record every Java process of the user, including those started later, one file each.
+  -interval <duration>    Specify the sampling interval. Defaults to 100ms.
+  -duration <duration>    Specify how long to record for. Defaults to until interrupted or the processes exit.
+  -o <path>               Specify the file to record to, or the directory with -all. (required)
+  <pid>                   The pid of the Java process to record, unless -all is given.
+
+replay options:
+  -gcutil                 Show garbage collection statistics summary. (required)
+  -t                      Show the JVM uptime as the first column.
+  <file>                  The recording to replay. (required)
+
+fleet options:
+  -hosts <file>           Specify a file with one ssh destination per line; # starts a comment. (required)
+  -concurrency <n>        Specify the number of hosts to run on at once. Defaults to 64.
+  -timeout <duration>     Specify the time allowed per host, 0 for none. Defaults to 1m.
+  -persist <duration>     Specify how long pooled ssh connections stay open after use, 0 to not pool. Defaults to 5m.
+  -ssh <path>             Specify the ssh client. Defaults to ssh.
+  -remote <path>          Specify the path of jvmtool on the hosts. Defaults to jvmtool.
+  -- <command> [args...]  The jvmtool command to run on every host. (required)
+  Lines of output are prefixed with the host. With -o ndjson, records get a "host" field instead,
+  and hosts that fail get an "error" event.
 
 Examples:
   jvmtool jps
   jvmtool jps -user alice
   jvmtool jps -l -v -m
+  jvmtool jps -o ndjson
+  jvmtool jps -watch -l
+  jvmtool jps -all-users
   jvmtool jattach -pid 12345 -agentpath /path/to/agent.jar
   jvmtool jattach -user alice -pid 12345 -agentpath /path/to/agent.jar -agentparams "foo=bar"
+  jvmtool jattach -main com.example.App -agentpath /path/to/agent.jar
+  jvmtool jattach -all -concurrency 4 -jitter 500ms -gc-gate 200ms -sensitive Trading -agentpath /path/to/agent.jar
+  jvmtool jstat -gcutil -interval 10ms 12345
+  jvmtool jcmd 12345 GC.heap_info
+  jvmtool threads -count 3 -interval 2s -l 12345
+  jvmtool histo -live -top 30 -diff 5m 12345
+  jvmtool flags -all -grep MaxHeapSize
+  jvmtool serve
+  curl --unix-socket /tmp/.jvmtool-serve-$(id -u)/jvmtool.sock http://localhost/v1/jps
+  jvmtool record -all -o /var/log/jvmtool
+  jvmtool replay -gcutil -t /var/log/jvmtool/12345-1700000000.jvmrec
+  jvmtool fleet -hosts hosts.txt -- jps -l -o ndjson
+  jvmtool fleet -hosts hosts.txt -concurrency 200 -timeout 2m -- jattach -main com.example.App -agentpath /opt/agent.jar -o ndjson
+  jvmtool profile -lib /opt/async-profiler/lib/libasyncProfiler.so -duration 30s -o cpu.collapsed 12345
 
 `)
 }
@@ -1,6 +1,10 @@
 package main
 
 import (
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"strings"
 	"testing"
 )
 
@@ -53,3 +57,48 @@ func TestRunJattach_InvalidArgs(t *testing.T) {
 		t.Errorf("expected exit code 1 for non-existent user, got %d", code)
 	}
 }
+
+// buildJvmtool builds the command into a temp dir, or skips without a go tool.
+func buildJvmtool(tb testing.TB) string {
+	tb.Helper()
+	goTool, err := exec.LookPath("go")
+	if err != nil {
+		tb.Skip("go tool not found")
+	}
+	bin := filepath.Join(tb.TempDir(), "jvmtool")
+	if out, err := exec.Command(goTool, "build", "-o", bin, ".").CombinedOutput(); err != nil {
+		tb.Skipf("cannot build jvmtool: %v\n%s", err, out)
+	}
+	return bin
+}
+
+// TestColdStart_Deps tests that gopsutil, which pulls in a tree of platform
+// packages and runs ps on some systems, is linked only where there is no procfs
+// or sysctl to read processes from.
+func TestColdStart_Deps(t *testing.T) {
+	if runtime.GOOS != "linux" && runtime.GOOS != "darwin" {
+		t.Skip("gopsutil is the fallback on", runtime.GOOS)
+	}
+	goTool, err := exec.LookPath("go")
+	if err != nil {
+		t.Skip("go tool not found")
+	}
+	out, err := exec.Command(goTool, "list", "-deps", ".").Output()
+	if err != nil {
+		t.Skipf("cannot list dependencies: %v", err)
+	}
+	if strings.Contains(string(out), "gopsutil") {
+		t.Errorf("expected jvmtool not to depend on gopsutil on %s", runtime.GOOS)
+	}
+}
+
+// BenchmarkColdStart_JpsQuiet measures a whole jvmtool jps -q invocation, as run
+// from cron and health checks; the target is under 5ms per run.
+func BenchmarkColdStart_JpsQuiet(b *testing.B) {
+	bin := buildJvmtool(b)
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		// Exits with 1 when no Java process runs, which is as good a run.
+		exec.Command(bin, "jps", "-q").Run()
+	}
+}
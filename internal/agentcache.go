@@ -0,0 +1,73 @@
+package internal
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"sync"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// containerAgentDir is where agent jars are placed in the /tmp of a container.
+const containerAgentDir = ".jvmtool-agents"
+
+// agentCache is the per-host store agent jars are placed into containers from.
+var agentCache = &pkg.FileCache{Dir: defaultAgentCacheDir()}
+
+// defaultAgentCacheDir returns the user cache directory, or the temp dir if there is none.
+func defaultAgentCacheDir() string {
+	dir, err := os.UserCacheDir()
+	if err != nil {
+		dir = os.TempDir()
+	}
+	return filepath.Join(dir, "jvmtool", "agents")
+}
+
+// cachedAgent is the result of adding an agent jar to agentCache.
+type cachedAgent struct {
+	path string
+	err  error
+}
+
+// cachedAgents memoizes agentCache.Add by host path, so attaching to many
+// containers hashes and copies each jar once per run.
+var cachedAgents sync.Map // string -> func() cachedAgent
+
+// cacheAgent adds agentPath to agentCache once per run.
+func cacheAgent(agentPath string) (string, error) {
+	add, _ := cachedAgents.LoadOrStore(agentPath, sync.OnceValue(func() cachedAgent {
+		path, err := agentCache.Add(agentPath)
+		return cachedAgent{path, err}
+	}))
+	r := add.(func() cachedAgent)()
+	return r.path, r.err
+}
+
+// containerAgentPath makes agentPath visible to a JVM in another mount namespace
+// and returns the path the JVM sees it under. The jar is placed in the container's
+// /tmp keyed by its content hash, so it is only copied in when that content is not
+// there yet. JVMs in our namespace use agentPath as is.
+func (jp *JvmProcess) containerAgentPath(agentPath string) (string, error) {
+	if jp.root == "" {
+		return agentPath, nil
+	}
+	cached, err := cacheAgent(agentPath)
+	if err != nil {
+		return "", err
+	}
+	uid, err := pkg.ProcessUid(jp.Pid)
+	if err != nil {
+		return "", fmt.Errorf("java process does not exist, %v", jp.Pid)
+	}
+	root, dir, err := jp.attachRoot()
+	if err != nil {
+		return "", err
+	}
+	defer root.Close()
+	placed, err := agentCache.Place(cached, root, dir+containerAgentDir, uid)
+	if err != nil {
+		return "", err
+	}
+	return "/" + placed, nil
+}
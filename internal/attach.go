@@ -0,0 +1,329 @@
+package internal
+
+import (
+	"bufio"
+	"bytes"
+	"context"
+	"errors"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"sync"
+	"time"
+)
+
+// Commands understood by the HotSpot Attach Listener.
+// @see jdk/src/hotspot/share/services/attachListener.cpp
+const (
+	attachCmdLoad        = "load"
+	attachCmdJcmd        = "jcmd"
+	attachCmdThreadDump  = "threaddump"
+	attachCmdProperties  = "properties"
+	attachCmdInspectHeap = "inspectheap"
+	attachCmdSetFlag     = "setflag"
+	attachCmdPrintFlag   = "printflag"
+)
+
+const (
+	attachProtocolVersion = "1"
+	// attachMaxArgs is the number of arguments every request carries, empty ones included.
+	attachMaxArgs = 3
+)
+
+// attachOutput is the destination of attach command output.
+var attachOutput io.Writer = os.Stdout
+
+// attachSocketPath returns the path of the Attach Listener socket of pid.
+func attachSocketPath(pid int32) string {
+	return fmt.Sprintf("%s/.java_pid%d", os.TempDir(), pid)
+}
+
+// defaultAttachIOTimeout bounds each connect, write and read of an attach session.
+const defaultAttachIOTimeout = 30 * time.Second
+
+// AttachClient sends commands to the Attach Listener of a JVM.
+// The listener must already be running, see JvmProcess.checkSocket.
+//
+// Sessions run on non-blocking sockets registered with the runtime network
+// poller, so many sessions can be in flight without a thread each, and a wedged
+// JVM surfaces as a timeout instead of hanging the caller.
+type AttachClient struct {
+	Pid        int32
+	SocketPath string
+	// Timeout bounds every single connect, write and read; zero disables deadlines.
+	// Reads are bounded individually, so a long but steady response is not cut off.
+	Timeout time.Duration
+	// Trace, if set, records the connect, write and response phases.
+	Trace *AttachTrace
+}
+
+// NewAttachClient returns a client for the Attach Listener of pid.
+func NewAttachClient(pid int32) *AttachClient {
+	return &AttachClient{Pid: pid, SocketPath: attachSocketPath(pid), Timeout: defaultAttachIOTimeout}
+}
+
+// deadlineConn sets a fresh read deadline before every read of the connection.
+// Cancelling ctx expires the deadline once, which re-arming it would undo, so ctx
+// is checked after every re-arm.
+type deadlineConn struct {
+	net.Conn
+	ctx     context.Context
+	timeout time.Duration
+}
+
+func (c deadlineConn) Read(p []byte) (int, error) {
+	if c.timeout > 0 {
+		c.Conn.SetReadDeadline(time.Now().Add(c.timeout))
+	}
+	if err := c.ctx.Err(); err != nil {
+		return 0, err
+	}
+	return c.Conn.Read(p)
+}
+
+// attachBufferSize is the size of the pooled buffers attach responses are read through.
+const attachBufferSize = 32 * 1024
+
+// attachBufferPool holds the buffers attach responses are read through, so that
+// streaming a response of any size keeps a single fixed-size buffer alive.
+var attachBufferPool = sync.Pool{
+	New: func() any {
+		b := make([]byte, attachBufferSize)
+		return &b
+	},
+}
+
+// AttachResponse is the reply of the target JVM to a single command.
+// Code is the return code sent on the first line; reading yields the rest of the
+// output as it arrives. The response must be closed.
+type AttachResponse struct {
+	Code int
+
+	conn    io.ReadCloser
+	buf     *[]byte
+	pending []byte // output read together with the return code line
+	pid     int32
+}
+
+// newAttachResponse reads the return code line from conn. Bytes that arrive with
+// it are kept and handed out first by Read and WriteTo.
+func newAttachResponse(conn io.ReadCloser, pid int32) (*AttachResponse, error) {
+	r := &AttachResponse{conn: conn, buf: attachBufferPool.Get().(*[]byte), pid: pid}
+	buf := *r.buf
+	n := 0
+	for {
+		if i := bytes.IndexByte(buf[:n], '\n'); i >= 0 {
+			code, ok := parseAttachCode(buf[:i])
+			if !ok {
+				r.Close()
+				return nil, fmt.Errorf("invalid attach response from process %v: %q", pid, buf[:i])
+			}
+			r.Code = code
+			r.pending = buf[i+1 : n]
+			return r, nil
+		}
+		if n == len(buf) {
+			r.Close()
+			return nil, fmt.Errorf("invalid attach response from process %v: return code line too long", pid)
+		}
+		m, err := conn.Read(buf[n:])
+		n += m
+		if err == io.EOF && bytes.IndexByte(buf[:n], '\n') >= 0 {
+			continue
+		}
+		if err == io.EOF {
+			if n == 0 {
+				r.Close()
+				return nil, errors.New("target VM did not respond")
+			}
+			// A bare return code without a trailing newline.
+			code, ok := parseAttachCode(buf[:n])
+			if !ok {
+				r.Close()
+				return nil, fmt.Errorf("invalid attach response from process %v: %q", pid, buf[:n])
+			}
+			r.Code = code
+			return r, nil
+		}
+		if err != nil {
+			r.Close()
+			return nil, fmt.Errorf("failed to read attach response from process %v: %v", pid, err.Error())
+		}
+	}
+}
+
+// parseAttachCode parses a decimal return code, ignoring surrounding whitespace.
+func parseAttachCode(line []byte) (int, bool) {
+	line = bytes.TrimSpace(line)
+	if len(line) == 0 {
+		return 0, false
+	}
+	negative := line[0] == '-'
+	if negative {
+		line = line[1:]
+	}
+	if len(line) == 0 || len(line) > 9 {
+		return 0, false
+	}
+	code := 0
+	for _, b := range line {
+		if b < '0' || b > '9' {
+			return 0, false
+		}
+		code = code*10 + int(b-'0')
+	}
+	if negative {
+		code = -code
+	}
+	return code, true
+}
+
+// Read reads the command output following the return code.
+func (r *AttachResponse) Read(p []byte) (int, error) {
+	if len(r.pending) > 0 {
+		n := copy(p, r.pending)
+		r.pending = r.pending[n:]
+		return n, nil
+	}
+	n, err := r.conn.Read(p)
+	if err != nil && err != io.EOF {
+		err = fmt.Errorf("failed to read attach response from process %v: %v", r.pid, err.Error())
+	}
+	return n, err
+}
+
+// WriteTo streams the command output to w, see readAttachResponse.
+// It lets io.Copy use the pooled buffer instead of allocating its own.
+func (r *AttachResponse) WriteTo(w io.Writer) (int64, error) {
+	var written int64
+	if len(r.pending) > 0 {
+		n, err := w.Write(r.pending)
+		written += int64(n)
+		r.pending = nil
+		if err != nil {
+			return written, err
+		}
+	}
+	n, err := readAttachResponse(r.conn, w, *r.buf, r.pid)
+	return written + n, err
+}
+
+// Close closes the connection to the target JVM and releases the buffer.
+func (r *AttachResponse) Close() error {
+	if r.buf != nil {
+		r.pending = nil
+		attachBufferPool.Put(r.buf)
+		r.buf = nil
+	}
+	return r.conn.Close()
+}
+
+// readAttachResponse copies the response from conn to w through buf until EOF.
+// Nothing beyond buf is held, so memory stays flat regardless of the response size.
+func readAttachResponse(conn io.Reader, w io.Writer, buf []byte, pid int32) (int64, error) {
+	var written int64
+	for {
+		n, err := conn.Read(buf)
+		if n > 0 {
+			m, werr := w.Write(buf[:n])
+			written += int64(m)
+			if werr != nil {
+				return written, werr
+			}
+		}
+		if err == io.EOF {
+			return written, nil
+		}
+		if err != nil {
+			return written, fmt.Errorf("failed to read attach response from process %v: %v", pid, err.Error())
+		}
+	}
+}
+
+// attachMaxLine bounds the lines of line oriented responses, such as thread dumps
+// and heap histograms, see readAttachLine.
+const attachMaxLine = 64 * 1024
+
+// readAttachLine reads the next line of a response through br, which must be at
+// least attachMaxLine large. A longer line is skipped and reported as too long.
+// The line is only valid until the next read.
+func readAttachLine(br *bufio.Reader) (line []byte, tooLong bool, err error) {
+	line, err = br.ReadSlice('\n')
+	tooLong = err == bufio.ErrBufferFull
+	for err == bufio.ErrBufferFull {
+		_, err = br.ReadSlice('\n')
+	}
+	return line, tooLong, err
+}
+
+// Execute sends cmd with up to three arguments and returns once the return code is read.
+// A non-zero Code is not an error; the output then usually explains the failure.
+func (c *AttachClient) Execute(cmd string, args ...string) (*AttachResponse, error) {
+	return c.ExecuteContext(context.Background(), cmd, args...)
+}
+
+// ExecuteContext is like Execute but aborts the session, including reads of the
+// returned response, once ctx is done.
+func (c *AttachClient) ExecuteContext(ctx context.Context, cmd string, args ...string) (*AttachResponse, error) {
+	request, err := buildAttachRequest(cmd, args)
+	if err != nil {
+		return nil, err
+	}
+
+	dialer := net.Dialer{Timeout: c.Timeout}
+	conn, err := dialer.DialContext(ctx, "unix", c.SocketPath)
+	if err != nil {
+		return nil, fmt.Errorf("failed to connect to target process %v: %v %w", c.Pid, c.SocketPath, err)
+	}
+	c.Trace.Done(PhaseConnect)
+	// Expire every pending and future operation on cancellation.
+	stop := context.AfterFunc(ctx, func() {
+		conn.SetDeadline(time.Now())
+	})
+
+	if c.Timeout > 0 {
+		conn.SetWriteDeadline(time.Now().Add(c.Timeout))
+	}
+	if _, err = conn.Write(request); err != nil {
+		stop()
+		conn.Close()
+		return nil, fmt.Errorf("failed to write attach request to process %v: %v", c.Pid, err.Error())
+	}
+	c.Trace.Done(PhaseWrite)
+
+	resp, err := newAttachResponse(stopConn{deadlineConn{conn, ctx, c.Timeout}, stop}, c.Pid)
+	c.Trace.Done(PhaseResponse)
+	return resp, err
+}
+
+// stopConn releases the cancellation hook of a session when it is closed.
+type stopConn struct {
+	deadlineConn
+	stop func() bool
+}
+
+func (c stopConn) Close() error {
+	c.stop()
+	return c.deadlineConn.Close()
+}
+
+// buildAttachRequest encodes a protocol version 1 request:
+// the version, the command and exactly three arguments, each NUL terminated.
+func buildAttachRequest(cmd string, args []string) ([]byte, error) {
+	if len(args) > attachMaxArgs {
+		return nil, fmt.Errorf("attach command %s takes at most %d arguments, got %d", cmd, attachMaxArgs, len(args))
+	}
+	request := make([]byte, 0, 64)
+	request = append(request, attachProtocolVersion...)
+	request = append(request, 0)
+	request = append(request, cmd...)
+	request = append(request, 0)
+	for i := 0; i < attachMaxArgs; i++ {
+		if i < len(args) {
+			request = append(request, args[i]...)
+		}
+		request = append(request, 0)
+	}
+	return request, nil
+}
@@ -0,0 +1,300 @@
+package internal
+
+import (
+	"bytes"
+	"context"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"testing/iotest"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// TestBuildAttachRequest tests encoding of attach requests.
+func TestBuildAttachRequest(t *testing.T) {
+	req, err := buildAttachRequest("jcmd", []string{"VM.flags"})
+	assert.Nil(t, err)
+	assert.Equal(t, "1\x00jcmd\x00VM.flags\x00\x00\x00", string(req))
+
+	_, err = buildAttachRequest("load", []string{"a", "b", "c", "d"})
+	assert.NotNil(t, err)
+}
+
+// TestAttachClient_Execute tests sending a command and streaming its response.
+func TestAttachClient_Execute(t *testing.T) {
+	pid := int32(os.Getpid())
+	var gotCmd string
+	var gotArgs []string
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		gotCmd, gotArgs = cmd, args
+		return "0\njava.version=21\nuser.name=test\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	resp, err := NewAttachClient(pid).Execute(attachCmdProperties)
+	if !assert.Nil(t, err) {
+		return
+	}
+	defer resp.Close()
+	out, err := io.ReadAll(resp)
+	assert.Nil(t, err)
+	assert.Equal(t, 0, resp.Code)
+	assert.Equal(t, "java.version=21\nuser.name=test\n", string(out))
+	assert.Equal(t, attachCmdProperties, gotCmd)
+	assert.Equal(t, []string{"", "", ""}, gotArgs)
+}
+
+// TestAttachClient_Errors tests failing return codes and unreachable listeners.
+func TestAttachClient_Errors(t *testing.T) {
+	pid := int32(os.Getpid())
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		if cmd == "noreply" {
+			return ""
+		}
+		return "1\nUnknown diagnostic command\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+
+	resp, err := NewAttachClient(pid).Execute(attachCmdJcmd, "Foo.bar")
+	if assert.Nil(t, err) {
+		out, _ := io.ReadAll(resp)
+		resp.Close()
+		assert.Equal(t, 1, resp.Code)
+		assert.True(t, strings.Contains(string(out), "Unknown diagnostic command"))
+	}
+	_, err = NewAttachClient(pid).Execute("noreply")
+	assert.EqualError(t, err, "target VM did not respond")
+
+	cleanup()
+	_, err = NewAttachClient(pid).Execute(attachCmdProperties)
+	assert.NotNil(t, err)
+}
+
+// TestLoadAgent_Response tests parsing of load command results.
+func TestLoadAgent_Response(t *testing.T) {
+	pid := int32(os.Getpid())
+	reply := ""
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		return reply
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	jp := JvmProcess{Pid: pid}
+	for _, tt := range []struct {
+		reply    string
+		expected string
+	}{
+		{"0\nreturn code: 0\n", ""},
+		{"0\n0\n", ""},
+		{"0\nreturn code: 102\n", "agent load failed, code 102: No agentmain method or agentmain failed"},
+		{"0\ncom.sun.tools.attach.AgentLoadException\n", "com.sun.tools.attach.AgentLoadException"},
+		{"0\n", "target VM did not respond"},
+		{"101\n", "agent load failed, return code: 101"},
+	} {
+		reply = tt.reply
+		err := jp.loadAgent("/tmp/agent.jar", "")
+		if tt.expected == "" {
+			assert.Nil(t, err)
+		} else {
+			assert.EqualError(t, err, tt.expected)
+		}
+	}
+}
+
+// TestNewAttachResponse_Incremental tests parsing the return code when it arrives in pieces.
+func TestNewAttachResponse_Incremental(t *testing.T) {
+	for _, tt := range []struct {
+		name   string
+		reader func(io.Reader) io.Reader
+	}{
+		{"one byte", iotest.OneByteReader},
+		{"data with eof", iotest.DataErrReader},
+	} {
+		t.Run(tt.name, func(t *testing.T) {
+			conn := io.NopCloser(tt.reader(strings.NewReader("-1\nfirst line\nsecond line\n")))
+			resp, err := newAttachResponse(conn, 1)
+			if !assert.Nil(t, err) {
+				return
+			}
+			defer resp.Close()
+			var out bytes.Buffer
+			_, err = io.Copy(&out, resp)
+			assert.Nil(t, err)
+			assert.Equal(t, -1, resp.Code)
+			assert.Equal(t, "first line\nsecond line\n", out.String())
+		})
+	}
+
+	resp, err := newAttachResponse(io.NopCloser(strings.NewReader("0")), 1)
+	if assert.Nil(t, err) {
+		assert.Equal(t, 0, resp.Code)
+		resp.Close()
+	}
+	_, err = newAttachResponse(io.NopCloser(strings.NewReader("abc\n")), 1)
+	assert.EqualError(t, err, `invalid attach response from process 1: "abc"`)
+	_, err = newAttachResponse(io.NopCloser(strings.NewReader("")), 1)
+	assert.EqualError(t, err, "target VM did not respond")
+}
+
+// TestAttachResponse_Streaming tests streaming a multi-MB response through the pooled buffer.
+func TestAttachResponse_Streaming(t *testing.T) {
+	pid := int32(os.Getpid())
+	body := strings.Repeat("\"worker-1\" #12 prio=5 os_prio=0 tid=0x1 nid=0x2 waiting on condition\n", 64*1024)
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		return "0\n" + body
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	resp, err := NewAttachClient(pid).Execute(attachCmdThreadDump)
+	if !assert.Nil(t, err) {
+		return
+	}
+	defer resp.Close()
+	var out bytes.Buffer
+	n, err := io.Copy(&out, resp)
+	assert.Nil(t, err)
+	assert.Equal(t, int64(len(body)), n)
+	assert.True(t, out.String() == body, "streamed body differs")
+}
+
+// TestAttachClient_Deadlines tests that a JVM that never answers surfaces as an error.
+func TestAttachClient_Deadlines(t *testing.T) {
+	pid := int32(os.Getpid())
+	wedged := make(chan struct{})
+	defer close(wedged)
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		<-wedged
+		return ""
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	client := NewAttachClient(pid)
+	client.Timeout = 50 * time.Millisecond
+	start := time.Now()
+	_, err = client.Execute(attachCmdProperties)
+	assert.NotNil(t, err)
+	assert.Less(t, time.Since(start), 5*time.Second)
+
+	client.Timeout = 0
+	ctx, cancel := context.WithTimeout(context.Background(), 50*time.Millisecond)
+	defer cancel()
+	start = time.Now()
+	_, err = client.ExecuteContext(ctx, attachCmdProperties)
+	assert.NotNil(t, err)
+	assert.Less(t, time.Since(start), 5*time.Second)
+}
+
+// TestAttachResponse_Cancel tests that cancelling between reads of a response
+// ends it although every read re-arms the read deadline.
+func TestAttachResponse_Cancel(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "socket")
+	l, err := net.Listen("unix", path)
+	if err != nil {
+		t.Fatalf("failed to listen: %v", err)
+	}
+	defer l.Close()
+	done := make(chan struct{})
+	defer close(done)
+	go func() {
+		conn, err := l.Accept()
+		if err != nil {
+			return
+		}
+		defer conn.Close()
+		conn.Write([]byte("0\npartial output\n"))
+		<-done
+	}()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	client := &AttachClient{Pid: 1, SocketPath: path, Timeout: 10 * time.Second}
+	resp, err := client.ExecuteContext(ctx, attachCmdThreadDump)
+	if !assert.Nil(t, err) {
+		return
+	}
+	defer resp.Close()
+	cancel()
+	// Let the cancellation expire the deadline before the next read re-arms it.
+	time.Sleep(10 * time.Millisecond)
+	start := time.Now()
+	_, err = io.ReadAll(resp)
+	assert.EqualError(t, err, "failed to read attach response from process 1: context canceled")
+	assert.Less(t, time.Since(start), time.Second)
+}
+
+// TestAttachClient_Concurrent tests many sessions in flight at once.
+func TestAttachClient_Concurrent(t *testing.T) {
+	pid := int32(os.Getpid())
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		time.Sleep(10 * time.Millisecond)
+		return "0\n" + args[0] + "\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	const sessions = 200
+	errs := make(chan error, sessions)
+	for i := 0; i < sessions; i++ {
+		go func(i int) {
+			resp, err := NewAttachClient(pid).Execute(attachCmdJcmd, strconv.Itoa(i))
+			if err != nil {
+				errs <- err
+				return
+			}
+			defer resp.Close()
+			out, err := io.ReadAll(resp)
+			if err == nil && string(out) != strconv.Itoa(i)+"\n" {
+				err = fmt.Errorf("session %d got %q", i, out)
+			}
+			errs <- err
+		}(i)
+	}
+	for i := 0; i < sessions; i++ {
+		assert.Nil(t, <-errs)
+	}
+}
+
+// BenchmarkReadAttachResponse measures streaming multi-MB responses, such as thread
+// dumps and class histograms, through a pooled buffer.
+func BenchmarkReadAttachResponse(b *testing.B) {
+	for _, size := range []int{1 << 20, 8 << 20, 64 << 20} {
+		b.Run(strconv.Itoa(size>>20)+"MB", func(b *testing.B) {
+			payload := bytes.Repeat([]byte("\"main\" #1 prio=5 os_prio=0 tid=0x1 nid=0x2 runnable\n"), size/52+1)[:size]
+			r := bytes.NewReader(payload)
+			buf := attachBufferPool.Get().(*[]byte)
+			defer attachBufferPool.Put(buf)
+			b.ReportAllocs()
+			b.SetBytes(int64(size))
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				r.Reset(payload)
+				if _, err := readAttachResponse(r, io.Discard, *buf, 1); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
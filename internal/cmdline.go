@@ -0,0 +1,369 @@
+package internal
+
+import (
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"syscall"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// javaCommand is a java launcher command line split into the parts jps shows.
+// Main and MainArgs are substrings of the command line, and so is VMArgs unless
+// a class path option splits the JVM options in two. Names read from an argfile
+// are the exception, as they never were on the command line.
+type javaCommand struct {
+	Main     string // main class, jar, module[/class] or source file
+	VMArgs   string // launcher and JVM options, without the class path
+	MainArgs string // arguments passed to the main method
+}
+
+// javaValueOptions are the launcher options whose value is the next argument. All
+// of them are long options or a single letter.
+// jdk/src/java.base/share/native/libjli/args.c
+var javaValueOptions = map[string]bool{
+	"-p": true, "--module-path": true, "--upgrade-module-path": true,
+	"--add-modules": true, "--limit-modules": true, "--enable-native-access": true,
+	"--add-exports": true, "--add-opens": true, "--add-reads": true, "--patch-module": true,
+	"-d": true, "--describe-module": true, "--source": true,
+}
+
+// isClassPathOption reports whether arg sets the class path, whose value jps leaves out.
+func isClassPathOption(arg string) bool {
+	return arg == "-cp" || arg == "-classpath" || arg == "--class-path"
+}
+
+// argSpan is the byte range [start, end) of some arguments in the command line.
+type argSpan struct{ start, end int }
+
+// vmArgSpans is the number of runs of JVM options tracked without allocating.
+// More runs only happen with several class path options.
+const vmArgSpans = 4
+
+// javaCommandParser walks the arguments of a command line once. Arguments and
+// runs of JVM options are tracked as offsets into line, so nothing is copied.
+type javaCommandParser struct {
+	line    string
+	args    []string
+	argFile func(path string) []string
+
+	cmd       javaCommand
+	spans     [vmArgSpans]argSpan
+	nspans    int
+	more      []argSpan // runs past spans
+	skipValue bool      // the next argument is the value of a shown option
+	dropValue bool      // the next argument is the class path
+	mainNext  bool      // the next argument is the main jar or module
+	noArgFile bool      // --disable-@files was given
+	done      bool
+}
+
+// parseJavaCommand splits the java launcher command line into its parts. line must
+// be args joined by single spaces, as pkg.Cmdline holds it; args[0] is the launcher.
+// argFile returns the arguments of an @argfile, or nil if it cannot be read; a nil
+// argFile leaves @argfiles unexpanded.
+//
+// No allocation is made unless the JVM options have to be joined around class path
+// options, in more than vmArgSpans runs, or an argfile is read.
+func parseJavaCommand(line string, args []string, argFile func(path string) []string) javaCommand {
+	if len(args) < 2 {
+		return javaCommand{}
+	}
+	n := len(args) - 1
+	for _, arg := range args {
+		n += len(arg)
+	}
+	if n != len(line) {
+		line = strings.Join(args, " ")
+	}
+	p := javaCommandParser{line: line, args: args, argFile: argFile}
+	off := len(args[0]) + 1
+	for i := 1; i < len(args) && !p.done; i++ {
+		arg := args[i]
+		p.step(arg, argSpan{off, off + len(arg)}, i)
+		off += len(arg) + 1
+	}
+	p.cmd.VMArgs = p.vmArgs()
+	return p.cmd
+}
+
+// step processes the argument args[i] found at span of the command line.
+func (p *javaCommandParser) step(arg string, span argSpan, i int) {
+	if p.consume(arg) {
+		if !p.done && !p.dropValue {
+			p.addVMArg(span)
+		}
+		p.dropValue = false
+		if p.done {
+			p.cmd.MainArgs = p.restAfter(span)
+		}
+		return
+	}
+	if strings.HasPrefix(arg, "@") && !p.noArgFile && p.argFile != nil {
+		if expanded := p.argFile(arg[1:]); expanded != nil {
+			p.addVMArg(span)
+			p.expand(expanded, i)
+			return
+		}
+	}
+	if p.option(arg) {
+		p.addVMArg(span)
+	}
+	if p.done {
+		p.cmd.MainArgs = p.restAfter(span)
+	}
+}
+
+// consume handles an argument that is the value of the previous one, and reports
+// whether arg was one. It sets done when arg is the main jar or module.
+func (p *javaCommandParser) consume(arg string) bool {
+	switch {
+	case p.mainNext:
+		p.cmd.Main, p.mainNext, p.done = arg, false, true
+		return true
+	case p.skipValue:
+		p.skipValue = false
+		return true
+	case p.dropValue:
+		return true
+	}
+	return false
+}
+
+// option handles an argument that is not a value and reports whether it is
+// shown as a JVM option. It sets done when arg is the main class or source file.
+func (p *javaCommandParser) option(arg string) bool {
+	switch {
+	case arg == "-jar" || arg == "-m" || arg == "--module":
+		p.mainNext = true
+		return false
+	case strings.HasPrefix(arg, "--module="):
+		p.cmd.Main, p.done = arg[len("--module="):], true
+		return false
+	case isClassPathOption(arg):
+		p.dropValue = true
+		return false
+	case strings.HasPrefix(arg, "--class-path="):
+		return false
+	case arg == "--disable-@files":
+		p.noArgFile = true
+		return true
+	case strings.HasPrefix(arg, "@") && !p.noArgFile:
+		// An argfile that could not be read.
+		return true
+	case (len(arg) <= 2 || arg[1] == '-') && javaValueOptions[arg]:
+		p.skipValue = true
+		return true
+	case strings.HasPrefix(arg, "-"):
+		// Includes -XX:Flags= and -XX:VMOptionsFile=, whose files hold JVM flags
+		// only and are read by the JVM rather than the launcher.
+		return true
+	}
+	p.cmd.Main, p.done = arg, true
+	return false
+}
+
+// expand runs the arguments of the argfile passed as args[i] through the parser.
+// The argfile itself is shown as a JVM option, as the launcher was given it. If the
+// main class is in the argfile, the main arguments are its remaining arguments
+// followed by those after it on the command line.
+func (p *javaCommandParser) expand(expanded []string, i int) {
+	for j, arg := range expanded {
+		if p.consume(arg) {
+			p.dropValue = false
+		} else {
+			p.option(arg)
+		}
+		if p.done {
+			// The main name is copied out of the argfile contents.
+			p.cmd.Main = strings.Clone(p.cmd.Main)
+			rest := append(expanded[j+1:len(expanded):len(expanded)], p.args[i+1:]...)
+			p.cmd.MainArgs = strings.Join(rest, " ")
+			return
+		}
+	}
+}
+
+// addVMArg extends the last run of JVM options with span, or starts a new run.
+func (p *javaCommandParser) addVMArg(span argSpan) {
+	last := &p.spans[max(p.nspans-1, 0)]
+	if n := len(p.more); n > 0 {
+		last = &p.more[n-1]
+	}
+	switch {
+	case p.nspans > 0 && last.end+1 == span.start:
+		last.end = span.end
+	case p.nspans < vmArgSpans:
+		p.spans[p.nspans] = span
+		p.nspans++
+	default:
+		p.more = append(p.more, span)
+	}
+}
+
+// restAfter returns the arguments after span as one substring of the command line.
+func (p *javaCommandParser) restAfter(span argSpan) string {
+	if span.end+1 >= len(p.line) {
+		return ""
+	}
+	return p.line[span.end+1:]
+}
+
+// vmArgs returns the JVM options, a substring of the command line if they form one run.
+func (p *javaCommandParser) vmArgs() string {
+	switch {
+	case p.nspans == 0:
+		return ""
+	case p.nspans == 1:
+		return p.line[p.spans[0].start:p.spans[0].end]
+	}
+	n := -1
+	for _, runs := range [2][]argSpan{p.spans[:p.nspans], p.more} {
+		for _, s := range runs {
+			n += s.end - s.start + 1
+		}
+	}
+	var b strings.Builder
+	b.Grow(n)
+	for _, runs := range [2][]argSpan{p.spans[:p.nspans], p.more} {
+		for _, s := range runs {
+			if b.Len() > 0 {
+				b.WriteByte(' ')
+			}
+			b.WriteString(p.line[s.start:s.end])
+		}
+	}
+	return b.String()
+}
+
+// maxArgFileSize bounds the argfiles read, the launcher itself has no limit.
+const maxArgFileSize = 1 << 20
+
+// processArgFile returns a function reading the argfiles of a process. Relative
+// paths are resolved against the working directory of the process and absolute
+// ones against root, the filesystem of a container JVM or "" for our own.
+//
+// We may be reading the command lines of other users, so an argfile is resolved
+// below that directory without following symlinks, and only read if the user of
+// the process could read it too; otherwise it stays unexpanded.
+func processArgFile(pid int32, root string) func(path string) []string {
+	uid := sync.OnceValues(func() (int, error) { return pkg.ProcessUid(pid) })
+	return func(path string) []string {
+		dir := fmt.Sprintf("/proc/%d/cwd", pid)
+		if filepath.IsAbs(path) {
+			dir = root
+			if dir == "" {
+				dir = "/"
+			}
+		}
+		r, err := pkg.OpenRoot(dir)
+		if err != nil {
+			return nil
+		}
+		defer r.Close()
+		f, err := r.OpenFile(path, os.O_RDONLY, 0)
+		if err != nil {
+			return nil
+		}
+		defer f.Close()
+		fi, err := f.Stat()
+		if err != nil || !fi.Mode().IsRegular() {
+			return nil
+		}
+		if uid, err := uid(); err != nil || !argFileReadable(fi, uid) {
+			return nil
+		}
+		data, err := io.ReadAll(io.LimitReader(f, maxArgFileSize+1))
+		if err != nil || len(data) > maxArgFileSize {
+			return nil
+		}
+		return splitArgFile(data)
+	}
+}
+
+// argFileReadable reports whether uid can read the file by its owner or other
+// bits. Group bits are not relied on, the groups of the process being unknown.
+func argFileReadable(fi os.FileInfo, uid int) bool {
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !ok {
+		return false
+	}
+	perm := fi.Mode().Perm()
+	return uid == 0 || perm&0004 != 0 || int(st.Uid) == uid && perm&0400 != 0
+}
+
+// splitArgFile splits the contents of an @argfile into arguments. Arguments are
+// separated by white space, may be quoted with ' or ", inside of which \ escapes
+// the next character, and a # outside of an argument comments out the line.
+// jdk/src/java.base/share/native/libjli/args.c
+func splitArgFile(data []byte) []string {
+	args := []string{}
+	var cur []byte
+	inArg := false
+	for i := 0; i < len(data); i++ {
+		c := data[i]
+		switch {
+		case c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f':
+			if inArg {
+				args = append(args, string(cur))
+				cur, inArg = cur[:0], false
+			}
+		case c == '#' && !inArg:
+			for i < len(data) && data[i] != '\n' && data[i] != '\r' {
+				i++
+			}
+		case c == '"' || c == '\'':
+			inArg = true
+			quote := c
+			for i++; i < len(data) && data[i] != quote; i++ {
+				if data[i] != '\\' || i+1 == len(data) {
+					cur = append(cur, data[i])
+					continue
+				}
+				i++
+				switch data[i] {
+				case 'n':
+					cur = append(cur, '\n')
+				case 't':
+					cur = append(cur, '\t')
+				case 'r':
+					cur = append(cur, '\r')
+				case 'f':
+					cur = append(cur, '\f')
+				case '\n', '\r':
+					// A line continuation drops the new line and the leading white space.
+					for i+1 < len(data) && strings.IndexByte(" \t\n\r\f", data[i+1]) >= 0 {
+						i++
+					}
+				default:
+					cur = append(cur, data[i])
+				}
+			}
+		default:
+			inArg = true
+			cur = append(cur, c)
+		}
+	}
+	if inArg {
+		args = append(args, string(cur))
+	}
+	return args
+}
+
+// analyzeVmCmd returns the main class or jar, JVM arguments and main arguments of
+// the command line of the process, reading its @argfiles through argFile.
+func analyzeVmCmd(line string, args []string, option JpsOption, argFile func(path string) []string) (mainClassOrJar string, vmArgs string, mainArgs string) {
+	cmd := parseJavaCommand(line, args, argFile)
+	mainClassOrJar = cmd.Main
+	if option.ShowVMArgs {
+		vmArgs = cmd.VMArgs
+	}
+	if option.ShowArgs {
+		mainArgs = cmd.MainArgs
+	}
+	return
+}
@@ -0,0 +1,222 @@
+package internal
+
+import (
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"unicode/utf8"
+)
+
+// parseLine parses a command line given with spaces between its arguments.
+func parseLine(line string, argFile func(string) []string) javaCommand {
+	return parseJavaCommand(line, strings.Split(line, " "), argFile)
+}
+
+// TestParseJavaCommand tests the launch forms of the java launcher.
+func TestParseJavaCommand(t *testing.T) {
+	files := map[string][]string{
+		"cp.txt":   {"-cp", "/lib/a.jar:/lib/b.jar", "-Xss1m"},
+		"main.txt": {"-Xmx1g", "com.example.Main", "--from-file"},
+		"jar.txt":  {"-jar"},
+	}
+	argFile := func(path string) []string { return files[path] }
+	tests := []struct {
+		line string
+		want javaCommand
+	}{
+		{"java", javaCommand{}},
+		{"java com.example.App", javaCommand{Main: "com.example.App"}},
+		{"java -Xmx1g -Dfoo=bar com.example.App --port 8080", javaCommand{Main: "com.example.App", VMArgs: "-Xmx1g -Dfoo=bar", MainArgs: "--port 8080"}},
+		{"java -cp /lib/a.jar -Xmx1g com.example.App a", javaCommand{Main: "com.example.App", VMArgs: "-Xmx1g", MainArgs: "a"}},
+		{"java -Xmx1g -classpath /lib -Xss1m --class-path=/x App", javaCommand{Main: "App", VMArgs: "-Xmx1g -Xss1m"}},
+		{"java -Xmx1g -jar /opt/app.jar -Dnot.vm=1 arg", javaCommand{Main: "/opt/app.jar", VMArgs: "-Xmx1g", MainArgs: "-Dnot.vm=1 arg"}},
+		{"java -jar", javaCommand{}},
+		{"java --module-path /mods -m app/com.example.Main x", javaCommand{Main: "app/com.example.Main", VMArgs: "--module-path /mods", MainArgs: "x"}},
+		{"java -p /mods --add-modules a,b --module app", javaCommand{Main: "app", VMArgs: "-p /mods --add-modules a,b"}},
+		{"java --module=app/com.example.Main -v", javaCommand{Main: "app/com.example.Main", MainArgs: "-v"}},
+		{"java -XX:Flags=/etc/.hotspotrc -XX:VMOptionsFile=/etc/jvm.opts com.example.App", javaCommand{Main: "com.example.App", VMArgs: "-XX:Flags=/etc/.hotspotrc -XX:VMOptionsFile=/etc/jvm.opts"}},
+		{"java --source 21 Hello.java arg", javaCommand{Main: "Hello.java", VMArgs: "--source 21", MainArgs: "arg"}},
+		{"java @cp.txt com.example.App a", javaCommand{Main: "com.example.App", VMArgs: "@cp.txt", MainArgs: "a"}},
+		{"java -Xms1g @main.txt b", javaCommand{Main: "com.example.Main", VMArgs: "-Xms1g @main.txt", MainArgs: "--from-file b"}},
+		{"java @jar.txt /opt/app.jar a", javaCommand{Main: "/opt/app.jar", VMArgs: "@jar.txt", MainArgs: "a"}},
+		{"java @missing.txt App", javaCommand{Main: "App", VMArgs: "@missing.txt"}},
+		{"java --disable-@files @main.txt", javaCommand{Main: "@main.txt", VMArgs: "--disable-@files"}},
+		{"java -cp a -D1 -cp b -D2 -cp c -D3 -cp d -D4 -cp e -D5 App", javaCommand{Main: "App", VMArgs: "-D1 -D2 -D3 -D4 -D5"}},
+	}
+	for _, tt := range tests {
+		if got := parseLine(tt.line, argFile); got != tt.want {
+			t.Errorf("%q: expected %+v, got %+v", tt.line, tt.want, got)
+		}
+	}
+}
+
+// TestParseJavaCommand_Split tests that a line not joined from args is rebuilt from them.
+func TestParseJavaCommand_Split(t *testing.T) {
+	got := parseJavaCommand("", []string{"java", "-Xmx1g", "App", "a b"}, nil)
+	want := javaCommand{Main: "App", VMArgs: "-Xmx1g", MainArgs: "a b"}
+	if got != want {
+		t.Errorf("expected %+v, got %+v", want, got)
+	}
+}
+
+// TestParseJavaCommand_Allocs tests that command lines without argfiles are split without allocating.
+func TestParseJavaCommand_Allocs(t *testing.T) {
+	for _, line := range []string{longJavaCommand("-jar /opt/app.jar --server.port=8080"), longJavaCommand("com.example.App a b")} {
+		line = "java -cp /lib/a.jar:/lib/b.jar " + line[len("java "):]
+		args := strings.Split(line, " ")
+		allocs := testing.AllocsPerRun(100, func() {
+			parseJavaCommand(line, args, nil)
+		})
+		if allocs != 0 {
+			t.Errorf("expected no allocations, got %v", allocs)
+		}
+	}
+}
+
+// TestSplitArgFile tests the quoting, escape and comment rules of argfiles.
+func TestSplitArgFile(t *testing.T) {
+	data := "# comment\n-cp \"/a b/c.jar\"  -Dx='it''s'\t\n-Dy=\"1\\t2\\\\\" \"con\\\n    tinued\" #tail\nMain"
+	want := []string{"-cp", "/a b/c.jar", "-Dx=its", "-Dy=1\t2\\", "continued", "Main"}
+	got := splitArgFile([]byte(data))
+	if strings.Join(got, "|") != strings.Join(want, "|") {
+		t.Errorf("expected %q, got %q", want, got)
+	}
+}
+
+// TestProcessArgFile tests that relative argfiles are read from the working directory of the process.
+func TestProcessArgFile(t *testing.T) {
+	dir := t.TempDir()
+	os.WriteFile(filepath.Join(dir, "args.txt"), []byte("-Xmx1g App"), 0644)
+	read := processArgFile(int32(os.Getpid()), dir)
+	if got := read("/args.txt"); strings.Join(got, " ") != "-Xmx1g App" {
+		t.Errorf("expected the argfile under root, got %q", got)
+	}
+	if got := read("/missing.txt"); got != nil {
+		t.Errorf("expected nil for a missing argfile, got %q", got)
+	}
+	secret := filepath.Join(t.TempDir(), "secret")
+	os.WriteFile(secret, []byte("-Dsecret"), 0600)
+	os.Symlink(secret, filepath.Join(dir, "link.txt"))
+	if got := read("/link.txt"); got != nil {
+		t.Errorf("expected a symlinked argfile not to be followed, got %q", got)
+	}
+	if got := read("/../" + filepath.Base(dir) + "/args.txt"); got != nil {
+		t.Errorf("expected an argfile outside root to be refused, got %q", got)
+	}
+	if _, err := os.Stat("/proc/self/cwd"); err != nil {
+		t.Skip("no procfs")
+	}
+	wd, _ := os.Getwd()
+	defer os.Chdir(wd)
+	os.Chdir(dir)
+	if got := read("args.txt"); strings.Join(got, " ") != "-Xmx1g App" {
+		t.Errorf("expected the argfile in the working directory, got %q", got)
+	}
+}
+
+// TestArgFileReadable tests that argfiles are only read for a user who could read them.
+func TestArgFileReadable(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "args.txt")
+	os.WriteFile(path, nil, 0600)
+	fi, _ := os.Stat(path)
+	other := os.Getuid() + 1
+	if !argFileReadable(fi, os.Getuid()) {
+		t.Error("expected the owner to read the argfile")
+	}
+	if argFileReadable(fi, other) {
+		t.Error("expected another user not to read a private argfile")
+	}
+	os.Chmod(path, 0604)
+	fi, _ = os.Stat(path)
+	if !argFileReadable(fi, other) {
+		t.Error("expected another user to read a world readable argfile")
+	}
+	if !argFileReadable(fi, 0) {
+		t.Error("expected root to read any argfile")
+	}
+}
+
+// longJavaCommand returns a command line with 400 -D flags, as Spring services have, followed by tail.
+func longJavaCommand(tail string) string {
+	var b strings.Builder
+	b.WriteString("java -Xmx4g")
+	for i := 0; i < 400; i++ {
+		b.WriteString(" -Dspring.property.number")
+		b.WriteByte(byte('a' + i%26))
+		b.WriteString("=value")
+	}
+	b.WriteString(" " + tail)
+	return b.String()
+}
+
+// classPathJavaCommand returns a command line with a class path of 300 jars, as
+// IDEs and build tools launch applications with.
+func classPathJavaCommand() string {
+	jars := make([]string, 300)
+	for i := range jars {
+		jars[i] = "/home/user/.m2/repository/org/example/lib" + strconv.Itoa(i) + "/1.0/lib" + strconv.Itoa(i) + "-1.0.jar"
+	}
+	return "java -Xmx1g -Dfile.encoding=UTF-8 -classpath " + strings.Join(jars, ":") + " -Xss1m com.example.App --spring.profiles.active=dev"
+}
+
+// BenchmarkAnalyzeVmCmd measures splitting realistic large command lines.
+func BenchmarkAnalyzeVmCmd(b *testing.B) {
+	option := JpsOption{ShowLong: true, ShowVMArgs: true, ShowArgs: true}
+	benchmarks := []struct {
+		name string
+		line string
+	}{
+		{"spring-jar", longJavaCommand("-jar /opt/app.jar --server.port=8080")},
+		{"spring-classpath", longJavaCommand("-cp /lib/a.jar:/lib/b.jar -Xss1m com.example.App a b")},
+		{"ide-classpath", classPathJavaCommand()},
+		{"module", longJavaCommand("--module-path /opt/mods --add-modules ALL-MODULE-PATH -m app/com.example.Main")},
+	}
+	for _, bm := range benchmarks {
+		b.Run(bm.name, func(b *testing.B) {
+			args := strings.Split(bm.line, " ")
+			b.ReportAllocs()
+			b.SetBytes(int64(len(bm.line)))
+			for i := 0; i < b.N; i++ {
+				analyzeVmCmd(bm.line, args, option, nil)
+			}
+		})
+	}
+}
+
+// FuzzParseJavaCommand checks that any command line splits into parts of itself.
+func FuzzParseJavaCommand(f *testing.F) {
+	f.Add("java -Xmx1g -cp /lib com.example.App a")
+	f.Add("java -jar app.jar")
+	f.Add("java -p /mods -m app/Main x")
+	f.Add("java @args.txt Main")
+	f.Add("java --module=app -cp")
+	f.Fuzz(func(t *testing.T, line string) {
+		if !utf8.ValidString(line) {
+			return
+		}
+		args := strings.Split(line, " ")
+		// Argfile contents are not part of the command line, only check they parse.
+		parseJavaCommand(line, args, splitArgFileString)
+		cmd := parseJavaCommand(line, args, nil)
+		for _, part := range []string{cmd.Main, cmd.MainArgs} {
+			if !strings.Contains(line, part) {
+				t.Fatalf("%q: %q is not part of the command line", line, part)
+			}
+		}
+		for _, arg := range strings.Fields(cmd.VMArgs) {
+			if !strings.Contains(line, arg) {
+				t.Fatalf("%q: JVM option %q is not part of the command line", line, arg)
+			}
+		}
+		if cmd.MainArgs != "" && !strings.HasSuffix(line, cmd.MainArgs) {
+			t.Fatalf("%q: main arguments %q do not end the command line", line, cmd.MainArgs)
+		}
+	})
+}
+
+// splitArgFileString treats the argfile name as its contents, with ',' between the arguments.
+func splitArgFileString(path string) []string {
+	return splitArgFile([]byte(strings.ReplaceAll(path, ",", " ")))
+}
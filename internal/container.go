@@ -0,0 +1,89 @@
+package internal
+
+import (
+	"path/filepath"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// containerMount is a mount namespace other than ours, reached through the root
+// of one of its processes.
+type containerMount struct {
+	root     string
+	hostPids map[int32]int32 // pid inside the namespace -> pid on the host
+}
+
+// listContainerPids finds the JVMs of every container from this one process: the
+// host pids are grouped by mount namespace, the /tmp of each namespace is read
+// through /proc/<pid>/root once, and every perfdata file found there is mapped
+// back to a host pid with NSpid. Files without a live process are dropped.
+func listContainerPids() []hsperfdataEntry {
+	pids, err := pkg.ListPids()
+	if err != nil {
+		return nil
+	}
+	spaces := make([]pkg.ProcessNamespace, len(pids))
+	pkg.ParallelFor(len(pids), 0, func(i int) {
+		spaces[i], _ = pkg.GetProcessNamespace(pids[i])
+	})
+
+	mounts := map[string]*containerMount{}
+	order := []*containerMount{}
+	for i, ns := range spaces {
+		if ns.MountID == "" || ns.Shared() {
+			continue
+		}
+		m := mounts[ns.MountID]
+		if m == nil {
+			m = &containerMount{root: ns.Root, hostPids: map[int32]int32{}}
+			mounts[ns.MountID] = m
+			order = append(order, m)
+		}
+		m.hostPids[ns.Pid] = pids[i]
+	}
+
+	perMount := make([][]hsperfdataEntry, len(order))
+	pkg.ParallelFor(len(order), 0, func(i int) {
+		perMount[i] = order[i].list()
+	})
+	entries := []hsperfdataEntry{}
+	for _, list := range perMount {
+		entries = append(entries, list...)
+	}
+	return entries
+}
+
+// list returns the JVMs with a perfdata file in the /tmp of the namespace, by host pid.
+func (m *containerMount) list() []hsperfdataEntry {
+	entries := []hsperfdataEntry{}
+	for _, e := range listAllUsersPids(filepath.Join(m.root, "tmp"), m.hostPid) {
+		hostPid, ok := m.hostPid(e.pid)
+		if !ok {
+			continue
+		}
+		e.root, e.nsPid, e.pid = m.root, e.pid, hostPid
+		entries = append(entries, e)
+	}
+	return entries
+}
+
+// hostPid returns the host pid of the process with the given pid in the namespace.
+func (m *containerMount) hostPid(pid int32) (int32, bool) {
+	hostPid, ok := m.hostPids[pid]
+	return hostPid, ok
+}
+
+// appendContainerPids appends the container entries whose host pid is not listed yet.
+func appendContainerPids(entries, containers []hsperfdataEntry) []hsperfdataEntry {
+	seen := make(map[int32]bool, len(entries))
+	for _, e := range entries {
+		seen[e.pid] = true
+	}
+	for _, e := range containers {
+		if !seen[e.pid] {
+			seen[e.pid] = true
+			entries = append(entries, e)
+		}
+	}
+	return entries
+}
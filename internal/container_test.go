@@ -0,0 +1,80 @@
+package internal
+
+import (
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// TestContainerMount_List tests that perfdata files in a container map to host pids.
+func TestContainerMount_List(t *testing.T) {
+	root := t.TempDir()
+	dir := filepath.Join(root, "tmp", "hsperfdata_app")
+	os.MkdirAll(dir, 0755)
+	os.WriteFile(filepath.Join(dir, "1"), nil, 0644)
+	os.WriteFile(filepath.Join(dir, "7"), nil, 0644) // stale, no process
+
+	m := &containerMount{root: root, hostPids: map[int32]int32{1: 4242, 2: 4243}}
+	entries := m.list()
+	assert.Equal(t, []hsperfdataEntry{{pid: 4242, user: "app", root: root, nsPid: 1}}, entries)
+
+	merged := appendContainerPids([]hsperfdataEntry{{pid: 4242, user: "host"}}, append(entries, hsperfdataEntry{pid: 5000, nsPid: 1}))
+	assert.Equal(t, 2, len(merged))
+	assert.Equal(t, "host", merged[0].user)
+	assert.Equal(t, int32(5000), merged[1].pid)
+}
+
+// TestJvmProcess_ContainerAttach tests that a container JVM is attached to through its root.
+func TestJvmProcess_ContainerAttach(t *testing.T) {
+	root := t.TempDir()
+	os.MkdirAll(filepath.Join(root, "tmp"), 0755)
+	jp := &JvmProcess{Pid: int32(os.Getpid()), root: root, nsPid: 7}
+	assert.Equal(t, filepath.Join(root, "tmp", ".java_pid7"), jp.socketPath())
+
+	var gotArgs []string
+	cleanup, err := startMockAttachListenerAt(jp.socketPath(), func(cmd string, args []string) string {
+		gotArgs = args
+		return "0\n0\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	origDir := agentCache.Dir
+	agentCache.Dir = t.TempDir()
+	defer func() { agentCache.Dir = origDir }()
+	agentPath := filepath.Join(t.TempDir(), "agent.jar")
+	os.WriteFile(agentPath, []byte("agent"), 0644)
+
+	assert.Nil(t, jp.checkSocket())
+	assert.Nil(t, jp.loadAgent(agentPath, "foo=bar"))
+	if !assert.Len(t, gotArgs, 3) {
+		return
+	}
+	assert.Equal(t, []string{"instrument", "false"}, gotArgs[:2])
+	// The agent is placed in the container's /tmp and passed by its path in there.
+	placed, params, _ := strings.Cut(gotArgs[2], "=foo=")
+	assert.Equal(t, "bar", params)
+	assert.True(t, strings.HasPrefix(placed, "/tmp/"+containerAgentDir+"/"))
+	content, err := os.ReadFile(root + placed)
+	assert.Nil(t, err)
+	assert.Equal(t, "agent", string(content))
+
+	// A second attach finds the agent already in place.
+	again, err := jp.containerAgentPath(agentPath)
+	assert.Nil(t, err)
+	assert.Equal(t, placed, again)
+}
+
+// TestJvmProcess_Locate tests that a process in our namespace keeps the default paths.
+func TestJvmProcess_Locate(t *testing.T) {
+	jp := &JvmProcess{Pid: int32(os.Getpid())}
+	jp.locate()
+	assert.Equal(t, "", jp.root)
+	assert.Equal(t, jp.Pid, jp.nsPid)
+	assert.Equal(t, attachSocketPath(jp.Pid), jp.socketPath())
+}
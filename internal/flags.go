@@ -0,0 +1,515 @@
+package internal
+
+import (
+	"bufio"
+	"bytes"
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"syscall"
+	"unicode/utf16"
+	"unicode/utf8"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// flagsMaxOutput bounds the output of VM.flags and properties read from a JVM.
+const flagsMaxOutput = 4 << 20
+
+// flagsCacheVersion is the first line of a cache entry, changed with its layout.
+const flagsCacheVersion = "jvmtool-flags 1"
+
+// flagsCacheDir is where snapshots are cached, one file per JVM. Without a home
+// directory it lies in the shared temp dir, see openFlagsCache.
+var flagsCacheDir = filepath.Join(filepath.Dir(defaultAgentCacheDir()), "flags")
+
+// openFlagsCache opens flagsCacheDir, which must be a directory private to the
+// current user: an entry planted by someone else would be served as a snapshot.
+// Snapshots are not cached when it is not.
+func openFlagsCache() (*pkg.Root, error) {
+	if err := os.MkdirAll(filepath.Dir(flagsCacheDir), 0700); err != nil {
+		return nil, err
+	}
+	if err := os.Mkdir(flagsCacheDir, 0700); err != nil && !os.IsExist(err) {
+		return nil, err
+	}
+	link, err := os.Lstat(flagsCacheDir)
+	if err != nil {
+		return nil, err
+	}
+	root, err := pkg.OpenRoot(flagsCacheDir)
+	if err != nil {
+		return nil, err
+	}
+	// Checked through the opened directory too, so it cannot be swapped after the check.
+	fi, err := root.Lstat(".")
+	if err != nil {
+		root.Close()
+		return nil, err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !os.SameFile(link, fi) || !fi.IsDir() || fi.Mode().Perm() != 0700 || !ok || int(st.Uid) != os.Geteuid() {
+		root.Close()
+		return nil, fmt.Errorf("%s is not a private directory of the current user", flagsCacheDir)
+	}
+	return root, nil
+}
+
+type FlagsOption struct {
+	User    string
+	Pid     string
+	All     bool   // -all
+	Grep    string // -grep, only show the entries containing this
+	Refresh bool   // -refresh, attach even if the snapshot is cached
+	Output  string // -o, text or ndjson
+}
+
+// ParseFlagsFlags parses flags for the "flags" command and returns the corresponding FlagsOption.
+// The pid is taken from the first positional argument.
+func ParseFlagsFlags(args []string) (FlagsOption, error) {
+	flagsFlagSet := flag.NewFlagSet("flags", flag.ContinueOnError)
+	user := flagsFlagSet.String("user", "", "specify the user owning the Java processes")
+	all := flagsFlagSet.Bool("all", false, "snapshot every Java process of the user")
+	grep := flagsFlagSet.String("grep", "", "only show the arguments, flags and properties containing this")
+	refresh := flagsFlagSet.Bool("refresh", false, "attach even if the snapshot of a Java process is cached")
+	output := flagsFlagSet.String("o", jpsOutputText, "output format: text or ndjson")
+	if err := flagsFlagSet.Parse(args); err != nil {
+		return FlagsOption{}, err
+	}
+	return FlagsOption{
+		User:    *user,
+		Pid:     flagsFlagSet.Arg(0),
+		All:     *all,
+		Grep:    *grep,
+		Refresh: *refresh,
+		Output:  *output,
+	}, nil
+}
+
+// FlagsValidate validates the FlagsOption fields.
+func (opt *FlagsOption) FlagsValidate() error {
+	if opt.Output != "" && opt.Output != jpsOutputText && opt.Output != jpsOutputNDJSON {
+		return fmt.Errorf("unsupported output format: %s", opt.Output)
+	}
+	if opt.All == (opt.Pid != "") {
+		return errors.New("one of pid and -all is required")
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+	if opt.All {
+		return nil
+	}
+	if pid, err := strconv.Atoi(opt.Pid); err != nil || pid <= 0 {
+		return fmt.Errorf("invalid pid %s", opt.Pid)
+	}
+	return validateJvmPid(opt.User, toInt32(opt.Pid))
+}
+
+// Flags prints the JVM arguments, VM.flags and system properties of a Java process,
+// or with -all of every Java process of the user, queried concurrently. Flags and
+// properties are cached by pid and start time, so only JVMs started since the last
+// run are attached to; the arguments are read from the command line every time.
+func Flags(option FlagsOption) int {
+	if err := option.FlagsValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	var procs []JvmProcess
+	if option.All {
+		var anyAlive bool
+		procs, anyAlive = listJvmProcesses(JpsOption{User: option.User, ShowVMArgs: true, startTime: true})
+		if !anyAlive {
+			log("no java process")
+			return 1
+		}
+		pruneFlagsCache()
+	} else {
+		e := hsperfdataEntry{pid: toInt32(option.Pid), user: option.User}
+		if p := resolveJvmProcess(e, JpsOption{User: option.User, ShowVMArgs: true, startTime: true}); p != nil {
+			procs = []JvmProcess{*p}
+		} else {
+			procs = []JvmProcess{{Pid: e.pid}}
+		}
+	}
+
+	snapshots := make([]flagsSnapshot, len(procs))
+	pkg.ParallelFor(len(procs), defaultAttachConcurrency, func(i int) {
+		snapshots[i] = takeFlagsSnapshot(&procs[i], option)
+	})
+
+	w := bufio.NewWriter(attachOutput)
+	defer w.Flush()
+	code := 0
+	var buf []byte
+	for i := range snapshots {
+		s := &snapshots[i]
+		if s.err != nil {
+			code = 1
+			if option.Output != jpsOutputNDJSON {
+				log(fmt.Sprintf("%d: %v", s.process.Pid, s.err))
+			}
+		}
+		if option.Output == jpsOutputNDJSON {
+			buf = s.appendJSON(buf[:0], option.Grep)
+		} else {
+			buf = s.appendText(buf[:0], option.Grep)
+		}
+		w.Write(buf)
+	}
+	return code
+}
+
+// flagsSnapshot is the configuration of one JVM.
+type flagsSnapshot struct {
+	process    *JvmProcess
+	cached     bool
+	args       []string
+	flags      []string
+	properties [][2]string // sorted by key
+	err        error
+}
+
+// takeFlagsSnapshot returns the snapshot of p from the cache, or attaches to it and
+// caches the result.
+func takeFlagsSnapshot(p *JvmProcess, option FlagsOption) flagsSnapshot {
+	s := flagsSnapshot{process: p, args: strings.Fields(p.vmArgs)}
+	if p.resolveStartTime(); p.startTime == 0 {
+		s.err = fmt.Errorf("java process does not exist, %v", p.Pid)
+		return s
+	}
+	cache, err := openFlagsCache()
+	if err == nil {
+		defer cache.Close()
+	}
+	startId, err := pkg.ProcessStartId(p.Pid)
+	if err != nil {
+		s.err = fmt.Errorf("java process does not exist, %v", p.Pid)
+		return s
+	}
+	name := flagsCacheKey(p.Pid, startId)
+	if cache != nil && !option.Refresh {
+		if flags, props, err := readFlagsCache(cache, name); err == nil {
+			s.cached = true
+			s.flags, s.properties = parseVMFlags(flags), parseProperties(props)
+			return s
+		}
+	}
+
+	release, err := attachScheduler{concurrency: defaultAttachConcurrency}.admit(context.Background(), p, option.User)
+	if err != nil {
+		s.err = err
+		return s
+	}
+	defer release()
+	if err := p.checkSocket(); err != nil {
+		s.err = err
+		return s
+	}
+	flags, err := flagsAttachOutput(p, attachCmdJcmd, "VM.flags")
+	if err != nil {
+		s.err = err
+		return s
+	}
+	props, err := flagsAttachOutput(p, attachCmdProperties)
+	if err != nil {
+		s.err = err
+		return s
+	}
+	s.flags, s.properties = parseVMFlags(flags), parseProperties(props)
+	if cache != nil {
+		writeFlagsCache(cache, name, flags, props)
+	}
+	return s
+}
+
+// flagsAttachOutput runs an attach command and returns its output. Output over
+// flagsMaxOutput is an error rather than a snapshot cut short, which would be cached.
+func flagsAttachOutput(p *JvmProcess, cmd string, args ...string) ([]byte, error) {
+	resp, err := p.attachClient().Execute(cmd, args...)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Close()
+	out, err := io.ReadAll(io.LimitReader(resp, flagsMaxOutput+1))
+	if err != nil {
+		return nil, err
+	}
+	if len(out) > flagsMaxOutput {
+		return nil, fmt.Errorf("output of %s exceeds %d bytes", cmd, flagsMaxOutput)
+	}
+	if resp.Code != 0 {
+		return nil, fmt.Errorf("command %s failed, return code: %d", cmd, resp.Code)
+	}
+	return out, nil
+}
+
+// flagsCacheKey names the cache entry of a JVM after its pid and start id, see
+// pkg.ProcessStartId. A pid is reused only by a process started later, so the
+// entry of an exited JVM is never served to another. The start time in
+// milliseconds would not do: it follows the wall clock, which NTP may step.
+func flagsCacheKey(pid int32, startId string) string {
+	return strconv.Itoa(int(pid)) + "-" + startId
+}
+
+// readFlagsCache returns the VM.flags and properties output stored in a cache entry:
+// a version line with the size of each, followed by both.
+func readFlagsCache(cache *pkg.Root, name string) (flags, props []byte, err error) {
+	f, err := cache.OpenFile(name, os.O_RDONLY, 0)
+	if err != nil {
+		return nil, nil, err
+	}
+	defer f.Close()
+	data, err := io.ReadAll(io.LimitReader(f, 2*flagsMaxOutput+int64(len(flagsCacheVersion))+64))
+	if err != nil {
+		return nil, nil, err
+	}
+	header, rest, _ := bytes.Cut(data, []byte{'\n'})
+	fields := strings.Fields(string(header))
+	if len(fields) != 4 || strings.Join(fields[:2], " ") != flagsCacheVersion {
+		return nil, nil, errors.New("invalid flags cache entry")
+	}
+	n, err1 := strconv.Atoi(fields[2])
+	m, err2 := strconv.Atoi(fields[3])
+	if err1 != nil || err2 != nil || n < 0 || m < 0 || n+m != len(rest) {
+		return nil, nil, errors.New("invalid flags cache entry")
+	}
+	return rest[:n], rest[n:], nil
+}
+
+// writeFlagsCache stores a cache entry through a rename, so concurrent runs never
+// read a partial one. The cache is an optimization, so failures are ignored.
+func writeFlagsCache(cache *pkg.Root, name string, flags, props []byte) {
+	tmp, tmpName, err := cache.CreateTemp(".", ".tmp-"+name)
+	if err != nil {
+		return
+	}
+	defer cache.Remove(tmpName)
+	w := bufio.NewWriter(tmp)
+	fmt.Fprintf(w, "%s %d %d\n", flagsCacheVersion, len(flags), len(props))
+	w.Write(flags)
+	w.Write(props)
+	if err := w.Flush(); err != nil {
+		tmp.Close()
+		return
+	}
+	if tmp.Close() == nil {
+		cache.Rename(tmpName, name)
+	}
+}
+
+// pruneFlagsCache removes the entries of JVMs that exited, whose pid is gone or
+// belongs to a process started at another time.
+func pruneFlagsCache() {
+	cache, err := openFlagsCache()
+	if err != nil {
+		return
+	}
+	defer cache.Close()
+	dir, err := cache.OpenFile(".", os.O_RDONLY, 0)
+	if err != nil {
+		return
+	}
+	entries, _ := dir.ReadDir(-1)
+	dir.Close()
+	for _, e := range entries {
+		pidPart, startId, ok := strings.Cut(e.Name(), "-")
+		pid, err := strconv.Atoi(pidPart)
+		if !ok || err != nil || pid <= 0 {
+			continue
+		}
+		if id, err := pkg.ProcessStartId(int32(pid)); err != nil || id != startId {
+			cache.Remove(e.Name())
+		}
+	}
+}
+
+// parseVMFlags splits the output of VM.flags into flags. Values may contain spaces,
+// so a word that does not start with -X continues the previous flag.
+func parseVMFlags(out []byte) []string {
+	var flags []string
+	for _, word := range strings.Fields(string(out)) {
+		if strings.HasPrefix(word, "-X") || len(flags) == 0 {
+			flags = append(flags, word)
+		} else {
+			flags[len(flags)-1] += " " + word
+		}
+	}
+	return flags
+}
+
+// parseProperties parses system properties in the format of Properties.store, as
+// the properties attach command writes them, and sorts them by key.
+func parseProperties(out []byte) [][2]string {
+	var props [][2]string
+	for _, line := range strings.Split(string(out), "\n") {
+		line = strings.TrimLeft(strings.TrimSuffix(line, "\r"), " \t")
+		if line == "" || line[0] == '#' || line[0] == '!' {
+			continue
+		}
+		sep := len(line)
+		for i := 0; i < len(line); i++ {
+			if line[i] == '\\' {
+				i++
+			} else if line[i] == '=' || line[i] == ':' {
+				sep = i
+				break
+			}
+		}
+		value := ""
+		if sep < len(line) {
+			value = line[sep+1:]
+		}
+		props = append(props, [2]string{unescapeProperty(line[:sep]), unescapeProperty(value)})
+	}
+	sort.Slice(props, func(i, j int) bool { return props[i][0] < props[j][0] })
+	return props
+}
+
+// unescapeProperty decodes the backslash escapes of Properties.store, including
+// \uXXXX and the surrogate pairs of characters outside the BMP.
+func unescapeProperty(s string) string {
+	if strings.IndexByte(s, '\\') < 0 {
+		return s
+	}
+	var b strings.Builder
+	for i := 0; i < len(s); i++ {
+		if s[i] != '\\' || i+1 == len(s) {
+			b.WriteByte(s[i])
+			continue
+		}
+		i++
+		switch c := s[i]; c {
+		case 't':
+			b.WriteByte('\t')
+		case 'n':
+			b.WriteByte('\n')
+		case 'r':
+			b.WriteByte('\r')
+		case 'f':
+			b.WriteByte('\f')
+		case 'u':
+			r, n := unescapeUnicode(s[i+1:])
+			if n == 0 {
+				b.WriteByte(c)
+				continue
+			}
+			b.WriteRune(r)
+			i += n
+		default:
+			b.WriteByte(c)
+		}
+	}
+	return b.String()
+}
+
+// unescapeUnicode decodes the XXXX of a \uXXXX escape at the start of s, joined with
+// a following low surrogate escape, and returns the bytes of s it used.
+func unescapeUnicode(s string) (rune, int) {
+	if len(s) < 4 {
+		return 0, 0
+	}
+	v, err := strconv.ParseUint(s[:4], 16, 16)
+	if err != nil {
+		return 0, 0
+	}
+	r := rune(v)
+	if utf16.IsSurrogate(r) && len(s) >= 10 && s[4:6] == `\u` {
+		if low, err := strconv.ParseUint(s[6:10], 16, 16); err == nil {
+			if pair := utf16.DecodeRune(r, rune(low)); pair != utf8.RuneError {
+				return pair, 10
+			}
+		}
+	}
+	return r, 4
+}
+
+// flagsTextEscaper keeps every entry of the text output on one line.
+var flagsTextEscaper = strings.NewReplacer("\n", `\n`, "\r", `\r`, "\t", `\t`)
+
+// appendText appends one line per entry containing grep: "<pid> <kind> <entry>".
+func (s *flagsSnapshot) appendText(dst []byte, grep string) []byte {
+	pid := strconv.Itoa(int(s.process.Pid))
+	line := func(kind, entry string) {
+		if strings.Contains(entry, grep) {
+			dst = append(dst, pid...)
+			dst = append(dst, ' ')
+			dst = append(dst, kind...)
+			dst = append(dst, ' ')
+			dst = append(dst, flagsTextEscaper.Replace(entry)...)
+			dst = append(dst, '\n')
+		}
+	}
+	for _, arg := range s.args {
+		line("arg", arg)
+	}
+	for _, f := range s.flags {
+		line("flag", f)
+	}
+	for _, p := range s.properties {
+		line("property", p[0]+"="+p[1])
+	}
+	return dst
+}
+
+// appendJSON appends the ndjson record of the snapshot with the entries containing grep.
+// start_time is in milliseconds since the Unix epoch, as in jps records.
+func (s *flagsSnapshot) appendJSON(dst []byte, grep string) []byte {
+	dst = append(dst, `{"pid":`...)
+	dst = strconv.AppendInt(dst, int64(s.process.Pid), 10)
+	if s.process.startTime != 0 {
+		dst = append(dst, `,"start_time":`...)
+		dst = strconv.AppendInt(dst, s.process.startTime, 10)
+	}
+	if s.process.mainClassOrJar != "" {
+		dst = append(dst, `,"main_class":`...)
+		dst = appendJSONString(dst, s.process.mainClassOrJar)
+	}
+	if s.err != nil {
+		dst = append(dst, `,"error":`...)
+		dst = appendJSONString(dst, s.err.Error())
+		return append(dst, "}\n"...)
+	}
+	dst = append(dst, `,"cached":`...)
+	dst = strconv.AppendBool(dst, s.cached)
+	for _, list := range []struct {
+		name    string
+		entries []string
+	}{{"args", s.args}, {"flags", s.flags}} {
+		dst = append(dst, `,"`...)
+		dst = append(dst, list.name...)
+		dst = append(dst, `":[`...)
+		first := true
+		for _, e := range list.entries {
+			if strings.Contains(e, grep) {
+				if !first {
+					dst = append(dst, ',')
+				}
+				dst, first = appendJSONString(dst, e), false
+			}
+		}
+		dst = append(dst, ']')
+	}
+	dst = append(dst, `,"properties":{`...)
+	first := true
+	for _, p := range s.properties {
+		if strings.Contains(p[0]+"="+p[1], grep) {
+			if !first {
+				dst = append(dst, ',')
+			}
+			dst = appendJSONString(dst, p[0])
+			dst = append(dst, ':')
+			dst, first = appendJSONString(dst, p[1]), false
+		}
+	}
+	return append(dst, "}}\n"...)
+}
@@ -0,0 +1,257 @@
+package internal
+
+import (
+	"bytes"
+	"encoding/json"
+	"os"
+	"os/user"
+	"path/filepath"
+	"reflect"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"testing"
+)
+
+// TestParseFlagsFlags tests the ParseFlagsFlags function.
+func TestParseFlagsFlags(t *testing.T) {
+	opt, err := ParseFlagsFlags([]string{"-all", "-grep", "Heap", "-refresh", "-o", "ndjson"})
+	if err != nil {
+		t.Fatalf("ParseFlagsFlags failed: %v", err)
+	}
+	expected := FlagsOption{All: true, Grep: "Heap", Refresh: true, Output: "ndjson"}
+	if opt != expected {
+		t.Errorf("expected %+v, got %+v", expected, opt)
+	}
+	if opt, _ := ParseFlagsFlags([]string{"12345"}); opt.Pid != "12345" || opt.Output != jpsOutputText {
+		t.Errorf("expected pid 12345 and text output, got %+v", opt)
+	}
+}
+
+// TestFlagsValidate tests the FlagsValidate method of FlagsOption.
+func TestFlagsValidate(t *testing.T) {
+	tests := []struct {
+		option   FlagsOption
+		expected string
+	}{
+		{FlagsOption{}, "one of pid and -all is required"},
+		{FlagsOption{All: true, Pid: "1"}, "one of pid and -all is required"},
+		{FlagsOption{Pid: "abc"}, "invalid pid abc"},
+		{FlagsOption{All: true, Output: "tsv"}, "unsupported output format: tsv"},
+		{FlagsOption{All: true, User: "this_user_should_not_exist_12345"}, "user: unknown user this_user_should_not_exist_12345"},
+	}
+	for _, tt := range tests {
+		if err := tt.option.FlagsValidate(); err == nil || err.Error() != tt.expected {
+			t.Errorf("%+v: expected %q, got %v", tt.option, tt.expected, err)
+		}
+	}
+}
+
+// TestParseProperties tests the escapes of the Properties.store format.
+func TestParseProperties(t *testing.T) {
+	out := "#Mon Jan 01 00:00:00 UTC 2024\n" +
+		"java.version=17.0.9\n" +
+		"line.separator=\\n\n" +
+		"a\\:b=c\\=d\n" +
+		"user.name=Ren\\u00E9\n" +
+		"emoji=\\uD83D\\uDE00\n" +
+		"empty=\n" +
+		"java.home:/opt/jdk\r\n"
+	expected := [][2]string{
+		{"a:b", "c=d"},
+		{"emoji", "\U0001F600"},
+		{"empty", ""},
+		{"java.home", "/opt/jdk"},
+		{"java.version", "17.0.9"},
+		{"line.separator", "\n"},
+		{"user.name", "René"},
+	}
+	if props := parseProperties([]byte(out)); !reflect.DeepEqual(props, expected) {
+		t.Errorf("expected %q, got %q", expected, props)
+	}
+}
+
+// TestParseVMFlags tests that flag values with spaces stay one flag.
+func TestParseVMFlags(t *testing.T) {
+	flags := parseVMFlags([]byte("-XX:CICompilerCount=3 -XX:OnError=kill -9 %p -XX:+UseG1GC\n"))
+	expected := []string{"-XX:CICompilerCount=3", "-XX:OnError=kill -9 %p", "-XX:+UseG1GC"}
+	if !reflect.DeepEqual(flags, expected) {
+		t.Errorf("expected %q, got %q", expected, flags)
+	}
+}
+
+// TestFlags tests that a snapshot is served from the cache until it is refreshed,
+// and that entries of exited JVMs are pruned.
+func TestFlags(t *testing.T) {
+	restore, _, _ := captureLogs()
+	defer restore()
+	var out bytes.Buffer
+	attachOutput = &out
+	defer func() { attachOutput = os.Stdout }()
+	origDir := flagsCacheDir
+	flagsCacheDir = t.TempDir()
+	defer func() { flagsCacheDir = origDir }()
+	os.Chmod(flagsCacheDir, 0700)
+
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := int32(os.Getpid())
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, int(pid))
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+	var attaches atomic.Int32
+	stopListener, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		attaches.Add(1)
+		switch {
+		case cmd == attachCmdProperties:
+			return "0\n#comment\njava.version=17\nuser.timezone=UTC\n"
+		case cmd == attachCmdJcmd && args[0] == "VM.flags":
+			return "0\n-XX:MaxHeapSize=1073741824 -XX:+UseG1GC\n"
+		}
+		return "1\nunknown command\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer stopListener()
+	stale := filepath.Join(flagsCacheDir, flagsCacheKey(pid, "1"))
+	os.WriteFile(stale, nil, 0600)
+
+	type record struct {
+		Pid        int               `json:"pid"`
+		Cached     bool              `json:"cached"`
+		Flags      []string          `json:"flags"`
+		Properties map[string]string `json:"properties"`
+	}
+	snapshot := func(option FlagsOption) record {
+		t.Helper()
+		out.Reset()
+		option.User, option.Output = currentUser.Username, jpsOutputNDJSON
+		if code := Flags(option); code != 0 {
+			t.Fatalf("expected exit code 0, got %d: %s", code, out.String())
+		}
+		var r record
+		if err := json.Unmarshal(out.Bytes(), &r); err != nil {
+			t.Fatalf("invalid json %q: %v", out.String(), err)
+		}
+		return r
+	}
+
+	pidArg := strconv.Itoa(int(pid))
+	r := snapshot(FlagsOption{Pid: pidArg})
+	if r.Pid != int(pid) || r.Cached || len(r.Flags) != 2 || r.Properties["java.version"] != "17" {
+		t.Errorf("expected a fresh snapshot, got %+v", r)
+	}
+	if n := attaches.Load(); n != 2 {
+		t.Errorf("expected VM.flags and properties to be queried, got %d attach commands", n)
+	}
+
+	r = snapshot(FlagsOption{All: true, Grep: "MaxHeap"})
+	if !r.Cached || !reflect.DeepEqual(r.Flags, []string{"-XX:MaxHeapSize=1073741824"}) || len(r.Properties) != 0 {
+		t.Errorf("expected a cached snapshot filtered by -grep, got %+v", r)
+	}
+	if n := attaches.Load(); n != 2 {
+		t.Errorf("expected no attach for a cached snapshot, got %d attach commands", n)
+	}
+	if _, err := os.Stat(stale); !os.IsNotExist(err) {
+		t.Error("expected the entry of an exited JVM to be pruned")
+	}
+
+	if r = snapshot(FlagsOption{Pid: pidArg, Refresh: true}); r.Cached || attaches.Load() != 4 {
+		t.Errorf("expected -refresh to attach again, got %+v after %d attach commands", r, attaches.Load())
+	}
+
+	out.Reset()
+	Flags(FlagsOption{User: currentUser.Username, Pid: pidArg, Grep: "java."})
+	expected := pidArg + " property java.version=17\n"
+	if !strings.Contains(out.String(), expected) || strings.Contains(out.String(), " flag ") {
+		t.Errorf("expected the text line %q only, got %q", expected, out.String())
+	}
+}
+
+// TestFlagsCache tests that corrupt or truncated cache entries are not served,
+// nor any entry of a cache directory others can write to.
+func TestFlagsCache(t *testing.T) {
+	origDir := flagsCacheDir
+	flagsCacheDir = t.TempDir()
+	defer func() { flagsCacheDir = origDir }()
+	os.Chmod(flagsCacheDir, 0700)
+	cache, err := openFlagsCache()
+	if err != nil {
+		t.Fatalf("openFlagsCache failed: %v", err)
+	}
+	defer cache.Close()
+	path := filepath.Join(flagsCacheDir, "1-2")
+	writeFlagsCache(cache, "1-2", []byte("-XX:+UseG1GC\n"), []byte("a=b\n"))
+	flags, props, err := readFlagsCache(cache, "1-2")
+	if err != nil || string(flags) != "-XX:+UseG1GC\n" || string(props) != "a=b\n" {
+		t.Errorf("expected the stored outputs, got %q %q %v", flags, props, err)
+	}
+	data, _ := os.ReadFile(path)
+	for _, corrupt := range [][]byte{data[:len(data)-1], []byte("jvmtool-flags 0 0 0\n"), nil} {
+		os.WriteFile(path, corrupt, 0600)
+		if _, _, err := readFlagsCache(cache, "1-2"); err == nil {
+			t.Errorf("expected %q to be refused", corrupt)
+		}
+	}
+
+	os.Chmod(flagsCacheDir, 0755)
+	if c, err := openFlagsCache(); err == nil {
+		c.Close()
+		t.Error("expected a cache directory others can read to be refused")
+	}
+	os.Chmod(flagsCacheDir, 0700)
+	shared := filepath.Join(t.TempDir(), "shared")
+	os.Symlink(flagsCacheDir, shared)
+	flagsCacheDir = shared
+	if c, err := openFlagsCache(); err == nil {
+		c.Close()
+		t.Error("expected a symlinked cache directory to be refused")
+	}
+}
+
+// TestFlags_TooLong tests that output over flagsMaxOutput fails the snapshot
+// instead of caching a truncated one.
+func TestFlags_TooLong(t *testing.T) {
+	restore, getLogs, _ := captureLogs()
+	defer restore()
+	var out bytes.Buffer
+	attachOutput = &out
+	defer func() { attachOutput = os.Stdout }()
+	origDir := flagsCacheDir
+	flagsCacheDir = t.TempDir()
+	defer func() { flagsCacheDir = origDir }()
+	os.Chmod(flagsCacheDir, 0700)
+
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := int32(os.Getpid())
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, int(pid))
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+	stopListener, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		return "0\n" + strings.Repeat("-XX:+UseG1GC ", flagsMaxOutput/13+1)
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer stopListener()
+
+	if code := Flags(FlagsOption{User: currentUser.Username, Pid: strconv.Itoa(int(pid))}); code == 0 {
+		t.Error("expected a too long output to fail")
+	}
+	if logs := strings.Join(getLogs(), "\n"); !strings.Contains(logs, "output of jcmd exceeds") {
+		t.Errorf("expected the too long output to be reported, got %q", logs)
+	}
+	if entries, _ := os.ReadDir(flagsCacheDir); len(entries) != 0 {
+		t.Errorf("expected nothing to be cached, got %v", entries)
+	}
+}
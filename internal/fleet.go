@@ -0,0 +1,390 @@
+package internal
+
+import (
+	"bytes"
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"os/exec"
+	"os/signal"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// defaultFleetConcurrency is the number of hosts a fleet command runs on at once.
+const defaultFleetConcurrency = 64
+
+// fleetWaitDelay bounds how long the output of a host is read after its ssh client
+// exited or was killed, in case a process it started keeps the pipes open.
+const fleetWaitDelay = time.Second
+
+// fleetOutput is the destination of the merged standard output of the hosts.
+var fleetOutput io.Writer = os.Stdout
+
+type FleetOption struct {
+	Hosts       string        // -hosts, a file with one ssh destination per line
+	Concurrency int           // -concurrency, the number of hosts run on at once
+	Timeout     time.Duration // -timeout, per host, 0 for none
+	Persist     time.Duration // -persist, how long pooled ssh connections stay open, 0 to not pool
+	SSH         string        // -ssh, the ssh client
+	Remote      string        // -remote, the path of jvmtool on the hosts
+	Args        []string      // the jvmtool command run on every host
+
+	hosts []string // read from Hosts by FleetValidate
+}
+
+// ParseFleetFlags parses flags for the "fleet" command and returns the corresponding FleetOption.
+// The jvmtool command run on the hosts follows the flags, after "--".
+func ParseFleetFlags(args []string) (FleetOption, error) {
+	fleetFlagSet := flag.NewFlagSet("fleet", flag.ContinueOnError)
+	hosts := fleetFlagSet.String("hosts", "", "file with one ssh destination per line")
+	concurrency := fleetFlagSet.Int("concurrency", defaultFleetConcurrency, "number of hosts to run on at once")
+	timeout := fleetFlagSet.Duration("timeout", time.Minute, "time allowed per host, 0 for none")
+	persist := fleetFlagSet.Duration("persist", 5*time.Minute, "how long pooled ssh connections stay open after use, 0 to not pool")
+	ssh := fleetFlagSet.String("ssh", "ssh", "the ssh client")
+	remote := fleetFlagSet.String("remote", "jvmtool", "the path of jvmtool on the hosts")
+	if err := fleetFlagSet.Parse(args); err != nil {
+		return FleetOption{}, err
+	}
+	return FleetOption{
+		Hosts:       *hosts,
+		Concurrency: *concurrency,
+		Timeout:     *timeout,
+		Persist:     *persist,
+		SSH:         *ssh,
+		Remote:      *remote,
+		Args:        fleetFlagSet.Args(),
+	}, nil
+}
+
+// FleetValidate validates the FleetOption fields and reads the hosts file.
+func (opt *FleetOption) FleetValidate() error {
+	if opt.Hosts == "" {
+		return errors.New("hosts is required")
+	}
+	if len(opt.Args) == 0 {
+		return errors.New("a jvmtool command to run on the hosts is required after --")
+	}
+	if opt.Args[0] == "fleet" {
+		return errors.New("fleet cannot run fleet on the hosts")
+	}
+	if opt.Timeout < 0 || opt.Persist < 0 {
+		return errors.New("-timeout and -persist cannot be negative")
+	}
+	if opt.Concurrency <= 0 {
+		opt.Concurrency = defaultFleetConcurrency
+	}
+	if _, err := exec.LookPath(opt.SSH); err != nil {
+		return fmt.Errorf("ssh client not found: %v", err)
+	}
+	hosts, err := readFleetHosts(opt.Hosts)
+	if err != nil {
+		return err
+	}
+	if len(hosts) == 0 {
+		return fmt.Errorf("no hosts in %s", opt.Hosts)
+	}
+	opt.hosts = hosts
+	return nil
+}
+
+// readFleetHosts reads the ssh destinations of a hosts file: the first field of
+// every line, skipping blank lines, comments and duplicates.
+func readFleetHosts(path string) ([]string, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	hosts := []string{}
+	seen := map[string]bool{}
+	for _, line := range strings.Split(string(data), "\n") {
+		fields := strings.Fields(line)
+		if len(fields) == 0 || strings.HasPrefix(fields[0], "#") {
+			continue
+		}
+		host := fields[0]
+		if strings.HasPrefix(host, "-") {
+			return nil, fmt.Errorf("invalid host %s", host)
+		}
+		if !seen[host] {
+			seen[host] = true
+			hosts = append(hosts, host)
+		}
+	}
+	return hosts, nil
+}
+
+// Fleet runs a jvmtool command on every host over ssh, a bounded number of hosts at
+// once, and merges their output as it streams in. Lines of standard output are
+// prefixed with the host, and ndjson records get a "host" field; standard error is
+// logged the same way. Connections are pooled by the ssh client, see fleetControlDir.
+// Attaches stay spread out on every host by its own scheduler.
+func Fleet(option FleetOption) int {
+	if err := option.FleetValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+
+	var controlDir string
+	if option.Persist > 0 {
+		var err error
+		if controlDir, err = fleetControlDir(); err != nil {
+			log(fmt.Sprintf("ssh connections are not pooled: %v", err))
+		}
+	}
+	remote := fleetRemoteCommand(option.Remote, option.Args)
+	structured := fleetStructured(option.Args)
+	out := &fleetWriter{w: fleetOutput}
+
+	failed := make([]bool, len(option.hosts))
+	pkg.ParallelFor(len(option.hosts), option.Concurrency, func(i int) {
+		host := option.hosts[i]
+		exit, err := option.runHost(ctx, host, remote, controlDir, structured, out)
+		if err == nil {
+			return
+		}
+		failed[i] = true
+		if structured {
+			out.Write(appendFleetError(nil, host, exit, err))
+		} else {
+			log(fmt.Sprintf("%s: %v", host, err))
+		}
+	})
+
+	count := 0
+	for _, f := range failed {
+		if f {
+			count++
+		}
+	}
+	log(fmt.Sprintf("fleet: %d/%d hosts succeeded", len(failed)-count, len(failed)))
+	if count > 0 {
+		return 1
+	}
+	return 0
+}
+
+// runHost runs the remote command on host and returns its exit code, -1 if it has
+// none, and an error unless it succeeded.
+func (opt *FleetOption) runHost(ctx context.Context, host, remote, controlDir string, structured bool, out *fleetWriter) (int, error) {
+	if opt.Timeout > 0 {
+		var cancel context.CancelFunc
+		ctx, cancel = context.WithTimeout(ctx, opt.Timeout)
+		defer cancel()
+	}
+	stdout := &fleetLineWriter{host: host, json: structured, emit: func(b []byte) { out.Write(b) }}
+	stderr := &fleetLineWriter{host: host, stderr: true, emit: func(b []byte) {
+		log(string(bytes.TrimSuffix(b, []byte{'\n'})))
+	}}
+	cmd := exec.CommandContext(ctx, opt.SSH, append(opt.sshArgs(controlDir), host, remote)...)
+	cmd.Stdout, cmd.Stderr = stdout, stderr
+	cmd.WaitDelay = fleetWaitDelay
+	err := cmd.Run()
+	stdout.Flush()
+	stderr.Flush()
+
+	exit := -1
+	var exitErr *exec.ExitError
+	if errors.As(err, &exitErr) {
+		exit = exitErr.ExitCode()
+	}
+	switch {
+	case err == nil:
+		return 0, nil
+	case ctx.Err() == context.DeadlineExceeded:
+		return exit, fmt.Errorf("timed out after %v", opt.Timeout)
+	case ctx.Err() != nil:
+		return exit, errors.New("interrupted")
+	case exit == 255 && stderr.last != "":
+		return exit, fmt.Errorf("ssh failed: %s", stderr.last)
+	case stderr.last != "":
+		return exit, fmt.Errorf("%v: %s", err, stderr.last)
+	}
+	return exit, err
+}
+
+// sshArgs returns the options of the ssh client. With a control dir, the first
+// connection to a host becomes a master that later runs reuse until it has been
+// idle for opt.Persist.
+func (opt *FleetOption) sshArgs(controlDir string) []string {
+	args := []string{"-o", "BatchMode=yes"}
+	if opt.Timeout > 0 {
+		args = append(args, "-o", "ConnectTimeout="+strconv.Itoa(max(1, int(opt.Timeout.Seconds()))))
+	}
+	if controlDir != "" {
+		args = append(args,
+			"-o", "ControlMaster=auto",
+			"-o", "ControlPath="+filepath.Join(controlDir, "%C"),
+			"-o", "ControlPersist="+strconv.Itoa(max(1, int(opt.Persist.Seconds()))))
+	}
+	return args
+}
+
+// fleetControlDir returns the directory of the ssh control sockets of the current
+// user, creating it.
+func fleetControlDir() (string, error) {
+	return privateTempDir(".jvmtool-ssh")
+}
+
+// privateTempDir returns <temp dir>/<prefix>-<uid>, creating it. As it lives in
+// the shared temp dir, it must be a directory only the current user can access.
+func privateTempDir(prefix string) (string, error) {
+	dir := filepath.Join(os.TempDir(), fmt.Sprintf("%s-%d", prefix, os.Getuid()))
+	if err := os.Mkdir(dir, 0700); err != nil && !os.IsExist(err) {
+		return "", err
+	}
+	fi, err := os.Lstat(dir)
+	if err != nil {
+		return "", err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !fi.IsDir() || fi.Mode().Perm() != 0700 || !ok || int(st.Uid) != os.Getuid() {
+		return "", fmt.Errorf("%s is not a private directory of the current user", dir)
+	}
+	return dir, nil
+}
+
+// fleetRemoteCommand returns the command line run by the remote shell.
+func fleetRemoteCommand(remote string, args []string) string {
+	words := make([]string, 0, len(args)+1)
+	words = append(words, fleetShellQuote(remote))
+	for _, arg := range args {
+		words = append(words, fleetShellQuote(arg))
+	}
+	return strings.Join(words, " ")
+}
+
+// fleetShellQuote quotes s for a POSIX shell, leaving words that need no quoting as they are.
+func fleetShellQuote(s string) string {
+	safe := s != ""
+	for i := 0; i < len(s) && safe; i++ {
+		c := s[i]
+		safe = c >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z' || c >= '0' && c <= '9' || strings.IndexByte("_@%+=:,./-", c) >= 0
+	}
+	if safe {
+		return s
+	}
+	return "'" + strings.ReplaceAll(s, "'", `'\''`) + "'"
+}
+
+// fleetStructured reports whether the remote command writes ndjson records.
+func fleetStructured(args []string) bool {
+	for i, arg := range args {
+		if (arg == "-o" || arg == "--o") && i+1 < len(args) && args[i+1] == jpsOutputNDJSON {
+			return true
+		}
+		if arg == "-o="+jpsOutputNDJSON || arg == "--o="+jpsOutputNDJSON {
+			return true
+		}
+	}
+	return false
+}
+
+// appendFleetError appends the ndjson record of a host that failed.
+func appendFleetError(dst []byte, host string, exit int, err error) []byte {
+	dst = append(dst, `{"host":`...)
+	dst = appendJSONString(dst, host)
+	dst = append(dst, `,"event":"error","exit":`...)
+	dst = strconv.AppendInt(dst, int64(exit), 10)
+	dst = append(dst, `,"error":`...)
+	dst = appendJSONString(dst, err.Error())
+	return append(dst, "}\n"...)
+}
+
+// fleetWriter serializes the writes of the hosts, each a batch of whole lines.
+type fleetWriter struct {
+	mu sync.Mutex
+	w  io.Writer
+}
+
+func (w *fleetWriter) Write(p []byte) (int, error) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	return w.w.Write(p)
+}
+
+// fleetLineWriter splits the output of a host into lines, labels them with the
+// host and emits the lines of every write as one batch, so that the output of
+// hosts interleaves only at line boundaries. Lines longer than attachMaxLine are
+// dropped.
+type fleetLineWriter struct {
+	host   string
+	json   bool // ndjson records, which get a host field instead of a prefix
+	stderr bool // remembers the last line, to explain a failure
+	emit   func(batch []byte)
+
+	partial []byte
+	tooLong bool // dropping the rest of a line
+	batch   []byte
+	last    string
+}
+
+func (w *fleetLineWriter) Write(p []byte) (int, error) {
+	n := len(p)
+	w.batch = w.batch[:0]
+	for len(p) > 0 {
+		i := bytes.IndexByte(p, '\n')
+		if i < 0 {
+			if w.tooLong = w.tooLong || len(w.partial)+len(p) > attachMaxLine; w.tooLong {
+				w.partial = w.partial[:0]
+			} else {
+				w.partial = append(w.partial, p...)
+			}
+			break
+		}
+		line := p[:i]
+		if len(w.partial) > 0 {
+			w.partial = append(w.partial, line...)
+			line = w.partial
+		}
+		if !w.tooLong {
+			w.appendLine(line)
+		}
+		w.partial, w.tooLong, p = w.partial[:0], false, p[i+1:]
+	}
+	if len(w.batch) > 0 {
+		w.emit(w.batch)
+	}
+	return n, nil
+}
+
+// Flush emits the last line if it was not terminated.
+func (w *fleetLineWriter) Flush() {
+	if len(w.partial) > 0 && !w.tooLong {
+		w.Write([]byte{'\n'})
+	}
+}
+
+func (w *fleetLineWriter) appendLine(line []byte) {
+	line = bytes.TrimSuffix(line, []byte{'\r'})
+	if w.stderr {
+		if s := strings.TrimSpace(string(line)); s != "" {
+			w.last = s
+		}
+	}
+	if w.json && len(line) > 0 && line[0] == '{' {
+		w.batch = append(w.batch, `{"host":`...)
+		w.batch = appendJSONString(w.batch, w.host)
+		rest := line[1:]
+		if len(bytes.TrimSpace(rest)) > 0 && bytes.TrimSpace(rest)[0] != '}' {
+			w.batch = append(w.batch, ',')
+		}
+		w.batch = append(w.batch, rest...)
+	} else if w.stderr {
+		w.batch = append(append(append(w.batch, w.host...), ": "...), line...)
+	} else {
+		w.batch = append(append(append(w.batch, w.host...), '\t'), line...)
+	}
+	w.batch = append(w.batch, '\n')
+}
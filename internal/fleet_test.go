@@ -0,0 +1,222 @@
+package internal
+
+import (
+	"bytes"
+	"encoding/json"
+	"os"
+	"path/filepath"
+	"reflect"
+	"sort"
+	"strings"
+	"testing"
+	"time"
+)
+
+// TestParseFleetFlags tests that the remote command is taken after "--".
+func TestParseFleetFlags(t *testing.T) {
+	opt, err := ParseFleetFlags([]string{"-hosts", "hosts.txt", "-concurrency", "8", "-timeout", "10s", "--", "jps", "-o", "ndjson"})
+	if err != nil {
+		t.Fatalf("ParseFleetFlags failed: %v", err)
+	}
+	if opt.Hosts != "hosts.txt" || opt.Concurrency != 8 || opt.Timeout != 10*time.Second {
+		t.Errorf("unexpected option %+v", opt)
+	}
+	if !reflect.DeepEqual(opt.Args, []string{"jps", "-o", "ndjson"}) {
+		t.Errorf("expected the remote command, got %q", opt.Args)
+	}
+	if opt.Persist != 5*time.Minute || opt.SSH != "ssh" || opt.Remote != "jvmtool" {
+		t.Errorf("unexpected defaults %+v", opt)
+	}
+}
+
+// TestFleetValidate tests the FleetValidate method and the hosts file format.
+func TestFleetValidate(t *testing.T) {
+	hosts := filepath.Join(t.TempDir(), "hosts")
+	os.WriteFile(hosts, []byte("# web\nweb1\n  web2 rack=3\n\nweb1\n"), 0644)
+	tests := []struct {
+		name     string
+		option   FleetOption
+		expected string
+	}{
+		{"missing hosts", FleetOption{Args: []string{"jps"}, SSH: "sh"}, "hosts is required"},
+		{"missing command", FleetOption{Hosts: hosts, SSH: "sh"}, "a jvmtool command to run on the hosts is required after --"},
+		{"nested fleet", FleetOption{Hosts: hosts, Args: []string{"fleet"}, SSH: "sh"}, "fleet cannot run fleet on the hosts"},
+		{"negative timeout", FleetOption{Hosts: hosts, Args: []string{"jps"}, SSH: "sh", Timeout: -1}, "-timeout and -persist cannot be negative"},
+		{"valid", FleetOption{Hosts: hosts, Args: []string{"jps"}, SSH: "sh"}, ""},
+	}
+	for _, tt := range tests {
+		err := tt.option.FleetValidate()
+		if tt.expected == "" {
+			if err != nil {
+				t.Errorf("%s: expected no error, got %v", tt.name, err)
+			}
+			continue
+		}
+		if err == nil || err.Error() != tt.expected {
+			t.Errorf("%s: expected %q, got %v", tt.name, tt.expected, err)
+		}
+	}
+
+	opt := FleetOption{Hosts: hosts, Args: []string{"jps"}, SSH: "sh"}
+	opt.FleetValidate()
+	if !reflect.DeepEqual(opt.hosts, []string{"web1", "web2"}) || opt.Concurrency != defaultFleetConcurrency {
+		t.Errorf("expected hosts web1 and web2 and the default concurrency, got %q %d", opt.hosts, opt.Concurrency)
+	}
+	os.WriteFile(hosts, []byte("-oProxyCommand=x\n"), 0644)
+	if err := opt.FleetValidate(); err == nil {
+		t.Error("expected a host starting with - to be refused")
+	}
+}
+
+// TestFleetShellQuote tests that arguments survive the remote shell.
+func TestFleetShellQuote(t *testing.T) {
+	for in, expected := range map[string]string{
+		"jps":            "jps",
+		"-agentpath=/a.": "-agentpath=/a.",
+		"":               "''",
+		"foo=bar baz":    "'foo=bar baz'",
+		"it's":           `'it'\''s'`,
+		"$HOME;rm":       "'$HOME;rm'",
+	} {
+		if got := fleetShellQuote(in); got != expected {
+			t.Errorf("fleetShellQuote(%q) = %q, expected %q", in, got, expected)
+		}
+	}
+}
+
+// TestFleetLineWriter tests that lines split across writes are labelled once whole.
+func TestFleetLineWriter(t *testing.T) {
+	var batches []string
+	w := &fleetLineWriter{host: "web1", json: true, emit: func(b []byte) { batches = append(batches, string(b)) }}
+	w.Write([]byte(`{"pid":1}` + "\n" + `{"pi`))
+	w.Write([]byte(`d":2}` + "\n{}\ntext\n"))
+	w.Write([]byte("no newline"))
+	w.Flush()
+	expected := []string{
+		`{"host":"web1","pid":1}` + "\n",
+		`{"host":"web1","pid":2}` + "\n" + `{"host":"web1"}` + "\n" + "web1\ttext\n",
+		"web1\tno newline\n",
+	}
+	if !reflect.DeepEqual(batches, expected) {
+		t.Errorf("expected %q, got %q", expected, batches)
+	}
+
+	batches = nil
+	w = &fleetLineWriter{host: "web1", emit: func(b []byte) { batches = append(batches, string(b)) }}
+	w.Write(bytes.Repeat([]byte{'x'}, attachMaxLine+1))
+	w.Write([]byte("x\nok\n"))
+	if !reflect.DeepEqual(batches, []string{"web1\tok\n"}) {
+		t.Errorf("expected a too long line to be dropped, got %q", batches)
+	}
+}
+
+// fakeSSH is an ssh client for the tests: it skips the options, then runs the
+// command locally with FLEET_HOST set to the destination. Host "down" cannot be
+// connected to and host "slow" never answers.
+const fakeSSH = `#!/bin/sh
+while [ "$1" = "-o" ]; do shift 2; done
+host=$1
+shift
+case $host in
+down) echo "ssh: connect to host down port 22: Connection refused" >&2; exit 255;;
+slow) exec sleep 30;;
+esac
+FLEET_HOST=$host exec sh -c "$*"
+`
+
+// fakeJvmtool prints an ndjson record with its arguments and a line on stderr.
+const fakeJvmtool = `#!/bin/sh
+echo "{\"pid\":1,\"args\":\"$*\"}"
+echo "warning from $FLEET_HOST" >&2
+`
+
+// TestFleet tests that the output of every host is merged and labelled, and that
+// unreachable and timed out hosts are reported.
+func TestFleet(t *testing.T) {
+	restore, getLogs, clearLogs := captureLogs()
+	defer restore()
+	clearLogs()
+	var out bytes.Buffer
+	fleetOutput = &out
+	defer func() { fleetOutput = os.Stdout }()
+
+	dir := t.TempDir()
+	ssh, remote, hosts := filepath.Join(dir, "ssh"), filepath.Join(dir, "jvmtool"), filepath.Join(dir, "hosts")
+	os.WriteFile(ssh, []byte(fakeSSH), 0755)
+	os.WriteFile(remote, []byte(fakeJvmtool), 0755)
+	os.WriteFile(hosts, []byte("web1\nweb2\ndown\nslow\n"), 0644)
+
+	code := Fleet(FleetOption{
+		Hosts:   hosts,
+		Timeout: 500 * time.Millisecond,
+		SSH:     ssh,
+		Remote:  remote,
+		Args:    []string{"jattach", "-all", "-agentparams", "a b", "-o", "ndjson"},
+	})
+	if code != 1 {
+		t.Errorf("expected exit code 1, got %d", code)
+	}
+
+	type record struct {
+		Host  string `json:"host"`
+		Pid   int    `json:"pid"`
+		Args  string `json:"args"`
+		Event string `json:"event"`
+		Exit  int    `json:"exit"`
+		Error string `json:"error"`
+	}
+	records := map[string]record{}
+	for _, line := range strings.Split(strings.TrimSuffix(out.String(), "\n"), "\n") {
+		var r record
+		if err := json.Unmarshal([]byte(line), &r); err != nil {
+			t.Fatalf("invalid json %q: %v", line, err)
+		}
+		records[r.Host] = r
+	}
+	for _, host := range []string{"web1", "web2"} {
+		if r := records[host]; r.Pid != 1 || r.Args != "jattach -all -agentparams a b -o ndjson" {
+			t.Errorf("expected the record of %s, got %+v", host, r)
+		}
+	}
+	if r := records["down"]; r.Event != "error" || r.Exit != 255 || !strings.Contains(r.Error, "Connection refused") {
+		t.Errorf("expected down to be unreachable, got %+v", r)
+	}
+	if r := records["slow"]; r.Event != "error" || r.Error != "timed out after 500ms" {
+		t.Errorf("expected slow to time out, got %+v", r)
+	}
+
+	logs := getLogs()
+	sort.Strings(logs)
+	expected := []string{
+		"down: ssh: connect to host down port 22: Connection refused",
+		"fleet: 2/4 hosts succeeded",
+		"web1: warning from web1",
+		"web2: warning from web2",
+	}
+	if !reflect.DeepEqual(logs, expected) {
+		t.Errorf("expected logs %q, got %q", expected, logs)
+	}
+}
+
+// TestFleetSSHArgs tests the options that pool ssh connections.
+func TestFleetSSHArgs(t *testing.T) {
+	opt := FleetOption{Timeout: 10 * time.Second, Persist: time.Minute}
+	args := strings.Join(opt.sshArgs("/tmp/.jvmtool-ssh-0"), " ")
+	expected := "-o BatchMode=yes -o ConnectTimeout=10 -o ControlMaster=auto -o ControlPath=/tmp/.jvmtool-ssh-0/%C -o ControlPersist=60"
+	if args != expected {
+		t.Errorf("expected %q, got %q", expected, args)
+	}
+	if args := strings.Join((&FleetOption{}).sshArgs(""), " "); args != "-o BatchMode=yes" {
+		t.Errorf("expected no pooling without a control dir, got %q", args)
+	}
+
+	t.Setenv("TMPDIR", t.TempDir())
+	dir, err := fleetControlDir()
+	if err != nil {
+		t.Fatalf("fleetControlDir failed: %v", err)
+	}
+	os.Chmod(dir, 0755)
+	if _, err := fleetControlDir(); err == nil {
+		t.Error("expected a control dir others can access to be refused")
+	}
+}
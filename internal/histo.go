@@ -0,0 +1,317 @@
+package internal
+
+import (
+	"bufio"
+	"bytes"
+	"container/heap"
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"hash/maphash"
+	"io"
+	"os"
+	"os/signal"
+	"sort"
+	"strconv"
+	"syscall"
+	"time"
+)
+
+type HistoOption struct {
+	User string
+	Pid  string
+	Live bool          // -live, count only reachable objects, which runs a full GC
+	Top  int           // -top, the number of classes shown
+	Diff time.Duration // -diff, the time between the two snapshots compared, 0 for one snapshot
+}
+
+// ParseHistoFlags parses flags for the "histo" command and returns the corresponding HistoOption.
+// The pid is taken from the first positional argument.
+func ParseHistoFlags(args []string) (HistoOption, error) {
+	histoFlagSet := flag.NewFlagSet("histo", flag.ContinueOnError)
+	user := histoFlagSet.String("user", "", "specify the user owning the Java process")
+	live := histoFlagSet.Bool("live", false, "count only live objects, which triggers a full GC")
+	top := histoFlagSet.Int("top", 20, "number of classes to show")
+	diff := histoFlagSet.Duration("diff", 0, "take two snapshots this far apart and show the classes that grew the most")
+	if err := histoFlagSet.Parse(args); err != nil {
+		return HistoOption{}, err
+	}
+	return HistoOption{
+		User: *user,
+		Pid:  histoFlagSet.Arg(0),
+		Live: *live,
+		Top:  *top,
+		Diff: *diff,
+	}, nil
+}
+
+// HistoValidate validates the HistoOption fields.
+func (opt *HistoOption) HistoValidate() error {
+	if opt.Top <= 0 {
+		return errors.New("top must be positive")
+	}
+	if opt.Diff < 0 {
+		return errors.New("diff must not be negative")
+	}
+	if opt.Pid == "" {
+		return errors.New("pid is required")
+	}
+	if pid, err := strconv.Atoi(opt.Pid); err != nil || pid <= 0 {
+		return fmt.Errorf("invalid pid %s", opt.Pid)
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+	return validateJvmPid(opt.User, toInt32(opt.Pid))
+}
+
+// Histo prints the classes of a Java process taking the most heap, or with -diff the
+// classes whose footprint grew the most between two snapshots. Histograms are parsed
+// as they stream in and only the top classes are kept; a diff remembers the first
+// snapshot by a hash of each class name.
+func Histo(option HistoOption) int {
+	if err := option.HistoValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+	jp := &JvmProcess{Pid: toInt32(option.Pid)}
+	if err := jp.checkSocket(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	client := jp.attachClient()
+	top := newHistoTop(option.Top)
+	var total histoCount
+	var err error
+	if option.Diff == 0 {
+		total, err = takeHisto(ctx, client, option.Live, func(name []byte, c histoCount) {
+			if top.accepts(c.bytes) {
+				top.add(histoEntry{name: string(name), histoCount: c}, c.bytes)
+			}
+		})
+	} else {
+		total, err = diffHisto(ctx, client, option, top)
+	}
+	if err != nil {
+		log(err.Error())
+		return 1
+	}
+	w := bufio.NewWriter(attachOutput)
+	defer w.Flush()
+	writeHisto(w, top.sorted(), total, option.Diff != 0)
+	return 0
+}
+
+// diffHisto takes two snapshots option.Diff apart and keeps the classes that grew the
+// most in top. It returns the growth of the totals.
+func diffHisto(ctx context.Context, client *AttachClient, option HistoOption, top *histoTop) (histoCount, error) {
+	seed := maphash.MakeSeed()
+	base := map[uint64]histoCount{}
+	first, err := takeHisto(ctx, client, option.Live, func(name []byte, c histoCount) {
+		base[maphash.Bytes(seed, name)] = c
+	})
+	if err != nil {
+		return histoCount{}, err
+	}
+	select {
+	case <-ctx.Done():
+		return histoCount{}, errors.New("interrupted before the second snapshot")
+	case <-time.After(option.Diff):
+	}
+	second, err := takeHisto(ctx, client, option.Live, func(name []byte, c histoCount) {
+		growth := c.sub(base[maphash.Bytes(seed, name)])
+		if growth.bytes > 0 && top.accepts(growth.bytes) {
+			top.add(histoEntry{name: string(name), histoCount: growth}, growth.bytes)
+		}
+	})
+	return second.sub(first), err
+}
+
+// histoCount is the footprint of a class, or of the whole heap.
+type histoCount struct {
+	instances, bytes int64
+}
+
+func (c histoCount) sub(o histoCount) histoCount {
+	return histoCount{c.instances - o.instances, c.bytes - o.bytes}
+}
+
+// takeHisto runs inspectheap and calls class for every line of the histogram as it
+// arrives. The name is only valid during the call. It returns the total line.
+func takeHisto(ctx context.Context, client *AttachClient, live bool, class func(name []byte, c histoCount)) (histoCount, error) {
+	arg := "-all"
+	if live {
+		arg = "-live"
+	}
+	resp, err := client.ExecuteContext(ctx, attachCmdInspectHeap, arg)
+	if err != nil {
+		return histoCount{}, err
+	}
+	defer resp.Close()
+	if resp.Code != 0 {
+		return histoCount{}, fmt.Errorf("command %s failed, return code: %d", attachCmdInspectHeap, resp.Code)
+	}
+	var total histoCount
+	seen := false
+	br := bufio.NewReaderSize(resp, attachMaxLine)
+	for {
+		line, tooLong, err := readAttachLine(br)
+		if err != nil && err != io.EOF {
+			return histoCount{}, err
+		}
+		if !tooLong {
+			if name, c, ok := parseHistoLine(line); ok {
+				class(name, c)
+			} else if c, ok := parseHistoTotal(line); ok {
+				total, seen = c, true
+			}
+		}
+		if err == io.EOF {
+			break
+		}
+	}
+	if !seen {
+		return histoCount{}, errors.New("heap histogram has no total, the response was cut short")
+	}
+	return total, nil
+}
+
+// parseHistoLine parses a class line of a histogram:
+// "   1:         12345        1234560  [B (java.base@17.0.9)"
+func parseHistoLine(line []byte) ([]byte, histoCount, bool) {
+	rank, rest := histoField(line)
+	if len(rank) < 2 || rank[len(rank)-1] != ':' {
+		return nil, histoCount{}, false
+	}
+	c, name, ok := parseHistoCounts(rest)
+	if !ok || len(name) == 0 {
+		return nil, histoCount{}, false
+	}
+	return name, c, true
+}
+
+// parseHistoTotal parses the last line of a histogram: "Total      123456      12345678".
+func parseHistoTotal(line []byte) (histoCount, bool) {
+	word, rest := histoField(line)
+	if string(word) != "Total" {
+		return histoCount{}, false
+	}
+	c, _, ok := parseHistoCounts(rest)
+	return c, ok
+}
+
+// parseHistoCounts parses the instance and byte counts of a line and returns the rest.
+func parseHistoCounts(line []byte) (histoCount, []byte, bool) {
+	instances, rest := histoField(line)
+	size, rest := histoField(rest)
+	var c histoCount
+	var err error
+	if c.instances, err = strconv.ParseInt(string(instances), 10, 64); err != nil {
+		return c, nil, false
+	}
+	if c.bytes, err = strconv.ParseInt(string(size), 10, 64); err != nil {
+		return c, nil, false
+	}
+	return c, bytes.TrimSpace(rest), true
+}
+
+// histoField splits the first space separated field off line.
+func histoField(line []byte) (field, rest []byte) {
+	line = bytes.TrimLeft(line, " ")
+	if i := bytes.IndexByte(line, ' '); i >= 0 {
+		return line[:i], line[i:]
+	}
+	return bytes.TrimRight(line, "\r\n"), nil
+}
+
+// histoEntry is a class kept for the output.
+type histoEntry struct {
+	name string
+	histoCount
+}
+
+// histoTop keeps the entries with the largest keys, at most limit of them, in a
+// min-heap so the smallest is replaced in O(log limit).
+type histoTop struct {
+	limit   int
+	entries []histoEntry
+	keys    []int64
+}
+
+func newHistoTop(limit int) *histoTop {
+	return &histoTop{limit: limit}
+}
+
+func (t *histoTop) Len() int           { return len(t.entries) }
+func (t *histoTop) Less(i, j int) bool { return t.keys[i] < t.keys[j] }
+func (t *histoTop) Swap(i, j int) {
+	t.entries[i], t.entries[j] = t.entries[j], t.entries[i]
+	t.keys[i], t.keys[j] = t.keys[j], t.keys[i]
+}
+func (t *histoTop) Push(x any) {}
+func (t *histoTop) Pop() any {
+	n := len(t.entries) - 1
+	t.entries, t.keys = t.entries[:n], t.keys[:n]
+	return nil
+}
+
+// accepts reports whether an entry with key would be kept, so callers can skip
+// building entries that would not.
+func (t *histoTop) accepts(key int64) bool {
+	return len(t.entries) < t.limit || key > t.keys[0]
+}
+
+func (t *histoTop) add(e histoEntry, key int64) {
+	if len(t.entries) < t.limit {
+		t.entries, t.keys = append(t.entries, e), append(t.keys, key)
+		heap.Fix(t, len(t.entries)-1)
+		return
+	}
+	if key > t.keys[0] {
+		t.entries[0], t.keys[0] = e, key
+		heap.Fix(t, 0)
+	}
+}
+
+// sorted returns the entries by descending key.
+func (t *histoTop) sorted() []histoEntry {
+	index := make([]int, len(t.entries))
+	for i := range index {
+		index[i] = i
+	}
+	sort.Slice(index, func(i, j int) bool {
+		a, b := index[i], index[j]
+		if t.keys[a] != t.keys[b] {
+			return t.keys[a] > t.keys[b]
+		}
+		return t.entries[a].name < t.entries[b].name
+	})
+	entries := make([]histoEntry, len(index))
+	for i, j := range index {
+		entries[i] = t.entries[j]
+	}
+	return entries
+}
+
+// writeHisto writes the entries in the layout of jmap -histo, with signed counts for a diff.
+func writeHisto(w io.Writer, entries []histoEntry, total histoCount, diff bool) {
+	format := "%4d: %14d %14d  %s\n"
+	totalFormat := "Total %14d %14d\n"
+	if diff {
+		format = "%4d: %+14d %+14d  %s\n"
+		totalFormat = "Total %+14d %+14d\n"
+		fmt.Fprintf(w, " num    +#instances        +#bytes  class name (module)\n")
+	} else {
+		fmt.Fprintf(w, " num     #instances         #bytes  class name (module)\n")
+	}
+	fmt.Fprintf(w, "-------------------------------------------------------\n")
+	for i, e := range entries {
+		fmt.Fprintf(w, format, i+1, e.instances, e.bytes, e.name)
+	}
+	fmt.Fprintf(w, totalFormat, total.instances, total.bytes)
+}
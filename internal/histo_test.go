@@ -0,0 +1,150 @@
+package internal
+
+import (
+	"bytes"
+	"fmt"
+	"os"
+	"os/user"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// testHisto is a heap histogram as sent by inspectheap.
+const testHisto = ` num     #instances         #bytes  class name (module)
+-------------------------------------------------------
+   1:         50000        4000000  [B (java.base@17.0.9)
+   2:         40000         960000  java.lang.String (java.base@17.0.9)
+   3:          1000         320000  com.example.Session
+   4:            10            480  java.lang.Object (java.base@17.0.9)
+Total         91010        5280480
+`
+
+// TestParseHistoFlags tests the ParseHistoFlags function.
+func TestParseHistoFlags(t *testing.T) {
+	opt, err := ParseHistoFlags([]string{"-live", "-top", "5", "-diff", "1m", "12345"})
+	assert.Nil(t, err)
+	assert.Equal(t, HistoOption{Pid: "12345", Live: true, Top: 5, Diff: time.Minute}, opt)
+}
+
+// TestHistoValidate tests the HistoValidate method of HistoOption.
+func TestHistoValidate(t *testing.T) {
+	opt := HistoOption{Pid: "1"}
+	assert.EqualError(t, opt.HistoValidate(), "top must be positive")
+	opt = HistoOption{Pid: "1", Top: 1, Diff: -time.Second}
+	assert.EqualError(t, opt.HistoValidate(), "diff must not be negative")
+	opt = HistoOption{Top: 1}
+	assert.EqualError(t, opt.HistoValidate(), "pid is required")
+	opt = HistoOption{Top: 1, Pid: "x"}
+	assert.EqualError(t, opt.HistoValidate(), "invalid pid x")
+}
+
+// TestParseHistoLine tests parsing class and total lines of a histogram.
+func TestParseHistoLine(t *testing.T) {
+	name, c, ok := parseHistoLine([]byte("   1:         50000        4000000  [B (java.base@17.0.9)\n"))
+	assert.True(t, ok)
+	assert.Equal(t, "[B (java.base@17.0.9)", string(name))
+	assert.Equal(t, histoCount{50000, 4000000}, c)
+	for _, line := range []string{" num     #instances         #bytes  class name (module)\n", "-------\n", "   1:  x  1  A\n", "   1:  1  1\n", "Total 1 2\n"} {
+		_, _, ok := parseHistoLine([]byte(line))
+		assert.False(t, ok, line)
+	}
+	total, ok := parseHistoTotal([]byte("Total         91010        5280480\n"))
+	assert.True(t, ok)
+	assert.Equal(t, histoCount{91010, 5280480}, total)
+}
+
+// TestHistoTop tests that only the entries with the largest keys are kept, in order.
+func TestHistoTop(t *testing.T) {
+	top := newHistoTop(3)
+	for _, key := range []int64{5, 1, 9, 3, 7, 2, 8} {
+		if top.accepts(key) {
+			top.add(histoEntry{name: strconv.FormatInt(key, 10)}, key)
+		}
+	}
+	var names []string
+	for _, e := range top.sorted() {
+		names = append(names, e.name)
+	}
+	assert.Equal(t, []string{"9", "8", "7"}, names)
+}
+
+// startMockHistoListener serves the histograms in turn, the last one repeatedly, and
+// records the arguments. The output goes to the returned buffer.
+func startMockHistoListener(t *testing.T, histos ...string) (*[]string, *bytes.Buffer) {
+	restore, _, _ := captureLogs()
+	t.Cleanup(restore)
+	u, _ := user.Current()
+	pid := os.Getpid()
+	_, cleanupPerf, err := prepareHsperfdataFile(u.Username, pid)
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	t.Cleanup(cleanupPerf)
+	var calls atomic.Int32
+	var gotArgs []string
+	cleanup, err := startMockAttachListener(int32(pid), func(cmd string, args []string) string {
+		gotArgs = append([]string{cmd}, args...)
+		i := min(int(calls.Add(1)), len(histos)) - 1
+		return "0\n" + histos[i]
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	t.Cleanup(cleanup)
+	var out bytes.Buffer
+	orig := attachOutput
+	attachOutput = &out
+	t.Cleanup(func() { attachOutput = orig })
+	return &gotArgs, &out
+}
+
+// TestHisto tests showing the top classes of a histogram.
+func TestHisto(t *testing.T) {
+	gotArgs, out := startMockHistoListener(t, testHisto)
+
+	code := Histo(HistoOption{Pid: strconv.Itoa(os.Getpid()), Live: true, Top: 2})
+	assert.Equal(t, 0, code)
+	assert.Equal(t, []string{attachCmdInspectHeap, "-live", "", ""}, *gotArgs)
+	expected := ` num     #instances         #bytes  class name (module)
+-------------------------------------------------------
+   1:          50000        4000000  [B (java.base@17.0.9)
+   2:          40000         960000  java.lang.String (java.base@17.0.9)
+Total          91010        5280480
+`
+	assert.Equal(t, expected, out.String())
+}
+
+// TestHisto_Diff tests showing the classes that grew the most between two histograms.
+func TestHisto_Diff(t *testing.T) {
+	grown := strings.NewReplacer(
+		"1000         320000  com.example.Session", "5000        1600000  com.example.Session",
+		"40000         960000", "40100         962400",
+		"50000        4000000", "40000        3000000",
+		"Total         91010        5280480", "Total         85110        5562880",
+	).Replace(testHisto)
+	gotArgs, out := startMockHistoListener(t, testHisto, grown+"   5:             1             16  com.example.New\n")
+
+	code := Histo(HistoOption{Pid: strconv.Itoa(os.Getpid()), Top: 10, Diff: time.Millisecond})
+	assert.Equal(t, 0, code)
+	assert.Equal(t, []string{attachCmdInspectHeap, "-all", "", ""}, *gotArgs)
+	lines := strings.Split(strings.TrimSuffix(out.String(), "\n"), "\n")
+	assert.Equal(t, []string{
+		" num    +#instances        +#bytes  class name (module)",
+		"-------------------------------------------------------",
+		"   1:          +4000       +1280000  com.example.Session",
+		"   2:           +100          +2400  java.lang.String (java.base@17.0.9)",
+		"   3:             +1            +16  com.example.New",
+		fmt.Sprintf("Total %+14d %+14d", -5900, 282400),
+	}, lines)
+}
+
+// TestHisto_Truncated tests that a histogram without its total line is an error.
+func TestHisto_Truncated(t *testing.T) {
+	startMockHistoListener(t, strings.Split(testHisto, "Total")[0])
+	assert.Equal(t, 1, Histo(HistoOption{Pid: strconv.Itoa(os.Getpid()), Top: 10}))
+}
@@ -1,29 +1,56 @@
 package internal
 
 import (
+	"bufio"
+	"context"
+	"errors"
 	"flag"
 	"fmt"
-	"os"
-	"os/user"
+	"io"
+	"path/filepath"
 	"strconv"
+	"strings"
+	"time"
 
 	"github.com/XHao/jvmtool/pkg"
-	"github.com/shirou/gopsutil/process"
 )
 
+// defaultAttachConcurrency is the number of JVMs attached to at once when fanning out.
+const defaultAttachConcurrency = 16
+
 type JattachOption struct {
 	User        string
-	Pid         string
+	Pid         string        // a single pid or a comma separated list
+	All         bool          // -all
+	MainClass   string        // -main
+	Concurrency int           // -concurrency
+	Jitter      time.Duration // -jitter
+	GCGate      time.Duration // -gc-gate
+	Sensitive   string        // -sensitive
+	Trace       bool          // -trace
+	Containers  bool          // -containers
+	Output      string        // -o, text or ndjson
 	AgentPath   string
 	AgentParams string
+
+	pids []int32 // parsed from Pid by JattachValidate
 }
 
 // ParseJattachFlags parses flags for the "jattach" command and returns the corresponding JattachOption.
 func ParseJattachFlags(args []string) (JattachOption, error) {
 	jattachFlagSet := flag.NewFlagSet("jattach", flag.ContinueOnError)
 	user := jattachFlagSet.String("user", "", "specify the user to attach to")
-	pid := jattachFlagSet.String("pid", "", "specify the pid of the Java process to attach to")
-	agentPath := jattachFlagSet.String("agentpath", "", "specify the path to the Java agent jar")
+	pid := jattachFlagSet.String("pid", "", "specify the pid, or a comma separated list of pids, of the Java process to attach to")
+	all := jattachFlagSet.Bool("all", false, "attach to every Java process of the user")
+	mainClass := jattachFlagSet.String("main", "", "attach to every Java process of the user whose main class or jar matches")
+	concurrency := jattachFlagSet.Int("concurrency", defaultAttachConcurrency, "maximum number of Java processes attached to at once on the host")
+	jitter := jattachFlagSet.Duration("jitter", 0, "delay each attach by a random duration up to this")
+	gcGate := jattachFlagSet.Duration("gc-gate", 0, "wait up to this long for the target to finish a garbage collection")
+	sensitive := jattachFlagSet.String("sensitive", "", "attach to the Java processes whose main class or jar matches a name of this comma separated list last, one at a time")
+	trace := jattachFlagSet.Bool("trace", false, "print how long each phase of the attach took")
+	containers := jattachFlagSet.Bool("containers", false, "with -all or -main, also attach to the Java processes running in containers")
+	output := jattachFlagSet.String("o", jpsOutputText, "output format of the results: text or ndjson")
+	agentPath := jattachFlagSet.String("agentpath", "", "specify the path to the Java agent jar or native agent library (.so)")
 	agentParams := jattachFlagSet.String("agentparams", "", "specify the parameters for the Java agent")
 	if err := jattachFlagSet.Parse(args); err != nil {
 		return JattachOption{}, err
@@ -31,43 +58,130 @@ func ParseJattachFlags(args []string) (JattachOption, error) {
 	return JattachOption{
 		User:        *user,
 		Pid:         *pid,
+		All:         *all,
+		MainClass:   *mainClass,
+		Concurrency: *concurrency,
+		Jitter:      *jitter,
+		GCGate:      *gcGate,
+		Sensitive:   *sensitive,
+		Trace:       *trace,
+		Containers:  *containers,
+		Output:      *output,
 		AgentPath:   *agentPath,
 		AgentParams: *agentParams,
 	}, nil
 }
 
 // JattachValidate validates the JattachOption fields.
+// A single pid is fully checked here; pids of a list, and every pid with ndjson output,
+// are checked when attaching so that a bad pid is reported in the results instead of
+// aborting the others.
 func (opt *JattachOption) JattachValidate() error {
 	if opt.AgentPath == "" {
 		return fmt.Errorf("agentpath is required")
 	}
-	if opt.User == "" {
-		currentUser, err := user.Current()
+	if opt.Output != "" && opt.Output != jpsOutputText && opt.Output != jpsOutputNDJSON {
+		return fmt.Errorf("unsupported output format: %s", opt.Output)
+	}
+	if isNativeAgent(opt.AgentPath) {
+		// The target resolves native libraries against its own working directory.
+		abs, err := filepath.Abs(opt.AgentPath)
 		if err != nil {
 			return err
 		}
-		opt.User = currentUser.Username
-	} else {
-		_, err := user.Lookup(opt.User)
-		if err != nil {
-			return err
+		opt.AgentPath = abs
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+
+	selectors := 0
+	for _, set := range []bool{opt.Pid != "", opt.All, opt.MainClass != ""} {
+		if set {
+			selectors++
 		}
 	}
-	if opt.Pid == "" {
+	if selectors == 0 {
 		return fmt.Errorf("pid is required")
 	}
+	if selectors > 1 {
+		return errors.New("only one of -pid, -all and -main can be used")
+	}
+	if opt.Concurrency <= 0 {
+		opt.Concurrency = defaultAttachConcurrency
+	}
+	if opt.Jitter < 0 || opt.GCGate < 0 {
+		return errors.New("-jitter and -gc-gate cannot be negative")
+	}
+	if opt.Pid == "" {
+		return nil
+	}
 
-	_, err := process.NewProcess(toInt32(opt.Pid))
-	if err != nil {
-		return fmt.Errorf("process not found")
+	opt.pids = opt.pids[:0]
+	for _, s := range strings.Split(opt.Pid, ",") {
+		pid, err := strconv.Atoi(strings.TrimSpace(s))
+		if err != nil || pid <= 0 {
+			return fmt.Errorf("invalid pid %s", s)
+		}
+		opt.pids = append(opt.pids, int32(pid))
 	}
-	pidFile := os.TempDir() + "/hsperfdata_" + opt.User + "/" + fmt.Sprint(opt.Pid)
-	if !pkg.PathExists(pidFile) {
-		return fmt.Errorf("pid does not belong to the specified user")
+	if len(opt.pids) == 1 && opt.Output != jpsOutputNDJSON {
+		return opt.validatePid(opt.pids[0])
 	}
 	return nil
 }
 
+// validatePid checks that pid is a live process owned by the option's user.
+func (opt *JattachOption) validatePid(pid int32) error {
+	return validateJvmPid(opt.User, pid)
+}
+
+// targets returns the JVMs to attach to, discovering them for -all and -main.
+func (opt *JattachOption) targets() []attachTarget {
+	targets := []attachTarget{}
+	if opt.Pid != "" {
+		for _, pid := range opt.pids {
+			target := attachTarget{process: JvmProcess{Pid: pid}}
+			target.process.resolveStartTime()
+			if opt.Sensitive != "" {
+				if cmdline, err := pkg.ReadCmdline(pid); err == nil {
+					jp := JvmProcess{mainClassOrJar: parseJavaCommand(cmdline.Line, cmdline.Args, nil).Main}
+					target.priority = opt.priority(&jp)
+				}
+			}
+			targets = append(targets, target)
+		}
+		return targets
+	}
+	procs, _ := listJvmProcesses(JpsOption{User: opt.User, Containers: opt.Containers, startTime: true})
+	for i, p := range procs {
+		if opt.All || p.matchMainClass(opt.MainClass) {
+			targets = append(targets, attachTarget{process: p, priority: opt.priority(&procs[i])})
+		}
+	}
+	return targets
+}
+
+// priority returns the priority class of the JVM, sensitive if it matches a name of -sensitive.
+func (opt *JattachOption) priority(jp *JvmProcess) int {
+	if opt.Sensitive == "" {
+		return attachPriorityNormal
+	}
+	for _, name := range strings.Split(opt.Sensitive, ",") {
+		if jp.matchMainClass(strings.TrimSpace(name)) {
+			return attachPrioritySensitive
+		}
+	}
+	return attachPriorityNormal
+}
+
+// scheduler returns the scheduler the attaches of the option go through.
+func (opt *JattachOption) scheduler() attachScheduler {
+	return attachScheduler{concurrency: opt.Concurrency, jitter: opt.Jitter, gcGate: opt.GCGate}
+}
+
 // toInt32 converts a string to int32, returns 0 if conversion fails.
 func toInt32(s string) int32 {
 	n, _ := strconv.Atoi(s)
@@ -75,21 +189,143 @@ func toInt32(s string) int32 {
 }
 
 // Jattach performs the attach operation to a Java process specified by the JattachOption.
+// When several processes are selected, they are attached to concurrently and a
+// result table is printed at the end. With ndjson output, one record per process is
+// written instead, whatever the number of processes.
 func Jattach(option JattachOption) int {
+	trace := NewAttachTrace()
 	if err := option.JattachValidate(); err != nil {
 		log(err.Error())
 		return 1
 	}
+	trace.Done(PhaseValidate)
 
-	jp := &JvmProcess{
-		Pid: toInt32(option.Pid),
+	targets := option.targets()
+	if len(targets) == 0 {
+		log("no java process")
+		return 1
+	}
+	if option.Pid != "" && len(targets) == 1 && option.Output != jpsOutputNDJSON {
+		jp := &targets[0].process
+		jp.trace = trace
+		release, err := option.scheduler().admit(context.Background(), jp, option.User)
+		if err == nil {
+			err = jp.checkSocket()
+			if err == nil {
+				log("waiting for attach to complete...")
+				err = jp.loadAgent(option.AgentPath, option.AgentParams)
+			}
+			release()
+		}
+		trace.Finish()
+		if err != nil {
+			log(err.Error())
+		} else {
+			log("attach operation completed")
+		}
+		if option.Trace {
+			log("attach trace:")
+			for _, line := range trace.Breakdown() {
+				log(line)
+			}
+		}
+		if err != nil {
+			return 1
+		}
+		return 0
 	}
 
-	if err := jp.checkSocket(); err != nil {
-		log(err.Error())
+	results := option.scheduler().run(targets, option.attach)
+	if option.Output == jpsOutputNDJSON {
+		return writeAttachRecords(attachOutput, results, option.Trace)
+	}
+	return printAttachResults(results, option.Trace)
+}
+
+// attachResult is the outcome of attaching to one process during a fan-out.
+type attachResult struct {
+	pid     int32
+	err     error
+	elapsed time.Duration
+	trace   *AttachTrace
+}
+
+// attach validates jp and loads the agent into it once the scheduler admits it.
+func (opt *JattachOption) attach(jp JvmProcess) attachResult {
+	start := time.Now()
+	trace := NewAttachTrace()
+	jp.trace = trace
+	err := opt.validatePid(jp.Pid)
+	trace.Done(PhaseValidate)
+	if err == nil {
+		var release func()
+		if release, err = opt.scheduler().admit(context.Background(), &jp, opt.User); err == nil {
+			err = jp.checkSocket()
+			if err == nil {
+				err = jp.loadAgent(opt.AgentPath, opt.AgentParams)
+			}
+			release()
+		}
+	}
+	trace.Finish()
+	return attachResult{pid: jp.Pid, err: err, elapsed: time.Since(start), trace: trace}
+}
+
+// printAttachResults prints one row per process, optionally followed by the phase
+// timings of each, and returns 1 if any attach failed.
+func printAttachResults(results []attachResult, showTrace bool) int {
+	failed := 0
+	log(fmt.Sprintf("%-10s %-8s %10s  %s", "PID", "RESULT", "TIME(ms)", "MESSAGE"))
+	for _, r := range results {
+		status, message := "ok", ""
+		if r.err != nil {
+			status, message = "failed", r.err.Error()
+			failed++
+		}
+		log(strings.TrimSpace(fmt.Sprintf("%-10d %-8s %10d  %s", r.pid, status, r.elapsed.Milliseconds(), message)))
+	}
+	if showTrace {
+		for _, r := range results {
+			log(fmt.Sprintf("trace %d %s", r.pid, r.trace.Summary()))
+		}
+	}
+	log(fmt.Sprintf("attached %d/%d", len(results)-failed, len(results)))
+	if failed > 0 {
 		return 1
-	} else if err := jp.loadAgent(option.AgentPath, option.AgentParams); err != nil {
-		log(err.Error())
+	}
+	return 0
+}
+
+// writeAttachRecords writes one ndjson record per process and returns 1 if any
+// attach failed, e.g. {"pid":12345,"result":"ok","time_ms":42}.
+func writeAttachRecords(w io.Writer, results []attachResult, showTrace bool) int {
+	bw := bufio.NewWriter(w)
+	defer bw.Flush()
+	failed := 0
+	buf := make([]byte, 0, 256)
+	for _, r := range results {
+		buf = append(buf[:0], `{"pid":`...)
+		buf = strconv.AppendInt(buf, int64(r.pid), 10)
+		if r.err != nil {
+			failed++
+			buf = append(buf, `,"result":"failed"`...)
+		} else {
+			buf = append(buf, `,"result":"ok"`...)
+		}
+		buf = append(buf, `,"time_ms":`...)
+		buf = strconv.AppendInt(buf, r.elapsed.Milliseconds(), 10)
+		if r.err != nil {
+			buf = append(buf, `,"error":`...)
+			buf = appendJSONString(buf, r.err.Error())
+		}
+		if showTrace {
+			buf = append(buf, `,"trace":`...)
+			buf = appendJSONString(buf, r.trace.Summary())
+		}
+		buf = append(buf, "}\n"...)
+		bw.Write(buf)
+	}
+	if failed > 0 {
 		return 1
 	}
 	return 0
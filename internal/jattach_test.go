@@ -1,10 +1,18 @@
 package internal
 
 import (
+	"bytes"
+	"encoding/json"
+	"fmt"
 	"os"
+	"os/exec"
 	"os/user"
 	"strconv"
+	"strings"
 	"testing"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
 )
 
 // TestParseJattachFlags tests the ParseJattachFlags function.
@@ -14,6 +22,9 @@ func TestParseJattachFlags(t *testing.T) {
 		"-pid", "12345",
 		"-agentpath", "/tmp/agent.jar",
 		"-agentparams", "foo=bar",
+		"-jitter", "100ms",
+		"-gc-gate", "1s",
+		"-sensitive", "Trading,Pricing",
 	}
 	opt, err := ParseJattachFlags(args)
 	if err != nil {
@@ -31,6 +42,15 @@ func TestParseJattachFlags(t *testing.T) {
 	if opt.AgentParams != "foo=bar" {
 		t.Errorf("expected agentparams 'foo=bar', got '%s'", opt.AgentParams)
 	}
+	if opt.Jitter != 100*time.Millisecond || opt.GCGate != time.Second || opt.Sensitive != "Trading,Pricing" {
+		t.Errorf("expected the scheduling flags, got %v %v %q", opt.Jitter, opt.GCGate, opt.Sensitive)
+	}
+	if p := opt.priority(&JvmProcess{mainClassOrJar: "com.example.Pricing"}); p != attachPrioritySensitive {
+		t.Errorf("expected a matching main class to be sensitive, got %d", p)
+	}
+	if p := opt.priority(&JvmProcess{mainClassOrJar: "com.example.Batch"}); p != attachPriorityNormal {
+		t.Errorf("expected other main classes to be normal, got %d", p)
+	}
 }
 
 // TestJattachValidate tests the JattachValidate method of JattachOption.
@@ -61,6 +81,44 @@ func TestJattachValidate(t *testing.T) {
 			},
 			expected: "pid is required",
 		},
+		{
+			name: "invalid pid list",
+			option: JattachOption{
+				User:      u.Username,
+				Pid:       "12345,abc",
+				AgentPath: "/tmp/agent.jar",
+			},
+			expected: "invalid pid abc",
+		},
+		{
+			name: "pid list",
+			option: JattachOption{
+				User:      u.Username,
+				Pid:       "12345,12346",
+				AgentPath: "/tmp/agent.jar",
+			},
+			expected: "",
+		},
+		{
+			name: "negative jitter",
+			option: JattachOption{
+				User:      u.Username,
+				Pid:       "12345,12346",
+				Jitter:    -time.Second,
+				AgentPath: "/tmp/agent.jar",
+			},
+			expected: "-jitter and -gc-gate cannot be negative",
+		},
+		{
+			name: "conflicting selectors",
+			option: JattachOption{
+				User:      u.Username,
+				Pid:       "12345",
+				All:       true,
+				AgentPath: "/tmp/agent.jar",
+			},
+			expected: "only one of -pid, -all and -main can be used",
+		},
 		{
 			name: "missing agentpath",
 			option: JattachOption{
@@ -83,3 +141,156 @@ func TestJattachValidate(t *testing.T) {
 		})
 	}
 }
+
+// TestJattach_FanOut tests that a pid list is attached to concurrently and reported per pid.
+func TestJattach_FanOut(t *testing.T) {
+	restore, getLogs, clearLogs := captureLogs()
+	defer restore()
+
+	u, _ := user.Current()
+	clearLogs()
+	code := Jattach(JattachOption{
+		User:        u.Username,
+		Pid:         strconv.Itoa(os.Getpid()) + ",999999",
+		Concurrency: 2,
+		AgentPath:   "/tmp/agent.jar",
+	})
+	if code != 1 {
+		t.Errorf("expected exit code 1, got %d", code)
+	}
+	logs := getLogs()
+	if len(logs) != 4 {
+		t.Fatalf("expected header, 2 rows and summary, got %v", logs)
+	}
+	if !strings.Contains(logs[1], "pid does not belong to the specified user") || !strings.Contains(logs[2], "process not found") {
+		t.Errorf("expected per-pid failures in order, got %v", logs)
+	}
+	if logs[3] != "attached 0/2" {
+		t.Errorf("expected summary 'attached 0/2', got %q", logs[3])
+	}
+}
+
+// TestJattach_NDJSON tests that ndjson output has one record per pid, even for a single pid.
+func TestJattach_NDJSON(t *testing.T) {
+	restore, _, _ := captureLogs()
+	defer restore()
+	var out bytes.Buffer
+	attachOutput = &out
+	defer func() { attachOutput = os.Stdout }()
+
+	u, _ := user.Current()
+	code := Jattach(JattachOption{
+		User:      u.Username,
+		Pid:       strconv.Itoa(os.Getpid()) + ",999999",
+		Output:    jpsOutputNDJSON,
+		AgentPath: "/tmp/agent.jar",
+	})
+	if code != 1 {
+		t.Errorf("expected exit code 1, got %d", code)
+	}
+	lines := strings.Split(strings.TrimSuffix(out.String(), "\n"), "\n")
+	if len(lines) != 2 {
+		t.Fatalf("expected 2 records, got %q", out.String())
+	}
+	for i, pid := range []int{os.Getpid(), 999999} {
+		var r struct {
+			Pid    int    `json:"pid"`
+			Result string `json:"result"`
+			Error  string `json:"error"`
+		}
+		if err := json.Unmarshal([]byte(lines[i]), &r); err != nil {
+			t.Fatalf("invalid json %q: %v", lines[i], err)
+		}
+		if r.Pid != pid || r.Result != "failed" || r.Error == "" {
+			t.Errorf("expected a failure of %d, got %+v", pid, r)
+		}
+	}
+
+	out.Reset()
+	Jattach(JattachOption{User: u.Username, Pid: "999999", Output: jpsOutputNDJSON, AgentPath: "/tmp/agent.jar"})
+	if !strings.HasPrefix(out.String(), `{"pid":999999,"result":"failed"`) {
+		t.Errorf("expected a record for a single pid, got %q", out.String())
+	}
+}
+
+// TestJattach_Targets tests that the processes to attach to carry their start
+// time, and that a process whose start time changed is not signalled.
+func TestJattach_Targets(t *testing.T) {
+	u, _ := user.Current()
+	pid := int32(os.Getpid())
+	_, cleanup, err := prepareHsperfdataFile(u.Username, int(pid))
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+	for _, opt := range []JattachOption{{User: u.Username, Pid: strconv.Itoa(int(pid)), AgentPath: "/tmp/agent.jar"}, {User: u.Username, All: true, AgentPath: "/tmp/agent.jar"}} {
+		if err := opt.JattachValidate(); err != nil {
+			t.Fatalf("JattachValidate failed: %v", err)
+		}
+		found := false
+		for _, target := range opt.targets() {
+			if target.process.Pid == pid {
+				found = true
+				if target.process.startTime == 0 {
+					t.Errorf("expected the start time of %+v to be resolved", opt)
+				}
+			}
+		}
+		if !found {
+			t.Errorf("expected %d to be a target of %+v", pid, opt)
+		}
+	}
+
+	// Our pid, as if it had been reused since the listing.
+	opt := JattachOption{User: u.Username, AgentPath: "/tmp/agent.jar", Concurrency: 1}
+	r := opt.attach(JvmProcess{Pid: pid, startTime: 1})
+	if r.err == nil || r.err.Error() != fmt.Sprintf("java process %d has exited, its pid was reused", pid) {
+		t.Errorf("expected the reused pid to be refused, got %v", r.err)
+	}
+}
+
+// BenchmarkAttach measures loading an agent into N mock JVMs at once, from the
+// socket check to the Agent_OnAttach result, with the default concurrency.
+func BenchmarkAttach(b *testing.B) {
+	for _, n := range []int{1, 16, 64} {
+		b.Run("jvms="+strconv.Itoa(n), func(b *testing.B) {
+			b.Setenv("TMPDIR", b.TempDir())
+			// Processes of ours, as the socket must belong to the user of the JVM. The
+			// listeners are up already, so no signal is ever sent to them.
+			pids := make([]int32, n)
+			for i := range pids {
+				cmd := exec.Command("/bin/sh", "-c", "trap '' QUIT; sleep 60")
+				if err := cmd.Start(); err != nil {
+					b.Fatalf("failed to start process: %v", err)
+				}
+				defer cmd.Wait()
+				defer cmd.Process.Kill()
+				pids[i] = int32(cmd.Process.Pid)
+				cleanup, err := startMockAttachListener(pids[i], func(cmd string, args []string) string {
+					return "0\n0\n"
+				})
+				if err != nil {
+					b.Fatalf("failed to start mock attach listener: %v", err)
+				}
+				defer cleanup()
+			}
+			b.ReportAllocs()
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				errs := make([]error, n)
+				pkg.ParallelFor(n, defaultAttachConcurrency, func(j int) {
+					jp := &JvmProcess{Pid: pids[j]}
+					if errs[j] = jp.checkSocket(); errs[j] == nil {
+						errs[j] = jp.loadAgent("/tmp/agent.jar", "")
+					}
+				})
+				for _, err := range errs {
+					if err != nil {
+						b.Fatal(err)
+					}
+				}
+			}
+			b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*n), "ns/attach")
+		})
+	}
+}
@@ -0,0 +1,84 @@
+package internal
+
+import (
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"strconv"
+	"strings"
+)
+
+type JcmdOption struct {
+	User    string
+	Pid     string
+	Command []string
+}
+
+// ParseJcmdFlags parses flags for the "jcmd" command and returns the corresponding JcmdOption.
+// The first positional argument is the pid, the rest form the diagnostic command.
+func ParseJcmdFlags(args []string) (JcmdOption, error) {
+	jcmdFlagSet := flag.NewFlagSet("jcmd", flag.ContinueOnError)
+	user := jcmdFlagSet.String("user", "", "specify the user owning the Java process")
+	if err := jcmdFlagSet.Parse(args); err != nil {
+		return JcmdOption{}, err
+	}
+	opt := JcmdOption{User: *user, Pid: jcmdFlagSet.Arg(0)}
+	if jcmdFlagSet.NArg() > 1 {
+		opt.Command = jcmdFlagSet.Args()[1:]
+	}
+	return opt, nil
+}
+
+// JcmdValidate validates the JcmdOption fields.
+func (opt *JcmdOption) JcmdValidate() error {
+	if opt.Pid == "" {
+		return errors.New("pid is required")
+	}
+	if pid, err := strconv.Atoi(opt.Pid); err != nil || pid <= 0 {
+		return fmt.Errorf("invalid pid %s", opt.Pid)
+	}
+	if len(opt.Command) == 0 {
+		return errors.New("command is required")
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+	return validateJvmPid(opt.User, toInt32(opt.Pid))
+}
+
+// Jcmd sends a diagnostic command to a Java process and streams its output.
+func Jcmd(option JcmdOption) int {
+	if err := option.JcmdValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	jp := &JvmProcess{Pid: toInt32(option.Pid)}
+	if err := jp.checkSocket(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	return executeAttachCommand(jp.attachClient(), attachCmdJcmd, strings.Join(option.Command, " "))
+}
+
+// executeAttachCommand runs an attach command and copies its output to attachOutput.
+// Returns 1 if the command could not be sent or the JVM reported a failure.
+func executeAttachCommand(client *AttachClient, cmd string, args ...string) int {
+	resp, err := client.Execute(cmd, args...)
+	if err != nil {
+		log(err.Error())
+		return 1
+	}
+	defer resp.Close()
+	if _, err := io.Copy(attachOutput, resp); err != nil {
+		log(err.Error())
+		return 1
+	}
+	if resp.Code != 0 {
+		log(fmt.Sprintf("command %s failed, return code: %d", cmd, resp.Code))
+		return 1
+	}
+	return 0
+}
@@ -0,0 +1,63 @@
+package internal
+
+import (
+	"bytes"
+	"os"
+	"os/user"
+	"strconv"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// TestParseJcmdFlags tests the ParseJcmdFlags function.
+func TestParseJcmdFlags(t *testing.T) {
+	opt, err := ParseJcmdFlags([]string{"-user", "alice", "12345", "GC.heap_info", "-all"})
+	assert.Nil(t, err)
+	assert.Equal(t, "alice", opt.User)
+	assert.Equal(t, "12345", opt.Pid)
+	assert.Equal(t, []string{"GC.heap_info", "-all"}, opt.Command)
+}
+
+// TestJcmdValidate tests the JcmdValidate method of JcmdOption.
+func TestJcmdValidate(t *testing.T) {
+	opt := JcmdOption{}
+	assert.EqualError(t, opt.JcmdValidate(), "pid is required")
+	opt = JcmdOption{Pid: "x", Command: []string{"VM.flags"}}
+	assert.EqualError(t, opt.JcmdValidate(), "invalid pid x")
+	opt = JcmdOption{Pid: "12345"}
+	assert.EqualError(t, opt.JcmdValidate(), "command is required")
+}
+
+// TestJcmd tests running a diagnostic command against a mock attach listener.
+func TestJcmd(t *testing.T) {
+	restore, _, _ := captureLogs()
+	defer restore()
+
+	u, _ := user.Current()
+	pid := os.Getpid()
+	_, cleanupPerf, err := prepareHsperfdataFile(u.Username, pid)
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanupPerf()
+	var gotArgs []string
+	cleanup, err := startMockAttachListener(int32(pid), func(cmd string, args []string) string {
+		gotArgs = args
+		return "0\n-XX:+UseG1GC\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	var out bytes.Buffer
+	orig := attachOutput
+	attachOutput = &out
+	defer func() { attachOutput = orig }()
+
+	code := Jcmd(JcmdOption{Pid: strconv.Itoa(pid), Command: []string{"VM.flags", "-all"}})
+	assert.Equal(t, 0, code)
+	assert.Equal(t, "-XX:+UseG1GC\n", out.String())
+	assert.Equal(t, "VM.flags -all", gotArgs[0])
+}
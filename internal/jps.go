@@ -9,9 +9,9 @@ import (
 	"path/filepath"
 	"strconv"
 	"strings"
+	"syscall"
 
 	"github.com/XHao/jvmtool/pkg"
-	"github.com/shirou/gopsutil/process"
 )
 
 // ParseJpsFlags parses flags for the "jps" command and returns the corresponding JpsOption.
@@ -22,6 +22,10 @@ func ParseJpsFlags(args []string) (JpsOption, error) {
 	showVMArgs := jpsFlagSet.Bool("v", false, "show JVM arguments")
 	showArgs := jpsFlagSet.Bool("m", false, "show main method arguments")
 	quiet := jpsFlagSet.Bool("q", false, "only show process id")
+	output := jpsFlagSet.String("o", jpsOutputText, "output format: text, json, ndjson or tsv")
+	allUsers := jpsFlagSet.Bool("all-users", false, "list the Java processes of every user")
+	containers := jpsFlagSet.Bool("containers", false, "also list the Java processes running in containers")
+	watch := jpsFlagSet.Bool("watch", false, "keep running and report Java processes as they start and exit")
 	if err := jpsFlagSet.Parse(args); err != nil {
 		return JpsOption{}, err
 	}
@@ -31,20 +35,48 @@ func ParseJpsFlags(args []string) (JpsOption, error) {
 		ShowVMArgs: *showVMArgs,
 		ShowArgs:   *showArgs,
 		Quiet:      *quiet,
+		Output:     *output,
+		Watch:      *watch,
+		AllUsers:   *allUsers,
+		Containers: *containers,
 	}, nil
 }
 
 type JpsOption struct {
 	User       string
-	ShowLong   bool // -l
-	ShowVMArgs bool // -v
-	ShowArgs   bool // -m
-	Quiet      bool // -q
+	ShowLong   bool   // -l
+	ShowVMArgs bool   // -v
+	ShowArgs   bool   // -m
+	Quiet      bool   // -q
+	Output     string // -o
+	Watch      bool   // -watch
+	AllUsers   bool   // -all-users
+	Containers bool   // -containers
+
+	startTime bool // resolve the start time also for text output, for processes to attach to
 }
 
 // JpsValidate checks if the JpsOption fields are valid.
-// Currently, it validates the User field if provided.
+// It validates the User field if provided; no user is resolved for -all-users.
 func (opt *JpsOption) JpsValidate() error {
+	if opt.Output != "" && opt.Output != jpsOutputText && !isStructuredOutput(opt.Output) {
+		return fmt.Errorf("unsupported output format: %s", opt.Output)
+	}
+	if opt.Watch && (opt.Output == jpsOutputJSON || opt.Output == jpsOutputTSV) {
+		return fmt.Errorf("-watch supports text and ndjson output only")
+	}
+	if opt.Watch && opt.Containers {
+		return errors.New("-watch cannot be used with -containers")
+	}
+	if opt.AllUsers {
+		if opt.User != "" {
+			return errors.New("only one of -user and -all-users can be used")
+		}
+		if opt.Watch {
+			return errors.New("-watch cannot be used with -all-users")
+		}
+		return nil
+	}
 	if opt.User != "" {
 		_, err := user.Lookup(opt.User)
 		if err != nil {
@@ -68,58 +100,225 @@ func JpsList(option JpsOption) int {
 		return 1
 	}
 
-	finded := []JvmProcess{}
-	tempDir := os.TempDir()
-
-	namePatternPrefix := tempDir + "/hsperfdata_" + option.User + "/"
-	fileNamePattern := namePatternPrefix + "*"
-	pids := []int32{}
-
-	files, err := filepath.Glob(fileNamePattern)
-	if err != nil || len(files) == 0 {
+	structured := isStructuredOutput(option.Output)
+	if structured {
+		// Machine-readable records always carry every field.
+		option.ShowLong, option.ShowVMArgs, option.ShowArgs = true, true, true
+	}
+	if option.Watch {
+		return JpsWatch(option)
+	}
+	finded, anyAlive := listJvmProcesses(option)
+	if structured {
+		// No process is an empty list of records, such as [], rather than an error.
+		if err := writeJpsRecords(jpsOutput, finded, option.Output); err != nil {
+			log(err.Error())
+			return 1
+		}
+		return 0
+	}
+	if !anyAlive {
 		log("no java process")
 		return 1
 	}
-	for _, file := range files {
-		index := strings.LastIndex(file, "/") + 1
+	for _, p := range finded {
+		printJps(p, option)
+	}
+	return 0
+}
 
-		if pid, err := strconv.Atoi(file[index:]); err != nil {
-			continue
-		} else if exist, _ := pkg.PidExists(int32(pid)); !exist {
-			continue
-		} else {
-			pids = append(pids, int32(pid))
+// hsperfdataPrefix is the name prefix of the per-user perfdata directories in the temp dir.
+const hsperfdataPrefix = "hsperfdata_"
+
+// hsperfdataEntry is a pid listed in the perfdata directory of a user.
+type hsperfdataEntry struct {
+	pid  int32
+	user string
+
+	// Set for JVMs found in a container, see listContainerPids.
+	root  string
+	nsPid int32
+}
+
+// listHsperfdataPids returns the pids listed in the perfdata directory of username, in directory order.
+func listHsperfdataPids(dir, username string) []hsperfdataEntry {
+	files, err := os.ReadDir(dir)
+	if err != nil {
+		return nil
+	}
+	entries := make([]hsperfdataEntry, 0, len(files))
+	for _, f := range files {
+		if pid, err := strconv.Atoi(f.Name()); err == nil {
+			entries = append(entries, hsperfdataEntry{pid: int32(pid), user: username})
 		}
 	}
+	return entries
+}
 
-	if len(pids) == 0 {
-		log("no java process")
-		return 1
+// listAllUsersPids reads the temp dir once and lists every hsperfdata_* directory
+// concurrently. Pids are deduplicated, as a stale file may survive in the directory
+// of a previous owner: the file owned by the user the process runs as wins, else
+// the most recently modified one. Pids keep the position of their first listing.
+// hostPid maps a listed pid to the pid of the process as seen from here.
+func listAllUsersPids(tempDir string, hostPid func(int32) (int32, bool)) []hsperfdataEntry {
+	dirs, err := os.ReadDir(tempDir)
+	if err != nil {
+		return nil
+	}
+	users := []string{}
+	for _, d := range dirs {
+		if d.IsDir() && strings.HasPrefix(d.Name(), hsperfdataPrefix) {
+			users = append(users, d.Name()[len(hsperfdataPrefix):])
+		}
+	}
+	perUser := make([][]hsperfdataEntry, len(users))
+	pkg.ParallelFor(len(users), 0, func(i int) {
+		perUser[i] = listHsperfdataPids(filepath.Join(tempDir, hsperfdataPrefix+users[i]), users[i])
+	})
+
+	entries := []hsperfdataEntry{}
+	index := map[int32]int{}
+	duplicated := map[int32][]hsperfdataEntry{}
+	for _, list := range perUser {
+		for _, e := range list {
+			if i, ok := index[e.pid]; ok {
+				if duplicated[e.pid] == nil {
+					duplicated[e.pid] = []hsperfdataEntry{entries[i]}
+				}
+				duplicated[e.pid] = append(duplicated[e.pid], e)
+				continue
+			}
+			index[e.pid] = len(entries)
+			entries = append(entries, e)
+		}
+	}
+	for pid, candidates := range duplicated {
+		entries[index[pid]] = pickHsperfdataOwner(tempDir, candidates, hostPid)
+	}
+	return entries
+}
+
+// sameHostPid is the hostPid of listAllUsersPids for the perfdata of our namespace.
+func sameHostPid(pid int32) (int32, bool) {
+	return pid, true
+}
+
+// pickHsperfdataOwner returns the entry, among those listed for the same pid by
+// several users, whose file is owned by the user the process runs as, falling
+// back to the most recently modified file.
+func pickHsperfdataOwner(tempDir string, candidates []hsperfdataEntry, hostPid func(int32) (int32, bool)) hsperfdataEntry {
+	uid, uidErr := -1, errors.New("no such process")
+	if pid, ok := hostPid(candidates[0].pid); ok {
+		uid, uidErr = pkg.ProcessUid(pid)
 	}
-	for _, pid := range pids {
-		p, err := process.NewProcess(pid)
+	newest, newestTime := candidates[0], int64(-1)
+	for _, e := range candidates {
+		fi, err := os.Lstat(filepath.Join(tempDir, hsperfdataPrefix+e.user, strconv.Itoa(int(e.pid))))
 		if err != nil {
 			continue
 		}
-		cmdSlice, _ := p.CmdlineSlice()
-		cmd := strings.Join(cmdSlice, " ")
-		mainClassOrJar, vmArgs, mainArgs := analyzeVmCmd(cmdSlice, option)
-		finded = append(finded, JvmProcess{Pid: p.Pid, Cmd: cmd, mainClassOrJar: mainClassOrJar, vmArgs: vmArgs, mainArgs: mainArgs})
+		if st, ok := fi.Sys().(*syscall.Stat_t); ok && uidErr == nil && int(st.Uid) == uid {
+			return e
+		}
+		if mtime := fi.ModTime().UnixNano(); mtime > newestTime {
+			newest, newestTime = e, mtime
+		}
 	}
+	return newest
+}
 
-	for _, p := range finded {
-		printJps(p, option)
+// listJvmProcesses discovers the Java processes of option.User, or of every user
+// with option.AllUsers, in directory order. With option.Containers the JVMs of every
+// user in every container follow, by host pid.
+// The second result reports whether any hsperfdata pid belongs to a live process.
+func listJvmProcesses(option JpsOption) ([]JvmProcess, bool) {
+	tempDir := os.TempDir()
+	var entries []hsperfdataEntry
+	if option.AllUsers {
+		entries = listAllUsersPids(tempDir, sameHostPid)
+	} else {
+		entries = listHsperfdataPids(filepath.Join(tempDir, hsperfdataPrefix+option.User), option.User)
 	}
-	return 0
+	if option.Containers {
+		entries = appendContainerPids(entries, listContainerPids())
+	}
+	if len(entries) == 0 {
+		return nil, false
+	}
+
+	// Liveness and cmdline resolution are independent per pid, so they run on a
+	// bounded pool; results are kept by index to preserve the listing order.
+	alive := make([]bool, len(entries))
+	resolved := make([]*JvmProcess, len(entries))
+	pkg.ParallelFor(len(entries), 0, func(i int) {
+		if exist, _ := pkg.PidExists(entries[i].pid); !exist {
+			return
+		}
+		alive[i] = true
+		resolved[i] = resolveJvmProcess(entries[i], option)
+	})
+
+	finded := []JvmProcess{}
+	anyAlive := false
+	for i, p := range resolved {
+		anyAlive = anyAlive || alive[i]
+		if p != nil {
+			finded = append(finded, *p)
+		}
+	}
+	return finded, anyAlive
+}
+
+// resolveJvmProcess reads the command line of the listed pid and extracts the jps fields from it,
+// unless only pids are printed. Returns nil if the process cannot be inspected.
+func resolveJvmProcess(e hsperfdataEntry, option JpsOption) *JvmProcess {
+	pid := e.pid
+	if option.Quiet && !isStructuredOutput(option.Output) {
+		// Only the pid is printed, so nothing is read from the process.
+		jp := &JvmProcess{Pid: pid, root: e.root, nsPid: e.nsPid}
+		jp.Username = e.user
+		return jp
+	}
+	// The start time is read first: should the pid be reused meanwhile, it is the
+	// process the command line was read from that gets refused on attach.
+	var startTime int64
+	if isStructuredOutput(option.Output) || option.startTime {
+		if start, err := pkg.ProcessStartTime(pid); err == nil {
+			startTime = start.UnixMilli()
+		}
+	}
+	cmdline, err := pkg.ReadCmdline(pid)
+	if err != nil {
+		return nil
+	}
+	mainClassOrJar, vmArgs, mainArgs := analyzeVmCmd(cmdline.Line, cmdline.Args, option, processArgFile(pid, e.root))
+	if option.ShowVMArgs {
+		// The launcher reads JDK_JAVA_OPTIONS in front of the command line options.
+		if env, ok, _ := pkg.ProcessEnv(pid, "JDK_JAVA_OPTIONS"); ok && strings.TrimSpace(env) != "" {
+			vmArgs = strings.TrimSpace(strings.TrimSpace(env) + " " + vmArgs)
+		}
+	}
+	jp := &JvmProcess{Pid: pid, Cmd: cmdline.Line, mainClassOrJar: mainClassOrJar, vmArgs: vmArgs, mainArgs: mainArgs}
+	jp.Username = e.user
+	jp.root, jp.nsPid = e.root, e.nsPid
+	jp.startTime = startTime
+	return jp
 }
 
 // printJps prints the information of a Java process according to the JpsOption.
 func printJps(process JvmProcess, option JpsOption) {
+	log(formatJps(process, option))
+}
+
+// formatJps formats the jps line of a Java process according to the JpsOption.
+func formatJps(process JvmProcess, option JpsOption) string {
 	if option.Quiet {
-		log(fmt.Sprintf("%d", process.Pid))
-		return
+		return fmt.Sprintf("%d", process.Pid)
 	}
 	output := fmt.Sprintf("%d", process.Pid)
+	if option.AllUsers {
+		output += fmt.Sprintf(" %s", process.Username)
+	}
 	if option.ShowLong {
 		output += fmt.Sprintf(" %s", process.Cmd)
 	} else {
@@ -131,44 +330,15 @@ func printJps(process JvmProcess, option JpsOption) {
 	if option.ShowArgs && process.mainArgs != "" {
 		output += fmt.Sprintf(" %s", process.mainArgs)
 	}
-	log(output)
+	return output
 }
 
-func analyzeVmCmd(cmdSlice []string, option JpsOption) (mainClassOrJar string, vmArgs string, mainArgs string) {
-	if len(cmdSlice) < 2 {
-		return
-	}
-	skipNext := false
-	for i := 1; i < len(cmdSlice); i++ {
-		arg := cmdSlice[i]
-		if skipNext {
-			skipNext = false
-			continue
-		}
-		if arg == "-cp" || arg == "-classpath" {
-			skipNext = true
-			continue
-		}
-		if arg == "-jar" && i+1 < len(cmdSlice) {
-			mainClassOrJar = cmdSlice[i+1]
-			if option.ShowArgs && i+2 < len(cmdSlice) {
-				mainArgs = strings.Join(cmdSlice[i+2:], " ")
-			}
-			break
-		}
-		if strings.HasPrefix(arg, "-") {
-			if option.ShowVMArgs {
-				vmArgs += arg + " "
-			}
-			continue
-		}
-		if mainClassOrJar == "" {
-			mainClassOrJar = arg
-			if option.ShowArgs && i+1 < len(cmdSlice) {
-				mainArgs = strings.Join(cmdSlice[i+1:], " ")
-			}
-			break
-		}
+// matchMainClass reports whether the main class or jar of the process matches filter.
+// The filter matches the full name, the simple class name or the jar file name.
+func (jp *JvmProcess) matchMainClass(filter string) bool {
+	name := jp.mainClassOrJar
+	if name == "" || filter == "" {
+		return false
 	}
-	return
+	return name == filter || strings.HasSuffix(name, "."+filter) || strings.HasSuffix(name, "/"+filter)
 }
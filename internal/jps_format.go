@@ -0,0 +1,154 @@
+package internal
+
+import (
+	"bufio"
+	"io"
+	"os"
+	"strconv"
+	"unicode/utf8"
+)
+
+// Output formats of the jps command.
+const (
+	jpsOutputText   = "text"
+	jpsOutputJSON   = "json"
+	jpsOutputNDJSON = "ndjson"
+	jpsOutputTSV    = "tsv"
+)
+
+// jpsOutput is the destination of machine-readable jps records.
+var jpsOutput io.Writer = os.Stdout
+
+// isStructuredOutput reports whether format is one of the machine-readable formats.
+func isStructuredOutput(format string) bool {
+	return format == jpsOutputJSON || format == jpsOutputNDJSON || format == jpsOutputTSV
+}
+
+// writeJpsRecords writes processes to w in the given structured format.
+// Records are encoded straight into one reused buffer; no per-field strings are built.
+func writeJpsRecords(w io.Writer, processes []JvmProcess, format string) error {
+	bw := bufio.NewWriter(w)
+	buf := make([]byte, 0, 1024)
+	switch format {
+	case jpsOutputJSON:
+		bw.WriteByte('[')
+		for i := range processes {
+			if i > 0 {
+				bw.WriteByte(',')
+			}
+			buf = appendJpsJSON(buf[:0], &processes[i])
+			bw.Write(buf)
+		}
+		bw.WriteString("]\n")
+	case jpsOutputNDJSON:
+		for i := range processes {
+			buf = appendJpsJSON(buf[:0], &processes[i])
+			buf = append(buf, '\n')
+			bw.Write(buf)
+		}
+	case jpsOutputTSV:
+		bw.WriteString("pid\tuser\tmain_class\tvm_args\tmain_args\tstart_time\n")
+		for i := range processes {
+			buf = appendJpsTSV(buf[:0], &processes[i])
+			bw.Write(buf)
+		}
+	}
+	return bw.Flush()
+}
+
+// appendJpsJSON appends the process as a JSON object.
+// start_time is in milliseconds since the Unix epoch, 0 if unknown.
+func appendJpsJSON(dst []byte, p *JvmProcess) []byte {
+	dst = append(dst, `{"pid":`...)
+	dst = strconv.AppendInt(dst, int64(p.Pid), 10)
+	dst = append(dst, `,"user":`...)
+	dst = appendJSONString(dst, p.Username)
+	dst = append(dst, `,"main_class":`...)
+	dst = appendJSONString(dst, p.mainClassOrJar)
+	dst = append(dst, `,"vm_args":`...)
+	dst = appendJSONString(dst, p.vmArgs)
+	dst = append(dst, `,"main_args":`...)
+	dst = appendJSONString(dst, p.mainArgs)
+	dst = append(dst, `,"start_time":`...)
+	dst = strconv.AppendInt(dst, p.startTime, 10)
+	return append(dst, '}')
+}
+
+// appendJpsTSV appends the process as one tab separated line.
+func appendJpsTSV(dst []byte, p *JvmProcess) []byte {
+	dst = strconv.AppendInt(dst, int64(p.Pid), 10)
+	dst = append(dst, '\t')
+	dst = appendTSVField(dst, p.Username)
+	dst = append(dst, '\t')
+	dst = appendTSVField(dst, p.mainClassOrJar)
+	dst = append(dst, '\t')
+	dst = appendTSVField(dst, p.vmArgs)
+	dst = append(dst, '\t')
+	dst = appendTSVField(dst, p.mainArgs)
+	dst = append(dst, '\t')
+	dst = strconv.AppendInt(dst, p.startTime, 10)
+	return append(dst, '\n')
+}
+
+const hexDigits = "0123456789abcdef"
+
+// appendJSONString appends s as a quoted JSON string.
+func appendJSONString(dst []byte, s string) []byte {
+	dst = append(dst, '"')
+	start := 0
+	for i := 0; i < len(s); {
+		b := s[i]
+		if b >= utf8.RuneSelf {
+			r, size := utf8.DecodeRuneInString(s[i:])
+			if r == utf8.RuneError && size == 1 {
+				dst = append(dst, s[start:i]...)
+				dst = append(dst, "\ufffd"...)
+				i += size
+				start = i
+				continue
+			}
+			i += size
+			continue
+		}
+		if b >= 0x20 && b != '"' && b != '\\' {
+			i++
+			continue
+		}
+		dst = append(dst, s[start:i]...)
+		switch b {
+		case '"', '\\':
+			dst = append(dst, '\\', b)
+		case '\n':
+			dst = append(dst, '\\', 'n')
+		case '\r':
+			dst = append(dst, '\\', 'r')
+		case '\t':
+			dst = append(dst, '\\', 't')
+		default:
+			dst = append(dst, '\\', 'u', '0', '0', hexDigits[b>>4], hexDigits[b&0xf])
+		}
+		i++
+		start = i
+	}
+	dst = append(dst, s[start:]...)
+	return append(dst, '"')
+}
+
+// appendTSVField appends s with tabs, newlines and backslashes escaped.
+func appendTSVField(dst []byte, s string) []byte {
+	for i := 0; i < len(s); i++ {
+		switch b := s[i]; b {
+		case '\t':
+			dst = append(dst, '\\', 't')
+		case '\n':
+			dst = append(dst, '\\', 'n')
+		case '\r':
+			dst = append(dst, '\\', 'r')
+		case '\\':
+			dst = append(dst, '\\', '\\')
+		default:
+			dst = append(dst, b)
+		}
+	}
+	return dst
+}
@@ -0,0 +1,184 @@
+package internal
+
+import (
+	"bytes"
+	"encoding/json"
+	"os"
+	"os/user"
+	"strings"
+	"testing"
+)
+
+var formatTestProcesses = []JvmProcess{
+	{Pid: 42, User: user.User{Username: "alice"}, mainClassOrJar: "com.example.App", vmArgs: "-Xmx1g -Dname=\"a\\b\"", mainArgs: "--port 8080", startTime: 1700000000000},
+	{Pid: 43, User: user.User{Username: "bob"}, mainClassOrJar: "/opt/app.jar", vmArgs: "-Dtab=\t -Dnl=\n", mainArgs: "\x01ü"},
+}
+
+type jpsRecord struct {
+	Pid       int32  `json:"pid"`
+	User      string `json:"user"`
+	MainClass string `json:"main_class"`
+	VMArgs    string `json:"vm_args"`
+	MainArgs  string `json:"main_args"`
+	StartTime int64  `json:"start_time"`
+}
+
+func checkJpsRecord(t *testing.T, got jpsRecord, p JvmProcess) {
+	t.Helper()
+	want := jpsRecord{p.Pid, p.Username, p.mainClassOrJar, p.vmArgs, p.mainArgs, p.startTime}
+	if got != want {
+		t.Errorf("expected %+v, got %+v", want, got)
+	}
+}
+
+// TestWriteJpsRecords_JSON tests that the json output is a valid array of records.
+func TestWriteJpsRecords_JSON(t *testing.T) {
+	var buf bytes.Buffer
+	if err := writeJpsRecords(&buf, formatTestProcesses, jpsOutputJSON); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	var records []jpsRecord
+	if err := json.Unmarshal(buf.Bytes(), &records); err != nil {
+		t.Fatalf("invalid json %q: %v", buf.String(), err)
+	}
+	if len(records) != len(formatTestProcesses) {
+		t.Fatalf("expected %d records, got %d", len(formatTestProcesses), len(records))
+	}
+	for i, r := range records {
+		checkJpsRecord(t, r, formatTestProcesses[i])
+	}
+
+	buf.Reset()
+	writeJpsRecords(&buf, nil, jpsOutputJSON)
+	if buf.String() != "[]\n" {
+		t.Errorf("expected an empty array, got %q", buf.String())
+	}
+}
+
+// TestWriteJpsRecords_NDJSON tests that the ndjson output has one valid record per line.
+func TestWriteJpsRecords_NDJSON(t *testing.T) {
+	var buf bytes.Buffer
+	if err := writeJpsRecords(&buf, formatTestProcesses, jpsOutputNDJSON); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	lines := strings.Split(strings.TrimSuffix(buf.String(), "\n"), "\n")
+	if len(lines) != len(formatTestProcesses) {
+		t.Fatalf("expected %d lines, got %q", len(formatTestProcesses), buf.String())
+	}
+	for i, line := range lines {
+		var r jpsRecord
+		if err := json.Unmarshal([]byte(line), &r); err != nil {
+			t.Fatalf("invalid json line %q: %v", line, err)
+		}
+		checkJpsRecord(t, r, formatTestProcesses[i])
+	}
+}
+
+// TestWriteJpsRecords_TSV tests that tsv fields never contain tabs or newlines.
+func TestWriteJpsRecords_TSV(t *testing.T) {
+	var buf bytes.Buffer
+	if err := writeJpsRecords(&buf, formatTestProcesses, jpsOutputTSV); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	lines := strings.Split(strings.TrimSuffix(buf.String(), "\n"), "\n")
+	if len(lines) != len(formatTestProcesses)+1 {
+		t.Fatalf("expected a header and %d lines, got %q", len(formatTestProcesses), buf.String())
+	}
+	for _, line := range lines {
+		if n := len(strings.Split(line, "\t")); n != 6 {
+			t.Errorf("expected 6 fields, got %d in %q", n, line)
+		}
+	}
+	expected := "42\talice\tcom.example.App\t-Xmx1g -Dname=\"a\\\\b\"\t--port 8080\t1700000000000"
+	if lines[1] != expected {
+		t.Errorf("expected %q, got %q", expected, lines[1])
+	}
+	if !strings.Contains(lines[2], `-Dtab=\t -Dnl=\n`) {
+		t.Errorf("expected escaped tab and newline, got %q", lines[2])
+	}
+}
+
+// TestAppendJSONString_InvalidUTF8 tests that invalid UTF-8 is replaced so the output stays valid.
+func TestAppendJSONString_InvalidUTF8(t *testing.T) {
+	out := appendJSONString(nil, "a\xffb")
+	var s string
+	if err := json.Unmarshal(out, &s); err != nil {
+		t.Fatalf("invalid json %q: %v", out, err)
+	}
+	if s != "a�b" {
+		t.Errorf("expected replacement character, got %q", s)
+	}
+}
+
+// TestJpsList_JSONOutput tests that JpsList writes records for the processes found.
+func TestJpsList_JSONOutput(t *testing.T) {
+	restore, _, _ := captureLogs()
+	defer restore()
+	var buf bytes.Buffer
+	origOutput := jpsOutput
+	jpsOutput = &buf
+	defer func() { jpsOutput = origOutput }()
+
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, os.Getpid())
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+
+	if code := JpsList(JpsOption{User: currentUser.Username, Output: jpsOutputNDJSON}); code != 0 {
+		t.Fatalf("expected exit code 0, got %d", code)
+	}
+	var r jpsRecord
+	if err := json.Unmarshal(buf.Bytes(), &r); err != nil {
+		t.Fatalf("invalid json %q: %v", buf.String(), err)
+	}
+	if r.Pid != int32(os.Getpid()) || r.User != currentUser.Username {
+		t.Errorf("unexpected record %+v", r)
+	}
+	if r.StartTime <= 0 {
+		t.Errorf("expected start time to be resolved, got %d", r.StartTime)
+	}
+}
+
+// TestJpsList_JSONOutputEmpty tests that no process is written as an empty list.
+func TestJpsList_JSONOutputEmpty(t *testing.T) {
+	restore, getLogs, _ := captureLogs()
+	defer restore()
+	var buf bytes.Buffer
+	origOutput := jpsOutput
+	jpsOutput = &buf
+	defer func() { jpsOutput = origOutput }()
+
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	hsperfFile, cleanup, err := prepareHsperfdataFile(currentUser.Username, os.Getpid())
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	os.Remove(hsperfFile)
+	defer cleanup()
+
+	if code := JpsList(JpsOption{User: currentUser.Username, Output: jpsOutputJSON}); code != 0 {
+		t.Fatalf("expected exit code 0, got %d", code)
+	}
+	if buf.String() != "[]\n" {
+		t.Errorf("expected an empty list, got %q", buf.String())
+	}
+	if logs := getLogs(); len(logs) != 0 {
+		t.Errorf("expected no logs, got %v", logs)
+	}
+}
+
+// TestJpsValidate_Output tests that unknown output formats are rejected.
+func TestJpsValidate_Output(t *testing.T) {
+	opt := JpsOption{Output: "xml"}
+	if err := opt.JpsValidate(); err == nil || err.Error() != "unsupported output format: xml" {
+		t.Errorf("expected unsupported output format error, got %v", err)
+	}
+}
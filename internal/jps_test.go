@@ -167,3 +167,167 @@ func TestJpsList_ActualJavaProcess(t *testing.T) {
 		t.Errorf("expected to find %s in logs, got: %v", p.class, getLogs())
 	}
 }
+
+// TestJpsList_KeepsOrder tests that JpsList prints processes in directory order when resolved in parallel.
+func TestJpsList_KeepsOrder(t *testing.T) {
+	restore, getLogs, clearLogs := captureLogs()
+	defer restore()
+
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pids := []int{os.Getpid(), os.Getppid(), 1}
+	var cleanup func()
+	for _, pid := range pids {
+		_, c, err := prepareHsperfdataFile(currentUser.Username, pid)
+		if err != nil {
+			t.Fatalf("failed to create hsperfdata file: %v", err)
+		}
+		cleanup = c
+	}
+	defer cleanup()
+
+	clearLogs()
+	JpsList(JpsOption{User: currentUser.Username, Quiet: true})
+	logs := getLogs()
+	for i := 1; i < len(logs); i++ {
+		if logs[i-1] >= logs[i] {
+			t.Errorf("expected listing in directory order, got %v", logs)
+		}
+	}
+}
+
+// TestMatchMainClass tests matching processes by main class or jar.
+func TestMatchMainClass(t *testing.T) {
+	tests := []struct {
+		mainClassOrJar string
+		filter         string
+		expected       bool
+	}{
+		{"com.example.App", "com.example.App", true},
+		{"com.example.App", "App", true},
+		{"com.example.MyApp", "App", false},
+		{"/opt/app/service.jar", "service.jar", true},
+		{"", "App", false},
+	}
+	for _, tt := range tests {
+		jp := JvmProcess{mainClassOrJar: tt.mainClassOrJar}
+		if got := jp.matchMainClass(tt.filter); got != tt.expected {
+			t.Errorf("matchMainClass(%q, %q) = %v, expected %v", tt.mainClassOrJar, tt.filter, got, tt.expected)
+		}
+	}
+}
+
+// TestListAllUsersPids tests that every hsperfdata directory is listed and pids are deduplicated.
+func TestListAllUsersPids(t *testing.T) {
+	tempDir := t.TempDir()
+	self, stale := strconv.Itoa(os.Getpid()), "4194305" // above the largest pid_max
+	files := map[string][]string{
+		"hsperfdata_alice": {"100", stale, self},
+		"hsperfdata_bob":   {stale, "300", "not-a-pid", self},
+		"other":            {"400"},
+	}
+	for dir, names := range files {
+		os.MkdirAll(filepath.Join(tempDir, dir), 0755)
+		for _, name := range names {
+			os.WriteFile(filepath.Join(tempDir, dir, name), nil, 0644)
+		}
+	}
+	os.WriteFile(filepath.Join(tempDir, "hsperfdata_file"), nil, 0644)
+	// The stale pid has no process to match the owner of its files, so the newest
+	// file wins; our own files match us, however old.
+	old := time.Now().Add(-time.Hour)
+	os.Chtimes(filepath.Join(tempDir, "hsperfdata_alice", stale), old, old)
+	os.Chtimes(filepath.Join(tempDir, "hsperfdata_alice", self), old, old)
+
+	entries := listAllUsersPids(tempDir, sameHostPid)
+	expected := map[int32]string{100: "alice", 4194305: "bob", int32(os.Getpid()): "alice", 300: "bob"}
+	if len(entries) != len(expected) {
+		t.Fatalf("expected %v, got %v", expected, entries)
+	}
+	for _, e := range entries {
+		if expected[e.pid] != e.user {
+			t.Errorf("expected pid %d of %s, got %v", e.pid, expected[e.pid], entries)
+		}
+	}
+	// Pids keep the position of their first listing, so bob's own pid comes last.
+	if entries[len(entries)-1].pid != 300 {
+		t.Errorf("expected directory order, got %v", entries)
+	}
+}
+
+// TestJpsList_AllUsers tests that -all-users lists processes with their owner.
+func TestJpsList_AllUsers(t *testing.T) {
+	restore, getLogs, clearLogs := captureLogs()
+	defer restore()
+
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, os.Getpid())
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+
+	clearLogs()
+	if code := JpsList(JpsOption{AllUsers: true}); code != 0 {
+		t.Fatalf("expected exit code 0, got %d", code)
+	}
+	prefix := strconv.Itoa(os.Getpid()) + " " + currentUser.Username + " "
+	found := false
+	for _, line := range getLogs() {
+		found = found || strings.HasPrefix(line, prefix)
+	}
+	if !found {
+		t.Errorf("expected a line starting with %q, got %v", prefix, getLogs())
+	}
+
+	opt := JpsOption{AllUsers: true, User: currentUser.Username}
+	if err := opt.JpsValidate(); err == nil {
+		t.Error("expected -user with -all-users to be rejected")
+	}
+}
+
+// BenchmarkJpsList measures listing perfdata directories of 10 to 10k entries, all but
+// one of them stale, as left behind by JVMs that were killed.
+func BenchmarkJpsList(b *testing.B) {
+	currentUser, err := user.Current()
+	if err != nil {
+		b.Fatalf("failed to get current user: %v", err)
+	}
+	origLogger := globalLogger
+	defer func() { globalLogger = origLogger }()
+	logInit(func(string) {})
+
+	for _, n := range []int{10, 100, 1000, 10000} {
+		b.Run("entries="+strconv.Itoa(n), func(b *testing.B) {
+			tempDir := b.TempDir()
+			b.Setenv("TMPDIR", tempDir)
+			dir := filepath.Join(tempDir, hsperfdataPrefix+currentUser.Username)
+			if err := os.Mkdir(dir, 0755); err != nil {
+				b.Fatal(err)
+			}
+			// Pids past the largest pid_max Linux allows never exist.
+			names := []string{strconv.Itoa(os.Getpid())}
+			for i := 1; i < n; i++ {
+				names = append(names, strconv.Itoa(1<<22+i))
+			}
+			for _, name := range names {
+				if err := os.WriteFile(filepath.Join(dir, name), nil, 0644); err != nil {
+					b.Fatal(err)
+				}
+			}
+			option := JpsOption{User: currentUser.Username, ShowLong: true, ShowVMArgs: true, ShowArgs: true}
+			b.ReportAllocs()
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if code := JpsList(option); code != 0 {
+					b.Fatalf("expected exit code 0, got %d", code)
+				}
+			}
+		})
+	}
+}
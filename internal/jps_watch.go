@@ -0,0 +1,324 @@
+package internal
+
+import (
+	"bufio"
+	"errors"
+	"os"
+	"os/signal"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// jpsWatchInterval is how often jps -watch checks that the processes it lists are
+// still alive, for JVMs that exit without removing their hsperfdata file. Processes
+// held by a pidfd report their exit instead, see pkg.ProcessWatcher.
+const jpsWatchInterval = time.Second
+
+// jpsEvent is a Java process starting or exiting, as reported by jps -watch.
+type jpsEvent struct {
+	process JvmProcess
+	removed bool
+}
+
+// JpsWatch prints the Java processes of option.User, then reports every process that
+// starts or exits until interrupted. Lines are prefixed with "+" or "-"; ndjson
+// records carry an "event" field instead.
+func JpsWatch(option JpsOption) int {
+	stop := make(chan struct{})
+	signals := make(chan os.Signal, 1)
+	signal.Notify(signals, os.Interrupt, syscall.SIGTERM)
+	defer signal.Stop(signals)
+	go func() {
+		<-signals
+		close(stop)
+	}()
+
+	w := bufio.NewWriter(jpsOutput)
+	buf := make([]byte, 0, 1024)
+	emit := func(events []jpsEvent) {
+		for i := range events {
+			e := &events[i]
+			if option.Output == jpsOutputNDJSON {
+				buf = appendJpsEvent(buf[:0], e)
+				w.Write(buf)
+				continue
+			}
+			prefix := "+ "
+			if e.removed {
+				prefix = "- "
+			}
+			log(prefix + formatJps(e.process, option))
+		}
+		w.Flush()
+	}
+	if err := watchJvmProcesses(option, stop, emit); err != nil {
+		log(err.Error())
+		return 1
+	}
+	return 0
+}
+
+// appendJpsEvent appends the event as a JSON object, see appendJpsJSON.
+func appendJpsEvent(dst []byte, e *jpsEvent) []byte {
+	event := "added"
+	if e.removed {
+		event = "removed"
+	}
+	dst = append(dst, `{"event":`...)
+	dst = appendJSONString(dst, event)
+	dst = append(dst, ',')
+	// Splice the process fields in place of their opening brace.
+	start := len(dst)
+	dst = appendJpsJSON(dst, &e.process)
+	dst = append(dst[:start], dst[start+1:]...)
+	return append(dst, '\n')
+}
+
+// jvmTable is the set of Java processes known to jps -watch, keyed by pid. Every
+// process is held by a handle, which is watched for its exit when pidfds are
+// available and polled otherwise.
+type jvmTable struct {
+	option    JpsOption
+	processes map[int32]*JvmProcess
+	events    []jpsEvent
+	synced    bool // flushed at least once
+
+	watcher *pkg.ProcessWatcher // nil when exits are polled for
+	polled  map[int32]bool      // the processes the watcher does not watch
+	exitMu  sync.Mutex
+	exited  []int32 // reported by the watcher, see waitExits
+}
+
+// open returns a handle on pid, or nil if it is not alive. Opening the handle is
+// the liveness check, so no process is probed on top.
+func (t *jvmTable) open(pid int32) *pkg.Process {
+	proc, err := pkg.OpenProcess(pid)
+	if err != nil {
+		return nil
+	}
+	return proc
+}
+
+// track records p as started, held by proc.
+func (t *jvmTable) track(p *JvmProcess, proc *pkg.Process) {
+	p.process = proc
+	t.processes[p.Pid] = p
+	t.events = append(t.events, jpsEvent{process: *p})
+	if t.watcher == nil || t.watcher.Watch(proc) != nil {
+		t.polled[p.Pid] = true
+	}
+}
+
+// add resolves pid and records it as started. The command line is read only here,
+// once per process.
+func (t *jvmTable) add(pid int32) {
+	if _, ok := t.processes[pid]; ok {
+		return
+	}
+	proc := t.open(pid)
+	if proc == nil {
+		return
+	}
+	if p := resolveJvmProcess(hsperfdataEntry{pid: pid, user: t.option.User}, t.option); p != nil {
+		t.track(p, proc)
+	} else {
+		proc.Close()
+	}
+}
+
+// remove records pid as exited if it is known, and releases its handle.
+func (t *jvmTable) remove(pid int32) {
+	if p, ok := t.processes[pid]; ok {
+		delete(t.processes, pid)
+		delete(t.polled, pid)
+		if t.watcher != nil {
+			t.watcher.Unwatch(pid)
+		}
+		p.process.Close()
+		t.events = append(t.events, jpsEvent{process: *p, removed: true})
+	}
+}
+
+// resync lists dir and reconciles the table with it. Only pids that are not known
+// yet are resolved, in parallel and in directory order.
+func (t *jvmTable) resync(dir string) {
+	entries, _ := os.ReadDir(dir)
+	listed := make(map[int32]bool, len(entries))
+	var added []int32
+	for _, e := range entries {
+		pid, err := strconv.Atoi(e.Name())
+		if err != nil || pid <= 0 {
+			continue
+		}
+		listed[int32(pid)] = true
+		if _, ok := t.processes[int32(pid)]; !ok {
+			added = append(added, int32(pid))
+		}
+	}
+	resolved := make([]*JvmProcess, len(added))
+	procs := make([]*pkg.Process, len(added))
+	pkg.ParallelFor(len(added), 0, func(i int) {
+		if procs[i] = t.open(added[i]); procs[i] != nil {
+			resolved[i] = resolveJvmProcess(hsperfdataEntry{pid: added[i], user: t.option.User}, t.option)
+		}
+	})
+	for i, p := range resolved {
+		if p != nil {
+			t.track(p, procs[i])
+		} else if procs[i] != nil {
+			procs[i].Close()
+		}
+	}
+	var gone []int32
+	for pid := range t.processes {
+		if !listed[pid] {
+			gone = append(gone, pid)
+		}
+	}
+	t.removeAll(gone)
+}
+
+// reap removes the polled processes that are no longer alive, and the watched ones
+// the watcher reported.
+func (t *jvmTable) reap() {
+	var gone []int32
+	for pid := range t.polled {
+		if t.processes[pid].process.Exited() {
+			gone = append(gone, pid)
+		}
+	}
+	t.exitMu.Lock()
+	gone, t.exited = append(gone, t.exited...), t.exited[:0]
+	t.exitMu.Unlock()
+	t.removeAll(gone)
+}
+
+// waitExits collects the exits reported by the watcher until it is closed, waking
+// the directory watcher in use so that they are handled right away.
+func (t *jvmTable) waitExits(current *atomic.Pointer[pkg.DirWatcher]) {
+	var pids []int32
+	for {
+		var err error
+		if pids, err = t.watcher.Wait(pids[:0], 0); err != nil {
+			return
+		}
+		t.exitMu.Lock()
+		t.exited = append(t.exited, pids...)
+		t.exitMu.Unlock()
+		if w := current.Load(); w != nil {
+			w.Wake()
+		}
+	}
+}
+
+// hasExits reports whether the watcher reported exits not reaped yet.
+func (t *jvmTable) hasExits() bool {
+	t.exitMu.Lock()
+	defer t.exitMu.Unlock()
+	return len(t.exited) > 0
+}
+
+// close stops the watcher and releases the handles of every process.
+func (t *jvmTable) close() {
+	if t.watcher != nil {
+		t.watcher.Close()
+	}
+	for _, p := range t.processes {
+		p.process.Close()
+	}
+}
+
+// removeAll removes pids in ascending order, so the report does not depend on map order.
+func (t *jvmTable) removeAll(pids []int32) {
+	sort.Slice(pids, func(i, j int) bool { return pids[i] < pids[j] })
+	for _, pid := range pids {
+		t.remove(pid)
+	}
+}
+
+// flush hands the pending events to emit. The first flush always calls emit, even
+// with no events, so callers learn that the initial listing is complete.
+func (t *jvmTable) flush(emit func([]jpsEvent)) {
+	if len(t.events) > 0 || !t.synced {
+		t.synced = true
+		emit(t.events)
+		t.events = t.events[:0]
+	}
+}
+
+// watchJvmProcesses keeps a table of the Java processes of option.User up to date
+// from create and delete events on their hsperfdata directory, and emits every
+// change until stop is closed. The directory is only listed again when the watch
+// is (re)established, e.g. after lost events or when the directory reappears.
+func watchJvmProcesses(option JpsOption, stop <-chan struct{}, emit func([]jpsEvent)) error {
+	dir := filepath.Join(os.TempDir(), hsperfdataPrefix+option.User)
+	table := &jvmTable{option: option, processes: map[int32]*JvmProcess{}, polled: map[int32]bool{}}
+	var current atomic.Pointer[pkg.DirWatcher]
+	if watcher, err := pkg.NewProcessWatcher(); err == nil {
+		table.watcher = watcher
+		go table.waitExits(&current)
+	}
+	defer table.close()
+	var batch []pkg.DirEvent
+	for {
+		select {
+		case <-stop:
+			return nil
+		default:
+		}
+		watcher, err := pkg.WatchDir(dir)
+		if err != nil {
+			if !errors.Is(err, os.ErrNotExist) {
+				return err
+			}
+			// No JVM has run as this user yet, or the directory was removed.
+			table.resync(dir)
+			table.flush(emit)
+			pkg.WaitForFile(dir, jpsWatchInterval)
+			continue
+		}
+		// Listed after the watch is in place so no process slips in between.
+		current.Store(watcher)
+		table.resync(dir)
+		table.flush(emit)
+
+		lastReap := time.Now()
+		for err == nil {
+			select {
+			case <-stop:
+				watcher.Close()
+				return nil
+			default:
+			}
+			batch, err = watcher.Next(batch[:0], jpsWatchInterval)
+			for _, e := range batch {
+				pid, perr := strconv.Atoi(e.Name)
+				if perr != nil || pid <= 0 {
+					continue
+				}
+				if e.Removed {
+					table.remove(int32(pid))
+				} else {
+					table.add(int32(pid))
+				}
+			}
+			if time.Since(lastReap) >= jpsWatchInterval || table.hasExits() {
+				lastReap = time.Now()
+				table.reap()
+			}
+			table.flush(emit)
+		}
+		current.Store(nil)
+		watcher.Close()
+		if !errors.Is(err, pkg.ErrWatchOverflow) && !errors.Is(err, os.ErrNotExist) {
+			return err
+		}
+	}
+}
@@ -0,0 +1,134 @@
+package internal
+
+import (
+	"bytes"
+	"encoding/json"
+	"os"
+	"os/exec"
+	"os/user"
+	"path/filepath"
+	"strconv"
+	"testing"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+// startJpsWatch runs watchJvmProcesses in the background and returns its events on a channel.
+func startJpsWatch(t *testing.T, option JpsOption) (<-chan jpsEvent, func()) {
+	t.Helper()
+	events := make(chan jpsEvent, 64)
+	stop := make(chan struct{})
+	done := make(chan error, 1)
+	go func() {
+		done <- watchJvmProcesses(option, stop, func(batch []jpsEvent) {
+			for _, e := range batch {
+				events <- e
+			}
+		})
+	}()
+	return events, func() {
+		close(stop)
+		if err := <-done; err != nil {
+			t.Errorf("watchJvmProcesses failed: %v", err)
+		}
+	}
+}
+
+// expectJpsEvent waits for the next event and checks it.
+func expectJpsEvent(t *testing.T, events <-chan jpsEvent, pid int, removed bool) {
+	t.Helper()
+	select {
+	case e := <-events:
+		if int(e.process.Pid) != pid || e.removed != removed {
+			t.Errorf("expected event for pid %d (removed=%v), got pid %d (removed=%v)", pid, removed, e.process.Pid, e.removed)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatalf("timed out waiting for event for pid %d (removed=%v)", pid, removed)
+	}
+}
+
+// TestWatchJvmProcesses tests that processes are reported as their hsperfdata files
+// come and go, and when they exit without removing it.
+func TestWatchJvmProcesses(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, os.Getpid())
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+
+	events, stop := startJpsWatch(t, JpsOption{User: currentUser.Username})
+	defer stop()
+	expectJpsEvent(t, events, os.Getpid(), false)
+
+	cmd := exec.Command("sleep", "30")
+	if err := cmd.Start(); err != nil {
+		t.Skip("failed to start process:", err)
+	}
+	pid := cmd.Process.Pid
+	hsperfFile := filepath.Join(os.TempDir(), "hsperfdata_"+currentUser.Username, strconv.Itoa(pid))
+	if err := os.WriteFile(hsperfFile, nil, 0644); err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	expectJpsEvent(t, events, pid, false)
+
+	os.Remove(hsperfFile)
+	expectJpsEvent(t, events, pid, true)
+
+	// Exiting without removing the file is noticed by the liveness check, right
+	// away where the exit is reported through a pidfd.
+	os.WriteFile(hsperfFile, nil, 0644)
+	expectJpsEvent(t, events, pid, false)
+	start := time.Now()
+	cmd.Process.Kill()
+	cmd.Wait()
+	expectJpsEvent(t, events, pid, true)
+	if w, err := pkg.NewProcessWatcher(); err == nil {
+		w.Close()
+		if elapsed := time.Since(start); elapsed >= jpsWatchInterval {
+			t.Errorf("expected the exit to be reported before the liveness check, took %v", elapsed)
+		}
+	}
+
+	select {
+	case e := <-events:
+		t.Errorf("unexpected event for pid %d", e.process.Pid)
+	default:
+	}
+}
+
+// TestAppendJpsEvent tests that watch records are valid JSON with an event field.
+func TestAppendJpsEvent(t *testing.T) {
+	for _, removed := range []bool{false, true} {
+		out := appendJpsEvent(nil, &jpsEvent{process: formatTestProcesses[0], removed: removed})
+		if !bytes.HasSuffix(out, []byte("\n")) {
+			t.Errorf("expected a trailing newline, got %q", out)
+		}
+		var r struct {
+			Event string `json:"event"`
+			Pid   int32  `json:"pid"`
+		}
+		if err := json.Unmarshal(out, &r); err != nil {
+			t.Fatalf("invalid json %q: %v", out, err)
+		}
+		expected := "added"
+		if removed {
+			expected = "removed"
+		}
+		if r.Event != expected || r.Pid != formatTestProcesses[0].Pid {
+			t.Errorf("unexpected record %q", out)
+		}
+	}
+}
+
+// TestJpsValidate_Watch tests that -watch rejects output formats that cannot be streamed.
+func TestJpsValidate_Watch(t *testing.T) {
+	opt := JpsOption{Watch: true, Output: jpsOutputJSON}
+	if err := opt.JpsValidate(); err == nil {
+		t.Error("expected -watch with json output to be rejected")
+	}
+}
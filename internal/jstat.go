@@ -0,0 +1,299 @@
+package internal
+
+import (
+	"bufio"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"os/user"
+	"strconv"
+	"syscall"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+// jstatOutput is the destination of jstat samples.
+var jstatOutput io.Writer = os.Stdout
+
+type JstatOption struct {
+	User     string
+	Pid      string
+	GcUtil   bool          // -gcutil
+	Interval time.Duration // -interval
+	Count    int           // -count, 0 means until the process exits
+	Buffer   int           // -buffer, ring capacity in samples
+	Uptime   bool          // -t
+}
+
+// ParseJstatFlags parses flags for the "jstat" command and returns the corresponding JstatOption.
+// The pid is taken from the first positional argument.
+func ParseJstatFlags(args []string) (JstatOption, error) {
+	jstatFlagSet := flag.NewFlagSet("jstat", flag.ContinueOnError)
+	user := jstatFlagSet.String("user", "", "specify the user owning the Java process")
+	gcUtil := jstatFlagSet.Bool("gcutil", false, "show garbage collection statistics summary")
+	interval := jstatFlagSet.Duration("interval", time.Second, "sampling interval, e.g. 10ms")
+	count := jstatFlagSet.Int("count", 0, "number of samples to take, 0 for unlimited")
+	buffer := jstatFlagSet.Int("buffer", 1024, "number of samples buffered between sampling and output")
+	uptime := jstatFlagSet.Bool("t", false, "show the JVM uptime as the first column")
+	if err := jstatFlagSet.Parse(args); err != nil {
+		return JstatOption{}, err
+	}
+	return JstatOption{
+		User:     *user,
+		Pid:      jstatFlagSet.Arg(0),
+		GcUtil:   *gcUtil,
+		Interval: *interval,
+		Count:    *count,
+		Buffer:   *buffer,
+		Uptime:   *uptime,
+	}, nil
+}
+
+// JstatValidate validates the JstatOption fields.
+func (opt *JstatOption) JstatValidate() error {
+	if !opt.GcUtil {
+		return errors.New("an output option is required, e.g. -gcutil")
+	}
+	if opt.Interval <= 0 {
+		return errors.New("interval must be positive")
+	}
+	if opt.Count < 0 {
+		return errors.New("count must not be negative")
+	}
+	if opt.Pid == "" {
+		return errors.New("pid is required")
+	}
+	if _, err := strconv.Atoi(opt.Pid); err != nil {
+		return fmt.Errorf("invalid pid %s", opt.Pid)
+	}
+	if opt.User == "" {
+		currentUser, err := user.Current()
+		if err != nil {
+			return err
+		}
+		opt.User = currentUser.Username
+	} else if _, err := user.Lookup(opt.User); err != nil {
+		return err
+	}
+	return nil
+}
+
+// Counters resolved by jstat -gcutil, indexed by the constants below.
+// @see jdk/src/jdk.jcmd/share/classes/sun/tools/jstat/resources/jstat_options
+var gcutilCounters = []string{
+	"sun.os.hrt.ticks",
+	"sun.gc.generation.0.space.1.used",
+	"sun.gc.generation.0.space.1.capacity",
+	"sun.gc.generation.0.space.2.used",
+	"sun.gc.generation.0.space.2.capacity",
+	"sun.gc.generation.0.space.0.used",
+	"sun.gc.generation.0.space.0.capacity",
+	"sun.gc.generation.1.space.0.used",
+	"sun.gc.generation.1.space.0.capacity",
+	"sun.gc.metaspace.used",
+	"sun.gc.metaspace.capacity",
+	"sun.gc.compressedclassspace.used",
+	"sun.gc.compressedclassspace.capacity",
+	"sun.gc.collector.0.invocations",
+	"sun.gc.collector.0.time",
+	"sun.gc.collector.1.invocations",
+	"sun.gc.collector.1.time",
+	"sun.gc.collector.2.invocations",
+	"sun.gc.collector.2.time",
+}
+
+const (
+	gcTicks = iota
+	gcS0Used
+	gcS0Capacity
+	gcS1Used
+	gcS1Capacity
+	gcEdenUsed
+	gcEdenCapacity
+	gcOldUsed
+	gcOldCapacity
+	gcMetaUsed
+	gcMetaCapacity
+	gcCcsUsed
+	gcCcsCapacity
+	gcYoungCount
+	gcYoungTime
+	gcFullCount
+	gcFullTime
+	gcConcurrentCount
+	gcConcurrentTime
+)
+
+// gcutilColumns are the -gcutil column headers and their widths.
+var gcutilColumns = []struct {
+	name  string
+	width int
+}{
+	{"S0", 7}, {"S1", 7}, {"E", 7}, {"O", 7}, {"M", 7}, {"CCS", 7},
+	{"YGC", 9}, {"YGCT", 10}, {"FGC", 9}, {"FGCT", 10}, {"CGC", 9}, {"CGCT", 10}, {"GCT", 10},
+}
+
+// appendGcutilHeader formats the -gcutil header line.
+func appendGcutilHeader(dst []byte, uptime bool) []byte {
+	if uptime {
+		dst = append(dst, "Timestamp "...)
+	}
+	for _, c := range gcutilColumns {
+		dst = appendPadded(dst, []byte(c.name), c.width)
+	}
+	return append(dst, '\n')
+}
+
+// Jstat samples the perfdata counters of a Java process at a fixed interval.
+// Sampling runs on its own goroutine and writes into a preallocated ring, so a
+// slow output never delays a sample and the sampling loop does not allocate.
+func Jstat(option JstatOption) int {
+	if err := option.JstatValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	pid := toInt32(option.Pid)
+	pd, err := perfdata.Open(perfdata.Path(option.User, pid))
+	if err != nil {
+		log(fmt.Sprintf("cannot read perfdata of process %d: %v", pid, err))
+		return 1
+	}
+	defer pd.Close()
+
+	frequency, err := pd.Long("sun.os.hrt.frequency")
+	if err != nil || frequency <= 0 {
+		log(fmt.Sprintf("cannot read hrt frequency of process %d", pid))
+		return 1
+	}
+	sampler := perfdata.NewSampler(pd, gcutilCounters)
+	ring := perfdata.NewRing(option.Buffer, sampler.Len())
+	notify := make(chan struct{}, 1)
+	done := make(chan struct{})
+	go sampleLoop(pid, option, sampler, ring, notify, done)
+
+	w := bufio.NewWriter(jstatOutput)
+	defer w.Flush()
+	row := make([]int64, sampler.Len())
+	line := appendGcutilHeader(make([]byte, 0, 256), option.Uptime)
+	w.Write(line)
+	var next, dropped uint64
+	drain := func() {
+		for head := ring.Head(); next < head; next++ {
+			if _, ok := ring.Read(next, row); !ok {
+				// Overwritten while we were writing, resume at the oldest sample.
+				if oldest := ring.Head() - uint64(ring.Cap()); oldest > next {
+					dropped += oldest - next
+					next = oldest - 1
+				}
+				continue
+			}
+			line = appendGcutil(line[:0], sampler, row, float64(frequency), option.Uptime)
+			w.Write(line)
+		}
+		w.Flush()
+	}
+	for {
+		select {
+		case <-notify:
+			drain()
+		case <-done:
+			drain()
+			if dropped > 0 {
+				log(fmt.Sprintf("%d samples dropped, output could not keep up", dropped))
+			}
+			return 0
+		}
+	}
+}
+
+// sampleLoop records a sample every interval until the count is reached or the process exits.
+func sampleLoop(pid int32, option JstatOption, sampler *perfdata.Sampler, ring *perfdata.Ring, notify chan<- struct{}, done chan<- struct{}) {
+	defer close(done)
+	start := time.Now()
+	lastCheck := start
+	ticker := time.NewTicker(option.Interval)
+	defer ticker.Stop()
+	for n := 0; option.Count == 0 || n < option.Count; n++ {
+		if n > 0 {
+			<-ticker.C
+		}
+		now := time.Now()
+		if now.Sub(lastCheck) >= time.Second {
+			lastCheck = now
+			if err := syscall.Kill(int(pid), 0); err == syscall.ESRCH {
+				return
+			}
+		}
+		ring.Record(now.Sub(start).Nanoseconds(), sampler)
+		select {
+		case notify <- struct{}{}:
+		default:
+		}
+	}
+}
+
+// counterSet tells which counters of a sample exist, see perfdata.Sampler.Has.
+type counterSet interface {
+	Has(i int) bool
+}
+
+// appendGcutil formats one -gcutil sample the way jstat does.
+func appendGcutil(dst []byte, s counterSet, v []int64, frequency float64, uptime bool) []byte {
+	if uptime {
+		dst = appendFloat(dst, float64(v[gcTicks])/frequency, 1, 9)
+		dst = append(dst, ' ')
+	}
+	dst = appendPercent(dst, s, v, gcS0Used, gcS0Capacity)
+	dst = appendPercent(dst, s, v, gcS1Used, gcS1Capacity)
+	dst = appendPercent(dst, s, v, gcEdenUsed, gcEdenCapacity)
+	dst = appendPercent(dst, s, v, gcOldUsed, gcOldCapacity)
+	dst = appendPercent(dst, s, v, gcMetaUsed, gcMetaCapacity)
+	dst = appendPercent(dst, s, v, gcCcsUsed, gcCcsCapacity)
+	dst = appendCount(dst, s, v, gcYoungCount)
+	dst = appendTime(dst, s, v, gcYoungTime, frequency)
+	dst = appendCount(dst, s, v, gcFullCount)
+	dst = appendTime(dst, s, v, gcFullTime, frequency)
+	dst = appendCount(dst, s, v, gcConcurrentCount)
+	dst = appendTime(dst, s, v, gcConcurrentTime, frequency)
+	total := v[gcYoungTime] + v[gcFullTime] + v[gcConcurrentTime]
+	dst = appendFloat(dst, float64(total)/frequency, 3, 10)
+	return append(dst, '\n')
+}
+
+func appendPercent(dst []byte, s counterSet, v []int64, used, capacity int) []byte {
+	if !s.Has(used) || !s.Has(capacity) || v[capacity] <= 0 {
+		return appendPadded(dst, []byte("-"), 7)
+	}
+	return appendFloat(dst, float64(v[used])*100/float64(v[capacity]), 2, 7)
+}
+
+func appendCount(dst []byte, s counterSet, v []int64, i int) []byte {
+	if !s.Has(i) {
+		return appendPadded(dst, []byte("-"), 9)
+	}
+	var scratch [24]byte
+	return appendPadded(dst, strconv.AppendInt(scratch[:0], v[i], 10), 9)
+}
+
+func appendTime(dst []byte, s counterSet, v []int64, i int, frequency float64) []byte {
+	if !s.Has(i) {
+		return appendPadded(dst, []byte("-"), 10)
+	}
+	return appendFloat(dst, float64(v[i])/frequency, 3, 10)
+}
+
+func appendFloat(dst []byte, f float64, prec, width int) []byte {
+	var scratch [32]byte
+	return appendPadded(dst, strconv.AppendFloat(scratch[:0], f, 'f', prec, 64), width)
+}
+
+// appendPadded appends b right-aligned to width.
+func appendPadded(dst []byte, b []byte, width int) []byte {
+	for i := len(b); i < width; i++ {
+		dst = append(dst, ' ')
+	}
+	return append(dst, b...)
+}
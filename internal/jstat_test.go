@@ -0,0 +1,100 @@
+package internal
+
+import (
+	"bytes"
+	"os"
+	"os/user"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+// prepareGcPerfdataFile writes a mock hsperfdata file with GC counters for the given user and pid.
+func prepareGcPerfdataFile(username string, pid int) (func(), error) {
+	hsperfDir := filepath.Join(os.TempDir(), "hsperfdata_"+username)
+	if err := os.MkdirAll(hsperfDir, 0755); err != nil {
+		return nil, err
+	}
+	err := perfdata.WriteMock(perfdata.Path(username, int32(pid)),
+		perfdata.MockCounter{Name: "sun.os.hrt.frequency", Long: 1_000_000_000, Variability: perfdata.VariabilityConstant},
+		perfdata.MockCounter{Name: "sun.os.hrt.ticks", Long: 5_000_000_000},
+		perfdata.MockCounter{Name: "sun.gc.generation.0.space.0.used", Long: 25},
+		perfdata.MockCounter{Name: "sun.gc.generation.0.space.0.capacity", Long: 100},
+		perfdata.MockCounter{Name: "sun.gc.collector.0.invocations", Long: 7},
+		perfdata.MockCounter{Name: "sun.gc.collector.0.time", Long: 250_000_000},
+	)
+	return func() { os.RemoveAll(hsperfDir) }, err
+}
+
+// TestParseJstatFlags tests the ParseJstatFlags function.
+func TestParseJstatFlags(t *testing.T) {
+	opt, err := ParseJstatFlags([]string{"-gcutil", "-interval", "10ms", "-count", "5", "12345"})
+	if err != nil {
+		t.Fatalf("ParseJstatFlags failed: %v", err)
+	}
+	if !opt.GcUtil || opt.Interval != 10*time.Millisecond || opt.Count != 5 || opt.Pid != "12345" {
+		t.Errorf("unexpected option: %+v", opt)
+	}
+}
+
+// TestJstatValidate tests the JstatValidate method of JstatOption.
+func TestJstatValidate(t *testing.T) {
+	tests := []struct {
+		name     string
+		option   JstatOption
+		expected string
+	}{
+		{"missing option", JstatOption{Pid: "1", Interval: time.Second}, "an output option is required, e.g. -gcutil"},
+		{"bad interval", JstatOption{GcUtil: true, Pid: "1"}, "interval must be positive"},
+		{"missing pid", JstatOption{GcUtil: true, Interval: time.Second}, "pid is required"},
+		{"invalid pid", JstatOption{GcUtil: true, Interval: time.Second, Pid: "abc"}, "invalid pid abc"},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			err := tt.option.JstatValidate()
+			if err == nil || err.Error() != tt.expected {
+				t.Errorf("expected error '%s', got: %v", tt.expected, err)
+			}
+		})
+	}
+}
+
+// TestJstat_GcUtil tests sampling a mock perfdata file.
+func TestJstat_GcUtil(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := os.Getpid()
+	cleanup, err := prepareGcPerfdataFile(currentUser.Username, pid)
+	if err != nil {
+		t.Fatalf("failed to create perfdata file: %v", err)
+	}
+	defer cleanup()
+
+	var out bytes.Buffer
+	orig := jstatOutput
+	jstatOutput = &out
+	defer func() { jstatOutput = orig }()
+
+	code := Jstat(JstatOption{GcUtil: true, Interval: time.Millisecond, Count: 3, Buffer: 8, Uptime: true, Pid: strconv.Itoa(pid)})
+	if code != 0 {
+		t.Fatalf("expected exit code 0, got %d", code)
+	}
+	lines := strings.Split(strings.TrimSpace(out.String()), "\n")
+	if len(lines) != 4 {
+		t.Fatalf("expected header and 3 samples, got: %q", out.String())
+	}
+	if !strings.HasPrefix(lines[0], "Timestamp") || !strings.Contains(lines[0], "YGCT") {
+		t.Errorf("unexpected header: %q", lines[0])
+	}
+	fields := strings.Fields(lines[1])
+	expected := []string{"5.0", "-", "-", "25.00", "-", "-", "-", "7", "0.250", "-", "-", "-", "-", "0.250"}
+	if strings.Join(fields, " ") != strings.Join(expected, " ") {
+		t.Errorf("expected %v, got %v", expected, fields)
+	}
+}
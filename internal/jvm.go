@@ -3,14 +3,15 @@ package internal
 import (
 	"errors"
 	"fmt"
-	"io"
 	"os"
 	"os/user"
+	"path/filepath"
+	"strconv"
 	"strings"
 	"syscall"
 	"time"
 
-	"golang.org/x/sys/unix"
+	"github.com/XHao/jvmtool/pkg"
 )
 
 type JvmProcess struct {
@@ -21,114 +22,228 @@ type JvmProcess struct {
 	mainClassOrJar string
 	vmArgs         string
 	mainArgs       string
+	startTime      int64 // milliseconds since the Unix epoch, 0 if not resolved
+
+	// Set for JVMs in another mount namespace, e.g. a container: root is the
+	// /proc/<pid>/root path their filesystem is reached through and nsPid their
+	// pid inside the container. See locate.
+	root  string
+	nsPid int32
+
+	trace *AttachTrace // optional, records the attach phases
+
+	// process, if set, is a handle held since discovery, so the Attach Listener
+	// is started in this very process even if its pid was reused. See checkSocket.
+	process *pkg.Process
+}
+
+// attachTimeout bounds the wait for the Attach Listener, as sun.tools.attach.attachTimeout does.
+const attachTimeout = 10 * time.Second
+
+// locate finds out whether the JVM runs in another mount namespace, unless discovery already did.
+func (jp *JvmProcess) locate() {
+	if jp.nsPid != 0 {
+		return
+	}
+	jp.nsPid = jp.Pid
+	if ns, err := pkg.GetProcessNamespace(jp.Pid); err == nil && !ns.Shared() {
+		jp.root, jp.nsPid = ns.Root, ns.Pid
+	}
+}
+
+// tempDir returns the directory the JVM keeps its attach files in, as seen from here.
+// HotSpot always uses /tmp on Linux, which for a container JVM lives under its root.
+func (jp *JvmProcess) tempDir() string {
+	if jp.root != "" {
+		return jp.root + "/tmp"
+	}
+	return os.TempDir()
+}
+
+// socketPath returns the path of the Attach Listener socket of the JVM.
+func (jp *JvmProcess) socketPath() string {
+	if jp.root == "" {
+		return attachSocketPath(jp.Pid)
+	}
+	return fmt.Sprintf("%s/.java_pid%d", jp.tempDir(), jp.nsPid)
+}
+
+// attachClient returns a client for the Attach Listener of the JVM.
+func (jp *JvmProcess) attachClient() *AttachClient {
+	client := NewAttachClient(jp.Pid)
+	client.SocketPath = jp.socketPath()
+	client.Trace = jp.trace
+	return client
+}
+
+// attachRoot opens the directory the JVM keeps its attach files in and returns
+// it with the prefix of their names in there. A container JVM is reached through
+// /proc/<pid>/root, so its /tmp, which a container user can plant symlinks in, is
+// resolved inside the container rather than against our root.
+func (jp *JvmProcess) attachRoot() (*pkg.Root, string, error) {
+	if jp.root != "" {
+		r, err := pkg.OpenRoot(jp.root)
+		return r, "tmp/", err
+	}
+	r, err := pkg.OpenRoot(os.TempDir())
+	return r, "", err
 }
 
+// checkSocket starts the Attach Listener of the JVM unless it is already running.
+// Container JVMs are reached through /proc/<pid>/root, so the files are created in
+// their /tmp and named after their own pid, while the signal goes to the host pid.
 // jdk/src/jdk.attach/share/classes/sun/tools/attach/HotSpotVirtualMachine.java
 func (jp *JvmProcess) checkSocket() error {
-	socketPath := fmt.Sprintf("%s/.java_pid%d", os.TempDir(), jp.Pid)
-	attachFile := fmt.Sprintf("%s/.attach_pid%d", os.TempDir(), jp.Pid)
-	var created bool
-	timeout := 9_000
-	timeSpend := 0
-	for {
-		_, err := os.Stat(socketPath)
-		if err == nil {
-			return nil
-		}
-		if timeSpend > timeout {
-			break
-		}
-		if created {
-			time.Sleep(1000 * time.Millisecond)
-			timeSpend += 1000
-			continue
-		}
-		created = true
-		f, err := os.Create(attachFile)
-		if f != nil {
-			defer f.Close()
-		}
-		defer os.Remove(attachFile)
-		if err != nil {
-			return fmt.Errorf("attach failed, cannot create file, %v", err.Error())
-		} else {
-			p, err := os.FindProcess(int(jp.Pid))
-			if err != nil {
-				return fmt.Errorf("java process does not exist, %v", jp.Pid)
-			}
-			err = p.Signal(syscall.SIGQUIT)
-			if err != nil {
-				return fmt.Errorf("cannot send signal %v to Java process", syscall.SIGQUIT)
-			}
+	jp.locate()
+	root, dir, err := jp.attachRoot()
+	if err != nil {
+		return fmt.Errorf("attach failed, %v", err)
+	}
+	defer root.Close()
+	socketName := fmt.Sprintf("%s.java_pid%d", dir, jp.nsPid)
+	attachName := fmt.Sprintf("%s.attach_pid%d", dir, jp.nsPid)
+	if _, err := root.Lstat(socketName); err == nil {
+		jp.trace.Done(PhaseWaitSocket)
+		return jp.verifySocket(root, socketName)
+	}
+
+	// O_EXCL, so that nothing planted under the name is followed or truncated. A
+	// file left there by an earlier attach triggers the listener just as well.
+	f, err := root.OpenFile(attachName, os.O_WRONLY|os.O_CREATE|os.O_EXCL, 0666)
+	switch {
+	case err == nil:
+		f.Close()
+		defer root.Remove(attachName)
+	case !os.IsExist(err):
+		return fmt.Errorf("attach failed, cannot create file, %v", err.Error())
+	}
+	jp.trace.Done(PhaseAttachFile)
+
+	p := jp.process
+	if p == nil {
+		if p, err = jp.open(); err != nil {
+			return err
 		}
-		time.Sleep(1000 * time.Millisecond)
-		timeSpend += 1000
+		defer p.Close()
 	}
-	return fmt.Errorf("unable to open socket file %s: target process %d doesn't respond within %dms or HotSpot VM not loaded", socketPath, jp.Pid, timeSpend)
+	if err = p.Signal(syscall.SIGQUIT); err != nil {
+		return fmt.Errorf("cannot send signal %v to Java process", syscall.SIGQUIT)
+	}
+	jp.trace.Done(PhaseSignal)
+
+	// The Attach Listener creates the socket as soon as it starts, so wait for it
+	// to appear instead of sleeping in fixed steps.
+	socketPath := jp.socketPath()
+	start := time.Now()
+	err = pkg.WaitForFile(socketPath, attachTimeout)
+	jp.trace.Done(PhaseWaitSocket)
+	if err != nil {
+		return fmt.Errorf("unable to open socket file %s: target process %d doesn't respond within %dms or HotSpot VM not loaded", socketPath, jp.Pid, time.Since(start).Milliseconds())
+	}
+	return jp.verifySocket(root, socketName)
 }
 
-func (jp *JvmProcess) loadAgent(agentPath string, params string) error {
-	socketPath := fmt.Sprintf("%s/.java_pid%d", os.TempDir(), jp.Pid)
-	fd, err := unix.Socket(unix.AF_UNIX, unix.SOCK_STREAM, 0)
+// verifySocket checks that name is a socket owned by the effective uid of the
+// JVM, as the one its Attach Listener creates is, so that we never talk to a
+// socket someone else put in its place.
+func (jp *JvmProcess) verifySocket(root *pkg.Root, name string) error {
+	fi, err := root.Lstat(name)
+	if err != nil {
+		return fmt.Errorf("unable to open socket file %s: %v", root.Join(name), err)
+	}
+	if fi.Mode().Type() != os.ModeSocket {
+		return fmt.Errorf("%s is not a socket", root.Join(name))
+	}
+	uid, err := pkg.ProcessUid(jp.Pid)
 	if err != nil {
-		return fmt.Errorf("failed to create unix socket: %v", err.Error())
+		return fmt.Errorf("java process does not exist, %v", jp.Pid)
+	}
+	if st, ok := fi.Sys().(*syscall.Stat_t); !ok || int(st.Uid) != uid {
+		return fmt.Errorf("socket file %s is not owned by the user of java process %d", root.Join(name), jp.Pid)
+	}
+	return nil
+}
+
+// resolveStartTime records the start time of the JVM unless it is known, so that
+// attaching to it later refuses a process that took over its pid. See open.
+func (jp *JvmProcess) resolveStartTime() {
+	if jp.startTime != 0 {
+		return
 	}
-	addr := unix.SockaddrUnix{
-		Name: socketPath,
+	if start, err := pkg.ProcessStartTime(jp.Pid); err == nil {
+		jp.startTime = start.UnixMilli()
 	}
-	err = unix.Connect(fd, &addr)
+}
+
+// open returns a handle on the JVM. SIGQUIT kills a process that does not handle
+// it, so when the start time of the JVM is known, a process that took over its pid
+// since discovery is refused; the handle then keeps referring to the right one.
+func (jp *JvmProcess) open() (*pkg.Process, error) {
+	p, err := pkg.OpenProcess(jp.Pid)
 	if err != nil {
-		return fmt.Errorf("failed to connect to target process %v: %v %v", jp.Pid, socketPath, err.Error())
-	}
-	defer unix.Close(fd)
-
-	request := make([]byte, 0)
-	// Protocol version
-	request = append(request, byte('1'))
-	request = append(request, byte(0))
-	// Command: "load"
-	request = append(request, []byte("load")...)
-	request = append(request, byte(0))
-	// Argument 1: "instrument"
-	request = append(request, []byte("instrument")...)
-	request = append(request, byte(0))
-	// Argument 2: "false"
-	request = append(request, []byte("false")...)
-	request = append(request, byte(0))
+		return nil, fmt.Errorf("java process does not exist, %v", jp.Pid)
+	}
+	if jp.startTime != 0 {
+		if start, err := pkg.ProcessStartTime(jp.Pid); err == nil && start.UnixMilli() != jp.startTime {
+			p.Close()
+			return nil, fmt.Errorf("java process %v has exited, its pid was reused", jp.Pid)
+		}
+	}
+	return p, nil
+}
+
+// isNativeAgent reports whether path names a JVMTI library rather than a Java agent jar.
+func isNativeAgent(path string) bool {
+	return strings.HasSuffix(path, ".so") || strings.HasSuffix(path, ".dylib")
+}
+
+// loadAgent loads an agent into the target JVM: a Java agent jar through the
+// instrument library, or a native JVMTI library, such as async-profiler, directly.
+// Native libraries must be given by absolute path.
+func (jp *JvmProcess) loadAgent(agentPath string, params string) error {
 	// Argument 3: agent JAR path (with optional params)
-	request = append(request, []byte(agentPath)...)
+	agent, err := jp.containerAgentPath(agentPath)
+	if err != nil {
+		return fmt.Errorf("cannot place agent into the target process: %v", err.Error())
+	}
+	if isNativeAgent(agentPath) {
+		return jp.load(agent, true, params)
+	}
 	if params != "" {
-		request = append(request, []byte("="+params)...)
+		agent += "=" + params
 	}
-	request = append(request, byte(0))
+	return jp.load("instrument", false, agent)
+}
 
-	if _, err = unix.Write(fd, request); err != nil {
-		return fmt.Errorf("failed to write attach request to process %v: %v", jp.Pid, err.Error())
+// load sends the load command and interprets the result of Agent_OnAttach.
+func (jp *JvmProcess) load(library string, absolute bool, options string) error {
+	client := jp.attachClient()
+	resp, err := client.Execute(attachCmdLoad, library, strconv.FormatBool(absolute), options)
+	if err != nil {
+		return err
+	}
+	defer resp.Close()
+	if resp.Code != 0 {
+		return fmt.Errorf("agent load failed, return code: %d", resp.Code)
 	}
 
-	log("waiting for attach to complete...")
-	resp, err := readAttachResponse(fd, jp.Pid)
+	var out strings.Builder
+	_, err = resp.WriteTo(&out)
+	jp.trace.Done(PhaseRead)
 	if err != nil {
 		return err
 	}
-	log("attach operation completed")
-
-	if len(resp) == 0 {
+	result, _, _ := strings.Cut(out.String(), "\n")
+	if result == "" {
 		return fmt.Errorf("target VM did not respond")
 	}
-	ret := strings.Split(resp, "\n")
-	returnCode := ret[0]
-	if returnCode != "0" {
-		return fmt.Errorf("agent load failed, return code: %s", returnCode)
-
-	}
 	var errCode string
-	if strings.HasPrefix(ret[1], "return code: ") {
-		errCode = ret[1][13:]
+	if strings.HasPrefix(result, "return code: ") {
+		errCode = result[13:]
 	} else {
-		b := ret[1][0]
+		b := result[0]
 		if b == '-' || (b >= '0' && b <= '9') {
-			errCode = ret[1]
+			errCode = result
 		} else {
 			errCode = "-1"
 		}
@@ -136,9 +251,14 @@ func (jp *JvmProcess) loadAgent(agentPath string, params string) error {
 
 	switch errCode {
 	case "-1":
-		return errors.New(ret[1])
+		return errors.New(result)
 	case "0":
 		return nil
+	}
+	if absolute {
+		return fmt.Errorf("agent load failed, Agent_OnAttach returned %s", errCode)
+	}
+	switch errCode {
 	case "100":
 		return fmt.Errorf("agent load failed, code 100: Agent JAR not found or no Agent-Class attribute")
 	case "101":
@@ -146,28 +266,41 @@ func (jp *JvmProcess) loadAgent(agentPath string, params string) error {
 	case "102":
 		return fmt.Errorf("agent load failed, code 102: No agentmain method or agentmain failed")
 	}
-	return fmt.Errorf("agent load failed, unknown message: %s", ret[1])
+	return fmt.Errorf("agent load failed, unknown message: %s", result)
 }
 
-func readAttachResponse(fd int, pid int32) (resp string, err error) {
-	buf := make([]byte, 4096)
-	var data []byte
-	n := 0
-	for {
-		n, err = unix.Read(fd, buf)
-		if n > 0 {
-			data = append(data, buf[:n]...)
-		}
+// resolveUser returns name if the user exists, or the current user's name if name is empty.
+func resolveUser(name string) (string, error) {
+	if name == "" {
+		currentUser, err := user.Current()
 		if err != nil {
-			if err == io.EOF {
-				break
-			}
-			return "", fmt.Errorf("failed to read attach response from process %v: %v", pid, err.Error())
+			return "", err
 		}
-		if n == 0 {
-			break
+		return currentUser.Username, nil
+	}
+	if _, err := user.Lookup(name); err != nil {
+		return "", err
+	}
+	return name, nil
+}
+
+// validateJvmPid checks that pid is a live process owned by username.
+// Users inside a container do not map to ours, so a container JVM only needs to
+// have a perfdata file in its own /tmp.
+func validateJvmPid(username string, pid int32) error {
+	if exist, _ := pkg.PidExists(pid); !exist {
+		return fmt.Errorf("process not found")
+	}
+	if ns, err := pkg.GetProcessNamespace(pid); err == nil && !ns.Shared() {
+		matches, _ := filepath.Glob(fmt.Sprintf("%s/tmp/%s*/%d", ns.Root, hsperfdataPrefix, ns.Pid))
+		if len(matches) == 0 {
+			return fmt.Errorf("process is not a java process")
 		}
+		return nil
+	}
+	pidFile := os.TempDir() + "/hsperfdata_" + username + "/" + fmt.Sprint(pid)
+	if !pkg.PathExists(pidFile) {
+		return fmt.Errorf("pid does not belong to the specified user")
 	}
-	resp = string(data)
-	return
+	return nil
 }
@@ -1,6 +1,11 @@
 package internal
 
 import (
+	"fmt"
+	"net"
+	"os"
+	"os/exec"
+	"path/filepath"
 	"testing"
 	"time"
 
@@ -62,3 +67,90 @@ func TestLoadAgent(t *testing.T) {
 		assert.NotNil(t, err)
 	}
 }
+
+// TestCheckSocket_WaitsForSocket tests that checkSocket returns as soon as the attach socket appears.
+func TestCheckSocket_WaitsForSocket(t *testing.T) {
+	cmd := exec.Command("/bin/sh", "-c", "trap '' QUIT; sleep 5")
+	if err := cmd.Start(); err != nil {
+		t.Skip("failed to start shell:", err)
+	}
+	defer func() {
+		cmd.Process.Kill()
+		cmd.Wait()
+	}()
+
+	jvmProc := JvmProcess{Pid: int32(cmd.Process.Pid)}
+	socketPath := fmt.Sprintf("%s/.java_pid%d", os.TempDir(), jvmProc.Pid)
+	attachFile := fmt.Sprintf("%s/.attach_pid%d", os.TempDir(), jvmProc.Pid)
+	defer os.Remove(socketPath)
+	go func() {
+		// Mimic the Attach Listener, which reacts to the attach file.
+		assert.Eventually(t, func() bool { _, err := os.Stat(attachFile); return err == nil }, time.Second, time.Millisecond)
+		if l, err := net.Listen("unix", socketPath); err == nil {
+			defer l.Close()
+			time.Sleep(time.Second)
+		}
+	}()
+
+	start := time.Now()
+	assert.Nil(t, jvmProc.checkSocket())
+	assert.Less(t, time.Since(start), time.Second)
+	_, err := os.Stat(attachFile)
+	assert.True(t, os.IsNotExist(err), "attach file should be removed")
+}
+
+// TestCheckSocket_Planted tests that files planted in the attach directory of a
+// container JVM are neither followed nor talked to.
+func TestCheckSocket_Planted(t *testing.T) {
+	cmd := exec.Command("/bin/sh", "-c", "trap '' QUIT; sleep 5")
+	if err := cmd.Start(); err != nil {
+		t.Skip("failed to start shell:", err)
+	}
+	defer func() {
+		cmd.Process.Kill()
+		cmd.Wait()
+	}()
+	root := t.TempDir()
+	tmp := filepath.Join(root, "tmp")
+	os.Mkdir(tmp, 0755)
+	target := filepath.Join(t.TempDir(), "target")
+	os.WriteFile(target, []byte("keep"), 0600)
+	jp := &JvmProcess{Pid: int32(cmd.Process.Pid), root: root, nsPid: 7}
+	socket := filepath.Join(tmp, ".java_pid7")
+
+	// An attach file that is a symlink is left alone, yet still triggers the listener.
+	os.Symlink(target, filepath.Join(tmp, ".attach_pid7"))
+	go func() {
+		time.Sleep(10 * time.Millisecond)
+		if l, err := net.Listen("unix", socket); err == nil {
+			defer l.Close()
+			time.Sleep(time.Second)
+		}
+	}()
+	assert.Nil(t, jp.checkSocket())
+	content, _ := os.ReadFile(target)
+	assert.Equal(t, "keep", string(content))
+	_, err := os.Lstat(filepath.Join(tmp, ".attach_pid7"))
+	assert.Nil(t, err, "a planted attach file is not ours to remove")
+
+	// Only a socket itself is talked to, not a file or a symlink to another socket.
+	os.Remove(socket)
+	os.WriteFile(socket, nil, 0600)
+	assert.EqualError(t, jp.checkSocket(), socket+" is not a socket")
+	other := filepath.Join(t.TempDir(), "other")
+	l, err := net.Listen("unix", other)
+	if err != nil {
+		t.Fatalf("failed to listen: %v", err)
+	}
+	defer l.Close()
+	os.Remove(socket)
+	os.Symlink(other, socket)
+	assert.EqualError(t, jp.checkSocket(), socket+" is not a socket")
+
+	// A /tmp that is a symlink is not entered.
+	os.RemoveAll(tmp)
+	os.Symlink(filepath.Dir(target), tmp)
+	assert.NotNil(t, jp.checkSocket())
+	_, err = os.Stat(filepath.Join(filepath.Dir(target), ".attach_pid7"))
+	assert.True(t, os.IsNotExist(err), "attach file should not be created through a symlink")
+}
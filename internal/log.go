@@ -1,6 +1,15 @@
 package internal
 
-import "os"
+import (
+	"bufio"
+	"io"
+	"os"
+	"sync"
+	"time"
+)
+
+// logFlushInterval is how often buffered loggers flush in the background.
+const logFlushInterval = 100 * time.Millisecond
 
 // globalLogger is the global logger instance used by the log and logInit functions.
 var globalLogger *Logger
@@ -20,42 +29,137 @@ var log = func(msg string) {
 	globalLogger.Print(msg)
 }
 
+// FlushLog writes out any message still buffered by the global logger.
+// It must be called before the process exits.
+func FlushLog() error {
+	if globalLogger == nil {
+		return nil
+	}
+	return globalLogger.Flush()
+}
+
 // Logger is a configurable logging utility. By default, it outputs to the console in a pretty format.
+// Loggers without an output function buffer messages and flush them from a background
+// goroutine, so a burst of messages costs one write instead of one per line.
 type Logger struct {
 	outputFunc func(msg string)
+
+	mu        sync.Mutex
+	w         *bufio.Writer
+	closer    io.Closer
+	stop      chan struct{}
+	done      chan struct{}
+	closeOnce sync.Once
 }
 
 // NewLogger creates a new Logger with the specified output function.
-// If outputFunc is nil, it defaults to pretty console output.
+// If outputFunc is nil, it defaults to buffered console output on stderr.
 func NewLogger(outputFunc func(msg string)) *Logger {
 	if outputFunc == nil {
-		outputFunc = func(msg string) {
-			println(msg)
-		}
+		return newBufferedLogger(os.Stderr, nil)
 	}
 	return &Logger{outputFunc: outputFunc}
 }
 
-// Print logs a message using the configured output function.
+// NewFileLogger creates a buffered Logger that appends to the specified file.
+// The file is opened once and closed by Close.
+func NewFileLogger(filePath string) (*Logger, error) {
+	f, err := openLogFile(filePath)
+	if err != nil {
+		return nil, err
+	}
+	return newBufferedLogger(f, f), nil
+}
+
+// newBufferedLogger creates a Logger buffering writes to w and starts its flusher.
+func newBufferedLogger(w io.Writer, closer io.Closer) *Logger {
+	l := &Logger{
+		w:      bufio.NewWriter(w),
+		closer: closer,
+		stop:   make(chan struct{}),
+		done:   make(chan struct{}),
+	}
+	go l.flushLoop()
+	return l
+}
+
+// flushLoop periodically flushes the buffer until the logger is closed.
+func (l *Logger) flushLoop() {
+	defer close(l.done)
+	ticker := time.NewTicker(logFlushInterval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ticker.C:
+			l.Flush()
+		case <-l.stop:
+			return
+		}
+	}
+}
+
+// Print logs a message using the configured output function. It is safe for
+// concurrent use; output functions are called one message at a time.
 func (l *Logger) Print(msg string) {
-	l.outputFunc(msg)
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	if l.outputFunc != nil {
+		l.outputFunc(msg)
+		return
+	}
+	l.w.WriteString(msg)
+	l.w.WriteByte('\n')
+}
+
+// Flush writes out any buffered message. It is a no-op for output functions.
+func (l *Logger) Flush() error {
+	if l.w == nil {
+		return nil
+	}
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	return l.w.Flush()
+}
+
+// Close stops the background flusher, flushes and closes the underlying file, if any.
+func (l *Logger) Close() error {
+	if l.w == nil {
+		return nil
+	}
+	var err error
+	l.closeOnce.Do(func() {
+		close(l.stop)
+		<-l.done
+		err = l.Flush()
+		if l.closer != nil {
+			if cerr := l.closer.Close(); err == nil {
+				err = cerr
+			}
+		}
+	})
+	return err
 }
 
-// FileOutputFunc returns an output function that writes log messages to the specified file path, overwriting the file if it exists.
+// FileOutputFunc returns an output function that appends log messages to the specified file path.
+// The file is opened once, on the first message, and every message is written with a single call.
 func FileOutputFunc(filePath string) func(msg string) {
+	var once sync.Once
+	var f *os.File
+	var openErr error
 	return func(msg string) {
-		f, err := openLogFile(filePath)
-		if err != nil {
-			println("Logger error:", err.Error())
+		once.Do(func() {
+			f, openErr = openLogFile(filePath)
+		})
+		if openErr != nil {
+			println("Logger error:", openErr.Error())
 			println(msg)
 			return
 		}
-		defer f.Close()
 		f.WriteString(msg + "\n")
 	}
 }
 
-// openLogFile opens or creates the log file in write-only mode, truncating it if it already exists.
+// openLogFile opens or creates the log file in write-only mode, appending to it if it already exists.
 func openLogFile(filePath string) (*os.File, error) {
-	return os.OpenFile(filePath, os.O_CREATE|os.O_WRONLY|os.O_TRUNC, 0644)
+	return os.OpenFile(filePath, os.O_CREATE|os.O_WRONLY|os.O_APPEND, 0644)
 }
@@ -5,6 +5,7 @@ import (
 	"path/filepath"
 	"strings"
 	"testing"
+	"time"
 )
 
 // TestNewLogger_DefaultOutput tests the default output function of Logger.
@@ -46,28 +47,79 @@ func TestFileOutputFunc_WritesToFile(t *testing.T) {
 	}
 }
 
-// TestFileOutputFunc_OverwriteFile tests that FileOutputFunc overwrites the file on each call.
-func TestFileOutputFunc_OverwriteFile(t *testing.T) {
+// TestFileOutputFunc_AppendFile tests that FileOutputFunc appends every message to the file.
+func TestFileOutputFunc_AppendFile(t *testing.T) {
 	dir := t.TempDir()
-	logFile := filepath.Join(dir, "overwrite.log")
+	logFile := filepath.Join(dir, "append.log")
+	if err := os.WriteFile(logFile, []byte("existing\n"), 0644); err != nil {
+		t.Fatalf("Failed to prepare log file: %v", err)
+	}
 	outputFunc := FileOutputFunc(logFile)
-	msg1 := "first"
-	msg2 := "second"
-	outputFunc(msg1)
-	outputFunc(msg2)
+	outputFunc("first")
+	outputFunc("second")
 
 	data, err := os.ReadFile(logFile)
 	if err != nil {
 		t.Fatalf("Failed to read log file: %v", err)
 	}
-	content := string(data)
-	// Since FileOutputFunc overwrites the file, only the last message should be present.
-	if strings.Contains(content, msg1) {
-		t.Errorf("Expected log file to not contain the first message, got '%s'", content)
+	if string(data) != "existing\nfirst\nsecond\n" {
+		t.Errorf("Expected every message to be appended, got '%s'", string(data))
+	}
+}
+
+// TestNewFileLogger tests that a file logger buffers messages until flushed and appends on reopen.
+func TestNewFileLogger(t *testing.T) {
+	dir := t.TempDir()
+	logFile := filepath.Join(dir, "buffered.log")
+	logger, err := NewFileLogger(logFile)
+	if err != nil {
+		t.Fatalf("NewFileLogger failed: %v", err)
+	}
+	logger.Print("one")
+	logger.Print("two")
+	if err := logger.Flush(); err != nil {
+		t.Fatalf("Flush failed: %v", err)
+	}
+	data, _ := os.ReadFile(logFile)
+	if string(data) != "one\ntwo\n" {
+		t.Errorf("Expected flushed messages, got '%s'", string(data))
+	}
+	logger.Print("three")
+	if err := logger.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	logger.Close()
+
+	logger, err = NewFileLogger(logFile)
+	if err != nil {
+		t.Fatalf("NewFileLogger failed: %v", err)
+	}
+	logger.Print("four")
+	logger.Close()
+	data, _ = os.ReadFile(logFile)
+	if string(data) != "one\ntwo\nthree\nfour\n" {
+		t.Errorf("Expected messages to be appended across loggers, got '%s'", string(data))
+	}
+}
+
+// TestLogger_BackgroundFlush tests that buffered messages are flushed without an explicit Flush.
+func TestLogger_BackgroundFlush(t *testing.T) {
+	dir := t.TempDir()
+	logFile := filepath.Join(dir, "background.log")
+	logger, err := NewFileLogger(logFile)
+	if err != nil {
+		t.Fatalf("NewFileLogger failed: %v", err)
 	}
-	if !strings.Contains(content, msg2) {
-		t.Errorf("Expected log file to contain only the second message, got '%s'", content)
+	defer logger.Close()
+	logger.Print("later")
+	deadline := time.Now().Add(5 * time.Second)
+	for time.Now().Before(deadline) {
+		if data, _ := os.ReadFile(logFile); string(data) == "later\n" {
+			return
+		}
+		time.Sleep(10 * time.Millisecond)
 	}
+	t.Errorf("Expected message to be flushed in the background")
 }
 
 // TestOpenLogFile_CreatesFile tests that openLogFile creates a new file if it does not exist.
@@ -0,0 +1,370 @@
+package internal
+
+import (
+	"bufio"
+	"net/http"
+	"os"
+	"slices"
+	"strconv"
+	"strings"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+// metricFamily is a Prometheus metric published by /metrics.
+type metricFamily struct {
+	name, kind, help string
+}
+
+// Metric families read from perfdata, indexed by the constants below.
+var perfMetricFamilies = []metricFamily{
+	{"jvm_gc_collections_total", "counter", "Number of collections of the collector."},
+	{"jvm_gc_collection_seconds_total", "counter", "Time spent in collections of the collector."},
+	{"jvm_memory_used_bytes", "gauge", "Used size of the memory space."},
+	{"jvm_memory_capacity_bytes", "gauge", "Committed size of the memory space."},
+	{"jvm_classes_loaded_total", "counter", "Number of classes loaded."},
+	{"jvm_classes_unloaded_total", "counter", "Number of classes unloaded."},
+	{"jvm_jit_compilations_total", "counter", "Number of JIT compilations."},
+	{"jvm_jit_compilation_seconds_total", "counter", "Time spent in JIT compilation."},
+	{"jvm_safepoints_total", "counter", "Number of safepoints."},
+	{"jvm_safepoint_seconds_total", "counter", "Time spent at safepoints."},
+	{"jvm_safepoint_sync_seconds_total", "counter", "Time spent reaching safepoints."},
+	{"jvm_threads_live", "gauge", "Number of live threads."},
+	{"jvm_uptime_seconds", "gauge", "Time since the JVM started."},
+}
+
+const (
+	metricGcCollections = iota
+	metricGcSeconds
+	metricMemoryUsed
+	metricMemoryCapacity
+	metricClassesLoaded
+	metricClassesUnloaded
+	metricJitCompilations
+	metricJitSeconds
+	metricSafepoints
+	metricSafepointSeconds
+	metricSafepointSyncSeconds
+	metricThreadsLive
+	metricUptime
+)
+
+// perfMetricCounters maps the families that come from a single counter.
+var perfMetricCounters = []struct {
+	family  int
+	counter string
+	ticks   bool // the counter is in hrt ticks, published in seconds
+}{
+	{metricClassesLoaded, "java.cls.loadedClasses", false},
+	{metricClassesUnloaded, "java.cls.unloadedClasses", false},
+	{metricJitCompilations, "sun.ci.totalCompiles", false},
+	{metricJitSeconds, "sun.ci.totalTime", true},
+	{metricSafepoints, "sun.rt.safepoints", false},
+	{metricSafepointSeconds, "sun.rt.safepointTime", true},
+	{metricSafepointSyncSeconds, "sun.rt.safepointSyncTime", true},
+	{metricThreadsLive, "java.threads.live", false},
+	{metricUptime, "sun.os.hrt.ticks", true},
+}
+
+// metricsContentType is shared by every scrape instead of allocated by Header.Set.
+var metricsContentType = []string{"text/plain; version=0.0.4; charset=utf-8"}
+
+// metricsUserRescan is how often /metrics looks for hsperfdata directories of new
+// users, and for the JVMs of containers.
+const metricsUserRescan = 10 * time.Second
+
+// perfMetric is one sample of a family: the rendered labels and the counter whose
+// current value is read from the mapped file at every scrape.
+type perfMetric struct {
+	labels  []byte // {pid="...",main="...",...}
+	counter perfdata.Counter
+	scale   float64 // 0 to publish the raw long value
+}
+
+// perfMetrics are the samples of one JVM, by family.
+type perfMetrics [][]perfMetric
+
+// buildPerfMetrics resolves the counters published for p once, so that scraping
+// only has to read their values.
+func buildPerfMetrics(p JvmProcess, pd *perfdata.PerfData) perfMetrics {
+	metrics := make(perfMetrics, len(perfMetricFamilies))
+	base := appendLabel(nil, "pid", strconv.Itoa(int(p.Pid)))
+	base = append(base, ',')
+	base = appendLabel(base, "main", p.mainClassOrJar)
+	labels := func(name, value string) []byte {
+		l := append([]byte{'{'}, base...)
+		if name != "" {
+			l = append(l, ',')
+			l = appendLabel(l, name, value)
+		}
+		return append(l, '}')
+	}
+	var tickScale float64
+	if frequency, err := pd.Long("sun.os.hrt.frequency"); err == nil && frequency > 0 {
+		tickScale = 1 / float64(frequency)
+	}
+	add := func(family int, labels []byte, name string, ticks bool) bool {
+		c, ok := pd.Lookup(name)
+		if !ok || !c.IsLong() || (ticks && tickScale == 0) {
+			return false
+		}
+		m := perfMetric{labels: labels, counter: c}
+		if ticks {
+			m.scale = tickScale
+		}
+		metrics[family] = append(metrics[family], m)
+		return true
+	}
+	// name returns the value of a string counter, or fallback.
+	name := func(counter, fallback string) string {
+		if s, err := pd.String(counter); err == nil && s != "" {
+			return s
+		}
+		return fallback
+	}
+
+	for i := 0; ; i++ {
+		prefix := "sun.gc.collector." + strconv.Itoa(i) + "."
+		l := labels("collector", name(prefix+"name", strconv.Itoa(i)))
+		if !add(metricGcCollections, l, prefix+"invocations", false) {
+			break
+		}
+		add(metricGcSeconds, l, prefix+"time", true)
+	}
+	for g := 0; ; g++ {
+		generation := "sun.gc.generation." + strconv.Itoa(g) + "."
+		found := false
+		for s := 0; ; s++ {
+			prefix := generation + "space." + strconv.Itoa(s) + "."
+			l := labels("space", name(prefix+"name", strconv.Itoa(g)+"."+strconv.Itoa(s)))
+			if !add(metricMemoryUsed, l, prefix+"used", false) {
+				break
+			}
+			add(metricMemoryCapacity, l, prefix+"capacity", false)
+			found = true
+		}
+		if !found {
+			break
+		}
+	}
+	for _, space := range []struct{ counter, name string }{
+		{"sun.gc.metaspace.", "metaspace"},
+		{"sun.gc.compressedclassspace.", "compressed-class"},
+	} {
+		l := labels("space", space.name)
+		add(metricMemoryUsed, l, space.counter+"used", false)
+		add(metricMemoryCapacity, l, space.counter+"capacity", false)
+	}
+	l := labels("", "")
+	for _, c := range perfMetricCounters {
+		add(c.family, l, c.counter, c.ticks)
+	}
+	return metrics
+}
+
+// appendLabel appends name="value" with the value escaped for the text exposition format.
+func appendLabel(dst []byte, name, value string) []byte {
+	dst = append(dst, name...)
+	dst = append(dst, '=', '"')
+	for i := 0; i < len(value); i++ {
+		switch b := value[i]; b {
+		case '\\', '"':
+			dst = append(dst, '\\', b)
+		case '\n':
+			dst = append(dst, '\\', 'n')
+		default:
+			dst = append(dst, b)
+		}
+	}
+	return append(dst, '"')
+}
+
+// appendFamilyHeader appends the HELP and TYPE lines of a family.
+func appendFamilyHeader(dst []byte, f metricFamily) []byte {
+	dst = append(dst, "# HELP "...)
+	dst = append(dst, f.name...)
+	dst = append(dst, ' ')
+	dst = append(dst, f.help...)
+	dst = append(dst, "\n# TYPE "...)
+	dst = append(dst, f.name...)
+	dst = append(dst, ' ')
+	dst = append(dst, f.kind...)
+	return append(dst, '\n')
+}
+
+// appendSample appends one sample line.
+func appendSample(dst []byte, name string, labels []byte, m *perfMetric) []byte {
+	dst = append(dst, name...)
+	dst = append(dst, labels...)
+	dst = append(dst, ' ')
+	if m.scale == 0 {
+		dst = strconv.AppendInt(dst, m.counter.Long(), 10)
+	} else {
+		dst = strconv.AppendFloat(dst, float64(m.counter.Long())*m.scale, 'g', -1, 64)
+	}
+	return append(dst, '\n')
+}
+
+// handleMetrics publishes the perfdata counters of every JVM on the host, those of
+// containers included, and the attach phase latencies of this server, in the Prometheus text format.
+// Values are read from the mapped perfdata files as the response is written;
+// the counters themselves are resolved once per JVM, so a scrape of known JVMs
+// reuses every buffer it needs.
+func (s *Server) handleMetrics(w http.ResponseWriter, r *http.Request) {
+	s.scrapeMu.Lock()
+	defer s.scrapeMu.Unlock()
+	if time.Since(s.usersScanned) >= metricsUserRescan {
+		s.usersScanned = time.Now()
+		s.discoverUsers()
+		s.discoverContainers(listContainerPids())
+	}
+
+	s.scrapeProcesses = s.scrapeProcesses[:0]
+	s.mu.Lock()
+	for _, t := range s.tables {
+		t.mu.RLock()
+		for _, p := range t.processes {
+			s.scrapeProcesses = append(s.scrapeProcesses, p)
+		}
+		t.mu.RUnlock()
+	}
+	s.mu.Unlock()
+	// A pid listed on the host as well as in a container is published once, from
+	// the host, which comes first in the stable sort.
+	s.scrapeProcesses = append(s.scrapeProcesses, s.containers...)
+	slices.SortStableFunc(s.scrapeProcesses, func(a, b JvmProcess) int { return int(a.Pid - b.Pid) })
+	s.scrapeProcesses = slices.CompactFunc(s.scrapeProcesses, func(a, b JvmProcess) bool { return a.Pid == b.Pid })
+	for i := range s.scrapeProcesses {
+		s.preparePerfMetrics(s.scrapeProcesses[i])
+	}
+
+	w.Header()["Content-Type"] = metricsContentType
+	if s.scrapeWriter == nil {
+		s.scrapeWriter = bufio.NewWriterSize(w, 32*1024)
+	} else {
+		s.scrapeWriter.Reset(w)
+	}
+	bw, buf := s.scrapeWriter, s.scrapeBuf[:0]
+	s.perfMu.RLock()
+	for f, family := range perfMetricFamilies {
+		buf = appendFamilyHeader(buf[:0], family)
+		bw.Write(buf)
+		for i := range s.scrapeProcesses {
+			// Checked under the lock, as the process may have exited since.
+			e := s.perfdata[s.scrapeProcesses[i].Pid]
+			if e == nil || e.metrics == nil {
+				continue
+			}
+			for j := range e.metrics[f] {
+				m := &e.metrics[f][j]
+				buf = appendSample(buf[:0], family.name, m.labels, m)
+				bw.Write(buf)
+			}
+		}
+	}
+	s.perfMu.RUnlock()
+	s.scrapeBuf = appendAttachHistograms(buf[:0], bw)
+	bw.Flush()
+	s.scrapeWriter.Reset(nil)
+}
+
+// discoverUsers starts watching every user with an hsperfdata directory.
+func (s *Server) discoverUsers() {
+	entries, err := os.ReadDir(os.TempDir())
+	if err != nil {
+		return
+	}
+	for _, e := range entries {
+		if username, ok := strings.CutPrefix(e.Name(), hsperfdataPrefix); ok && e.IsDir() {
+			s.table(username)
+		}
+	}
+}
+
+// discoverContainers replaces the JVMs found in containers by those of entries,
+// see listContainerPids, and unmaps the perfdata of the ones gone. The processes
+// of the previous scan are kept rather than resolved again.
+func (s *Server) discoverContainers(entries []hsperfdataEntry) {
+	previous := s.containers
+	s.containers = make([]JvmProcess, 0, len(entries))
+	for _, e := range entries {
+		i := slices.IndexFunc(previous, func(p JvmProcess) bool {
+			return p.Pid == e.pid && p.root == e.root && p.nsPid == e.nsPid
+		})
+		if i >= 0 {
+			s.containers = append(s.containers, previous[i])
+			previous[i].Pid = 0
+		} else if p := resolveJvmProcess(e, JpsOption{ShowLong: true}); p != nil {
+			s.containers = append(s.containers, *p)
+		}
+	}
+	for _, p := range previous {
+		if p.Pid != 0 {
+			s.closePerfData(p.Pid)
+		}
+	}
+}
+
+// preparePerfMetrics maps the perfdata file of p and resolves its metrics, once.
+func (s *Server) preparePerfMetrics(p JvmProcess) {
+	s.perfMu.RLock()
+	e := s.perfdata[p.Pid]
+	ready := e != nil && e.metrics != nil
+	s.perfMu.RUnlock()
+	if ready {
+		return
+	}
+	if s.withPerfData(p, func(*servedPerfData) {}) != nil {
+		return
+	}
+	s.perfMu.Lock()
+	defer s.perfMu.Unlock()
+	if e := s.perfdata[p.Pid]; e != nil && e.metrics == nil {
+		e.metrics = buildPerfMetrics(p, e.pd)
+	}
+}
+
+// attachHistogramFamily publishes attachPhaseHistograms.
+var attachHistogramFamily = metricFamily{"jvmtool_attach_phase_seconds", "histogram", "Time spent in each phase of attaching to a JVM."}
+
+// appendAttachHistograms writes the attach phase histograms through buf, which it returns for reuse.
+func appendAttachHistograms(buf []byte, bw *bufio.Writer) []byte {
+	buf = appendFamilyHeader(buf[:0], attachHistogramFamily)
+	bw.Write(buf)
+	for p := range attachPhaseHistograms {
+		h := &attachPhaseHistograms[p]
+		phase := attachPhaseNames[p]
+		var cumulative uint64
+		for i := range h.counts {
+			cumulative += h.counts[i].Load()
+			buf = append(buf[:0], attachHistogramFamily.name...)
+			buf = append(buf, "_bucket{"...)
+			buf = appendLabel(buf, "phase", phase)
+			buf = append(buf, `,le="`...)
+			if i < len(latencyBuckets) {
+				buf = strconv.AppendFloat(buf, latencyBuckets[i].Seconds(), 'g', -1, 64)
+			} else {
+				buf = append(buf, "+Inf"...)
+			}
+			buf = append(buf, `"} `...)
+			buf = strconv.AppendUint(buf, cumulative, 10)
+			buf = append(buf, '\n')
+			bw.Write(buf)
+		}
+		buf = append(buf[:0], attachHistogramFamily.name...)
+		buf = append(buf, "_sum{"...)
+		buf = appendLabel(buf, "phase", phase)
+		buf = append(buf, "} "...)
+		buf = strconv.AppendFloat(buf, time.Duration(h.sum.Load()).Seconds(), 'g', -1, 64)
+		buf = append(buf, '\n')
+		buf = append(buf, attachHistogramFamily.name...)
+		buf = append(buf, "_count{"...)
+		buf = appendLabel(buf, "phase", phase)
+		buf = append(buf, "} "...)
+		buf = strconv.AppendUint(buf, h.count.Load(), 10)
+		buf = append(buf, '\n')
+		bw.Write(buf)
+	}
+	return buf
+}
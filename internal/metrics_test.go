@@ -0,0 +1,146 @@
+package internal
+
+import (
+	"net/http"
+	"os"
+	"os/user"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg/perfdata"
+	"github.com/stretchr/testify/assert"
+)
+
+// discardResponseWriter is a ResponseWriter that drops the body, for allocation checks.
+type discardResponseWriter struct {
+	header http.Header
+	body   strings.Builder
+	keep   bool
+}
+
+func (w *discardResponseWriter) Header() http.Header { return w.header }
+func (w *discardResponseWriter) WriteHeader(int)     {}
+func (w *discardResponseWriter) Write(p []byte) (int, error) {
+	if w.keep {
+		w.body.Write(p)
+	}
+	return len(p), nil
+}
+
+// prepareMetricsPerfdataFile writes a perfdata file with the counters published by /metrics.
+func prepareMetricsPerfdataFile(t *testing.T, username string, pid int) {
+	t.Helper()
+	hsperfDir := filepath.Join(os.TempDir(), "hsperfdata_"+username)
+	if err := os.MkdirAll(hsperfDir, 0755); err != nil {
+		t.Fatalf("failed to create hsperfdata dir: %v", err)
+	}
+	t.Cleanup(func() { os.RemoveAll(hsperfDir) })
+	writeMetricsPerfdataFile(t, perfdata.Path(username, int32(pid)))
+}
+
+// writeMetricsPerfdataFile writes a perfdata file with the counters published by /metrics at path.
+func writeMetricsPerfdataFile(t *testing.T, path string) {
+	t.Helper()
+	err := perfdata.WriteMock(path,
+		perfdata.MockCounter{Name: "sun.os.hrt.frequency", Long: 1_000_000_000},
+		perfdata.MockCounter{Name: "sun.os.hrt.ticks", Long: 5_000_000_000},
+		perfdata.MockCounter{Name: "sun.gc.collector.0.name", Text: "G1 Young \"Generation\""},
+		perfdata.MockCounter{Name: "sun.gc.collector.0.invocations", Long: 7},
+		perfdata.MockCounter{Name: "sun.gc.collector.0.time", Long: 250_000_000},
+		perfdata.MockCounter{Name: "sun.gc.generation.0.space.0.name", Text: "eden"},
+		perfdata.MockCounter{Name: "sun.gc.generation.0.space.0.used", Long: 25},
+		perfdata.MockCounter{Name: "sun.gc.generation.0.space.0.capacity", Long: 100},
+		perfdata.MockCounter{Name: "sun.gc.metaspace.used", Long: 10},
+		perfdata.MockCounter{Name: "java.cls.loadedClasses", Long: 1234},
+		perfdata.MockCounter{Name: "sun.rt.safepoints", Long: 3},
+		perfdata.MockCounter{Name: "sun.rt.safepointTime", Long: 2_000_000},
+	)
+	if err != nil {
+		t.Fatalf("failed to write perfdata file: %v", err)
+	}
+}
+
+// TestServer_Metrics tests the exposition of perfdata counters and attach histograms.
+func TestServer_Metrics(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := os.Getpid()
+	prepareMetricsPerfdataFile(t, currentUser.Username, pid)
+	s := NewServer()
+	defer s.Close()
+
+	w := serveRequest(s, http.MethodGet, "/metrics", "")
+	assert.Equal(t, http.StatusOK, w.Code)
+	body := w.Body.String()
+	labels := `pid="` + strconv.Itoa(pid) + `",main="`
+	for _, expected := range []string{
+		"# TYPE jvm_gc_collections_total counter\n",
+		`jvm_gc_collections_total{` + labels,
+		`collector="G1 Young \"Generation\""} 7` + "\n",
+		`collector="G1 Young \"Generation\""} 0.25` + "\n",
+		`space="eden"} 25` + "\n",
+		`space="eden"} 100` + "\n",
+		`space="metaspace"} 10` + "\n",
+		`jvm_classes_loaded_total{` + labels,
+		`jvm_safepoint_seconds_total{`,
+		"} 0.002\n",
+		"jvm_uptime_seconds{",
+		"} 5\n",
+		"# TYPE jvmtool_attach_phase_seconds histogram\n",
+		`jvmtool_attach_phase_seconds_bucket{phase="connect",le="+Inf"} `,
+		`jvmtool_attach_phase_seconds_count{phase="read"} `,
+	} {
+		assert.Contains(t, body, expected)
+	}
+	assert.False(t, strings.Contains(body, "jvm_jit_compilations_total{"), "missing counters must be skipped")
+	assert.Equal(t, http.StatusMethodNotAllowed, serveRequest(s, http.MethodPost, "/metrics", "").Code)
+}
+
+// TestServer_MetricsContainers tests that the JVMs of containers are published until they are gone.
+func TestServer_MetricsContainers(t *testing.T) {
+	root := t.TempDir()
+	dir := filepath.Join(root, "tmp", "hsperfdata_app")
+	os.MkdirAll(dir, 0755)
+	writeMetricsPerfdataFile(t, filepath.Join(dir, "7"))
+	s := NewServer()
+	defer s.Close()
+	s.usersScanned = time.Now()
+
+	pid := os.Getpid()
+	s.discoverContainers([]hsperfdataEntry{{pid: int32(pid), user: "app", root: root, nsPid: 7}})
+	body := serveRequest(s, http.MethodGet, "/metrics", "").Body.String()
+	assert.Contains(t, body, `jvm_classes_loaded_total{pid="`+strconv.Itoa(pid)+`",main="`)
+
+	s.discoverContainers(nil)
+	body = serveRequest(s, http.MethodGet, "/metrics", "").Body.String()
+	assert.False(t, strings.Contains(body, "jvm_classes_loaded_total{"), "a container JVM that is gone must not be published")
+	assert.Equal(t, 0, len(s.perfdata))
+}
+
+// TestServer_MetricsAllocs tests that scraping known JVMs does not allocate.
+func TestServer_MetricsAllocs(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	prepareMetricsPerfdataFile(t, currentUser.Username, os.Getpid())
+	s := NewServer()
+	defer s.Close()
+
+	w := &discardResponseWriter{header: http.Header{}}
+	r, _ := http.NewRequest(http.MethodGet, "/metrics", nil)
+	s.handleMetrics(w, r)
+	allocs := testing.AllocsPerRun(100, func() {
+		s.handleMetrics(w, r)
+	})
+	assert.Equal(t, float64(0), allocs)
+
+	w.keep = true
+	s.handleMetrics(w, r)
+	assert.Contains(t, w.body.String(), "jvm_gc_collections_total{")
+}
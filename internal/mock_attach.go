@@ -0,0 +1,48 @@
+package internal
+
+import (
+	"bufio"
+	"net"
+	"os"
+)
+
+// startMockAttachListener serves the attach protocol on the socket of pid the way a HotSpot
+// Attach Listener does: one request per connection, answered by respond and then closed.
+func startMockAttachListener(pid int32, respond func(cmd string, args []string) string) (func(), error) {
+	return startMockAttachListenerAt(attachSocketPath(pid), respond)
+}
+
+// startMockAttachListenerAt is like startMockAttachListener but listens on path.
+func startMockAttachListenerAt(path string, respond func(cmd string, args []string) string) (func(), error) {
+	os.Remove(path)
+	l, err := net.Listen("unix", path)
+	if err != nil {
+		return nil, err
+	}
+	go func() {
+		for {
+			conn, err := l.Accept()
+			if err != nil {
+				return
+			}
+			go func(conn net.Conn) {
+				defer conn.Close()
+				r := bufio.NewReader(conn)
+				fields := make([]string, 0, 2+attachMaxArgs)
+				for len(fields) < cap(fields) {
+					s, err := r.ReadString(0)
+					if err != nil {
+						return
+					}
+					fields = append(fields, s[:len(s)-1])
+				}
+				conn.Write([]byte(respond(fields[1], fields[2:])))
+			}(conn)
+		}
+	}()
+	cleanup := func() {
+		l.Close()
+		os.Remove(path)
+	}
+	return cleanup, nil
+}
@@ -0,0 +1,185 @@
+package internal
+
+import (
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"os/signal"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"syscall"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+)
+
+type ProfileOption struct {
+	User     string
+	Pid      string
+	Lib      string        // -lib, path to libasyncProfiler.so
+	Event    string        // -event
+	Duration time.Duration // -duration
+	Interval string        // -interval, passed to async-profiler as is
+	Output   string        // -o, stdout if empty
+}
+
+// ParseProfileFlags parses flags for the "profile" command and returns the corresponding ProfileOption.
+// The pid is taken from the first positional argument.
+func ParseProfileFlags(args []string) (ProfileOption, error) {
+	profileFlagSet := flag.NewFlagSet("profile", flag.ContinueOnError)
+	user := profileFlagSet.String("user", "", "specify the user owning the Java process")
+	lib := profileFlagSet.String("lib", "", "specify the path to libasyncProfiler.so")
+	event := profileFlagSet.String("event", "cpu", "specify the event to profile, e.g. cpu, alloc, lock or wall")
+	duration := profileFlagSet.Duration("duration", 30*time.Second, "how long to profile for")
+	interval := profileFlagSet.String("interval", "", "specify the sampling interval, in the event's units")
+	output := profileFlagSet.String("o", "", "write the collapsed stacks to this file instead of stdout")
+	if err := profileFlagSet.Parse(args); err != nil {
+		return ProfileOption{}, err
+	}
+	return ProfileOption{
+		User:     *user,
+		Pid:      profileFlagSet.Arg(0),
+		Lib:      *lib,
+		Event:    *event,
+		Duration: *duration,
+		Interval: *interval,
+		Output:   *output,
+	}, nil
+}
+
+// ProfileValidate validates the ProfileOption fields.
+func (opt *ProfileOption) ProfileValidate() error {
+	if opt.Lib == "" {
+		return errors.New("lib is required")
+	}
+	if !isNativeAgent(opt.Lib) {
+		return fmt.Errorf("lib must be a native library: %s", opt.Lib)
+	}
+	abs, err := filepath.Abs(opt.Lib)
+	if err != nil {
+		return err
+	}
+	opt.Lib = abs
+	if opt.Event == "" || strings.ContainsAny(opt.Event, ",=") {
+		return fmt.Errorf("invalid event %s", opt.Event)
+	}
+	if strings.ContainsAny(opt.Interval, ",=") {
+		return fmt.Errorf("invalid interval %s", opt.Interval)
+	}
+	if opt.Duration <= 0 {
+		return errors.New("duration must be positive")
+	}
+	if opt.Pid == "" {
+		return errors.New("pid is required")
+	}
+	if pid, err := strconv.Atoi(opt.Pid); err != nil || pid <= 0 {
+		return fmt.Errorf("invalid pid %s", opt.Pid)
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+	return validateJvmPid(opt.User, toInt32(opt.Pid))
+}
+
+// Profile runs async-profiler in a Java process for the given duration and writes
+// the collected stacks in collapsed format, ready for flamegraph tools.
+// The library is loaded as a native agent twice, to start and to stop profiling;
+// an interrupt stops early. The JVM dumps the stacks into its own temp dir, from
+// where they are streamed back and removed.
+func Profile(option ProfileOption) int {
+	if err := option.ProfileValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+	if err := profile(ctx, option); err != nil {
+		log(err.Error())
+		return 1
+	}
+	return 0
+}
+
+// profile starts, waits for and stops a profiling session, then copies the result.
+func profile(ctx context.Context, option ProfileOption) error {
+	jp := &JvmProcess{Pid: toInt32(option.Pid)}
+	if err := jp.checkSocket(); err != nil {
+		return err
+	}
+	// The dump is written to a directory the user of the JVM can write to, so it
+	// is reached through the attach root and never through a symlink planted there.
+	root, dir, err := jp.attachRoot()
+	if err != nil {
+		return err
+	}
+	defer root.Close()
+	base := fmt.Sprintf("jvmtool-profile-%d-%d.collapsed", jp.nsPid, time.Now().UnixNano())
+	dump := jp.tempDir() + "/" + base
+	defer root.Remove(dir + base)
+
+	start := "start,event=" + option.Event
+	if option.Interval != "" {
+		start += ",interval=" + option.Interval
+	}
+	if err := jp.loadAgent(option.Lib, start); err != nil {
+		return fmt.Errorf("cannot start profiler: %v", err.Error())
+	}
+	log(fmt.Sprintf("profiling process %d for %v...", jp.Pid, option.Duration))
+	timer := time.NewTimer(option.Duration)
+	select {
+	case <-timer.C:
+	case <-ctx.Done():
+		timer.Stop()
+		log("interrupted, stopping profiler")
+	}
+	if err := jp.loadAgent(option.Lib, "stop,file="+strings.TrimPrefix(dump, jp.root)+",collapsed"); err != nil {
+		return fmt.Errorf("cannot stop profiler: %v", err.Error())
+	}
+
+	f, err := openProfileDump(jp, root, dir+base)
+	if err != nil {
+		return fmt.Errorf("cannot read profile: %v", err.Error())
+	}
+	defer f.Close()
+	out := attachOutput
+	if option.Output != "" {
+		w, err := os.Create(option.Output)
+		if err != nil {
+			return err
+		}
+		defer w.Close()
+		out = w
+	}
+	_, err = io.Copy(out, f)
+	return err
+}
+
+// openProfileDump opens the dump written by the profiler, which must be a regular
+// file owned by the user the JVM runs as.
+func openProfileDump(jp *JvmProcess, root *pkg.Root, name string) (*os.File, error) {
+	f, err := root.OpenFile(name, os.O_RDONLY, 0)
+	if err != nil {
+		return nil, err
+	}
+	fi, err := f.Stat()
+	if err != nil {
+		f.Close()
+		return nil, err
+	}
+	uid, err := pkg.ProcessUid(jp.Pid)
+	if err != nil {
+		f.Close()
+		return nil, err
+	}
+	if st, ok := fi.Sys().(*syscall.Stat_t); !fi.Mode().IsRegular() || !ok || int(st.Uid) != uid {
+		f.Close()
+		return nil, fmt.Errorf("%s is not a file of the user of process %d", root.Join(name), jp.Pid)
+	}
+	return f, nil
+}
@@ -0,0 +1,132 @@
+package internal
+
+import (
+	"bytes"
+	"context"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// TestIsNativeAgent tests telling native libraries from agent jars.
+func TestIsNativeAgent(t *testing.T) {
+	assert.True(t, isNativeAgent("/opt/async-profiler/lib/libasyncProfiler.so"))
+	assert.True(t, isNativeAgent("libasyncProfiler.dylib"))
+	assert.False(t, isNativeAgent("/opt/agent.jar"))
+}
+
+// TestLoadAgent_Native tests that native libraries are loaded directly with their options.
+func TestLoadAgent_Native(t *testing.T) {
+	pid := int32(os.Getpid())
+	var gotArgs []string
+	code := "0"
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		gotArgs = args
+		return "0\nreturn code: " + code + "\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	jp := &JvmProcess{Pid: pid}
+	assert.Nil(t, jp.loadAgent("/opt/libagent.so", "start,event=cpu"))
+	assert.Equal(t, []string{"/opt/libagent.so", "true", "start,event=cpu"}, gotArgs)
+
+	code = "2"
+	assert.EqualError(t, jp.loadAgent("/opt/libagent.so", ""), "agent load failed, Agent_OnAttach returned 2")
+}
+
+// TestProfile tests a profiling session against a mock async-profiler.
+func TestProfile(t *testing.T) {
+	pid := int32(os.Getpid())
+	var commands []string
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		commands = append(commands, args[2])
+		if file, ok := strings.CutPrefix(args[2], "stop,file="); ok {
+			os.WriteFile(strings.TrimSuffix(file, ",collapsed"), []byte("main;work 42\n"), 0644)
+		}
+		return "0\nreturn code: 0\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+	restore, _, _ := captureLogs()
+	defer restore()
+
+	var out bytes.Buffer
+	origOutput := attachOutput
+	attachOutput = &out
+	defer func() { attachOutput = origOutput }()
+
+	option := ProfileOption{Pid: strconv.Itoa(int(pid)), Lib: "/opt/libasyncProfiler.so", Event: "cpu", Interval: "1ms", Duration: 10 * time.Millisecond}
+	if err := profile(context.Background(), option); err != nil {
+		t.Fatalf("profile failed: %v", err)
+	}
+	assert.Equal(t, "main;work 42\n", out.String())
+	if assert.Len(t, commands, 2) {
+		assert.Equal(t, "start,event=cpu,interval=1ms", commands[0])
+		assert.True(t, strings.HasSuffix(commands[1], ",collapsed"))
+	}
+	matches, _ := filepath.Glob(os.TempDir() + "/jvmtool-profile-*")
+	assert.Len(t, matches, 0)
+}
+
+// TestProfile_PlantedDump tests that a symlink planted as the dump is not followed.
+func TestProfile_PlantedDump(t *testing.T) {
+	secret := filepath.Join(t.TempDir(), "secret")
+	os.WriteFile(secret, []byte("secret\n"), 0600)
+	pid := int32(os.Getpid())
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		if file, ok := strings.CutPrefix(args[2], "stop,file="); ok {
+			os.Symlink(secret, strings.TrimSuffix(file, ",collapsed"))
+		}
+		return "0\nreturn code: 0\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+	restore, _, _ := captureLogs()
+	defer restore()
+
+	var out bytes.Buffer
+	origOutput := attachOutput
+	attachOutput = &out
+	defer func() { attachOutput = origOutput }()
+
+	option := ProfileOption{Pid: strconv.Itoa(int(pid)), Lib: "/opt/libasyncProfiler.so", Event: "cpu", Duration: time.Millisecond}
+	err = profile(context.Background(), option)
+	if assert.NotNil(t, err) {
+		assert.True(t, strings.HasPrefix(err.Error(), "cannot read profile: "), err.Error())
+	}
+	assert.Equal(t, "", out.String())
+	matches, _ := filepath.Glob(os.TempDir() + "/jvmtool-profile-*")
+	assert.Len(t, matches, 0)
+	_, err = os.Stat(secret)
+	assert.Nil(t, err)
+}
+
+// TestProfileValidate tests the validation of profile options.
+func TestProfileValidate(t *testing.T) {
+	tests := []struct {
+		option   ProfileOption
+		expected string
+	}{
+		{ProfileOption{Pid: "1", Event: "cpu", Duration: time.Second}, "lib is required"},
+		{ProfileOption{Pid: "1", Lib: "/agent.jar", Event: "cpu", Duration: time.Second}, "lib must be a native library: /agent.jar"},
+		{ProfileOption{Pid: "1", Lib: "/lib.so", Event: "cpu,file=x", Duration: time.Second}, "invalid event cpu,file=x"},
+		{ProfileOption{Pid: "1", Lib: "/lib.so", Event: "cpu"}, "duration must be positive"},
+		{ProfileOption{Lib: "/lib.so", Event: "cpu", Duration: time.Second}, "pid is required"},
+		{ProfileOption{Pid: "x", Lib: "/lib.so", Event: "cpu", Duration: time.Second}, "invalid pid x"},
+	}
+	for _, tt := range tests {
+		assert.EqualError(t, tt.option.ProfileValidate(), tt.expected)
+	}
+}
@@ -0,0 +1,324 @@
+package internal
+
+import (
+	"bufio"
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"os/signal"
+	"path/filepath"
+	"strconv"
+	"sync"
+	"syscall"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+// recordRescan is how often record -all looks for JVMs that started since.
+const recordRescan = time.Second
+
+// recordFileSuffix names the recordings written by record -all.
+const recordFileSuffix = ".jvmrec"
+
+type RecordOption struct {
+	User     string
+	Pid      string
+	All      bool          // -all
+	Interval time.Duration // -interval
+	Duration time.Duration // -duration, 0 means until interrupted
+	Output   string        // -o, a file, or a directory with -all
+}
+
+// ParseRecordFlags parses flags for the "record" command and returns the corresponding RecordOption.
+// The pid is taken from the first positional argument.
+func ParseRecordFlags(args []string) (RecordOption, error) {
+	recordFlagSet := flag.NewFlagSet("record", flag.ContinueOnError)
+	user := recordFlagSet.String("user", "", "specify the user owning the Java processes")
+	all := recordFlagSet.Bool("all", false, "record every Java process of the user, including those started later")
+	interval := recordFlagSet.Duration("interval", 100*time.Millisecond, "sampling interval, e.g. 100ms")
+	duration := recordFlagSet.Duration("duration", 0, "how long to record for, 0 until interrupted")
+	output := recordFlagSet.String("o", "", "the file to record to, or the directory with -all")
+	if err := recordFlagSet.Parse(args); err != nil {
+		return RecordOption{}, err
+	}
+	return RecordOption{
+		User:     *user,
+		Pid:      recordFlagSet.Arg(0),
+		All:      *all,
+		Interval: *interval,
+		Duration: *duration,
+		Output:   *output,
+	}, nil
+}
+
+// RecordValidate validates the RecordOption fields.
+func (opt *RecordOption) RecordValidate() error {
+	if opt.Output == "" {
+		return errors.New("output is required")
+	}
+	if opt.Interval <= 0 {
+		return errors.New("interval must be positive")
+	}
+	if opt.Duration < 0 {
+		return errors.New("duration must not be negative")
+	}
+	if (opt.Pid == "") == !opt.All {
+		return errors.New("one of pid and -all is required")
+	}
+	if opt.Pid != "" {
+		if pid, err := strconv.Atoi(opt.Pid); err != nil || pid <= 0 {
+			return fmt.Errorf("invalid pid %s", opt.Pid)
+		}
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+	return nil
+}
+
+// Record samples every long perfdata counter of a Java process, or of every Java
+// process of the user with -all, into compact recordings, see perfdata.Recorder.
+// Recording stops after the duration, on an interrupt or when the processes exit.
+func Record(option RecordOption) int {
+	if err := option.RecordValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+	if option.Duration > 0 {
+		var cancel context.CancelFunc
+		ctx, cancel = context.WithTimeout(ctx, option.Duration)
+		defer cancel()
+	}
+	if !option.All {
+		if err := recordJvm(ctx, option.User, toInt32(option.Pid), option.Output, option.Interval); err != nil {
+			log(err.Error())
+			return 1
+		}
+		return 0
+	}
+	if err := recordAll(ctx, option); err != nil {
+		log(err.Error())
+		return 1
+	}
+	return 0
+}
+
+// recordAll records every JVM of the user into its own file in the output directory,
+// named after its pid and start time, until ctx is done.
+func recordAll(ctx context.Context, option RecordOption) error {
+	if err := os.MkdirAll(option.Output, 0755); err != nil {
+		return err
+	}
+	dir := filepath.Join(os.TempDir(), hsperfdataPrefix+option.User)
+	var wg sync.WaitGroup
+	defer wg.Wait()
+	recording := map[int32]bool{}
+	var mu sync.Mutex
+	ticker := time.NewTicker(recordRescan)
+	defer ticker.Stop()
+	for {
+		for _, e := range listHsperfdataPids(dir, option.User) {
+			if exist, _ := pkg.PidExists(e.pid); !exist {
+				continue
+			}
+			mu.Lock()
+			started := recording[e.pid]
+			recording[e.pid] = true
+			mu.Unlock()
+			if started {
+				continue
+			}
+			path := filepath.Join(option.Output, fmt.Sprintf("%d-%d%s", e.pid, time.Now().Unix(), recordFileSuffix))
+			wg.Add(1)
+			go func(pid int32) {
+				defer wg.Done()
+				if err := recordJvm(ctx, option.User, pid, path, option.Interval); err != nil {
+					log(err.Error())
+				}
+				// A stale perfdata file is tried again when a new process takes the pid.
+				mu.Lock()
+				delete(recording, pid)
+				mu.Unlock()
+			}(e.pid)
+		}
+		select {
+		case <-ctx.Done():
+			return nil
+		case <-ticker.C:
+		}
+	}
+}
+
+// recordJvm records the JVM into path every interval until ctx is done or the process exits.
+func recordJvm(ctx context.Context, user string, pid int32, path string, interval time.Duration) error {
+	pd, err := perfdata.Open(perfdata.Path(user, pid))
+	if err != nil {
+		return fmt.Errorf("cannot read perfdata of process %d: %v", pid, err)
+	}
+	defer pd.Close()
+	if err := syscall.Kill(int(pid), 0); err == syscall.ESRCH {
+		return fmt.Errorf("process %d has exited", pid)
+	}
+
+	start := time.Now()
+	header, names := perfdata.NewRecordHeader(pd, pid, start)
+	f, err := os.Create(path)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+	rec, err := perfdata.NewRecorder(f, header)
+	if err != nil {
+		return err
+	}
+	sampler := perfdata.NewSampler(pd, names)
+	values := make([]int64, sampler.Len())
+	ticker := time.NewTicker(interval)
+	defer ticker.Stop()
+	lastCheck := start
+	for now := start; ; {
+		if now.Sub(lastCheck) >= time.Second {
+			lastCheck = now
+			if err := syscall.Kill(int(pid), 0); err == syscall.ESRCH {
+				break
+			}
+		}
+		sampler.Sample(values)
+		if err := rec.Record(now, values); err != nil {
+			return err
+		}
+		select {
+		case <-ctx.Done():
+			return rec.Flush()
+		case now = <-ticker.C:
+		}
+	}
+	return rec.Flush()
+}
+
+type ReplayOption struct {
+	Input  string
+	GcUtil bool // -gcutil
+	Uptime bool // -t
+}
+
+// ParseReplayFlags parses flags for the "replay" command and returns the corresponding ReplayOption.
+// The recording is taken from the first positional argument.
+func ParseReplayFlags(args []string) (ReplayOption, error) {
+	replayFlagSet := flag.NewFlagSet("replay", flag.ContinueOnError)
+	gcUtil := replayFlagSet.Bool("gcutil", false, "show garbage collection statistics summary")
+	uptime := replayFlagSet.Bool("t", false, "show the JVM uptime as the first column")
+	if err := replayFlagSet.Parse(args); err != nil {
+		return ReplayOption{}, err
+	}
+	return ReplayOption{
+		Input:  replayFlagSet.Arg(0),
+		GcUtil: *gcUtil,
+		Uptime: *uptime,
+	}, nil
+}
+
+// ReplayValidate validates the ReplayOption fields.
+func (opt *ReplayOption) ReplayValidate() error {
+	if !opt.GcUtil {
+		return errors.New("an output option is required, e.g. -gcutil")
+	}
+	if opt.Input == "" {
+		return errors.New("recording is required")
+	}
+	return nil
+}
+
+// counterPresence is a counterSet of the counters found in a recording.
+type counterPresence []bool
+
+func (p counterPresence) Has(i int) bool {
+	return p[i]
+}
+
+// Replay formats the samples of a recording the way jstat does.
+func Replay(option ReplayOption) int {
+	if err := option.ReplayValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	f, err := os.Open(option.Input)
+	if err != nil {
+		log(err.Error())
+		return 1
+	}
+	defer f.Close()
+	if err := replay(f, jstatOutput, option); err != nil {
+		log(fmt.Sprintf("cannot replay %s: %v", option.Input, err))
+		return 1
+	}
+	return 0
+}
+
+// replay streams the recording in r to w through the -gcutil formatter.
+func replay(r io.Reader, w io.Writer, option ReplayOption) error {
+	rr, err := perfdata.NewRecordReader(r)
+	if err != nil {
+		return err
+	}
+	header := rr.Header()
+	// The frequency is a constant in HotSpot, but read it from the samples if it was recorded.
+	frequency, frequencyColumn, ok := header.Lookup("sun.os.hrt.frequency")
+	if !ok {
+		return errors.New("recording has no hrt frequency")
+	}
+
+	// Each gcutil counter is a column of the recording, a constant or absent. The
+	// clock is derived from the sample times unless it was recorded.
+	_, derivedTicks := header.Ticks(header.Start)
+	columns := make([]int, len(gcutilCounters))
+	constants := make([]int64, len(gcutilCounters))
+	present := make(counterPresence, len(gcutilCounters))
+	for i, name := range gcutilCounters {
+		constants[i], columns[i], present[i] = header.Lookup(name)
+	}
+
+	out := bufio.NewWriter(w)
+	defer out.Flush()
+	values := make([]int64, len(header.Columns))
+	row := make([]int64, len(gcutilCounters))
+	line := appendGcutilHeader(make([]byte, 0, 256), option.Uptime)
+	out.Write(line)
+	for {
+		t, err := rr.Next(values)
+		if err == io.EOF {
+			return nil
+		} else if err != nil {
+			return err
+		}
+		if frequencyColumn >= 0 {
+			frequency = values[frequencyColumn]
+		}
+		if frequency <= 0 {
+			return errors.New("recording has no hrt frequency")
+		}
+		for i, c := range columns {
+			if c >= 0 {
+				row[i] = values[c]
+			} else {
+				row[i] = constants[i]
+			}
+		}
+		if derivedTicks {
+			row[gcTicks], _ = header.Ticks(t)
+		}
+		line = appendGcutil(line[:0], present, row, float64(frequency), option.Uptime)
+		if _, err := out.Write(line); err != nil {
+			return err
+		}
+	}
+}
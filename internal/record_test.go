@@ -0,0 +1,102 @@
+package internal
+
+import (
+	"bytes"
+	"os"
+	"os/user"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+)
+
+// TestParseRecordFlags tests the ParseRecordFlags function.
+func TestParseRecordFlags(t *testing.T) {
+	opt, err := ParseRecordFlags([]string{"-interval", "50ms", "-duration", "1h", "-o", "out.jvmrec", "12345"})
+	if err != nil {
+		t.Fatalf("ParseRecordFlags failed: %v", err)
+	}
+	if opt.Interval != 50*time.Millisecond || opt.Duration != time.Hour || opt.Output != "out.jvmrec" || opt.Pid != "12345" || opt.All {
+		t.Errorf("unexpected option: %+v", opt)
+	}
+}
+
+// TestRecordValidate tests the RecordValidate method of RecordOption.
+func TestRecordValidate(t *testing.T) {
+	tests := []struct {
+		name     string
+		option   RecordOption
+		expected string
+	}{
+		{"missing output", RecordOption{Pid: "1", Interval: time.Second}, "output is required"},
+		{"bad interval", RecordOption{Pid: "1", Output: "o"}, "interval must be positive"},
+		{"negative duration", RecordOption{Pid: "1", Output: "o", Interval: time.Second, Duration: -time.Second}, "duration must not be negative"},
+		{"missing pid", RecordOption{Output: "o", Interval: time.Second}, "one of pid and -all is required"},
+		{"pid and all", RecordOption{Pid: "1", All: true, Output: "o", Interval: time.Second}, "one of pid and -all is required"},
+		{"invalid pid", RecordOption{Pid: "abc", Output: "o", Interval: time.Second}, "invalid pid abc"},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			err := tt.option.RecordValidate()
+			if err == nil || err.Error() != tt.expected {
+				t.Errorf("expected error '%s', got: %v", tt.expected, err)
+			}
+		})
+	}
+}
+
+// TestRecord_Replay tests recording a mock perfdata file and replaying it with -gcutil.
+func TestRecord_Replay(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := os.Getpid()
+	cleanup, err := prepareGcPerfdataFile(currentUser.Username, pid)
+	if err != nil {
+		t.Fatalf("failed to create perfdata file: %v", err)
+	}
+	defer cleanup()
+
+	path := filepath.Join(t.TempDir(), "test.jvmrec")
+	code := Record(RecordOption{Pid: strconv.Itoa(pid), Interval: time.Millisecond, Duration: 50 * time.Millisecond, Output: path})
+	if code != 0 {
+		t.Fatalf("expected exit code 0, got %d", code)
+	}
+
+	var out bytes.Buffer
+	orig := jstatOutput
+	jstatOutput = &out
+	defer func() { jstatOutput = orig }()
+
+	if code := Replay(ReplayOption{Input: path, GcUtil: true, Uptime: true}); code != 0 {
+		t.Fatalf("expected exit code 0, got %d", code)
+	}
+	lines := strings.Split(strings.TrimSpace(out.String()), "\n")
+	if len(lines) < 2 {
+		t.Fatalf("expected header and samples, got: %q", out.String())
+	}
+	if !strings.HasPrefix(lines[0], "Timestamp") || !strings.Contains(lines[0], "YGCT") {
+		t.Errorf("unexpected header: %q", lines[0])
+	}
+	fields := strings.Fields(lines[1])
+	expected := []string{"5.0", "-", "-", "25.00", "-", "-", "-", "7", "0.250", "-", "-", "-", "-", "0.250"}
+	if strings.Join(fields, " ") != strings.Join(expected, " ") {
+		t.Errorf("expected %v, got %v", expected, fields)
+	}
+}
+
+// TestReplay_Invalid tests that a file that is not a recording is rejected.
+func TestReplay_Invalid(t *testing.T) {
+	restore, getLogs, _ := captureLogs()
+	defer restore()
+	path := filepath.Join(t.TempDir(), "bad.jvmrec")
+	os.WriteFile(path, []byte("not a recording"), 0644)
+	if code := Replay(ReplayOption{Input: path, GcUtil: true}); code != 1 {
+		t.Errorf("expected exit code 1, got %d", code)
+	}
+	if logs := getLogs(); len(logs) != 1 || !strings.Contains(logs[0], "invalid perfdata recording") {
+		t.Errorf("unexpected logs: %v", logs)
+	}
+}
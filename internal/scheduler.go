@@ -0,0 +1,152 @@
+package internal
+
+import (
+	"context"
+	"fmt"
+	"math/rand"
+	"os"
+	"path/filepath"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+// Priority classes of attach targets. A fan-out attaches class by class, in this order.
+const (
+	attachPriorityNormal    = iota
+	attachPrioritySensitive // latency-sensitive JVMs, attached to last and one at a time
+	attachPriorityCount
+)
+
+// attachTarget is a JVM to attach to and its priority class.
+type attachTarget struct {
+	process  JvmProcess // as selected, with its start time so that a reused pid is refused
+	priority int
+}
+
+// attachScheduler spreads attaches over time. Every attach may send SIGQUIT and
+// loading an agent brings the target to a safepoint, so attaching to every JVM of
+// a host at once would pause all of them together.
+type attachScheduler struct {
+	concurrency int           // attaches in flight at once on the host, across the jvmtool runs of a user
+	jitter      time.Duration // upper bound of the random delay before each attach
+	gcGate      time.Duration // longest wait for a target to finish a GC, 0 to not wait
+}
+
+// attachSlotsDir returns the directory of the host-wide attach slots. It is per
+// user, as anyone able to open a slot could hold it forever, so the cap applies
+// to the attaches of each user.
+func attachSlotsDir() string {
+	return filepath.Join(os.TempDir(), fmt.Sprintf(".jvmtool-attach-slots-%d", os.Geteuid()))
+}
+
+// attachSlotWait bounds the wait for a host-wide slot, the time an attach may
+// take to answer. Past it, the attach goes ahead without a slot rather than
+// behind holders that are stuck.
+var attachSlotWait = defaultAttachIOTimeout
+
+// gcGatePoll is how often the perfdata of a target in GC is checked again.
+const gcGatePoll = 2 * time.Millisecond
+
+// gcGateCollectors is the number of collectors checked: the young and the full
+// collector. G1 counts its concurrent cycle as collector 2, which does not pause.
+const gcGateCollectors = 2
+
+// run calls attach for every target and returns the results in target order. Priority
+// classes run one after the other, the sensitive one a target at a time.
+func (s attachScheduler) run(targets []attachTarget, attach func(jp JvmProcess) attachResult) []attachResult {
+	results := make([]attachResult, len(targets))
+	for class := 0; class < attachPriorityCount; class++ {
+		var indices []int
+		for i, t := range targets {
+			if t.priority == class {
+				indices = append(indices, i)
+			}
+		}
+		concurrency := s.concurrency
+		if class == attachPrioritySensitive {
+			concurrency = 1
+		}
+		pkg.ParallelFor(len(indices), concurrency, func(i int) {
+			results[indices[i]] = attach(targets[indices[i]].process)
+		})
+	}
+	return results
+}
+
+// admit waits until jp may be attached to: after the jitter, once a host-wide slot is
+// free and, with a GC gate, once the target is not collecting. The returned function
+// releases the slot. When the slot directory cannot be used or no slot frees up
+// within attachSlotWait, attaches are not capped across runs.
+func (s attachScheduler) admit(ctx context.Context, jp *JvmProcess, user string) (func(), error) {
+	defer jp.trace.Done(PhaseSchedule)
+	if s.jitter > 0 {
+		select {
+		case <-ctx.Done():
+			return nil, ctx.Err()
+		case <-time.After(time.Duration(rand.Int63n(int64(s.jitter)))):
+		}
+	}
+	slotCtx, cancel := context.WithTimeout(ctx, attachSlotWait)
+	release, err := pkg.HostSemaphore{Dir: attachSlotsDir(), Slots: s.concurrency}.Acquire(slotCtx)
+	cancel()
+	if err != nil {
+		if ctx.Err() != nil {
+			return nil, ctx.Err()
+		}
+		release = func() {}
+	}
+	if s.gcGate > 0 {
+		jp.locate()
+		waitOutOfGC(jp.perfDataPath(user), s.gcGate)
+	}
+	return release, nil
+}
+
+// perfDataPath returns the path of the perfdata file of the JVM, as seen from here.
+func (jp *JvmProcess) perfDataPath(user string) string {
+	if jp.root == "" {
+		return perfdata.Path(user, jp.Pid)
+	}
+	matches, _ := filepath.Glob(fmt.Sprintf("%s/tmp/%s*/%d", jp.root, hsperfdataPrefix, jp.nsPid))
+	if len(matches) == 0 {
+		return ""
+	}
+	return matches[0]
+}
+
+// waitOutOfGC waits for at most timeout until no collector of the JVM is running,
+// which its perfdata shows as a collector entered more recently than it was exited.
+// JVMs whose perfdata cannot be read are not waited for.
+func waitOutOfGC(path string, timeout time.Duration) {
+	pd, err := perfdata.Open(path)
+	if err != nil {
+		return
+	}
+	defer pd.Close()
+	names := make([]string, 0, 2*gcGateCollectors)
+	for i := 0; i < gcGateCollectors; i++ {
+		names = append(names, fmt.Sprintf("sun.gc.collector.%d.lastEntryTime", i), fmt.Sprintf("sun.gc.collector.%d.lastExitTime", i))
+	}
+	sampler := perfdata.NewSampler(pd, names)
+	sample := make([]int64, sampler.Len())
+	deadline := time.Now().Add(timeout)
+	for {
+		sampler.Sample(sample)
+		if !collecting(sample) || time.Now().After(deadline) {
+			return
+		}
+		time.Sleep(gcGatePoll)
+	}
+}
+
+// collecting reports whether any collector of the sample, given as entry and exit time pairs, is running.
+func collecting(sample []int64) bool {
+	for i := 0; i+1 < len(sample); i += 2 {
+		if sample[i] > sample[i+1] {
+			return true
+		}
+	}
+	return false
+}
@@ -0,0 +1,116 @@
+package internal
+
+import (
+	"context"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg"
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+// TestAttachScheduler_Run tests that sensitive targets are attached to last and one at a time.
+func TestAttachScheduler_Run(t *testing.T) {
+	targets := []attachTarget{
+		{process: JvmProcess{Pid: 1}, priority: attachPrioritySensitive},
+		{process: JvmProcess{Pid: 2}},
+		{process: JvmProcess{Pid: 3}, priority: attachPrioritySensitive},
+		{process: JvmProcess{Pid: 4}},
+	}
+	var mu sync.Mutex
+	var order []int32
+	inFlight, maxSensitive := 0, 0
+	results := attachScheduler{concurrency: 4}.run(targets, func(jp JvmProcess) attachResult {
+		pid := jp.Pid
+		mu.Lock()
+		order = append(order, pid)
+		sensitive := pid%2 == 1
+		if sensitive {
+			inFlight++
+			maxSensitive = max(maxSensitive, inFlight)
+		}
+		mu.Unlock()
+		time.Sleep(5 * time.Millisecond)
+		if sensitive {
+			mu.Lock()
+			inFlight--
+			mu.Unlock()
+		}
+		return attachResult{pid: pid}
+	})
+	for i, r := range results {
+		if r.pid != targets[i].process.Pid {
+			t.Errorf("expected results in target order, got %v", results)
+		}
+	}
+	if len(order) != 4 || order[2]%2 != 1 || order[3]%2 != 1 {
+		t.Errorf("expected the sensitive targets last, got %v", order)
+	}
+	if maxSensitive != 1 {
+		t.Errorf("expected sensitive targets one at a time, got %d at once", maxSensitive)
+	}
+}
+
+// TestAttachScheduler_Admit tests that an attach goes ahead once a slot held
+// elsewhere is not released in time, unless it was cancelled.
+func TestAttachScheduler_Admit(t *testing.T) {
+	t.Setenv("TMPDIR", t.TempDir())
+	origWait := attachSlotWait
+	attachSlotWait = 20 * time.Millisecond
+	defer func() { attachSlotWait = origWait }()
+	hold, err := pkg.HostSemaphore{Dir: attachSlotsDir(), Slots: 1}.Acquire(context.Background())
+	if err != nil {
+		t.Fatalf("Acquire failed: %v", err)
+	}
+	defer hold()
+
+	s := attachScheduler{concurrency: 1}
+	start := time.Now()
+	release, err := s.admit(context.Background(), &JvmProcess{Pid: 1}, "")
+	if err != nil {
+		t.Fatalf("admit failed: %v", err)
+	}
+	release()
+	if elapsed := time.Since(start); elapsed < attachSlotWait || elapsed > time.Second {
+		t.Errorf("expected admit to wait for the slot about %v, took %v", attachSlotWait, elapsed)
+	}
+	ctx, cancel := context.WithCancel(context.Background())
+	cancel()
+	if _, err := s.admit(ctx, &JvmProcess{Pid: 1}, ""); err != context.Canceled {
+		t.Errorf("expected a cancelled admit to fail, got %v", err)
+	}
+}
+
+// TestWaitOutOfGC tests that the gate waits while a collector runs, up to its timeout.
+func TestWaitOutOfGC(t *testing.T) {
+	dir := t.TempDir()
+	writeGC := func(name string, entry, exit int64) string {
+		path := dir + "/" + name
+		err := perfdata.WriteMock(path,
+			perfdata.MockCounter{Name: "sun.gc.collector.0.lastEntryTime", Long: 100},
+			perfdata.MockCounter{Name: "sun.gc.collector.0.lastExitTime", Long: 200},
+			perfdata.MockCounter{Name: "sun.gc.collector.1.lastEntryTime", Long: entry},
+			perfdata.MockCounter{Name: "sun.gc.collector.1.lastExitTime", Long: exit},
+		)
+		if err != nil {
+			t.Fatalf("failed to write perfdata: %v", err)
+		}
+		return path
+	}
+
+	for _, tt := range []struct {
+		path string
+		wait bool
+	}{
+		{writeGC("idle", 300, 400), false},
+		{writeGC("collecting", 500, 400), true},
+		{dir + "/missing", false},
+	} {
+		start := time.Now()
+		waitOutOfGC(tt.path, 50*time.Millisecond)
+		if waited := time.Since(start) >= 50*time.Millisecond; waited != tt.wait {
+			t.Errorf("%s: expected to wait %v, took %v", tt.path, tt.wait, time.Since(start))
+		}
+	}
+}
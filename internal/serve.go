@@ -0,0 +1,657 @@
+package internal
+
+import (
+	"bufio"
+	"bytes"
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"os"
+	"os/signal"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+
+	"github.com/XHao/jvmtool/pkg/perfdata"
+)
+
+type ServeOption struct {
+	Socket string // -socket
+}
+
+// ParseServeFlags parses flags for the "serve" command and returns the corresponding ServeOption.
+func ParseServeFlags(args []string) (ServeOption, error) {
+	serveFlagSet := flag.NewFlagSet("serve", flag.ContinueOnError)
+	socket := serveFlagSet.String("socket", defaultServeSocket(), "specify the path of the unix socket to serve on")
+	if err := serveFlagSet.Parse(args); err != nil {
+		return ServeOption{}, err
+	}
+	return ServeOption{Socket: *socket}, nil
+}
+
+// serveDirPrefix is the prefix of the private directory of the default socket.
+const serveDirPrefix = ".jvmtool-serve"
+
+// defaultServeSocket returns the socket path used when -socket is not given, in
+// a directory of the temp dir only the current user can access, see privateTempDir.
+func defaultServeSocket() string {
+	return filepath.Join(os.TempDir(), fmt.Sprintf("%s-%d", serveDirPrefix, os.Getuid()), "jvmtool.sock")
+}
+
+// ServeValidate validates the ServeOption fields.
+func (opt *ServeOption) ServeValidate() error {
+	if opt.Socket == "" {
+		return errors.New("socket is required")
+	}
+	if conn, err := net.Dial("unix", opt.Socket); err == nil {
+		conn.Close()
+		return fmt.Errorf("already serving on %s", opt.Socket)
+	}
+	return nil
+}
+
+// Serve runs the daemon: an HTTP API on a unix socket, only accessible to the
+// current user, until interrupted. See Server for the endpoints.
+func Serve(option ServeOption) int {
+	if err := option.ServeValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	if option.Socket == defaultServeSocket() {
+		if _, err := privateTempDir(serveDirPrefix); err != nil {
+			log(err.Error())
+			return 1
+		}
+	}
+	// A socket nobody listens on is left over from a previous run.
+	os.Remove(option.Socket)
+	// The socket is created with mode 0600 rather than chmod-ed after the fact,
+	// so there is no window in which others can connect.
+	umask := syscall.Umask(0177)
+	l, err := net.Listen("unix", option.Socket)
+	syscall.Umask(umask)
+	if err != nil {
+		log(fmt.Sprintf("cannot listen on %s: %v", option.Socket, err))
+		return 1
+	}
+	defer os.Remove(option.Socket)
+
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+	server := NewServer()
+	defer server.Close()
+	httpServer := &http.Server{Handler: server}
+	go func() {
+		<-ctx.Done()
+		httpServer.Shutdown(context.Background())
+	}()
+	log("serving on " + option.Socket)
+	if err := httpServer.Serve(l); err != http.ErrServerClosed {
+		log(err.Error())
+		return 1
+	}
+	return 0
+}
+
+// Server serves the jvmtool commands over HTTP without a process per call.
+// The Java processes of each user are discovered once and then kept up to date
+// from hsperfdata directory events, and perfdata files stay mapped while their
+// process lives. The Attach Listener of HotSpot closes its socket after each
+// command, so attach requests reuse the discovery table and a session of the
+// running listener rather than a connection, see attachSessions. A batch runs
+// independent commands over connections opened together.
+//
+//	GET  /v1/jps?user=                        the processes of user as a JSON array, see jps -o json
+//	GET  /v1/perfdata/<pid>?user=&prefix=     the perfdata counters of pid as a JSON object
+//	POST /v1/jcmd/<pid>?user=                 runs the diagnostic command in the body, streams its output
+//	POST /v1/batch/<pid>?user=                runs the attach commands in the body, one per line, see handleBatch
+//	POST /v1/attach/<pid>?user=&agentpath=&agentparams=
+//	                                          loads an agent, see jattach
+//	GET  /metrics                             perfdata counters of every JVM, in containers too, see handleMetrics
+//
+// user defaults to the user running the server.
+type Server struct {
+	currentUser string
+	stop        chan struct{}
+	sessions    *attachSessions
+
+	mu     sync.Mutex
+	tables map[string]*serverTable
+
+	perfMu   sync.RWMutex
+	perfdata map[int32]*servedPerfData
+
+	// Reused by every /metrics scrape, which are serialized.
+	scrapeMu        sync.Mutex
+	scrapeProcesses []JvmProcess
+	scrapeWriter    *bufio.Writer
+	scrapeBuf       []byte
+	usersScanned    time.Time
+	containers      []JvmProcess // found in containers by the last rescan
+}
+
+// servedPerfData is a mapped perfdata file and the metrics resolved from it.
+type servedPerfData struct {
+	pd      *perfdata.PerfData
+	metrics perfMetrics // resolved on the first scrape
+}
+
+// serverTable is the live set of Java processes of one user.
+type serverTable struct {
+	mu        sync.RWMutex
+	processes map[int32]JvmProcess
+	err       error
+	ready     chan struct{} // closed once the initial listing is in, or the watch failed
+	readyOnce sync.Once
+}
+
+// NewServer returns a Server for the current user. It must be closed.
+func NewServer() *Server {
+	currentUser, _ := resolveUser("")
+	return &Server{
+		currentUser: currentUser,
+		stop:        make(chan struct{}),
+		sessions:    newAttachSessions(),
+		tables:      map[string]*serverTable{},
+		perfdata:    map[int32]*servedPerfData{},
+	}
+}
+
+// Close stops watching and unmaps every perfdata file.
+func (s *Server) Close() error {
+	close(s.stop)
+	s.perfMu.Lock()
+	defer s.perfMu.Unlock()
+	for pid, e := range s.perfdata {
+		e.pd.Close()
+		delete(s.perfdata, pid)
+	}
+	return nil
+}
+
+// table returns the process table of username, starting to watch on first use.
+func (s *Server) table(username string) (*serverTable, error) {
+	if username == "" {
+		username = s.currentUser
+	}
+	s.mu.Lock()
+	t := s.tables[username]
+	s.mu.Unlock()
+	if t == nil {
+		if _, err := resolveUser(username); err != nil {
+			return nil, errors.New("user does not exist")
+		}
+		s.mu.Lock()
+		if t = s.tables[username]; t == nil {
+			t = &serverTable{processes: map[int32]JvmProcess{}, ready: make(chan struct{})}
+			s.tables[username] = t
+			go s.watch(username, t)
+		}
+		s.mu.Unlock()
+	}
+	<-t.ready
+	return t, t.err
+}
+
+// watch keeps t up to date until the server is closed. If the watch fails, the
+// table is dropped so that the next request starts over.
+func (s *Server) watch(username string, t *serverTable) {
+	option := JpsOption{User: username, ShowLong: true, ShowVMArgs: true, ShowArgs: true, Output: jpsOutputNDJSON}
+	err := watchJvmProcesses(option, s.stop, func(events []jpsEvent) {
+		t.mu.Lock()
+		for _, e := range events {
+			if e.removed {
+				delete(t.processes, e.process.Pid)
+			} else {
+				t.processes[e.process.Pid] = e.process
+			}
+		}
+		t.mu.Unlock()
+		for _, e := range events {
+			if e.removed {
+				s.closePerfData(e.process.Pid)
+				s.sessions.forget(e.process.Pid)
+			}
+		}
+		t.readyOnce.Do(func() { close(t.ready) })
+	})
+	if err != nil {
+		log(fmt.Sprintf("watching the java processes of %s failed: %v", username, err))
+		s.mu.Lock()
+		delete(s.tables, username)
+		s.mu.Unlock()
+		t.err = err
+		t.readyOnce.Do(func() { close(t.ready) })
+	}
+}
+
+// lookup returns the process pid of username.
+func (s *Server) lookup(username string, pid int32) (JvmProcess, error) {
+	t, err := s.table(username)
+	if err != nil {
+		return JvmProcess{}, err
+	}
+	t.mu.RLock()
+	defer t.mu.RUnlock()
+	p, ok := t.processes[pid]
+	if !ok {
+		return JvmProcess{}, errors.New("process not found")
+	}
+	return p, nil
+}
+
+// withPerfData calls fn with the mapped perfdata file of p, mapping it on first
+// use. The file cannot be unmapped while fn runs, which must not modify the entry.
+func (s *Server) withPerfData(p JvmProcess, fn func(e *servedPerfData)) error {
+	s.perfMu.RLock()
+	if e := s.perfdata[p.Pid]; e != nil {
+		fn(e)
+		s.perfMu.RUnlock()
+		return nil
+	}
+	s.perfMu.RUnlock()
+
+	s.perfMu.Lock()
+	defer s.perfMu.Unlock()
+	e := s.perfdata[p.Pid]
+	if e == nil {
+		pd, err := perfdata.Open(p.perfDataPath(p.Username))
+		if err != nil {
+			return err
+		}
+		e = &servedPerfData{pd: pd}
+		s.perfdata[p.Pid] = e
+	}
+	fn(e)
+	return nil
+}
+
+// closePerfData unmaps the perfdata file of an exited process.
+func (s *Server) closePerfData(pid int32) {
+	s.perfMu.Lock()
+	defer s.perfMu.Unlock()
+	if e := s.perfdata[pid]; e != nil {
+		e.pd.Close()
+		delete(s.perfdata, pid)
+	}
+}
+
+// ServeHTTP routes the API requests.
+func (s *Server) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+	if r.URL.Path == "/metrics" {
+		if r.Method != http.MethodGet {
+			writeHTTPError(w, http.StatusMethodNotAllowed, "method not allowed")
+			return
+		}
+		s.handleMetrics(w, r)
+		return
+	}
+	path, ok := strings.CutPrefix(r.URL.Path, "/v1/")
+	endpoint, arg, hasArg := strings.Cut(path, "/")
+	var method string
+	var handle func(http.ResponseWriter, *http.Request, int32)
+	switch {
+	case ok && endpoint == "jps" && !hasArg:
+		if r.Method != http.MethodGet {
+			writeHTTPError(w, http.StatusMethodNotAllowed, "method not allowed")
+			return
+		}
+		s.handleJps(w, r)
+		return
+	case ok && endpoint == "perfdata" && hasArg:
+		method, handle = http.MethodGet, s.handlePerfData
+	case ok && endpoint == "jcmd" && hasArg:
+		method, handle = http.MethodPost, s.handleJcmd
+	case ok && endpoint == "batch" && hasArg:
+		method, handle = http.MethodPost, s.handleBatch
+	case ok && endpoint == "attach" && hasArg:
+		method, handle = http.MethodPost, s.handleAttach
+	default:
+		writeHTTPError(w, http.StatusNotFound, "not found")
+		return
+	}
+	if r.Method != method {
+		writeHTTPError(w, http.StatusMethodNotAllowed, "method not allowed")
+		return
+	}
+	pid, err := strconv.Atoi(arg)
+	if err != nil || pid <= 0 {
+		writeHTTPError(w, http.StatusBadRequest, fmt.Sprintf("invalid pid %s", arg))
+		return
+	}
+	handle(w, r, int32(pid))
+}
+
+// handleJps lists the processes of a user, ordered by pid.
+func (s *Server) handleJps(w http.ResponseWriter, r *http.Request) {
+	t, err := s.table(r.URL.Query().Get("user"))
+	if err != nil {
+		writeHTTPError(w, http.StatusBadRequest, err.Error())
+		return
+	}
+	t.mu.RLock()
+	processes := make([]JvmProcess, 0, len(t.processes))
+	for _, p := range t.processes {
+		processes = append(processes, p)
+	}
+	t.mu.RUnlock()
+	sort.Slice(processes, func(i, j int) bool { return processes[i].Pid < processes[j].Pid })
+	w.Header().Set("Content-Type", "application/json")
+	writeJpsRecords(w, processes, jpsOutputJSON)
+}
+
+// handlePerfData reads the current value of the counters of a process.
+func (s *Server) handlePerfData(w http.ResponseWriter, r *http.Request, pid int32) {
+	p, err := s.lookup(r.URL.Query().Get("user"), pid)
+	if err != nil {
+		writeHTTPError(w, http.StatusNotFound, err.Error())
+		return
+	}
+	var body []byte
+	err = s.withPerfData(p, func(e *servedPerfData) {
+		counters := e.pd.Prefix(r.URL.Query().Get("prefix"))
+		body = appendPerfDataJSON(make([]byte, 0, 64*len(counters)), pid, counters)
+	})
+	if err != nil {
+		writeHTTPError(w, http.StatusNotFound, fmt.Sprintf("cannot read perfdata of process %d: %v", pid, err))
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	w.Write(body)
+}
+
+// appendPerfDataJSON appends the counters as {"pid":<pid>,"counters":{<name>:<value>,...}}.
+func appendPerfDataJSON(dst []byte, pid int32, counters []perfdata.Counter) []byte {
+	dst = append(dst, `{"pid":`...)
+	dst = strconv.AppendInt(dst, int64(pid), 10)
+	dst = append(dst, `,"counters":{`...)
+	for i, c := range counters {
+		if i > 0 {
+			dst = append(dst, ',')
+		}
+		dst = appendJSONString(dst, c.Name)
+		dst = append(dst, ':')
+		switch {
+		case c.IsLong():
+			dst = strconv.AppendInt(dst, c.Long(), 10)
+		case c.IsString():
+			dst = appendJSONString(dst, string(c.Bytes()))
+		default:
+			dst = append(dst, "null"...)
+		}
+	}
+	return append(dst, "}}\n"...)
+}
+
+// handleJcmd runs the diagnostic command in the request body. The return code of
+// the JVM is sent in the X-Attach-Code header; a non-zero code answers 502.
+func (s *Server) handleJcmd(w http.ResponseWriter, r *http.Request, pid int32) {
+	p, err := s.lookup(r.URL.Query().Get("user"), pid)
+	if err != nil {
+		writeHTTPError(w, http.StatusNotFound, err.Error())
+		return
+	}
+	body, err := io.ReadAll(io.LimitReader(r.Body, 4096))
+	command := strings.TrimSpace(string(body))
+	if err != nil || command == "" {
+		writeHTTPError(w, http.StatusBadRequest, "command is required")
+		return
+	}
+	p.trace = NewAttachTrace()
+	defer p.trace.Finish()
+	release, err := s.admit(r.Context(), &p)
+	if err != nil {
+		writeHTTPError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+	defer release()
+	resp, err := s.sessions.execute(r.Context(), &p, attachCmdJcmd, command)
+	if err != nil {
+		writeHTTPError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+	defer resp.Close()
+	w.Header().Set("Content-Type", "text/plain; charset=utf-8")
+	w.Header().Set("X-Attach-Code", strconv.Itoa(resp.Code))
+	if resp.Code != 0 {
+		w.WriteHeader(http.StatusBadGateway)
+	}
+	resp.WriteTo(w)
+	p.trace.Done(PhaseRead)
+}
+
+// admit waits until a request may attach to p, as the attaches of jattach do.
+func (s *Server) admit(ctx context.Context, p *JvmProcess) (func(), error) {
+	return attachScheduler{concurrency: defaultAttachConcurrency}.admit(ctx, p, p.Username)
+}
+
+// handleAttach loads an agent into a process.
+func (s *Server) handleAttach(w http.ResponseWriter, r *http.Request, pid int32) {
+	query := r.URL.Query()
+	p, err := s.lookup(query.Get("user"), pid)
+	if err != nil {
+		writeHTTPError(w, http.StatusNotFound, err.Error())
+		return
+	}
+	agentPath := query.Get("agentpath")
+	if agentPath == "" || (isNativeAgent(agentPath) && !filepath.IsAbs(agentPath)) {
+		writeHTTPError(w, http.StatusBadRequest, "an absolute agentpath is required")
+		return
+	}
+	p.trace = NewAttachTrace()
+	release, err := s.admit(r.Context(), &p)
+	if err == nil {
+		err = s.sessions.do(&p, func() error {
+			return p.loadAgent(agentPath, query.Get("agentparams"))
+		})
+		release()
+	}
+	p.trace.Finish()
+	if err != nil {
+		writeHTTPError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	io.WriteString(w, "{\"ok\":true}\n")
+}
+
+// Limits of a batch. The Attach Listener of HotSpot listens with a backlog of 5 and
+// serves one connection at a time, so more connections in flight would be refused.
+const (
+	serveBatchMaxCommands = 32
+	serveBatchConcurrency = 4
+	serveBatchMaxOutput   = 4 << 20 // per command, the rest is cut off
+)
+
+// serveBatchCommands are the attach commands a batch may run: those that only
+// read. Each maps to the first words of its argument it may run with, nil for any.
+var serveBatchCommands = map[string]map[string]bool{
+	attachCmdJcmd:       serveBatchJcmds,
+	attachCmdProperties: nil,
+	attachCmdPrintFlag:  nil,
+	attachCmdThreadDump: nil,
+	// Without -all only live objects are counted, which takes a full GC.
+	attachCmdInspectHeap: {"-all": true},
+}
+
+// serveBatchJcmds are the diagnostic commands a batch may run. Commands that
+// collect, change flags, start recordings or write files, such as GC.run,
+// VM.set_flag, JFR.start or GC.heap_dump, go through /v1/jcmd one at a time.
+// GC.class_histogram is left out as it collects unless given -all.
+var serveBatchJcmds = map[string]bool{
+	"help":                 true,
+	"Compiler.codecache":   true,
+	"Compiler.queue":       true,
+	"GC.heap_info":         true,
+	"JFR.check":            true,
+	"Thread.print":         true,
+	"VM.classloader_stats": true,
+	"VM.command_line":      true,
+	"VM.dynlibs":           true,
+	"VM.flags":             true,
+	"VM.info":              true,
+	"VM.metaspace":         true,
+	"VM.system_properties": true,
+	"VM.uptime":            true,
+	"VM.version":           true,
+}
+
+// serveBatchAllowed reports whether a batch may run cmd with the argument arg.
+func serveBatchAllowed(cmd, arg string) bool {
+	allowed, ok := serveBatchCommands[cmd]
+	if !ok {
+		return false
+	}
+	first, _, _ := strings.Cut(strings.TrimSpace(arg), " ")
+	return allowed == nil || allowed[first]
+}
+
+// batchResult is the outcome of one command of a batch.
+type batchResult struct {
+	command   string
+	code      int
+	output    []byte
+	truncated bool
+	err       error
+}
+
+// handleBatch runs independent attach commands, one per line of the body as the
+// command followed by its argument, e.g. "jcmd GC.heap_info" or "properties". The
+// listener is made ready once and the commands then run over parallel connections,
+// so each pays no setup of its own. The results are a JSON array in command order:
+// {"command":..., "code":..., "output":...}, with "truncated":true for an output
+// cut at serveBatchMaxOutput or {"command":..., "error":...} if it could not run.
+func (s *Server) handleBatch(w http.ResponseWriter, r *http.Request, pid int32) {
+	p, err := s.lookup(r.URL.Query().Get("user"), pid)
+	if err != nil {
+		writeHTTPError(w, http.StatusNotFound, err.Error())
+		return
+	}
+	body, err := io.ReadAll(io.LimitReader(r.Body, 64*1024))
+	if err != nil {
+		writeHTTPError(w, http.StatusBadRequest, err.Error())
+		return
+	}
+	var commands []string
+	for _, line := range strings.Split(string(body), "\n") {
+		line = strings.TrimSpace(line)
+		if line == "" {
+			continue
+		}
+		if cmd, arg, _ := strings.Cut(line, " "); !serveBatchAllowed(cmd, arg) {
+			writeHTTPError(w, http.StatusBadRequest, fmt.Sprintf("command %s cannot be batched", line))
+			return
+		}
+		commands = append(commands, line)
+	}
+	if len(commands) == 0 || len(commands) > serveBatchMaxCommands {
+		writeHTTPError(w, http.StatusBadRequest, fmt.Sprintf("between 1 and %d commands are required", serveBatchMaxCommands))
+		return
+	}
+	// The commands of a batch share one slot of the scheduler, as one attach.
+	release, err := s.admit(r.Context(), &p)
+	if err != nil {
+		writeHTTPError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+	defer release()
+	if _, err := s.sessions.ready(&p); err != nil {
+		writeHTTPError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+
+	// Results are written in command order as they come in, and a command only
+	// starts once the result serveBatchConcurrency before it is out, so no more
+	// than that many outputs are held at a time.
+	results := make([]chan batchResult, len(commands))
+	for i := range results {
+		results[i] = make(chan batchResult, 1)
+	}
+	slots := make(chan struct{}, serveBatchConcurrency)
+	go func() {
+		for i := range commands {
+			slots <- struct{}{}
+			go func(i int) {
+				results[i] <- s.runBatchCommand(r.Context(), p, commands[i])
+			}(i)
+		}
+	}()
+	w.Header().Set("Content-Type", "application/json")
+	out := []byte{'['}
+	for i := range commands {
+		res := <-results[i]
+		if i > 0 {
+			out = append(out, ',')
+		}
+		out = appendBatchResult(out, &res)
+		if i == len(commands)-1 {
+			out = append(out, "]\n"...)
+		}
+		// A client gone away has cancelled the commands, which are still drained.
+		w.Write(out)
+		out = out[:0]
+		<-slots
+	}
+}
+
+// appendBatchResult appends the result as a JSON object.
+func appendBatchResult(dst []byte, res *batchResult) []byte {
+	dst = append(dst, `{"command":`...)
+	dst = appendJSONString(dst, res.command)
+	if res.err != nil {
+		dst = append(dst, `,"error":`...)
+		dst = appendJSONString(dst, res.err.Error())
+	} else {
+		dst = append(dst, `,"code":`...)
+		dst = strconv.AppendInt(dst, int64(res.code), 10)
+		dst = append(dst, `,"output":`...)
+		dst = appendJSONString(dst, string(res.output))
+		if res.truncated {
+			dst = append(dst, `,"truncated":true`...)
+		}
+	}
+	return append(dst, '}')
+}
+
+// runBatchCommand runs one line of a batch in p.
+func (s *Server) runBatchCommand(ctx context.Context, p JvmProcess, line string) batchResult {
+	cmd, arg, _ := strings.Cut(line, " ")
+	var args []string
+	if arg = strings.TrimSpace(arg); arg != "" {
+		args = []string{arg}
+	}
+	res := batchResult{command: line}
+	resp, err := s.sessions.execute(ctx, &p, cmd, args...)
+	if err != nil {
+		res.err = err
+		return res
+	}
+	defer resp.Close()
+	res.code = resp.Code
+	var buf bytes.Buffer
+	n, err := io.Copy(&buf, io.LimitReader(resp, serveBatchMaxOutput+1))
+	if err != nil {
+		res.err = err
+		return res
+	}
+	res.output, res.truncated = buf.Bytes(), n > serveBatchMaxOutput
+	if res.truncated {
+		res.output = res.output[:serveBatchMaxOutput]
+	}
+	return res
+}
+
+// writeHTTPError answers with status and {"error":<message>}.
+func writeHTTPError(w http.ResponseWriter, status int, message string) {
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(status)
+	w.Write(append(appendJSONString([]byte(`{"error":`), message), "}\n"...))
+}
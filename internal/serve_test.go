@@ -0,0 +1,246 @@
+package internal
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"os/user"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// serveRequest sends a request to the server and returns the response.
+func serveRequest(s *Server, method, target, body string) *httptest.ResponseRecorder {
+	w := httptest.NewRecorder()
+	s.ServeHTTP(w, httptest.NewRequest(method, target, strings.NewReader(body)))
+	return w
+}
+
+// TestServer_JpsAndPerfData tests listing processes and reading their counters.
+func TestServer_JpsAndPerfData(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := os.Getpid()
+	cleanup, err := prepareGcPerfdataFile(currentUser.Username, pid)
+	if err != nil {
+		t.Fatalf("failed to create perfdata file: %v", err)
+	}
+	defer cleanup()
+	s := NewServer()
+	defer s.Close()
+
+	w := serveRequest(s, http.MethodGet, "/v1/jps", "")
+	assert.Equal(t, http.StatusOK, w.Code)
+	var records []jpsRecord
+	if err := json.Unmarshal(w.Body.Bytes(), &records); err != nil {
+		t.Fatalf("invalid json %q: %v", w.Body.String(), err)
+	}
+	if assert.Len(t, records, 1) {
+		assert.Equal(t, int32(pid), records[0].Pid)
+		assert.Equal(t, currentUser.Username, records[0].User)
+	}
+
+	w = serveRequest(s, http.MethodGet, "/v1/perfdata/"+strconv.Itoa(pid)+"?prefix=sun.gc.collector.0.", "")
+	assert.Equal(t, http.StatusOK, w.Code)
+	var counters struct {
+		Pid      int32            `json:"pid"`
+		Counters map[string]int64 `json:"counters"`
+	}
+	if err := json.Unmarshal(w.Body.Bytes(), &counters); err != nil {
+		t.Fatalf("invalid json %q: %v", w.Body.String(), err)
+	}
+	assert.Equal(t, map[string]int64{"sun.gc.collector.0.invocations": 7, "sun.gc.collector.0.time": 250_000_000}, counters.Counters)
+
+	// The table follows the directory without another scan.
+	hsperfFile := filepath.Join(os.TempDir(), "hsperfdata_"+currentUser.Username, strconv.Itoa(pid))
+	os.Remove(hsperfFile)
+	assert.Eventually(t, func() bool {
+		return strings.TrimSpace(serveRequest(s, http.MethodGet, "/v1/jps", "").Body.String()) == "[]"
+	}, 5*time.Second, 10*time.Millisecond)
+	assert.Equal(t, http.StatusNotFound, serveRequest(s, http.MethodGet, "/v1/perfdata/"+strconv.Itoa(pid), "").Code)
+}
+
+// TestServer_Jcmd tests running a diagnostic command through the server.
+func TestServer_Jcmd(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := int32(os.Getpid())
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, int(pid))
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+	stopListener, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		if args[0] == "VM.version" {
+			return "0\nOpenJDK 64-Bit Server VM\n"
+		}
+		return "1\nunknown command\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer stopListener()
+	s := NewServer()
+	defer s.Close()
+
+	target := "/v1/jcmd/" + strconv.Itoa(int(pid))
+	w := serveRequest(s, http.MethodPost, target, "VM.version")
+	assert.Equal(t, http.StatusOK, w.Code)
+	assert.Equal(t, "0", w.Header().Get("X-Attach-Code"))
+	assert.Equal(t, "OpenJDK 64-Bit Server VM\n", w.Body.String())
+
+	w = serveRequest(s, http.MethodPost, target, "VM.nope")
+	assert.Equal(t, http.StatusBadGateway, w.Code)
+	assert.Equal(t, "1", w.Header().Get("X-Attach-Code"))
+
+	assert.Equal(t, http.StatusBadRequest, serveRequest(s, http.MethodPost, target, "").Code)
+	assert.Equal(t, http.StatusMethodNotAllowed, serveRequest(s, http.MethodGet, target, "").Code)
+	assert.Equal(t, http.StatusNotFound, serveRequest(s, http.MethodPost, "/v1/jcmd/999999", "VM.version").Code)
+	assert.Equal(t, http.StatusBadRequest, serveRequest(s, http.MethodPost, "/v1/jcmd/x", "VM.version").Code)
+	assert.Equal(t, http.StatusNotFound, serveRequest(s, http.MethodGet, "/v2/jps", "").Code)
+	assert.Equal(t, http.StatusBadRequest, serveRequest(s, http.MethodGet, "/v1/jps?user=no-such-user-jvmtool", "").Code)
+}
+
+// TestServe tests serving on a unix socket until interrupted.
+func TestServe(t *testing.T) {
+	restore, _, _ := captureLogs()
+	defer restore()
+	socket := filepath.Join(t.TempDir(), "jvmtool.sock")
+	done := make(chan int, 1)
+	go func() { done <- Serve(ServeOption{Socket: socket}) }()
+
+	client := &http.Client{Transport: &http.Transport{
+		DialContext: func(ctx context.Context, _, _ string) (net.Conn, error) {
+			return (&net.Dialer{}).DialContext(ctx, "unix", socket)
+		},
+	}}
+	var resp *http.Response
+	assert.Eventually(t, func() bool {
+		var err error
+		resp, err = client.Get("http://jvmtool/v1/jps")
+		return err == nil
+	}, 5*time.Second, 10*time.Millisecond)
+	if resp == nil {
+		return
+	}
+	body, _ := io.ReadAll(resp.Body)
+	resp.Body.Close()
+	assert.Equal(t, http.StatusOK, resp.StatusCode)
+	assert.True(t, strings.HasPrefix(string(body), "["))
+	if info, err := os.Stat(socket); assert.Nil(t, err) {
+		assert.Equal(t, os.FileMode(0600), info.Mode().Perm())
+	}
+	opt := ServeOption{Socket: socket}
+	assert.EqualError(t, opt.ServeValidate(), "already serving on "+socket)
+
+	p, _ := os.FindProcess(os.Getpid())
+	p.Signal(os.Interrupt)
+	select {
+	case code := <-done:
+		assert.Equal(t, 0, code)
+	case <-time.After(5 * time.Second):
+		t.Fatal("Serve did not stop on interrupt")
+	}
+	_, err := os.Stat(socket)
+	assert.True(t, os.IsNotExist(err))
+}
+
+// TestServer_Batch tests running several attach commands of one batch through a warm session.
+func TestServer_Batch(t *testing.T) {
+	currentUser, err := user.Current()
+	if err != nil {
+		t.Fatalf("failed to get current user: %v", err)
+	}
+	pid := int32(os.Getpid())
+	_, cleanup, err := prepareHsperfdataFile(currentUser.Username, int(pid))
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanup()
+	stopListener, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		switch {
+		case cmd == attachCmdProperties:
+			return "0\njava.version=17\n"
+		case cmd == attachCmdJcmd && args[0] == "VM.flags -all":
+			return "0\n-XX:+UseG1GC\n"
+		}
+		return "1\nunknown command\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer stopListener()
+	s := NewServer()
+	defer s.Close()
+
+	target := "/v1/batch/" + strconv.Itoa(int(pid))
+	w := serveRequest(s, http.MethodPost, target, "jcmd VM.flags -all\nproperties\n\njcmd VM.version\n")
+	assert.Equal(t, http.StatusOK, w.Code)
+	var results []struct {
+		Command string `json:"command"`
+		Code    int    `json:"code"`
+		Output  string `json:"output"`
+	}
+	if err := json.Unmarshal(w.Body.Bytes(), &results); err != nil {
+		t.Fatalf("invalid json %q: %v", w.Body.String(), err)
+	}
+	if assert.Len(t, results, 3) {
+		assert.Equal(t, "jcmd VM.flags -all", results[0].Command)
+		assert.Equal(t, "-XX:+UseG1GC\n", results[0].Output)
+		assert.Equal(t, "java.version=17\n", results[1].Output)
+		assert.Equal(t, 1, results[2].Code)
+	}
+	session, ok := s.sessions.sessions[pid]
+	assert.True(t, ok && session.startTime != 0, "expected a session of the process")
+
+	// A full batch runs a few commands at a time and streams them back in order.
+	w = serveRequest(s, http.MethodPost, target, strings.Repeat("properties\njcmd VM.flags -all\n", serveBatchMaxCommands/2))
+	results = nil
+	if err := json.Unmarshal(w.Body.Bytes(), &results); err != nil {
+		t.Fatalf("invalid json %q: %v", w.Body.String(), err)
+	}
+	if assert.Len(t, results, serveBatchMaxCommands) {
+		for i, res := range results {
+			if expected := []string{"java.version=17\n", "-XX:+UseG1GC\n"}[i%2]; res.Output != expected {
+				t.Errorf("result %d: expected %q, got %q", i, expected, res.Output)
+			}
+		}
+	}
+
+	for _, body := range []string{"load instrument false agent.jar", "jcmd GC.run", "jcmd VM.set_flag HeapDumpPath /x", "inspectheap", "inspectheap -live"} {
+		assert.Equal(t, http.StatusBadRequest, serveRequest(s, http.MethodPost, target, body).Code, body)
+	}
+	assert.Equal(t, http.StatusBadRequest, serveRequest(s, http.MethodPost, target, "\n").Code)
+	assert.Equal(t, http.StatusMethodNotAllowed, serveRequest(s, http.MethodGet, target, "").Code)
+}
+
+// TestServe_DefaultSocket tests that the default socket lives in a private directory.
+func TestServe_DefaultSocket(t *testing.T) {
+	restore, getLogs, _ := captureLogs()
+	defer restore()
+	t.Setenv("TMPDIR", t.TempDir())
+	opt, err := ParseServeFlags(nil)
+	if err != nil {
+		t.Fatalf("ParseServeFlags failed: %v", err)
+	}
+	dir := filepath.Dir(opt.Socket)
+	assert.Equal(t, filepath.Join(os.TempDir(), fmt.Sprintf(".jvmtool-serve-%d", os.Getuid())), dir)
+
+	os.Mkdir(dir, 0755)
+	assert.Equal(t, 1, Serve(opt))
+	assert.Equal(t, []string{dir + " is not a private directory of the current user"}, getLogs())
+}
@@ -0,0 +1,96 @@
+package internal
+
+import (
+	"context"
+	"errors"
+	"os"
+	"sync"
+	"syscall"
+)
+
+// attachSessions remembers the JVMs whose Attach Listener is known to be running, so
+// that warm requests of the daemon skip locating the JVM and checking its socket.
+// HotSpot answers one command per connection, so a session is the located, listening
+// JVM rather than a connection. Sessions are keyed by pid and start time, so a new
+// process reusing the pid of a known one starts cold.
+type attachSessions struct {
+	mu       sync.Mutex
+	sessions map[int32]attachSession
+}
+
+// attachSession is a JVM with a running Attach Listener.
+type attachSession struct {
+	startTime int64
+	root      string
+	nsPid     int32
+}
+
+func newAttachSessions() *attachSessions {
+	return &attachSessions{sessions: map[int32]attachSession{}}
+}
+
+// ready makes p ready for attach commands, from its session if there is one and by
+// starting its Attach Listener otherwise. It reports whether a session was used.
+// Processes without a start time never get a session.
+func (s *attachSessions) ready(p *JvmProcess) (bool, error) {
+	s.mu.Lock()
+	session, ok := s.sessions[p.Pid]
+	s.mu.Unlock()
+	if ok && p.startTime != 0 && session.startTime == p.startTime {
+		p.root, p.nsPid = session.root, session.nsPid
+		p.trace.Done(PhaseWaitSocket)
+		return true, nil
+	}
+	if err := p.checkSocket(); err != nil {
+		return false, err
+	}
+	if p.startTime != 0 {
+		s.mu.Lock()
+		s.sessions[p.Pid] = attachSession{startTime: p.startTime, root: p.root, nsPid: p.nsPid}
+		s.mu.Unlock()
+	}
+	return false, nil
+}
+
+// forget drops the session of pid, e.g. once the process exited.
+func (s *attachSessions) forget(pid int32) {
+	s.mu.Lock()
+	delete(s.sessions, pid)
+	s.mu.Unlock()
+}
+
+// do calls fn once p is ready for attach commands. If the socket of a warm session
+// is gone, e.g. removed by a temp dir cleaner, nothing was sent, so the listener is
+// started again and fn retried once.
+func (s *attachSessions) do(p *JvmProcess, fn func() error) error {
+	discovered := *p
+	warm, err := s.ready(p)
+	if err != nil {
+		return err
+	}
+	err = fn()
+	if err != nil && warm && isSocketGone(err) {
+		s.forget(p.Pid)
+		p.root, p.nsPid = discovered.root, discovered.nsPid
+		if _, err := s.ready(p); err != nil {
+			return err
+		}
+		err = fn()
+	}
+	return err
+}
+
+// execute runs an attach command in p through its session, see do.
+func (s *attachSessions) execute(ctx context.Context, p *JvmProcess, cmd string, args ...string) (*AttachResponse, error) {
+	var resp *AttachResponse
+	err := s.do(p, func() (err error) {
+		resp, err = p.attachClient().ExecuteContext(ctx, cmd, args...)
+		return err
+	})
+	return resp, err
+}
+
+// isSocketGone reports whether a connect failed because nobody listens on the socket.
+func isSocketGone(err error) bool {
+	return errors.Is(err, os.ErrNotExist) || errors.Is(err, syscall.ECONNREFUSED)
+}
@@ -0,0 +1,80 @@
+package internal
+
+import (
+	"context"
+	"io"
+	"os"
+	"os/user"
+	"testing"
+
+	"github.com/XHao/jvmtool/pkg"
+	"github.com/stretchr/testify/assert"
+)
+
+// TestAttachSessions tests that sessions are keyed by pid and start time, and that a
+// warm session whose socket is gone is started again.
+func TestAttachSessions(t *testing.T) {
+	u, _ := user.Current()
+	pid := int32(os.Getpid())
+	_, cleanupPerf, err := prepareHsperfdataFile(u.Username, int(pid))
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanupPerf()
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		return "0\nok\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+	start, err := pkg.ProcessStartTime(pid)
+	if err != nil {
+		t.Skipf("no process start time: %v", err)
+	}
+
+	s := newAttachSessions()
+	p := JvmProcess{Pid: pid, startTime: start.UnixMilli()}
+	warm, err := s.ready(&p)
+	assert.Nil(t, err)
+	assert.False(t, warm)
+	warm, err = s.ready(&JvmProcess{Pid: pid, startTime: start.UnixMilli()})
+	assert.Nil(t, err)
+	assert.True(t, warm)
+	// Another process with the same pid.
+	warm, _ = s.ready(&JvmProcess{Pid: pid, startTime: start.UnixMilli() + 1})
+	assert.False(t, warm)
+	// Without a start time there is no session to trust.
+	warm, _ = s.ready(&JvmProcess{Pid: pid})
+	assert.False(t, warm)
+
+	// A session pointing at a socket that is gone falls back to the cold path.
+	s.sessions[pid] = attachSession{startTime: start.UnixMilli(), root: t.TempDir(), nsPid: pid}
+	p = JvmProcess{Pid: pid, startTime: start.UnixMilli()}
+	resp, err := s.execute(context.Background(), &p, attachCmdProperties)
+	if assert.Nil(t, err) {
+		out, _ := io.ReadAll(resp)
+		resp.Close()
+		assert.Equal(t, "ok\n", string(out))
+	}
+	assert.Equal(t, "", s.sessions[pid].root)
+
+	// Loading an agent, as /v1/attach does, is retried the same way.
+	s.sessions[pid] = attachSession{startTime: start.UnixMilli(), root: t.TempDir(), nsPid: pid}
+	p = JvmProcess{Pid: pid, startTime: start.UnixMilli()}
+	calls := 0
+	err = s.do(&p, func() error {
+		calls++
+		resp, err := p.attachClient().Execute(attachCmdLoad, "instrument", "false", "agent.jar")
+		if err == nil {
+			resp.Close()
+		}
+		return err
+	})
+	assert.Nil(t, err)
+	assert.Equal(t, 2, calls)
+
+	s.forget(pid)
+	_, ok := s.sessions[pid]
+	assert.False(t, ok)
+}
@@ -0,0 +1,462 @@
+package internal
+
+import (
+	"bufio"
+	"bytes"
+	"context"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"os/signal"
+	"sort"
+	"strconv"
+	"strings"
+	"syscall"
+	"time"
+)
+
+type ThreadsOption struct {
+	User     string
+	Pid      string
+	Count    int           // -count, the number of dumps
+	Interval time.Duration // -interval, between dumps
+	Top      int           // -top, the number of stacks shown
+	Depth    int           // -depth, the number of frames shown per stack
+	Locks    bool          // -l, also dump ownable synchronizers
+}
+
+// ParseThreadsFlags parses flags for the "threads" command and returns the corresponding ThreadsOption.
+// The pid is taken from the first positional argument.
+func ParseThreadsFlags(args []string) (ThreadsOption, error) {
+	threadsFlagSet := flag.NewFlagSet("threads", flag.ContinueOnError)
+	user := threadsFlagSet.String("user", "", "specify the user owning the Java process")
+	count := threadsFlagSet.Int("count", 1, "number of thread dumps to take")
+	interval := threadsFlagSet.Duration("interval", time.Second, "interval between thread dumps")
+	top := threadsFlagSet.Int("top", 10, "number of stacks to show, 0 for all")
+	depth := threadsFlagSet.Int("depth", 16, "number of frames to show per stack, 0 for all")
+	locks := threadsFlagSet.Bool("l", false, "also dump ownable synchronizers, which finds the owners of j.u.c locks")
+	if err := threadsFlagSet.Parse(args); err != nil {
+		return ThreadsOption{}, err
+	}
+	return ThreadsOption{
+		User:     *user,
+		Pid:      threadsFlagSet.Arg(0),
+		Count:    *count,
+		Interval: *interval,
+		Top:      *top,
+		Depth:    *depth,
+		Locks:    *locks,
+	}, nil
+}
+
+// ThreadsValidate validates the ThreadsOption fields.
+func (opt *ThreadsOption) ThreadsValidate() error {
+	if opt.Count <= 0 {
+		return errors.New("count must be positive")
+	}
+	if opt.Count > 1 && opt.Interval <= 0 {
+		return errors.New("interval must be positive")
+	}
+	if opt.Top < 0 || opt.Depth < 0 {
+		return errors.New("top and depth must not be negative")
+	}
+	if opt.Pid == "" {
+		return errors.New("pid is required")
+	}
+	if pid, err := strconv.Atoi(opt.Pid); err != nil || pid <= 0 {
+		return fmt.Errorf("invalid pid %s", opt.Pid)
+	}
+	username, err := resolveUser(opt.User)
+	if err != nil {
+		return err
+	}
+	opt.User = username
+	return validateJvmPid(opt.User, toInt32(opt.Pid))
+}
+
+// Threads takes thread dumps of a Java process and reports its threads grouped by
+// identical stack, the contended locks and, over several dumps, the stacks threads
+// stay on. The dumps are aggregated as they stream in and never held in memory.
+func Threads(option ThreadsOption) int {
+	if err := option.ThreadsValidate(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+	jp := &JvmProcess{Pid: toInt32(option.Pid)}
+	if err := jp.checkSocket(); err != nil {
+		log(err.Error())
+		return 1
+	}
+	client := jp.attachClient()
+	td := newThreadDump()
+	for i := 0; i < option.Count; i++ {
+		if i > 0 {
+			select {
+			case <-ctx.Done():
+				log("interrupted, reporting the dumps taken")
+				i = option.Count
+				continue
+			case <-time.After(option.Interval):
+			}
+		}
+		if err := takeThreadDump(ctx, client, td, option.Locks); err != nil {
+			log(err.Error())
+			return 1
+		}
+	}
+	w := bufio.NewWriter(attachOutput)
+	defer w.Flush()
+	td.report(w, jp.Pid, option)
+	return 0
+}
+
+// takeThreadDump streams a thread dump of the client's JVM into td.
+func takeThreadDump(ctx context.Context, client *AttachClient, td *threadDump, locks bool) error {
+	arg := ""
+	if locks {
+		arg = "-l"
+	}
+	resp, err := client.ExecuteContext(ctx, attachCmdThreadDump, arg)
+	if err != nil {
+		return err
+	}
+	defer resp.Close()
+	if resp.Code != 0 {
+		return fmt.Errorf("command %s failed, return code: %d", attachCmdThreadDump, resp.Code)
+	}
+	return td.parse(resp)
+}
+
+// threadDump aggregates HotSpot thread dumps. Frames and states are interned and
+// threads are grouped by identical state and stack, so memory grows with the number
+// of distinct stacks rather than with the size of the dumps.
+type threadDump struct {
+	strings map[string]int32 // interned frames and states
+	names   []string
+	stacks  map[string]int // index into list by key, see threadDump.key
+	list    []*threadStack
+	threads map[string]*threadTrack // by native thread id
+
+	dumps     int
+	total     int                    // threads of the latest dump
+	states    map[string]int         // thread count by state, of the latest dump
+	locks     map[string]*threadLock // by address, of the latest dump
+	deadlocks int                    // of the latest dump
+
+	current threadEntry // the thread being parsed
+	key     []byte
+}
+
+// threadStack is a distinct stack of a state.
+type threadStack struct {
+	state   int32
+	frames  []int32
+	threads int // of the latest dump
+	seen    int // dumps the stack was in
+	last    int // the latest dump the stack was in
+}
+
+// threadTrack follows a thread across dumps.
+type threadTrack struct {
+	stack int // index of its stack
+	since int // the first dump of an unbroken run on that stack
+	last  int // the latest dump the thread was in
+}
+
+// threadLock is a monitor or ownable synchronizer of a dump.
+type threadLock struct {
+	class   string
+	owner   string
+	waiters int
+}
+
+// threadLockRef is a lock line of the thread being parsed.
+type threadLockRef struct {
+	address, class string
+}
+
+// threadEntry is the thread being parsed.
+type threadEntry struct {
+	active    bool
+	name, nid string
+	state     int32
+	frames    []int32
+	held      []threadLockRef
+	waitingOn string // Object.wait() releases the monitor it waits on
+	blockedOn threadLockRef
+}
+
+// threadStateUnknown is shown for threads without a java.lang.Thread.State line,
+// which are the JVM's own threads.
+const threadStateUnknown = "-"
+
+func newThreadDump() *threadDump {
+	return &threadDump{
+		strings: map[string]int32{},
+		stacks:  map[string]int{},
+		threads: map[string]*threadTrack{},
+	}
+}
+
+// intern returns the id of s, converted to a string only the first time it is seen.
+func (td *threadDump) intern(s []byte) int32 {
+	if id, ok := td.strings[string(s)]; ok {
+		return id
+	}
+	id := int32(len(td.names))
+	name := string(s)
+	td.strings[name] = id
+	td.names = append(td.names, name)
+	return id
+}
+
+// parse reads one dump from r line by line.
+func (td *threadDump) parse(r io.Reader) error {
+	td.dumps++
+	td.total, td.deadlocks = 0, 0
+	td.states = map[string]int{}
+	td.locks = map[string]*threadLock{}
+	td.current = threadEntry{frames: td.current.frames[:0]}
+	br := bufio.NewReaderSize(r, attachMaxLine)
+	inThreads, synchronizers := true, false
+	for {
+		line, tooLong, err := readAttachLine(br)
+		if err != nil && err != io.EOF {
+			return err
+		}
+		line = bytes.TrimRight(line, "\r\n")
+		switch {
+		case tooLong:
+			// Not part of a thread.
+		case bytes.HasPrefix(line, []byte("Found one Java-level deadlock")):
+			td.deadlocks++
+			inThreads = false
+		case !inThreads:
+		case len(line) > 0 && line[0] == '"':
+			td.endThread()
+			td.startThread(line)
+			synchronizers = false
+		case !td.current.active:
+		case len(line) == 0:
+			// Ownable synchronizers follow the blank line after the frames.
+		case bytes.HasPrefix(line, []byte("   java.lang.Thread.State: ")):
+			td.current.state = td.intern(line[len("   java.lang.Thread.State: "):])
+		case bytes.HasPrefix(line, []byte("\tat ")):
+			td.current.frames = append(td.current.frames, td.intern(line[len("\tat "):]))
+		case bytes.HasPrefix(line, []byte("   Locked ownable synchronizers:")):
+			synchronizers = true
+		case bytes.HasPrefix(line, []byte("\t- ")):
+			td.lockLine(line[len("\t- "):], synchronizers)
+		case line[0] != ' ' && line[0] != '\t':
+			// The end of the threads, e.g. the JNI global refs.
+			td.endThread()
+		}
+		if err == io.EOF {
+			td.endThread()
+			return nil
+		}
+	}
+}
+
+// startThread begins a thread from its header line:
+// "name" #1 prio=5 os_prio=0 tid=0x00007f nid=0x1a03 waiting on condition [0x00007f]
+func (td *threadDump) startThread(line []byte) {
+	end := bytes.LastIndex(line, []byte(`" `))
+	if end <= 0 {
+		// Not a thread, e.g. the "name": lines of a deadlock report.
+		return
+	}
+	td.current.active = true
+	td.current.name = string(line[1:end])
+	td.current.nid = ""
+	if i := bytes.Index(line, []byte(" nid=")); i >= 0 {
+		nid := line[i+len(" nid="):]
+		if j := bytes.IndexByte(nid, ' '); j >= 0 {
+			nid = nid[:j]
+		}
+		td.current.nid = string(nid)
+	}
+	td.current.state = td.intern([]byte(threadStateUnknown))
+}
+
+// lockLine parses the text of a "- " line of the thread, e.g.
+// "waiting to lock <0x00000007> (a java.lang.Object)".
+func (td *threadDump) lockLine(line []byte, synchronizer bool) {
+	start, end := bytes.IndexByte(line, '<'), bytes.IndexByte(line, '>')
+	if start < 0 || end < start {
+		return
+	}
+	ref := threadLockRef{address: string(line[start+1 : end])}
+	if i := bytes.Index(line[end:], []byte("(a ")); i >= 0 {
+		ref.class = string(bytes.TrimSuffix(line[end+i+len("(a "):], []byte(")")))
+	}
+	verb := line[:start]
+	switch {
+	case synchronizer, bytes.HasPrefix(verb, []byte("locked")):
+		td.current.held = append(td.current.held, ref)
+	case bytes.HasPrefix(verb, []byte("waiting on")):
+		td.current.waitingOn = ref.address
+	case bytes.HasPrefix(verb, []byte("waiting to")), bytes.HasPrefix(verb, []byte("parking to wait for")):
+		td.current.blockedOn = ref
+	}
+}
+
+// endThread adds the thread being parsed to its stack and locks.
+func (td *threadDump) endThread() {
+	t := &td.current
+	if !t.active {
+		return
+	}
+	td.key = appendThreadKey(td.key[:0], t.state)
+	for _, id := range t.frames {
+		td.key = appendThreadKey(td.key, id)
+	}
+	index, ok := td.stacks[string(td.key)]
+	if !ok {
+		index = len(td.list)
+		td.stacks[string(td.key)] = index
+		td.list = append(td.list, &threadStack{state: t.state, frames: append([]int32(nil), t.frames...)})
+	}
+	s := td.list[index]
+	if s.last != td.dumps {
+		s.threads, s.last = 0, td.dumps
+		s.seen++
+	}
+	s.threads++
+
+	if t.nid != "" {
+		tr := td.threads[t.nid]
+		switch {
+		case tr == nil:
+			td.threads[t.nid] = &threadTrack{stack: index, since: td.dumps, last: td.dumps}
+		case tr.stack != index || tr.last != td.dumps-1:
+			*tr = threadTrack{stack: index, since: td.dumps, last: td.dumps}
+		default:
+			tr.last = td.dumps
+		}
+	}
+
+	td.total++
+	state := td.names[t.state]
+	if i := strings.IndexByte(state, ' '); i >= 0 {
+		state = state[:i]
+	}
+	td.states[state]++
+	for _, ref := range t.held {
+		if ref.address != t.waitingOn {
+			td.lock(ref).owner = t.name
+		}
+	}
+	if t.blockedOn.address != "" {
+		td.lock(t.blockedOn).waiters++
+	}
+	*t = threadEntry{frames: t.frames[:0], held: t.held[:0]}
+}
+
+// appendThreadKey appends an interned id to the key of a stack.
+func appendThreadKey(key []byte, id int32) []byte {
+	return append(key, byte(id), byte(id>>8), byte(id>>16), byte(id>>24))
+}
+
+func (td *threadDump) lock(ref threadLockRef) *threadLock {
+	l := td.locks[ref.address]
+	if l == nil {
+		l = &threadLock{class: ref.class}
+		td.locks[ref.address] = l
+	}
+	return l
+}
+
+// report writes the summary of the dumps: the states, the contended locks and the
+// stacks of the latest dump by thread count.
+func (td *threadDump) report(w io.Writer, pid int32, option ThreadsOption) {
+	var latest []int
+	for i, s := range td.list {
+		if s.last == td.dumps {
+			latest = append(latest, i)
+		}
+	}
+	// Threads on the same stack in every dump are stuck there.
+	stuck := make(map[int]int)
+	for _, tr := range td.threads {
+		if tr.last == td.dumps && tr.since == 1 {
+			stuck[tr.stack]++
+		}
+	}
+	sort.SliceStable(latest, func(i, j int) bool {
+		a, b := td.list[latest[i]], td.list[latest[j]]
+		if a.threads != b.threads {
+			return a.threads > b.threads
+		}
+		return stuck[latest[i]] > stuck[latest[j]]
+	})
+
+	if td.dumps > 1 {
+		fmt.Fprintf(w, "Process %d, %d dumps %v apart: %d threads on %d distinct stacks\n", pid, td.dumps, option.Interval, td.total, len(latest))
+	} else {
+		fmt.Fprintf(w, "Process %d: %d threads on %d distinct stacks\n", pid, td.total, len(latest))
+	}
+	states := make([]string, 0, len(td.states))
+	for state := range td.states {
+		states = append(states, state)
+	}
+	sort.Strings(states)
+	for i, state := range states {
+		states[i] = fmt.Sprintf("%s %d", state, td.states[state])
+	}
+	fmt.Fprintf(w, "States: %s\n", strings.Join(states, ", "))
+	if td.deadlocks > 0 {
+		fmt.Fprintf(w, "Found %d Java-level deadlock(s)\n", td.deadlocks)
+	}
+
+	var contended []string
+	for address, l := range td.locks {
+		if l.waiters > 0 {
+			contended = append(contended, address)
+		}
+	}
+	sort.Slice(contended, func(i, j int) bool {
+		a, b := td.locks[contended[i]], td.locks[contended[j]]
+		if a.waiters != b.waiters {
+			return a.waiters > b.waiters
+		}
+		return contended[i] < contended[j]
+	})
+	if len(contended) > 0 {
+		fmt.Fprintf(w, "\nContended locks:\n")
+	}
+	for _, address := range contended {
+		l := td.locks[address]
+		owner := "no owner in the dump"
+		if l.owner != "" {
+			owner = fmt.Sprintf("held by %q", l.owner)
+		}
+		fmt.Fprintf(w, "  <%s> (a %s) %s, %d waiting\n", address, l.class, owner, l.waiters)
+	}
+
+	if option.Top > 0 && len(latest) > option.Top {
+		latest = latest[:option.Top]
+	}
+	for _, index := range latest {
+		s := td.list[index]
+		fmt.Fprintf(w, "\n%d threads", s.threads)
+		if td.dumps > 1 {
+			fmt.Fprintf(w, ", in %d/%d dumps, %d stuck", s.seen, td.dumps, stuck[index])
+		}
+		fmt.Fprintf(w, ": %s\n", td.names[s.state])
+		frames := s.frames
+		if option.Depth > 0 && len(frames) > option.Depth {
+			frames = frames[:option.Depth]
+		}
+		for _, id := range frames {
+			fmt.Fprintf(w, "\tat %s\n", td.names[id])
+		}
+		if len(frames) < len(s.frames) {
+			fmt.Fprintf(w, "\t... %d more\n", len(s.frames)-len(frames))
+		}
+	}
+}
@@ -0,0 +1,200 @@
+package internal
+
+import (
+	"bytes"
+	"fmt"
+	"os"
+	"os/user"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// testThreadDump is a HotSpot thread dump with a pool of idle workers, two threads
+// blocked on a monitor, a parked thread and a deadlock report.
+const testThreadDump = `2024-05-01 12:00:00
+Full thread dump OpenJDK 64-Bit Server VM (17.0.9+9 mixed mode, sharing):
+
+Threads class SMR info:
+_java_thread_list=0x00007f, length=7, elements={
+0x00007f01, 0x00007f02
+}
+
+"main" #1 prio=5 os_prio=0 cpu=120.00ms elapsed=60.00s tid=0x00007f01 nid=0x101 waiting on condition  [0x00007e]
+   java.lang.Thread.State: TIMED_WAITING (sleeping)
+	at java.lang.Thread.sleep(java.base@17.0.9/Native Method)
+	at com.example.App.main(App.java:10)
+
+"worker-1" #20 prio=5 os_prio=0 cpu=5.00ms elapsed=59.00s tid=0x00007f20 nid=0x120 waiting on condition  [0x00007e]
+   java.lang.Thread.State: WAITING (parking)
+	at jdk.internal.misc.Unsafe.park(java.base@17.0.9/Native Method)
+	- parking to wait for  <0x0000000700000100> (a java.util.concurrent.locks.AbstractQueuedSynchronizer$ConditionObject)
+	at java.util.concurrent.ThreadPoolExecutor.getTask(java.base@17.0.9/ThreadPoolExecutor.java:1062)
+
+"worker-2" #21 prio=5 os_prio=0 cpu=5.00ms elapsed=59.00s tid=0x00007f21 nid=0x121 waiting on condition  [0x00007e]
+   java.lang.Thread.State: WAITING (parking)
+	at jdk.internal.misc.Unsafe.park(java.base@17.0.9/Native Method)
+	- parking to wait for  <0x0000000700000100> (a java.util.concurrent.locks.AbstractQueuedSynchronizer$ConditionObject)
+	at java.util.concurrent.ThreadPoolExecutor.getTask(java.base@17.0.9/ThreadPoolExecutor.java:1062)
+
+"owner" #30 prio=5 os_prio=0 cpu=900.00ms elapsed=30.00s tid=0x00007f30 nid=0x130 runnable  [0x00007e]
+   java.lang.Thread.State: RUNNABLE
+	at com.example.Cache.refresh(Cache.java:42)
+	- locked <0x0000000700000200> (a com.example.Cache)
+	at com.example.Cache.get(Cache.java:20)
+
+"blocked-1" #31 prio=5 os_prio=0 cpu=1.00ms elapsed=30.00s tid=0x00007f31 nid=0x131 waiting for monitor entry  [0x00007e]
+   java.lang.Thread.State: BLOCKED (on object monitor)
+	at com.example.Cache.get(Cache.java:19)
+	- waiting to lock <0x0000000700000200> (a com.example.Cache)
+
+"blocked-2" #32 prio=5 os_prio=0 cpu=1.00ms elapsed=30.00s tid=0x00007f32 nid=0x132 waiting for monitor entry  [0x00007e]
+   java.lang.Thread.State: BLOCKED (on object monitor)
+	at com.example.Cache.get(Cache.java:19)
+	- waiting to lock <0x0000000700000200> (a com.example.Cache)
+
+"waiter" #33 prio=5 os_prio=0 cpu=1.00ms elapsed=30.00s tid=0x00007f33 nid=0x133 in Object.wait()  [0x00007e]
+   java.lang.Thread.State: WAITING (on object monitor)
+	at java.lang.Object.wait(java.base@17.0.9/Native Method)
+	- waiting on <0x0000000700000300> (a java.lang.Object)
+	at com.example.Queue.take(Queue.java:5)
+	- locked <0x0000000700000300> (a java.lang.Object)
+
+"VM Thread" os_prio=0 cpu=10.00ms elapsed=60.00s tid=0x00007f40 nid=0x140 runnable
+
+"GC Thread#0" os_prio=0 cpu=10.00ms elapsed=60.00s tid=0x00007f41 nid=0x141 runnable
+
+JNI global refs: 15, weak refs: 0
+
+
+Found one Java-level deadlock:
+=============================
+"blocked-1":
+  waiting to lock monitor 0x00007f (object 0x0000000700000200, a com.example.Cache),
+  which is held by "owner"
+
+Found 1 deadlock.
+`
+
+// TestParseThreadsFlags tests the ParseThreadsFlags function.
+func TestParseThreadsFlags(t *testing.T) {
+	opt, err := ParseThreadsFlags([]string{"-count", "3", "-interval", "2s", "-top", "5", "-l", "12345"})
+	assert.Nil(t, err)
+	assert.Equal(t, ThreadsOption{Pid: "12345", Count: 3, Interval: 2 * time.Second, Top: 5, Depth: 16, Locks: true}, opt)
+}
+
+// TestThreadsValidate tests the ThreadsValidate method of ThreadsOption.
+func TestThreadsValidate(t *testing.T) {
+	opt := ThreadsOption{Pid: "1"}
+	assert.EqualError(t, opt.ThreadsValidate(), "count must be positive")
+	opt = ThreadsOption{Pid: "1", Count: 2}
+	assert.EqualError(t, opt.ThreadsValidate(), "interval must be positive")
+	opt = ThreadsOption{Pid: "1", Count: 1, Top: -1}
+	assert.EqualError(t, opt.ThreadsValidate(), "top and depth must not be negative")
+	opt = ThreadsOption{Count: 1}
+	assert.EqualError(t, opt.ThreadsValidate(), "pid is required")
+	opt = ThreadsOption{Count: 1, Pid: "x"}
+	assert.EqualError(t, opt.ThreadsValidate(), "invalid pid x")
+}
+
+// TestThreadDump_Parse tests grouping the threads of a dump by stack, state and lock.
+func TestThreadDump_Parse(t *testing.T) {
+	td := newThreadDump()
+	// A line longer than the reader buffer is skipped.
+	dump := strings.Replace(testThreadDump, "JNI global refs", strings.Repeat("x", 2*attachMaxLine)+"\nJNI global refs", 1)
+	assert.Nil(t, td.parse(strings.NewReader(dump)))
+
+	assert.Equal(t, 9, td.total)
+	assert.Equal(t, map[string]int{"-": 2, "BLOCKED": 2, "RUNNABLE": 1, "TIMED_WAITING": 1, "WAITING": 3}, td.states)
+	assert.Equal(t, 1, td.deadlocks)
+	assert.Len(t, td.list, 6)
+	for _, s := range td.list {
+		if td.names[s.state] == "BLOCKED (on object monitor)" {
+			assert.Equal(t, 2, s.threads)
+			assert.Equal(t, []string{"com.example.Cache.get(Cache.java:19)"}, []string{td.names[s.frames[0]]})
+		}
+	}
+	assert.Equal(t, &threadLock{class: "com.example.Cache", owner: "owner", waiters: 2}, td.locks["0x0000000700000200"])
+	assert.Equal(t, 2, td.locks["0x0000000700000100"].waiters)
+	// Object.wait() releases the monitor it waits on.
+	assert.Nil(t, td.locks["0x0000000700000300"])
+
+	var out bytes.Buffer
+	td.report(&out, 42, ThreadsOption{Top: 2, Depth: 1})
+	expected := `Process 42: 9 threads on 6 distinct stacks
+States: - 2, BLOCKED 2, RUNNABLE 1, TIMED_WAITING 1, WAITING 3
+Found 1 Java-level deadlock(s)
+
+Contended locks:
+  <0x0000000700000100> (a java.util.concurrent.locks.AbstractQueuedSynchronizer$ConditionObject) no owner in the dump, 2 waiting
+  <0x0000000700000200> (a com.example.Cache) held by "owner", 2 waiting
+`
+	assert.True(t, strings.HasPrefix(out.String(), expected), out.String())
+	assert.Contains(t, out.String(), "\n2 threads: WAITING (parking)\n\tat jdk.internal.misc.Unsafe.park(java.base@17.0.9/Native Method)\n\t... 1 more\n")
+}
+
+// TestThreads tests taking several dumps through a mock attach listener and finding the stuck threads.
+func TestThreads(t *testing.T) {
+	restore, _, _ := captureLogs()
+	defer restore()
+
+	u, _ := user.Current()
+	pid := os.Getpid()
+	_, cleanupPerf, err := prepareHsperfdataFile(u.Username, pid)
+	if err != nil {
+		t.Fatalf("failed to create hsperfdata file: %v", err)
+	}
+	defer cleanupPerf()
+	var dumps atomic.Int32
+	var gotArgs []string
+	cleanup, err := startMockAttachListener(int32(pid), func(cmd string, args []string) string {
+		gotArgs = append([]string{cmd}, args...)
+		if dumps.Add(1) == 1 {
+			return "0\n" + testThreadDump
+		}
+		// The owner moved on, the blocked threads are still waiting.
+		return "0\n" + strings.Replace(testThreadDump, "Cache.refresh(Cache.java:42)", "Cache.refresh(Cache.java:43)", 1)
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	var out bytes.Buffer
+	orig := attachOutput
+	attachOutput = &out
+	defer func() { attachOutput = orig }()
+
+	code := Threads(ThreadsOption{Pid: strconv.Itoa(pid), Count: 2, Interval: time.Millisecond, Locks: true})
+	assert.Equal(t, 0, code)
+	assert.Equal(t, int32(2), dumps.Load())
+	assert.Equal(t, []string{attachCmdThreadDump, "-l", "", ""}, gotArgs)
+	assert.Contains(t, out.String(), "Process "+strconv.Itoa(pid)+", 2 dumps 1ms apart: 9 threads on 6 distinct stacks\n")
+	assert.Contains(t, out.String(), "\n2 threads, in 2/2 dumps, 2 stuck: BLOCKED (on object monitor)\n")
+	assert.Contains(t, out.String(), "\n1 threads, in 1/2 dumps, 0 stuck: RUNNABLE\n\tat com.example.Cache.refresh(Cache.java:43)\n")
+}
+
+// BenchmarkThreadDump_Parse measures aggregating a dump of 10k threads on a few hundred stacks.
+func BenchmarkThreadDump_Parse(b *testing.B) {
+	var dump bytes.Buffer
+	for i := 0; i < 10_000; i++ {
+		fmt.Fprintf(&dump, "\"worker-%d\" #%d prio=5 os_prio=0 tid=0x%x nid=0x%x waiting on condition  [0x00007e]\n", i, i, i, i)
+		dump.WriteString("   java.lang.Thread.State: WAITING (parking)\n\tat jdk.internal.misc.Unsafe.park(java.base@17.0.9/Native Method)\n")
+		fmt.Fprintf(&dump, "\t- parking to wait for  <0x%x> (a java.util.concurrent.locks.AbstractQueuedSynchronizer$ConditionObject)\n", i%300)
+		for j := 0; j < 40; j++ {
+			fmt.Fprintf(&dump, "\tat com.example.Handler%d.handle(Handler.java:%d)\n", i%300, j)
+		}
+		dump.WriteString("\n")
+	}
+	b.SetBytes(int64(dump.Len()))
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if err := newThreadDump().parse(bytes.NewReader(dump.Bytes())); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -0,0 +1,132 @@
+package internal
+
+import (
+	"fmt"
+	"strings"
+	"sync/atomic"
+	"time"
+)
+
+// AttachPhase identifies a step of the attach handshake.
+type AttachPhase int
+
+const (
+	PhaseValidate   AttachPhase = iota // user lookup and pid ownership checks
+	PhaseSchedule                      // waiting for an attach slot, the jitter and the end of a GC
+	PhaseAttachFile                    // creating .attach_pid<pid>
+	PhaseSignal                        // sending SIGQUIT
+	PhaseWaitSocket                    // waiting for the Attach Listener socket
+	PhaseConnect                       // connecting to the socket
+	PhaseWrite                         // writing the request
+	PhaseResponse                      // waiting for the return code
+	PhaseRead                          // reading the command output
+	attachPhaseCount
+)
+
+var attachPhaseNames = [attachPhaseCount]string{
+	"validate", "schedule", "attach-file", "signal", "wait-socket", "connect", "write", "response", "read",
+}
+
+// String returns the name of the phase as printed by -trace.
+func (p AttachPhase) String() string {
+	return attachPhaseNames[p]
+}
+
+// AttachTrace records, on the monotonic clock, how long each phase of one attach took.
+// A nil trace records nothing, so instrumented code does not need to check for one.
+type AttachTrace struct {
+	Durations [attachPhaseCount]time.Duration
+
+	start time.Time
+	last  time.Time
+	done  uint32 // bit p is set once phase p ended, see Done
+}
+
+// NewAttachTrace starts a trace at the current time.
+func NewAttachTrace() *AttachTrace {
+	now := time.Now()
+	return &AttachTrace{start: now, last: now}
+}
+
+// Done attributes the time elapsed since the previous phase ended to phase p.
+func (t *AttachTrace) Done(p AttachPhase) {
+	if t == nil {
+		return
+	}
+	now := time.Now()
+	t.Durations[p] += now.Sub(t.last)
+	t.last = now
+	t.done |= 1 << p
+}
+
+// Total returns the time from the start of the trace to the end of the last phase.
+func (t *AttachTrace) Total() time.Duration {
+	return t.last.Sub(t.start)
+}
+
+// Finish adds the phase durations to the process-wide attach histograms. Phases
+// that did not run, such as the signal to a JVM already listening, are left out
+// rather than counted as instant.
+func (t *AttachTrace) Finish() {
+	if t == nil {
+		return
+	}
+	for p, d := range t.Durations {
+		if t.done&(1<<p) != 0 {
+			attachPhaseHistograms[p].observe(d)
+		}
+	}
+}
+
+// Breakdown formats the trace as one line per phase followed by the total.
+func (t *AttachTrace) Breakdown() []string {
+	lines := make([]string, 0, attachPhaseCount+1)
+	for p, d := range t.Durations {
+		lines = append(lines, fmt.Sprintf("  %-12s %10.3fms", AttachPhase(p), durationMs(d)))
+	}
+	return append(lines, fmt.Sprintf("  %-12s %10.3fms", "total", durationMs(t.Total())))
+}
+
+// Summary formats the trace on a single line of phase=duration pairs.
+func (t *AttachTrace) Summary() string {
+	var b strings.Builder
+	for p, d := range t.Durations {
+		fmt.Fprintf(&b, "%s=%.3fms ", AttachPhase(p), durationMs(d))
+	}
+	fmt.Fprintf(&b, "total=%.3fms", durationMs(t.Total()))
+	return b.String()
+}
+
+func durationMs(d time.Duration) float64 {
+	return float64(d) / float64(time.Millisecond)
+}
+
+// latencyBuckets are the upper bounds of the attach phase histograms.
+var latencyBuckets = [...]time.Duration{
+	100 * time.Microsecond, 250 * time.Microsecond, 500 * time.Microsecond,
+	time.Millisecond, 2500 * time.Microsecond, 5 * time.Millisecond,
+	10 * time.Millisecond, 25 * time.Millisecond, 50 * time.Millisecond,
+	100 * time.Millisecond, 250 * time.Millisecond, 500 * time.Millisecond,
+	time.Second, 2500 * time.Millisecond, 5 * time.Second, 10 * time.Second,
+}
+
+// latencyHistogram is a fixed-bucket histogram safe for concurrent use.
+// counts[i] holds observations up to latencyBuckets[i], the last one the overflow.
+type latencyHistogram struct {
+	counts [len(latencyBuckets) + 1]atomic.Uint64
+	count  atomic.Uint64
+	sum    atomic.Int64
+}
+
+func (h *latencyHistogram) observe(d time.Duration) {
+	i := 0
+	for i < len(latencyBuckets) && d > latencyBuckets[i] {
+		i++
+	}
+	h.counts[i].Add(1)
+	h.count.Add(1)
+	h.sum.Add(int64(d))
+}
+
+// attachPhaseHistograms aggregates the phase durations of every finished attach trace.
+var attachPhaseHistograms [attachPhaseCount]latencyHistogram
@@ -0,0 +1,68 @@
+package internal
+
+import (
+	"os"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// TestAttachTrace tests attributing elapsed time to phases.
+func TestAttachTrace(t *testing.T) {
+	trace := NewAttachTrace()
+	time.Sleep(2 * time.Millisecond)
+	trace.Done(PhaseValidate)
+	trace.Done(PhaseConnect)
+	assert.True(t, trace.Durations[PhaseValidate] >= 2*time.Millisecond)
+	assert.True(t, trace.Durations[PhaseConnect] < trace.Durations[PhaseValidate])
+	assert.Equal(t, trace.Durations[PhaseValidate]+trace.Durations[PhaseConnect], trace.Total())
+
+	lines := trace.Breakdown()
+	assert.Len(t, lines, int(attachPhaseCount)+1)
+	assert.True(t, strings.HasPrefix(strings.TrimSpace(lines[0]), "validate"))
+	assert.True(t, strings.HasPrefix(trace.Summary(), "validate="))
+
+	// A nil trace is a no-op.
+	var none *AttachTrace
+	none.Done(PhaseRead)
+	none.Finish()
+}
+
+// TestAttachTrace_Histograms tests that finished traces land in the phase histograms.
+func TestAttachTrace_Histograms(t *testing.T) {
+	before := attachPhaseHistograms[PhaseWrite].count.Load()
+	skipped := attachPhaseHistograms[PhaseSignal].count.Load()
+	trace := NewAttachTrace()
+	trace.Done(PhaseWrite)
+	trace.Durations[PhaseWrite] = 3 * time.Millisecond
+	trace.Finish()
+	h := &attachPhaseHistograms[PhaseWrite]
+	assert.Equal(t, before+1, h.count.Load())
+	// 3ms falls in the 5ms bucket.
+	assert.True(t, h.counts[5].Load() >= 1)
+	assert.Equal(t, skipped, attachPhaseHistograms[PhaseSignal].count.Load(), "a phase that did not run must not be observed")
+}
+
+// TestLoadAgent_Trace tests that an attach through the mock listener records every socket phase.
+func TestLoadAgent_Trace(t *testing.T) {
+	// The socket is checked to be owned by the user of the process, so use ours.
+	pid := int32(os.Getpid())
+	cleanup, err := startMockAttachListener(pid, func(cmd string, args []string) string {
+		return "0\nreturn code: 0\n"
+	})
+	if err != nil {
+		t.Fatalf("failed to start mock attach listener: %v", err)
+	}
+	defer cleanup()
+
+	trace := NewAttachTrace()
+	jp := JvmProcess{Pid: pid, trace: trace}
+	assert.Nil(t, jp.checkSocket())
+	assert.Nil(t, jp.loadAgent("/tmp/agent.jar", ""))
+	for _, p := range []AttachPhase{PhaseWaitSocket, PhaseConnect, PhaseWrite, PhaseResponse, PhaseRead} {
+		assert.True(t, trace.Durations[p] > 0, p.String())
+	}
+	assert.Equal(t, time.Duration(0), trace.Durations[PhaseSignal])
+}
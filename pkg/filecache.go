@@ -0,0 +1,175 @@
+package pkg
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"fmt"
+	"io"
+	"os"
+	"path"
+	"path/filepath"
+	"syscall"
+)
+
+// FileCache is a content-addressed store of files, keyed by the SHA-256 of their
+// content. Files are kept as <Dir>/<digest>/<name>, so they keep their base name.
+//
+// Cached and placed files are reached through a Root, so a symlink planted on
+// the way is never followed, and an existing file is only reused once its
+// content has been hashed again: a reader of the placed copy may well be able
+// to write to it.
+type FileCache struct {
+	Dir string
+}
+
+// Add stores the file at path unless a file with the same content and name is
+// already cached, and returns the path of the cached copy.
+func (c *FileCache) Add(path string) (string, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+	h := sha256.New()
+	size, err := io.Copy(h, f)
+	if err != nil {
+		return "", err
+	}
+	digest := hex.EncodeToString(h.Sum(nil))
+
+	if err := os.MkdirAll(c.Dir, 0700); err != nil {
+		return "", err
+	}
+	root, err := OpenRoot(c.Dir)
+	if err != nil {
+		return "", err
+	}
+	defer root.Close()
+	uid := os.Geteuid()
+	if err := checkCacheDir(root, ".", uid); err != nil {
+		return "", err
+	}
+	name := digest + "/" + filepath.Base(path)
+	if cachedFileMatches(root, name, digest, size, uid) {
+		return root.Join(name), nil
+	}
+	if err := mkdirCacheDir(root, digest, 0700, uid); err != nil {
+		return "", err
+	}
+	if _, err := f.Seek(0, io.SeekStart); err != nil {
+		return "", err
+	}
+	if err := writeFileAtomic(root, name, f); err != nil {
+		return "", err
+	}
+	return root.Join(name), nil
+}
+
+// Place makes the cached file src available as <dir>/<digest>/<name> below root
+// unless it is already there, and returns that name. A hard link is tried first,
+// then a reflink, and only then is the content copied. The directories must be
+// owned by us, by root or by uid, the user the copy is for, and nobody else may
+// write to them.
+func (c *FileCache) Place(src string, root *Root, dir string, uid int) (string, error) {
+	fi, err := os.Stat(src)
+	if err != nil {
+		return "", err
+	}
+	digest := filepath.Base(filepath.Dir(src))
+	name := path.Join(dir, digest, filepath.Base(src))
+	if cachedFileMatches(root, name, digest, fi.Size(), uid) {
+		return name, nil
+	}
+	for _, d := range []string{dir, path.Join(dir, digest)} {
+		if err := mkdirCacheDir(root, d, 0755, uid); err != nil {
+			return "", err
+		}
+	}
+	// A file that failed the check above stays in the way of the link, and is
+	// replaced by the copy.
+	if err := root.Link(src, name); err == nil {
+		return name, nil
+	}
+	f, err := os.Open(src)
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+	if err := writeFileAtomic(root, name, f); err != nil {
+		return "", err
+	}
+	return name, nil
+}
+
+// trustedOwner reports whether a cache file owned by owner can be trusted for uid.
+func trustedOwner(owner uint32, uid int) bool {
+	return owner == 0 || int(owner) == os.Geteuid() || int(owner) == uid
+}
+
+// checkCacheDir checks that name is a directory only trusted owners can write to.
+func checkCacheDir(root *Root, name string, uid int) error {
+	fi, err := root.Lstat(name)
+	if err != nil {
+		return err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !fi.IsDir() || fi.Mode().Perm()&0022 != 0 || !ok || !trustedOwner(st.Uid, uid) {
+		return fmt.Errorf("%s is not a directory of a trusted user", root.Join(name))
+	}
+	return nil
+}
+
+// mkdirCacheDir creates the directory name unless it exists, then checks it.
+func mkdirCacheDir(root *Root, name string, perm os.FileMode, uid int) error {
+	if err := root.Mkdir(name, perm); err != nil && !os.IsExist(err) {
+		return err
+	}
+	return checkCacheDir(root, name, uid)
+}
+
+// cachedFileMatches reports whether name is a regular file of a trusted owner
+// with the given size and digest.
+func cachedFileMatches(root *Root, name, digest string, size int64, uid int) bool {
+	f, err := root.OpenFile(name, os.O_RDONLY, 0)
+	if err != nil {
+		return false
+	}
+	defer f.Close()
+	fi, err := f.Stat()
+	if err != nil {
+		return false
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !fi.Mode().IsRegular() || fi.Size() != size || !ok || !trustedOwner(st.Uid, uid) {
+		return false
+	}
+	h := sha256.New()
+	if _, err := io.Copy(h, f); err != nil {
+		return false
+	}
+	return hex.EncodeToString(h.Sum(nil)) == digest
+}
+
+// writeFileAtomic writes the content of src to a temporary file next to name and
+// renames it into place, so concurrent readers never see a partial file.
+func writeFileAtomic(root *Root, name string, src *os.File) error {
+	tmp, tmpName, err := root.CreateTemp(path.Dir(name), ".tmp-"+path.Base(name))
+	if err != nil {
+		return err
+	}
+	defer root.Remove(tmpName)
+	if err := cloneFile(tmp, src); err != nil {
+		if _, err := io.Copy(tmp, src); err != nil {
+			tmp.Close()
+			return err
+		}
+	}
+	if err := tmp.Chmod(0644); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Close(); err != nil {
+		return err
+	}
+	return root.Rename(tmpName, name)
+}
@@ -0,0 +1,13 @@
+//go:build !linux
+
+package pkg
+
+import (
+	"errors"
+	"os"
+)
+
+// cloneFile is not supported, the content is copied instead.
+func cloneFile(dst, src *os.File) error {
+	return errors.ErrUnsupported
+}
@@ -0,0 +1,150 @@
+package pkg
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// TestFileCache tests that identical content is stored and placed once.
+func TestFileCache(t *testing.T) {
+	cache := &FileCache{Dir: filepath.Join(t.TempDir(), "cache")}
+	src := filepath.Join(t.TempDir(), "agent.jar")
+	os.WriteFile(src, []byte("agent v1"), 0600)
+
+	cached, err := cache.Add(src)
+	if err != nil {
+		t.Fatalf("Add failed: %v", err)
+	}
+	if filepath.Base(cached) != "agent.jar" {
+		t.Errorf("expected the cached file to keep its name, got %s", cached)
+	}
+	again, err := cache.Add(src)
+	if err != nil || again != cached {
+		t.Errorf("expected the same cached path %s, got %s, %v", cached, again, err)
+	}
+	os.WriteFile(src, []byte("agent v2"), 0600)
+	if other, _ := cache.Add(src); other == cached {
+		t.Errorf("expected different content to be cached separately, got %s", other)
+	}
+
+	// Placed by hard link on the same filesystem, by copy otherwise.
+	target := t.TempDir()
+	root, err := OpenRoot(target)
+	if err != nil {
+		t.Fatalf("OpenRoot failed: %v", err)
+	}
+	defer root.Close()
+	uid := os.Geteuid()
+	placed, err := cache.Place(cached, root, "agents", uid)
+	if err != nil {
+		t.Fatalf("Place failed: %v", err)
+	}
+	if content, _ := os.ReadFile(root.Join(placed)); string(content) != "agent v1" {
+		t.Errorf("expected placed content %q, got %q", "agent v1", content)
+	}
+	if info, _ := os.Stat(root.Join(placed)); info.Mode().Perm()&0044 != 0044 {
+		t.Errorf("expected the placed file to be readable by everyone, got %v", info.Mode())
+	}
+	before, _ := os.Stat(root.Join(placed))
+	if again, err := cache.Place(cached, root, "agents", uid); err != nil || again != placed {
+		t.Errorf("expected the same placed path %s, got %s, %v", placed, again, err)
+	}
+	if after, _ := os.Stat(root.Join(placed)); !os.SameFile(before, after) {
+		t.Error("expected an existing placement to be kept")
+	}
+}
+
+// TestFileCache_Tampered tests that a cache never serves or writes through files
+// someone else put in its way.
+func TestFileCache_Tampered(t *testing.T) {
+	cache := &FileCache{Dir: filepath.Join(t.TempDir(), "cache")}
+	src := filepath.Join(t.TempDir(), "agent.jar")
+	os.WriteFile(src, []byte("agent"), 0600)
+	cached, err := cache.Add(src)
+	if err != nil {
+		t.Fatalf("Add failed: %v", err)
+	}
+	// A modified cached copy is replaced by a fresh one.
+	os.Chmod(cached, 0600)
+	os.WriteFile(cached, []byte("evil!"), 0600)
+	if again, err := cache.Add(src); err != nil || again != cached {
+		t.Fatalf("expected the same cached path %s, got %s, %v", cached, again, err)
+	}
+	if content, _ := os.ReadFile(cached); string(content) != "agent" {
+		t.Errorf("expected the cached copy to be restored, got %q", content)
+	}
+
+	target, outside := t.TempDir(), t.TempDir()
+	root, err := OpenRoot(target)
+	if err != nil {
+		t.Fatalf("OpenRoot failed: %v", err)
+	}
+	defer root.Close()
+	uid := os.Geteuid()
+
+	// A symlinked placement directory is not entered.
+	os.Symlink(outside, filepath.Join(target, "agents"))
+	if _, err := cache.Place(cached, root, "agents", uid); err == nil {
+		t.Error("expected a symlinked directory to be refused")
+	}
+	if entries, _ := os.ReadDir(outside); len(entries) != 0 {
+		t.Errorf("expected nothing to be placed through the symlink, got %v", entries)
+	}
+	os.Remove(filepath.Join(target, "agents"))
+
+	// Others may not write to the placement directory.
+	os.Mkdir(filepath.Join(target, "agents"), 0777)
+	os.Chmod(filepath.Join(target, "agents"), 0777)
+	if _, err := cache.Place(cached, root, "agents", uid); err == nil {
+		t.Error("expected a world writable directory to be refused")
+	}
+	os.Chmod(filepath.Join(target, "agents"), 0755)
+
+	// A placed file that is a symlink, or has other content, is replaced.
+	placed, err := cache.Place(cached, root, "agents", uid)
+	if err != nil {
+		t.Fatalf("Place failed: %v", err)
+	}
+	for _, tamper := range []func(string){
+		func(p string) { os.Remove(p); os.Symlink(filepath.Join(outside, "x"), p) },
+		func(p string) { os.Remove(p); os.WriteFile(p, []byte("evil!"), 0644) },
+	} {
+		tamper(root.Join(placed))
+		if again, err := cache.Place(cached, root, "agents", uid); err != nil || again != placed {
+			t.Fatalf("expected the same placed path %s, got %s, %v", placed, again, err)
+		}
+		fi, _ := os.Lstat(root.Join(placed))
+		content, _ := os.ReadFile(root.Join(placed))
+		if !fi.Mode().IsRegular() || string(content) != "agent" {
+			t.Errorf("expected the placed copy to be restored, got %v %q", fi.Mode(), content)
+		}
+	}
+	if entries, _ := os.ReadDir(outside); len(entries) != 0 {
+		t.Errorf("expected nothing to be written outside the root, got %v", entries)
+	}
+}
+
+// TestWriteFileAtomic tests the copy used when neither a link nor a reflink is possible.
+func TestWriteFileAtomic(t *testing.T) {
+	src := filepath.Join(t.TempDir(), "src")
+	os.WriteFile(src, []byte("content"), 0600)
+	f, _ := os.Open(src)
+	defer f.Close()
+	dir := t.TempDir()
+	os.Mkdir(filepath.Join(dir, "a"), 0755)
+	root, err := OpenRoot(dir)
+	if err != nil {
+		t.Fatalf("OpenRoot failed: %v", err)
+	}
+	defer root.Close()
+	if err := writeFileAtomic(root, "a/dst", f); err != nil {
+		t.Fatalf("writeFileAtomic failed: %v", err)
+	}
+	if content, _ := os.ReadFile(filepath.Join(dir, "a", "dst")); string(content) != "content" {
+		t.Errorf("expected %q, got %q", "content", content)
+	}
+	if entries, _ := os.ReadDir(filepath.Join(dir, "a")); len(entries) != 1 {
+		t.Errorf("expected no temporary file left behind, got %v", entries)
+	}
+}
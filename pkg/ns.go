@@ -0,0 +1,28 @@
+package pkg
+
+// ProcessNamespace locates a process relative to the mount and pid namespaces of the caller.
+type ProcessNamespace struct {
+	// MountID identifies the mount namespace of the process, e.g. "mnt:[4026531840]".
+	MountID string
+	// Root is the root directory of the process as seen from here, such as
+	// /proc/<pid>/root, or "" if it shares our mount namespace.
+	Root string
+	// Pid is the pid of the process in its own, innermost pid namespace.
+	Pid int32
+}
+
+// Shared reports whether the process sees the same filesystem as we do.
+func (ns ProcessNamespace) Shared() bool {
+	return ns.Root == ""
+}
+
+// GetProcessNamespace returns the namespace of pid. Outside Linux every process
+// shares ours.
+func GetProcessNamespace(pid int32) (ProcessNamespace, error) {
+	return getProcessNamespace(pid)
+}
+
+// ListPids returns the pids of every process visible to us.
+func ListPids() ([]int32, error) {
+	return listPids()
+}
@@ -0,0 +1,75 @@
+package pkg
+
+import (
+	"bytes"
+	"os"
+	"strconv"
+	"sync"
+)
+
+// selfMountID is the mount namespace of this process.
+var selfMountID = sync.OnceValues(func() (string, error) {
+	return os.Readlink("/proc/self/ns/mnt")
+})
+
+// getProcessNamespace compares the mount namespace of pid with ours and reads its
+// innermost pid from the NSpid line of /proc/<pid>/status.
+func getProcessNamespace(pid int32) (ProcessNamespace, error) {
+	proc := "/proc/" + strconv.Itoa(int(pid))
+	ns := ProcessNamespace{Pid: pid}
+	mountID, err := os.Readlink(proc + "/ns/mnt")
+	if err != nil {
+		return ns, err
+	}
+	ns.MountID = mountID
+	if self, err := selfMountID(); err == nil && self == mountID {
+		return ns, nil
+	}
+	ns.Root = proc + "/root"
+
+	status, err := os.ReadFile(proc + "/status")
+	if err != nil {
+		return ns, err
+	}
+	if nsPid, ok := parseNSpid(status); ok {
+		ns.Pid = nsPid
+	}
+	return ns, nil
+}
+
+// parseNSpid returns the last pid of the NSpid line of a status file.
+// Kernels before 4.1 have no such line.
+func parseNSpid(status []byte) (int32, bool) {
+	i := bytes.Index(status, []byte("\nNSpid:"))
+	if i < 0 {
+		return 0, false
+	}
+	line := status[i+len("\nNSpid:"):]
+	if end := bytes.IndexByte(line, '\n'); end >= 0 {
+		line = line[:end]
+	}
+	fields := bytes.Fields(line)
+	if len(fields) == 0 {
+		return 0, false
+	}
+	pid, err := strconv.Atoi(string(fields[len(fields)-1]))
+	if err != nil {
+		return 0, false
+	}
+	return int32(pid), true
+}
+
+// listPids reads the numeric entries of /proc.
+func listPids() ([]int32, error) {
+	entries, err := os.ReadDir("/proc")
+	if err != nil {
+		return nil, err
+	}
+	pids := make([]int32, 0, len(entries))
+	for _, e := range entries {
+		if pid, err := strconv.Atoi(e.Name()); err == nil {
+			pids = append(pids, int32(pid))
+		}
+	}
+	return pids, nil
+}
@@ -0,0 +1,36 @@
+package pkg
+
+import (
+	"os"
+	"testing"
+)
+
+// TestGetProcessNamespace tests that our own process shares our namespace.
+func TestGetProcessNamespace(t *testing.T) {
+	ns, err := GetProcessNamespace(int32(os.Getpid()))
+	if err != nil {
+		t.Fatalf("GetProcessNamespace failed: %v", err)
+	}
+	if !ns.Shared() || ns.Pid != int32(os.Getpid()) {
+		t.Errorf("expected our own namespace, got %+v", ns)
+	}
+}
+
+// TestParseNSpid tests reading the innermost pid of a status file.
+func TestParseNSpid(t *testing.T) {
+	tests := []struct {
+		status string
+		pid    int32
+		ok     bool
+	}{
+		{"Name:\tjava\nTgid:\t4242\nNSpid:\t4242\t17\t1\nPPid:\t1\n", 1, true},
+		{"Name:\tjava\nNSpid:\t4242\n", 4242, true},
+		{"Name:\tjava\nPid:\t4242\n", 0, false},
+	}
+	for _, tt := range tests {
+		pid, ok := parseNSpid([]byte(tt.status))
+		if pid != tt.pid || ok != tt.ok {
+			t.Errorf("parseNSpid(%q) = %d, %v, expected %d, %v", tt.status, pid, ok, tt.pid, tt.ok)
+		}
+	}
+}
@@ -0,0 +1,15 @@
+//go:build !linux
+
+package pkg
+
+import "errors"
+
+// getProcessNamespace reports every process as sharing our namespaces.
+func getProcessNamespace(pid int32) (ProcessNamespace, error) {
+	return ProcessNamespace{Pid: pid}, nil
+}
+
+// listPids is not needed outside Linux, where there are no containers to look into.
+func listPids() ([]int32, error) {
+	return nil, errors.ErrUnsupported
+}
@@ -4,6 +4,7 @@ import (
 	"fmt"
 	"os"
 	"syscall"
+	"time"
 )
 
 // PathExists checks whether the given file or directory path exists.
@@ -22,11 +23,68 @@ var PidExists = func(pid int32) (bool, error) {
 	if pid <= 0 {
 		return false, fmt.Errorf("invalid pid %v", pid)
 	}
+	return pidExists(pid)
+}
+
+// Cmdline is the command line of a process.
+// Line holds the arguments joined by spaces and every element of Args is a substring of Line.
+type Cmdline struct {
+	Line string
+	Args []string
+}
+
+// ReadCmdline returns the command line of the process with the given pid.
+func ReadCmdline(pid int32) (Cmdline, error) {
+	if pid <= 0 {
+		return Cmdline{}, fmt.Errorf("invalid pid %v", pid)
+	}
+	return readCmdline(pid)
+}
+
+// ProcessStartTime returns the time the process with the given pid was started.
+// Together with the pid it identifies a process across pid reuse.
+func ProcessStartTime(pid int32) (time.Time, error) {
+	if pid <= 0 {
+		return time.Time{}, fmt.Errorf("invalid pid %v", pid)
+	}
+	return processStartTime(pid)
+}
+
+// ProcessStartId returns an identifier of the start of the process with the given
+// pid, to key what is kept about it on disk. Unlike ProcessStartTime, which follows
+// the wall clock the boot time of the system is derived from, it never changes
+// over the life of the process, and it differs for a later process with the pid.
+func ProcessStartId(pid int32) (string, error) {
+	if pid <= 0 {
+		return "", fmt.Errorf("invalid pid %v", pid)
+	}
+	return processStartId(pid)
+}
+
+// ProcessUid returns the effective uid of the process with the given pid, which
+// owns the files it creates, such as the Attach Listener socket of a JVM.
+func ProcessUid(pid int32) (int, error) {
+	if pid <= 0 {
+		return 0, fmt.Errorf("invalid pid %v", pid)
+	}
+	return processUid(pid)
+}
+
+// ProcessEnv returns the value of the environment variable name of the process
+// with the given pid, as it was when the process started.
+func ProcessEnv(pid int32, name string) (string, bool, error) {
+	if pid <= 0 {
+		return "", false, fmt.Errorf("invalid pid %v", pid)
+	}
+	return processEnv(pid, name)
+}
+
+// signalPidExists checks PID existence by signalling the pid.
+func signalPidExists(pid int32) (bool, error) {
 	proc, err := os.FindProcess(int(pid))
 	if err != nil {
 		return false, err
 	}
-	// procfs does not exist or is not mounted, check PID existence by signalling the pid
 	err = proc.Signal(syscall.Signal(0))
 	if err == nil {
 		return true, nil
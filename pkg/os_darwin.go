@@ -0,0 +1,116 @@
+package pkg
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"strconv"
+	"time"
+
+	"golang.org/x/sys/unix"
+)
+
+// pidExists checks PID existence by signalling the pid, as there is no procfs to consult.
+func pidExists(pid int32) (bool, error) {
+	return signalPidExists(pid)
+}
+
+// procArgs reads the kern.procargs2 sysctl of the process: the argument count,
+// the executable path, then the arguments and the environment, each NUL terminated.
+func procArgs(pid int32) (args [][]byte, env []byte, err error) {
+	data, err := unix.SysctlRaw("kern.procargs2", int(pid))
+	if err != nil {
+		return nil, nil, err
+	}
+	if len(data) < 4 {
+		return nil, nil, errors.New("short kern.procargs2")
+	}
+	argc := int(binary.LittleEndian.Uint32(data))
+	data = data[4:]
+	// Skip the executable path and the NULs padding it.
+	if i := bytes.IndexByte(data, 0); i >= 0 {
+		data = data[i:]
+	}
+	data = bytes.TrimLeft(data, "\x00")
+	for len(args) < argc && len(data) > 0 {
+		i := bytes.IndexByte(data, 0)
+		if i < 0 {
+			args, data = append(args, data), nil
+			break
+		}
+		args, data = append(args, data[:i]), data[i+1:]
+	}
+	return args, data, nil
+}
+
+// readCmdline resolves the command line through sysctl, without running ps.
+func readCmdline(pid int32) (Cmdline, error) {
+	args, _, err := procArgs(pid)
+	if err != nil || len(args) == 0 {
+		return Cmdline{}, err
+	}
+	line := string(bytes.Join(args, []byte{' '}))
+	c := Cmdline{Line: line, Args: make([]string, len(args))}
+	for i, arg := range args {
+		c.Args[i], line = line[:len(arg)], line[min(len(arg)+1, len(line)):]
+	}
+	return c, nil
+}
+
+// processStartTime resolves the start time from the kinfo_proc of the process.
+func processStartTime(pid int32) (time.Time, error) {
+	k, err := unix.SysctlKinfoProc("kern.proc.pid", int(pid))
+	if err != nil {
+		return time.Time{}, err
+	}
+	if k.Proc.P_pid != pid {
+		return time.Time{}, errors.New("process not found")
+	}
+	return time.Unix(k.Proc.P_starttime.Unix()), nil
+}
+
+// processStartId is the start time in the kinfo_proc of the process, recorded
+// once by the kernel.
+func processStartId(pid int32) (string, error) {
+	start, err := processStartTime(pid)
+	if err != nil {
+		return "", err
+	}
+	return strconv.FormatInt(start.UnixMicro(), 10), nil
+}
+
+// processUid reads the effective uid from the credentials in the kinfo_proc of the process.
+func processUid(pid int32) (int, error) {
+	k, err := unix.SysctlKinfoProc("kern.proc.pid", int(pid))
+	if err != nil {
+		return 0, err
+	}
+	if k.Proc.P_pid != pid {
+		return 0, errors.New("process not found")
+	}
+	return int(k.Eproc.Ucred.Uid), nil
+}
+
+// processEnv looks name up in the environment the process started with, which
+// follows its arguments in kern.procargs2.
+func processEnv(pid int32, name string) (string, bool, error) {
+	_, env, err := procArgs(pid)
+	if err != nil {
+		return "", false, err
+	}
+	for len(env) > 0 {
+		entry := env
+		if i := bytes.IndexByte(env, 0); i >= 0 {
+			entry, env = env[:i], env[i+1:]
+		} else {
+			env = nil
+		}
+		if len(entry) == 0 {
+			break // the environment ends with an empty string
+		}
+		if v, ok := bytes.CutPrefix(entry, []byte(name)); ok && len(v) > 0 && v[0] == '=' {
+			return string(v[1:]), true, nil
+		}
+	}
+	return "", false, nil
+}
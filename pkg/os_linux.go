@@ -0,0 +1,214 @@
+package pkg
+
+import (
+	"bytes"
+	"errors"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// userHz is the unit of the clock tick fields of /proc/<pid>/stat, fixed at 100 by the kernel ABI.
+const userHz = 100
+
+// cmdlinePool holds the buffers /proc/<pid>/cmdline is read into.
+var cmdlinePool = sync.Pool{
+	New: func() any {
+		b := make([]byte, 4096)
+		return &b
+	},
+}
+
+var procMounted = sync.OnceValue(func() bool {
+	var st syscall.Stat_t
+	return syscall.Stat("/proc/self", &st) == nil
+})
+
+// pidExists checks the pid with a single stat of /proc/<pid>.
+// Falls back to signalling the pid when procfs is not mounted.
+func pidExists(pid int32) (bool, error) {
+	if !procMounted() {
+		return signalPidExists(pid)
+	}
+	var st syscall.Stat_t
+	err := syscall.Stat("/proc/"+strconv.Itoa(int(pid)), &st)
+	switch err {
+	case nil:
+		return true, nil
+	case syscall.ENOENT:
+		return false, nil
+	}
+	return false, err
+}
+
+// readCmdline reads /proc/<pid>/cmdline into a pooled buffer and splits it on NUL.
+// The only copy made is the final string all arguments are sliced from.
+func readCmdline(pid int32) (Cmdline, error) {
+	fd, err := syscall.Open("/proc/"+strconv.Itoa(int(pid))+"/cmdline", syscall.O_RDONLY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return Cmdline{}, err
+	}
+	defer syscall.Close(fd)
+
+	bp := cmdlinePool.Get().(*[]byte)
+	defer cmdlinePool.Put(bp)
+	buf := *bp
+	n := 0
+	for {
+		if n == len(buf) {
+			buf = append(buf, make([]byte, len(buf))...)
+			*bp = buf
+		}
+		r, err := syscall.Read(fd, buf[n:])
+		if err == syscall.EINTR {
+			continue
+		}
+		if err != nil {
+			return Cmdline{}, err
+		}
+		if r == 0 {
+			break
+		}
+		n += r
+	}
+	data := buf[:n]
+	if n > 0 && data[n-1] == 0 {
+		data = data[:n-1]
+	}
+	if len(data) == 0 {
+		return Cmdline{}, nil
+	}
+
+	// Record argument boundaries before the NULs become spaces, then slice the
+	// arguments out of Line.
+	var stack [64]int
+	ends := stack[:0]
+	for i, b := range data {
+		if b == 0 {
+			ends = append(ends, i)
+			data[i] = ' '
+		}
+	}
+	ends = append(ends, len(data))
+	line := string(data)
+	args := make([]string, len(ends))
+	begin := 0
+	for i, end := range ends {
+		args[i] = line[begin:end]
+		begin = end + 1
+	}
+	return Cmdline{Line: line, Args: args}, nil
+}
+
+// bootTime reads the boot time of the system from the btime line of /proc/stat.
+var bootTime = sync.OnceValues(func() (time.Time, error) {
+	data, err := os.ReadFile("/proc/stat")
+	if err != nil {
+		return time.Time{}, err
+	}
+	for _, line := range bytes.Split(data, []byte("\n")) {
+		if v, ok := bytes.CutPrefix(line, []byte("btime ")); ok {
+			sec, err := strconv.ParseInt(string(bytes.TrimSpace(v)), 10, 64)
+			if err != nil {
+				return time.Time{}, err
+			}
+			return time.Unix(sec, 0), nil
+		}
+	}
+	return time.Time{}, errors.New("btime not found in /proc/stat")
+})
+
+// processStartTime derives the start time from the starttime field of /proc/<pid>/stat.
+func processStartTime(pid int32) (time.Time, error) {
+	boot, err := bootTime()
+	if err != nil {
+		return time.Time{}, err
+	}
+	ticks, err := processStartTicks(pid)
+	if err != nil {
+		return time.Time{}, err
+	}
+	return boot.Add(time.Duration(ticks) * time.Second / userHz), nil
+}
+
+// processStartId is the boot id of the system with the starttime field of
+// /proc/<pid>/stat, the clock ticks from boot to the start of the process.
+func processStartId(pid int32) (string, error) {
+	boot, err := bootId()
+	if err != nil {
+		return "", err
+	}
+	ticks, err := processStartTicks(pid)
+	if err != nil {
+		return "", err
+	}
+	return boot + "-" + strconv.FormatInt(ticks, 10), nil
+}
+
+// bootId reads the random id the kernel picks at every boot.
+var bootId = sync.OnceValues(func() (string, error) {
+	data, err := os.ReadFile("/proc/sys/kernel/random/boot_id")
+	if err != nil {
+		return "", err
+	}
+	return strings.TrimSpace(string(data)), nil
+})
+
+// processStartTicks reads the starttime field of /proc/<pid>/stat.
+func processStartTicks(pid int32) (int64, error) {
+	data, err := os.ReadFile("/proc/" + strconv.Itoa(int(pid)) + "/stat")
+	if err != nil {
+		return 0, err
+	}
+	// The command name may contain spaces and parentheses, so fields are counted
+	// from the last ')': state is field 3 and starttime field 22.
+	i := bytes.LastIndexByte(data, ')')
+	if i < 0 {
+		return 0, errors.New("malformed /proc/" + strconv.Itoa(int(pid)) + "/stat")
+	}
+	fields := bytes.Fields(data[i+1:])
+	if len(fields) < 20 {
+		return 0, errors.New("malformed /proc/" + strconv.Itoa(int(pid)) + "/stat")
+	}
+	return strconv.ParseInt(string(fields[19]), 10, 64)
+}
+
+// processUid reads the effective uid, the second field of the Uid line of /proc/<pid>/status.
+func processUid(pid int32) (int, error) {
+	data, err := os.ReadFile("/proc/" + strconv.Itoa(int(pid)) + "/status")
+	if err != nil {
+		return 0, err
+	}
+	i := bytes.Index(data, []byte("\nUid:"))
+	if i < 0 {
+		return 0, errors.New("malformed /proc/" + strconv.Itoa(int(pid)) + "/status")
+	}
+	fields := bytes.Fields(data[i+len("\nUid:"):])
+	if len(fields) < 2 {
+		return 0, errors.New("malformed /proc/" + strconv.Itoa(int(pid)) + "/status")
+	}
+	return strconv.Atoi(string(fields[1]))
+}
+
+// processEnv scans /proc/<pid>/environ, which holds NUL terminated name=value pairs.
+func processEnv(pid int32, name string) (string, bool, error) {
+	data, err := os.ReadFile("/proc/" + strconv.Itoa(int(pid)) + "/environ")
+	if err != nil {
+		return "", false, err
+	}
+	for len(data) > 0 {
+		entry := data
+		if i := bytes.IndexByte(data, 0); i >= 0 {
+			entry, data = data[:i], data[i+1:]
+		} else {
+			data = nil
+		}
+		if v, ok := bytes.CutPrefix(entry, []byte(name)); ok && len(v) > 0 && v[0] == '=' {
+			return string(v[1:]), true, nil
+		}
+	}
+	return "", false, nil
+}
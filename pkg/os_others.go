@@ -0,0 +1,73 @@
+//go:build !linux && !darwin
+
+package pkg
+
+import (
+	"errors"
+	"strconv"
+	"strings"
+	"time"
+
+	"github.com/shirou/gopsutil/process"
+)
+
+// pidExists checks PID existence by signalling the pid, as there is no procfs to consult.
+func pidExists(pid int32) (bool, error) {
+	return signalPidExists(pid)
+}
+
+// readCmdline resolves the command line through gopsutil.
+func readCmdline(pid int32) (Cmdline, error) {
+	p, err := process.NewProcess(pid)
+	if err != nil {
+		return Cmdline{}, err
+	}
+	args, err := p.CmdlineSlice()
+	if err != nil {
+		return Cmdline{}, err
+	}
+	return Cmdline{Line: strings.Join(args, " "), Args: args}, nil
+}
+
+// processStartTime resolves the start time through gopsutil.
+func processStartTime(pid int32) (time.Time, error) {
+	p, err := process.NewProcess(pid)
+	if err != nil {
+		return time.Time{}, err
+	}
+	ms, err := p.CreateTime()
+	if err != nil {
+		return time.Time{}, err
+	}
+	return time.UnixMilli(ms), nil
+}
+
+// processStartId is the start time reported by gopsutil.
+func processStartId(pid int32) (string, error) {
+	start, err := processStartTime(pid)
+	if err != nil {
+		return "", err
+	}
+	return strconv.FormatInt(start.UnixMicro(), 10), nil
+}
+
+// processUid resolves the effective uid through gopsutil.
+func processUid(pid int32) (int, error) {
+	p, err := process.NewProcess(pid)
+	if err != nil {
+		return 0, err
+	}
+	uids, err := p.Uids()
+	if err != nil {
+		return 0, err
+	}
+	if len(uids) < 2 {
+		return 0, errors.New("effective uid not found")
+	}
+	return int(uids[1]), nil
+}
+
+// processEnv is not supported, gopsutil does not read the environment of other processes here.
+func processEnv(pid int32, name string) (string, bool, error) {
+	return "", false, errors.ErrUnsupported
+}
@@ -2,8 +2,12 @@ package pkg
 
 import (
 	"os"
+	"os/exec"
+	"strconv"
+	"strings"
 	"syscall"
 	"testing"
+	"time"
 )
 
 // TestPathExists tests the PathExists function for both existing and non-existing paths.
@@ -63,3 +67,97 @@ func TestPidExists(t *testing.T) {
 		t.Errorf("PidExists(%d) should return false for non-existent pid", nonExistPid)
 	}
 }
+
+// TestReadCmdline tests reading the command line of the current process.
+func TestReadCmdline(t *testing.T) {
+	cmdline, err := ReadCmdline(int32(os.Getpid()))
+	if err != nil {
+		t.Fatalf("ReadCmdline failed: %v", err)
+	}
+	if strings.Join(cmdline.Args, "\x00") != strings.Join(os.Args, "\x00") {
+		t.Errorf("expected args %q, got %q", os.Args, cmdline.Args)
+	}
+	if cmdline.Line != strings.Join(os.Args, " ") {
+		t.Errorf("expected line %q, got %q", strings.Join(os.Args, " "), cmdline.Line)
+	}
+
+	if _, err := ReadCmdline(0); err == nil {
+		t.Errorf("ReadCmdline(0) should return error")
+	}
+	if _, err := ReadCmdline(999999); err == nil {
+		t.Errorf("ReadCmdline(999999) should return error for non-existent pid")
+	}
+}
+
+// TestReadCmdline_Long tests reading a command line larger than the pooled buffer.
+func TestReadCmdline_Long(t *testing.T) {
+	args := []string{"-c", "sleep 5", "sh"}
+	for i := 0; i < 500; i++ {
+		args = append(args, "-Dproperty.number."+strconv.Itoa(i)+"=value")
+	}
+	cmd := exec.Command("/bin/sh", args...)
+	if err := cmd.Start(); err != nil {
+		t.Skip("failed to start shell:", err)
+	}
+	defer func() {
+		cmd.Process.Kill()
+		cmd.Wait()
+	}()
+
+	// Start returns before the child has exec'd, so wait for its new command line.
+	var cmdline Cmdline
+	var err error
+	for deadline := time.Now().Add(time.Second); time.Now().Before(deadline); time.Sleep(time.Millisecond) {
+		if cmdline, err = ReadCmdline(int32(cmd.Process.Pid)); err == nil && len(cmdline.Args) > 1 {
+			break
+		}
+	}
+	if err != nil {
+		t.Fatalf("ReadCmdline failed: %v", err)
+	}
+	if len(cmdline.Args) != len(args)+1 || cmdline.Args[len(args)] != args[len(args)-1] {
+		t.Errorf("expected %d args ending with %q, got %d", len(args)+1, args[len(args)-1], len(cmdline.Args))
+	}
+}
+
+// TestProcessStartTime tests reading the start time of the current process.
+func TestProcessStartTime(t *testing.T) {
+	start, err := ProcessStartTime(int32(os.Getpid()))
+	if err != nil {
+		t.Fatalf("ProcessStartTime failed: %v", err)
+	}
+	// The test binary was started moments ago; allow for tick granularity and clock skew.
+	if age := time.Since(start); age < -time.Second || age > time.Hour {
+		t.Errorf("unexpected start time %v (age %v)", start, age)
+	}
+	if _, err := ProcessStartTime(999999); err == nil {
+		t.Errorf("ProcessStartTime(999999) should return error for non-existent pid")
+	}
+}
+
+// TestProcessStartId tests that the start id of a process is stable.
+func TestProcessStartId(t *testing.T) {
+	id, err := ProcessStartId(int32(os.Getpid()))
+	if err != nil || id == "" {
+		t.Fatalf("ProcessStartId failed: %q %v", id, err)
+	}
+	if again, _ := ProcessStartId(int32(os.Getpid())); again != id {
+		t.Errorf("expected start id %q, got %q", id, again)
+	}
+	if _, err := ProcessStartId(999999); err == nil {
+		t.Errorf("ProcessStartId(999999) should return error for non-existent pid")
+	}
+}
+
+func TestProcessUid(t *testing.T) {
+	uid, err := ProcessUid(int32(os.Getpid()))
+	if err != nil {
+		t.Fatalf("ProcessUid failed: %v", err)
+	}
+	if uid != os.Geteuid() {
+		t.Errorf("expected uid %d, got %d", os.Geteuid(), uid)
+	}
+	if _, err := ProcessUid(999999); err == nil {
+		t.Errorf("ProcessUid(999999) should return error for non-existent pid")
+	}
+}
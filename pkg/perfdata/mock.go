@@ -0,0 +1,70 @@
+package perfdata
+
+import (
+	"encoding/binary"
+	"os"
+)
+
+// MockCounter describes a counter written by BuildMock.
+// A counter with a non-empty Text is written as a string, otherwise as a long.
+type MockCounter struct {
+	Name        string
+	Long        int64
+	Text        string
+	Units       Units
+	Variability Variability
+}
+
+// BuildMock lays out the given counters the way HotSpot does in an hsperfdata file.
+func BuildMock(order binary.ByteOrder, counters ...MockCounter) []byte {
+	buf := make([]byte, prologueSize)
+	binary.BigEndian.PutUint32(buf[0:4], Magic)
+	if order == binary.BigEndian {
+		buf[4] = byteOrderBig
+	} else {
+		buf[4] = byteOrderLittle
+	}
+	buf[5] = supportedMajorVersion
+	buf[6] = 0
+	buf[7] = 1 // accessible
+
+	for _, c := range counters {
+		nameEnd := entryHeaderSize + len(c.Name) + 1
+		dataOffset := align(nameEnd, 8)
+		dataType, vectorLength, size := byte(TypeLong), 0, 8
+		if c.Text != "" {
+			dataType, vectorLength, size = TypeByte, len(c.Text)+1, len(c.Text)+1
+		}
+		entryLength := align(dataOffset+size, 8)
+
+		entry := make([]byte, entryLength)
+		order.PutUint32(entry[0:], uint32(entryLength))
+		order.PutUint32(entry[4:], entryHeaderSize)
+		order.PutUint32(entry[8:], uint32(vectorLength))
+		entry[12] = dataType
+		entry[14] = byte(c.Units)
+		entry[15] = byte(c.Variability)
+		order.PutUint32(entry[16:], uint32(dataOffset))
+		copy(entry[entryHeaderSize:], c.Name)
+		if dataType == TypeLong {
+			order.PutUint64(entry[dataOffset:], uint64(c.Long))
+		} else {
+			copy(entry[dataOffset:], c.Text)
+		}
+		buf = append(buf, entry...)
+	}
+
+	order.PutUint32(buf[8:12], uint32(len(buf)))
+	order.PutUint32(buf[24:28], prologueSize)
+	order.PutUint32(buf[28:32], uint32(len(counters)))
+	return buf
+}
+
+// WriteMock writes a mock hsperfdata file with the given counters to path.
+func WriteMock(path string, counters ...MockCounter) error {
+	return os.WriteFile(path, BuildMock(binary.LittleEndian, counters...), 0644)
+}
+
+func align(n, a int) int {
+	return (n + a - 1) / a * a
+}
@@ -0,0 +1,336 @@
+// Package perfdata reads HotSpot hsperfdata files in place.
+//
+// A running HotSpot JVM publishes its jvmstat counters in a shared memory file
+// at <tmpdir>/hsperfdata_<user>/<pid>. The file is mapped read-only and the
+// entry table is indexed once at open; counter values are then read straight
+// from the mapping on every access, so sampling never copies or attaches.
+//
+// @see jdk/src/hotspot/share/runtime/perfMemory.hpp
+// @see sun.jvmstat.perfdata.monitor.v2_0.PerfDataBuffer
+package perfdata
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"syscall"
+)
+
+const (
+	// Magic is the big-endian magic number at the start of every hsperfdata file.
+	Magic = 0xcafec0c0
+
+	prologueSize    = 32
+	entryHeaderSize = 20
+
+	byteOrderBig    = 0
+	byteOrderLittle = 1
+
+	supportedMajorVersion = 2
+)
+
+// Data types of counter entries, as defined by the jvmstat BasicType chars.
+const (
+	TypeByte = 'B'
+	TypeLong = 'J'
+)
+
+// Units is the unit of measure of a counter.
+type Units byte
+
+const (
+	UnitsNone   Units = 1
+	UnitsBytes  Units = 2
+	UnitsTicks  Units = 3
+	UnitsEvents Units = 4
+	UnitsString Units = 5
+	UnitsHertz  Units = 6
+)
+
+// Variability tells whether a counter may change over the lifetime of the JVM.
+type Variability byte
+
+const (
+	VariabilityConstant  Variability = 1
+	VariabilityMonotonic Variability = 2
+	VariabilityVariable  Variability = 3
+)
+
+var (
+	// ErrNotFound is returned when a counter does not exist in the file.
+	ErrNotFound = errors.New("perfdata counter not found")
+	// ErrType is returned when a counter is read as the wrong type.
+	ErrType = errors.New("perfdata counter type mismatch")
+)
+
+// Counter describes a single entry of the perfdata entry table.
+// Its value is read from the backing buffer every time it is accessed.
+type Counter struct {
+	Name        string
+	Type        byte
+	Units       Units
+	Variability Variability
+
+	data   []byte
+	order  binary.ByteOrder
+	offset int
+	length int // vector length in elements, 0 for scalars
+}
+
+// IsLong reports whether the counter is a scalar long.
+func (c Counter) IsLong() bool {
+	return c.Type == TypeLong && c.length == 0
+}
+
+// IsString reports whether the counter is a byte vector holding a string.
+func (c Counter) IsString() bool {
+	return c.Type == TypeByte && c.length > 0
+}
+
+// Offset returns the position of the counter value within the backing buffer.
+func (c Counter) Offset() int {
+	return c.offset
+}
+
+// Long returns the current value of a long counter. It returns 0 for other types.
+func (c Counter) Long() int64 {
+	if !c.IsLong() {
+		return 0
+	}
+	return int64(c.order.Uint64(c.data[c.offset : c.offset+8]))
+}
+
+// Bytes returns the current value of a string counter as a slice of the backing
+// buffer, without the trailing NUL padding. The slice must not be retained
+// after the PerfData is closed.
+func (c Counter) Bytes() []byte {
+	if !c.IsString() {
+		return nil
+	}
+	b := c.data[c.offset : c.offset+c.length]
+	if end := bytes.IndexByte(b, 0); end >= 0 {
+		return b[:end]
+	}
+	return b
+}
+
+// Text returns a copy of the current value of the counter as a string.
+func (c Counter) Text() string {
+	if c.IsLong() {
+		return strconv.FormatInt(c.Long(), 10)
+	}
+	return string(c.Bytes())
+}
+
+// PerfData is an indexed view over the contents of an hsperfdata file.
+type PerfData struct {
+	data     []byte
+	mapped   bool
+	order    binary.ByteOrder
+	major    byte
+	minor    byte
+	counters []Counter
+	index    map[string]int
+}
+
+// Path returns the hsperfdata file path of the given user and pid.
+func Path(user string, pid int32) string {
+	return filepath.Join(os.TempDir(), "hsperfdata_"+user, strconv.Itoa(int(pid)))
+}
+
+// Open maps the hsperfdata file at path read-only and indexes its entries.
+// The caller must Close the returned PerfData to release the mapping.
+func Open(path string) (*PerfData, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	info, err := f.Stat()
+	if err != nil {
+		return nil, err
+	}
+	size := info.Size()
+	if size < prologueSize {
+		return nil, fmt.Errorf("perfdata file %s is too small: %d bytes", path, size)
+	}
+	data, err := syscall.Mmap(int(f.Fd()), 0, int(size), syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, fmt.Errorf("failed to mmap perfdata file %s: %v", path, err)
+	}
+	pd, err := Parse(data)
+	if err != nil {
+		syscall.Munmap(data)
+		return nil, err
+	}
+	pd.mapped = true
+	return pd, nil
+}
+
+// Parse indexes the perfdata entries held in data. The buffer is used in place
+// and must stay valid for as long as the returned PerfData is in use.
+func Parse(data []byte) (*PerfData, error) {
+	if len(data) < prologueSize {
+		return nil, fmt.Errorf("perfdata buffer is too small: %d bytes", len(data))
+	}
+	if magic := binary.BigEndian.Uint32(data[0:4]); magic != Magic {
+		return nil, fmt.Errorf("invalid perfdata magic: %#x", magic)
+	}
+	pd := &PerfData{data: data, major: data[5], minor: data[6]}
+	switch data[4] {
+	case byteOrderBig:
+		pd.order = binary.BigEndian
+	case byteOrderLittle:
+		pd.order = binary.LittleEndian
+	default:
+		return nil, fmt.Errorf("invalid perfdata byte order: %d", data[4])
+	}
+	if pd.major != supportedMajorVersion {
+		return nil, fmt.Errorf("unsupported perfdata version %d.%d", pd.major, pd.minor)
+	}
+	if data[7] == 0 {
+		return nil, errors.New("perfdata is not accessible yet")
+	}
+
+	entryOffset := int(int32(pd.order.Uint32(data[24:28])))
+	numEntries := int(int32(pd.order.Uint32(data[28:32])))
+	if numEntries < 0 || entryOffset < prologueSize || entryOffset > len(data) {
+		return nil, fmt.Errorf("invalid perfdata entry table: offset %d, entries %d", entryOffset, numEntries)
+	}
+
+	pd.counters = make([]Counter, 0, numEntries)
+	pd.index = make(map[string]int, numEntries)
+	offset := entryOffset
+	for i := 0; i < numEntries; i++ {
+		c, length, err := pd.parseEntry(offset)
+		if err != nil {
+			return nil, fmt.Errorf("invalid perfdata entry %d: %v", i, err)
+		}
+		pd.index[c.Name] = len(pd.counters)
+		pd.counters = append(pd.counters, c)
+		offset += length
+	}
+	return pd, nil
+}
+
+// parseEntry decodes the entry header at offset and returns the counter and the entry length.
+func (pd *PerfData) parseEntry(offset int) (Counter, int, error) {
+	data := pd.data
+	if offset < 0 || offset+entryHeaderSize > len(data) {
+		return Counter{}, 0, fmt.Errorf("header out of bounds at %d", offset)
+	}
+	entryLength := int(int32(pd.order.Uint32(data[offset:])))
+	nameOffset := int(int32(pd.order.Uint32(data[offset+4:])))
+	vectorLength := int(int32(pd.order.Uint32(data[offset+8:])))
+	dataOffset := int(int32(pd.order.Uint32(data[offset+16:])))
+	if entryLength < entryHeaderSize || offset+entryLength > len(data) {
+		return Counter{}, 0, fmt.Errorf("bad entry length %d at %d", entryLength, offset)
+	}
+	if vectorLength < 0 || nameOffset < entryHeaderSize || nameOffset >= entryLength || dataOffset < nameOffset || dataOffset > entryLength {
+		return Counter{}, 0, fmt.Errorf("bad entry layout at %d", offset)
+	}
+
+	nameBytes := data[offset+nameOffset : offset+dataOffset]
+	if end := bytes.IndexByte(nameBytes, 0); end >= 0 {
+		nameBytes = nameBytes[:end]
+	}
+	c := Counter{
+		Name:        string(nameBytes),
+		Type:        data[offset+12],
+		Units:       Units(data[offset+14]),
+		Variability: Variability(data[offset+15]),
+		data:        data,
+		order:       pd.order,
+		offset:      offset + dataOffset,
+		length:      vectorLength,
+	}
+	size := vectorLength
+	if c.IsLong() {
+		size = 8
+	}
+	if c.offset+size > offset+entryLength {
+		return Counter{}, 0, fmt.Errorf("value of %s out of bounds", c.Name)
+	}
+	return c, entryLength, nil
+}
+
+// Close releases the mapping of the perfdata file.
+// Counters obtained from this PerfData must not be used afterwards.
+func (pd *PerfData) Close() error {
+	if pd.data == nil {
+		return nil
+	}
+	var err error
+	if pd.mapped {
+		err = syscall.Munmap(pd.data)
+	}
+	pd.data = nil
+	pd.counters = nil
+	pd.index = nil
+	return err
+}
+
+// Version returns the major and minor version of the perfdata layout.
+func (pd *PerfData) Version() (major, minor byte) {
+	return pd.major, pd.minor
+}
+
+// ModTimeStamp returns the modification time stamp of the buffer in hrt ticks.
+func (pd *PerfData) ModTimeStamp() int64 {
+	return int64(pd.order.Uint64(pd.data[16:24]))
+}
+
+// Counters returns all indexed counters in entry table order.
+func (pd *PerfData) Counters() []Counter {
+	return pd.counters
+}
+
+// Lookup returns the counter with the given name.
+func (pd *PerfData) Lookup(name string) (Counter, bool) {
+	i, ok := pd.index[name]
+	if !ok {
+		return Counter{}, false
+	}
+	return pd.counters[i], true
+}
+
+// Prefix returns all counters whose name starts with prefix, e.g. "sun.gc.".
+func (pd *PerfData) Prefix(prefix string) []Counter {
+	var found []Counter
+	for _, c := range pd.counters {
+		if strings.HasPrefix(c.Name, prefix) {
+			found = append(found, c)
+		}
+	}
+	return found
+}
+
+// Long returns the current value of the named long counter.
+func (pd *PerfData) Long(name string) (int64, error) {
+	c, ok := pd.Lookup(name)
+	if !ok {
+		return 0, fmt.Errorf("%w: %s", ErrNotFound, name)
+	}
+	if !c.IsLong() {
+		return 0, fmt.Errorf("%w: %s is not a long", ErrType, name)
+	}
+	return c.Long(), nil
+}
+
+// String returns the current value of the named string counter.
+func (pd *PerfData) String(name string) (string, error) {
+	c, ok := pd.Lookup(name)
+	if !ok {
+		return "", fmt.Errorf("%w: %s", ErrNotFound, name)
+	}
+	if !c.IsString() {
+		return "", fmt.Errorf("%w: %s is not a string", ErrType, name)
+	}
+	return string(c.Bytes()), nil
+}
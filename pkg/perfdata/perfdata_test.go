@@ -0,0 +1,106 @@
+package perfdata
+
+import (
+	"encoding/binary"
+	"errors"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+var testCounters = []MockCounter{
+	{Name: "sun.rt.createVmBeginTime", Long: 1700000000000, Units: UnitsTicks, Variability: VariabilityConstant},
+	{Name: "sun.gc.collector.0.invocations", Long: 12, Units: UnitsEvents, Variability: VariabilityMonotonic},
+	{Name: "sun.gc.collector.1.invocations", Long: 3, Units: UnitsEvents, Variability: VariabilityMonotonic},
+	{Name: "sun.rt.javaCommand", Text: "TestMain foo", Units: UnitsString, Variability: VariabilityConstant},
+}
+
+// TestParse tests parsing a buffer in both byte orders.
+func TestParse(t *testing.T) {
+	for _, order := range []binary.ByteOrder{binary.LittleEndian, binary.BigEndian} {
+		t.Run(order.String(), func(t *testing.T) {
+			pd, err := Parse(BuildMock(order, testCounters...))
+			if err != nil {
+				t.Fatalf("Parse failed: %v", err)
+			}
+			if major, _ := pd.Version(); major != 2 {
+				t.Errorf("expected major version 2, got %d", major)
+			}
+			if len(pd.Counters()) != len(testCounters) {
+				t.Fatalf("expected %d counters, got %d", len(testCounters), len(pd.Counters()))
+			}
+			if v, err := pd.Long("sun.gc.collector.0.invocations"); err != nil || v != 12 {
+				t.Errorf("expected 12, got %d, %v", v, err)
+			}
+			if v, err := pd.String("sun.rt.javaCommand"); err != nil || v != "TestMain foo" {
+				t.Errorf("expected 'TestMain foo', got '%s', %v", v, err)
+			}
+			c, ok := pd.Lookup("sun.gc.collector.1.invocations")
+			if !ok || c.Units != UnitsEvents || c.Variability != VariabilityMonotonic {
+				t.Errorf("unexpected counter metadata: %+v", c)
+			}
+			if got := len(pd.Prefix("sun.gc.")); got != 2 {
+				t.Errorf("expected 2 sun.gc counters, got %d", got)
+			}
+		})
+	}
+}
+
+// TestParse_Errors tests the typed lookup errors and malformed buffers.
+func TestParse_Errors(t *testing.T) {
+	pd, err := Parse(BuildMock(binary.LittleEndian, testCounters...))
+	if err != nil {
+		t.Fatalf("Parse failed: %v", err)
+	}
+	if _, err := pd.Long("sun.gc.none"); !errors.Is(err, ErrNotFound) {
+		t.Errorf("expected ErrNotFound, got %v", err)
+	}
+	if _, err := pd.Long("sun.rt.javaCommand"); !errors.Is(err, ErrType) {
+		t.Errorf("expected ErrType, got %v", err)
+	}
+
+	if _, err := Parse([]byte{0xca, 0xfe}); err == nil {
+		t.Errorf("expected error for short buffer")
+	}
+	bad := BuildMock(binary.LittleEndian, testCounters...)
+	bad[0] = 0
+	if _, err := Parse(bad); err == nil {
+		t.Errorf("expected error for bad magic")
+	}
+	truncated := BuildMock(binary.LittleEndian, testCounters...)
+	if _, err := Parse(truncated[:len(truncated)-8]); err == nil {
+		t.Errorf("expected error for truncated entry table")
+	}
+}
+
+// TestOpen tests mapping a file and observing updates to it in place.
+func TestOpen(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "12345")
+	if err := WriteMock(path, testCounters...); err != nil {
+		t.Fatalf("failed to write mock perfdata: %v", err)
+	}
+	pd, err := Open(path)
+	if err != nil {
+		t.Fatalf("Open failed: %v", err)
+	}
+	defer pd.Close()
+
+	c, _ := pd.Lookup("sun.gc.collector.0.invocations")
+	f, err := os.OpenFile(path, os.O_WRONLY, 0)
+	if err != nil {
+		t.Fatalf("failed to open mock perfdata: %v", err)
+	}
+	value := make([]byte, 8)
+	binary.LittleEndian.PutUint64(value, 13)
+	if _, err := f.WriteAt(value, int64(c.Offset())); err != nil {
+		t.Fatalf("failed to update mock perfdata: %v", err)
+	}
+	f.Close()
+	if c.Long() != 13 {
+		t.Errorf("expected mapped counter to read 13, got %d", c.Long())
+	}
+
+	if _, err := Open(filepath.Join(t.TempDir(), "missing")); err == nil {
+		t.Errorf("expected error for missing file")
+	}
+}
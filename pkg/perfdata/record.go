@@ -0,0 +1,443 @@
+package perfdata
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"time"
+)
+
+// A recording holds the long counters of one JVM sampled over time.
+//
+// The header is the magic, the pid, the wall clock time of the first sample and a
+// dictionary of the counters: constants with their value, then the columns. Samples
+// follow in blocks of up to RecordBlockSamples. A block is its sample count, the
+// size of every column and the columns one after another: first the sample times
+// in milliseconds since the start, then each counter in dictionary order.
+//
+// A column holds the deltas of its values, or the deltas of those deltas, whichever
+// is smaller for the block; the lowest bit of its size tells which. Deltas are taken
+// across blocks. Each delta is an uvarint token: odd tokens are runs of token>>1 zero
+// deltas, even tokens the zigzag encoded delta shifted left by one, and a zero token
+// an escape for a delta too large for that, followed by its varint. Counters that
+// rarely change thus cost a few bytes per block, and steadily growing ones such as
+// the clock ticks little more than their jitter.
+//
+// The hrt clock of the JVM is not a column: it advances with the sample times, and
+// its nanosecond jitter alone would cost more than every other column of a busy
+// JVM. It is kept among the constants with its value at the start and a monotonic
+// variability, and derived from the sample times at millisecond resolution, see
+// RecordHeader.Ticks.
+
+// RecordMagic starts every recording.
+const RecordMagic = "JVMREC\x02"
+
+// The counters of the hrt clock, see RecordHeader.Ticks.
+const (
+	recordTicks     = "sun.os.hrt.ticks"
+	recordFrequency = "sun.os.hrt.frequency"
+)
+
+// RecordBlockSamples is the number of samples per block, the most lost when a
+// recorder is killed.
+const RecordBlockSamples = 600
+
+// RecordCounter is an entry of the counter dictionary of a recording.
+type RecordCounter struct {
+	Name        string
+	Units       Units
+	Variability Variability
+	Value       int64 // the value of a constant counter
+}
+
+// RecordHeader describes a recording.
+type RecordHeader struct {
+	Pid       int32
+	Start     time.Time
+	Constants []RecordCounter // counters that never change, with their value
+	Columns   []RecordCounter // counters recorded with every sample
+}
+
+// NewRecordHeader builds the header recording every long counter of pd, read at
+// start. The names of the columns are returned for NewSampler.
+func NewRecordHeader(pd *PerfData, pid int32, start time.Time) (RecordHeader, []string) {
+	h := RecordHeader{Pid: pid, Start: start}
+	var names []string
+	counters := pd.Counters()
+	clock := false
+	for _, c := range counters {
+		clock = clock || c.Name == recordFrequency && c.IsLong() && c.Variability == VariabilityConstant
+	}
+	for _, c := range counters {
+		if !c.IsLong() {
+			continue
+		}
+		rc := RecordCounter{Name: c.Name, Units: c.Units, Variability: c.Variability}
+		if c.Variability == VariabilityConstant || clock && c.Name == recordTicks {
+			rc.Value = c.Long()
+			h.Constants = append(h.Constants, rc)
+			continue
+		}
+		h.Columns = append(h.Columns, rc)
+		names = append(names, c.Name)
+	}
+	return h, names
+}
+
+// Ticks returns the hrt clock of the JVM at the sample time t, if it is derived
+// from the sample times rather than recorded.
+func (h *RecordHeader) Ticks(t time.Time) (int64, bool) {
+	var ticks, frequency *RecordCounter
+	for i := range h.Constants {
+		switch c := &h.Constants[i]; c.Name {
+		case recordTicks:
+			ticks = c
+		case recordFrequency:
+			frequency = c
+		}
+	}
+	if ticks == nil || ticks.Variability == VariabilityConstant || frequency == nil {
+		return 0, false
+	}
+	ms := t.Sub(h.Start).Milliseconds()
+	return ticks.Value + ms/1000*frequency.Value + ms%1000*frequency.Value/1000, true
+}
+
+// Lookup returns the value of the constant counter name, or the column index of a
+// recorded one. It reports false if the recording has no such counter.
+func (h *RecordHeader) Lookup(name string) (value int64, column int, ok bool) {
+	for _, c := range h.Constants {
+		if c.Name == name {
+			return c.Value, -1, true
+		}
+	}
+	for i, c := range h.Columns {
+		if c.Name == name {
+			return 0, i, true
+		}
+	}
+	return 0, -1, false
+}
+
+// deltaStream encodes a stream of deltas, collapsing runs of zeros.
+type deltaStream struct {
+	zeros uint64
+	buf   []byte
+}
+
+func (s *deltaStream) add(d int64) {
+	if d == 0 {
+		s.zeros++
+		return
+	}
+	s.flush()
+	if z := uint64(d<<1) ^ uint64(d>>63); z < 1<<63 {
+		s.buf = binary.AppendUvarint(s.buf, z<<1)
+	} else {
+		s.buf = binary.AppendUvarint(s.buf, 0)
+		s.buf = binary.AppendVarint(s.buf, d)
+	}
+}
+
+// flush writes the pending run of zero deltas.
+func (s *deltaStream) flush() {
+	if s.zeros > 0 {
+		s.buf = binary.AppendUvarint(s.buf, s.zeros<<1|1)
+		s.zeros = 0
+	}
+}
+
+// columnEncoder encodes one column of a block both ways, see block.
+type columnEncoder struct {
+	prev, prevDelta int64
+	first, second   deltaStream // the deltas and the deltas of the deltas
+}
+
+func (e *columnEncoder) add(v int64) {
+	d := v - e.prev
+	e.first.add(d)
+	e.second.add(d - e.prevDelta)
+	e.prev, e.prevDelta = v, d
+}
+
+// block returns the smaller encoding of the block and whether it holds the deltas
+// of the deltas. The encoders are reset for the next block by reset.
+func (e *columnEncoder) block() ([]byte, bool) {
+	e.first.flush()
+	e.second.flush()
+	if len(e.second.buf) < len(e.first.buf) {
+		return e.second.buf, true
+	}
+	return e.first.buf, false
+}
+
+func (e *columnEncoder) reset() {
+	e.first.buf, e.second.buf = e.first.buf[:0], e.second.buf[:0]
+}
+
+// Recorder writes a recording. It is not safe for concurrent use.
+type Recorder struct {
+	w       *bufio.Writer
+	start   time.Time
+	width   int
+	n       int
+	columns []columnEncoder // the sample times followed by the counters
+	scratch []byte
+}
+
+// NewRecorder writes the header h to w and returns a recorder for its samples.
+func NewRecorder(w io.Writer, h RecordHeader) (*Recorder, error) {
+	buf := []byte(RecordMagic)
+	buf = binary.AppendUvarint(buf, uint64(h.Pid))
+	buf = binary.AppendVarint(buf, h.Start.UnixNano())
+	buf = binary.AppendUvarint(buf, uint64(len(h.Constants)))
+	for _, c := range h.Constants {
+		buf = appendRecordCounter(buf, c)
+		buf = binary.AppendVarint(buf, c.Value)
+	}
+	buf = binary.AppendUvarint(buf, uint64(len(h.Columns)))
+	for _, c := range h.Columns {
+		buf = appendRecordCounter(buf, c)
+	}
+	r := &Recorder{w: bufio.NewWriter(w), start: h.Start, width: len(h.Columns), columns: make([]columnEncoder, 1+len(h.Columns))}
+	if _, err := r.w.Write(buf); err != nil {
+		return nil, err
+	}
+	return r, r.w.Flush()
+}
+
+func appendRecordCounter(buf []byte, c RecordCounter) []byte {
+	buf = binary.AppendUvarint(buf, uint64(len(c.Name)))
+	buf = append(buf, c.Name...)
+	return append(buf, byte(c.Units), byte(c.Variability))
+}
+
+// Record adds a sample taken at t, with one value per column. A full block is
+// written out.
+func (r *Recorder) Record(t time.Time, values []int64) error {
+	if len(values) != r.width {
+		return fmt.Errorf("recording has %d columns, got %d values", r.width, len(values))
+	}
+	r.columns[0].add(t.Sub(r.start).Milliseconds())
+	for i, v := range values {
+		r.columns[1+i].add(v)
+	}
+	if r.n++; r.n == RecordBlockSamples {
+		return r.Flush()
+	}
+	return nil
+}
+
+// Flush writes out the samples recorded since the last block.
+func (r *Recorder) Flush() error {
+	if r.n == 0 {
+		return r.w.Flush()
+	}
+	r.scratch = binary.AppendUvarint(r.scratch[:0], uint64(r.n))
+	for i := range r.columns {
+		buf, second := r.columns[i].block()
+		size := uint64(len(buf)) << 1
+		if second {
+			size |= 1
+		}
+		r.scratch = binary.AppendUvarint(r.scratch, size)
+	}
+	r.w.Write(r.scratch)
+	for i := range r.columns {
+		buf, _ := r.columns[i].block()
+		r.w.Write(buf)
+		r.columns[i].reset()
+	}
+	r.n = 0
+	return r.w.Flush()
+}
+
+// ErrRecordFormat is returned for data that is not a valid recording.
+var ErrRecordFormat = errors.New("invalid perfdata recording")
+
+// columnDecoder reads one column of a block.
+type columnDecoder struct {
+	prev, prevDelta int64
+	zeros           uint64
+	second          bool // the block holds the deltas of the deltas
+	buf             []byte
+}
+
+func (d *columnDecoder) next() (int64, error) {
+	x, err := d.delta()
+	if err != nil {
+		return 0, err
+	}
+	if d.second {
+		x += d.prevDelta
+	}
+	d.prev += x
+	d.prevDelta = x
+	return d.prev, nil
+}
+
+// delta reads the next delta of the stream.
+func (d *columnDecoder) delta() (int64, error) {
+	if d.zeros > 0 {
+		d.zeros--
+		return 0, nil
+	}
+	token, n := binary.Uvarint(d.buf)
+	if n <= 0 {
+		return 0, ErrRecordFormat
+	}
+	d.buf = d.buf[n:]
+	switch {
+	case token&1 == 1:
+		if d.zeros = token >> 1; d.zeros == 0 {
+			return 0, ErrRecordFormat
+		}
+		d.zeros--
+		return 0, nil
+	case token == 0:
+		delta, n := binary.Varint(d.buf)
+		if n <= 0 {
+			return 0, ErrRecordFormat
+		}
+		d.buf = d.buf[n:]
+		return delta, nil
+	}
+	z := token >> 1
+	return int64(z>>1) ^ -int64(z&1), nil
+}
+
+// RecordReader reads the samples of a recording in order.
+type RecordReader struct {
+	r       *bufio.Reader
+	header  RecordHeader
+	left    int // samples left in the current block
+	block   []byte
+	columns []columnDecoder // the sample times followed by the counters
+}
+
+// NewRecordReader reads the header of the recording in r.
+func NewRecordReader(r io.Reader) (*RecordReader, error) {
+	rr := &RecordReader{r: bufio.NewReader(r)}
+	magic := make([]byte, len(RecordMagic))
+	if _, err := io.ReadFull(rr.r, magic); err != nil || string(magic) != RecordMagic {
+		return nil, ErrRecordFormat
+	}
+	pid, err := binary.ReadUvarint(rr.r)
+	if err != nil {
+		return nil, ErrRecordFormat
+	}
+	start, err := binary.ReadVarint(rr.r)
+	if err != nil {
+		return nil, ErrRecordFormat
+	}
+	rr.header = RecordHeader{Pid: int32(pid), Start: time.Unix(0, start)}
+	if rr.header.Constants, err = rr.readCounters(true); err != nil {
+		return nil, err
+	}
+	if rr.header.Columns, err = rr.readCounters(false); err != nil {
+		return nil, err
+	}
+	rr.columns = make([]columnDecoder, 1+len(rr.header.Columns))
+	return rr, nil
+}
+
+// maxRecordCounters bounds the dictionary, HotSpot publishes a few hundred counters.
+const maxRecordCounters = 1 << 16
+
+func (rr *RecordReader) readCounters(constants bool) ([]RecordCounter, error) {
+	n, err := binary.ReadUvarint(rr.r)
+	if err != nil || n > maxRecordCounters {
+		return nil, ErrRecordFormat
+	}
+	counters := make([]RecordCounter, n)
+	for i := range counters {
+		size, err := binary.ReadUvarint(rr.r)
+		if err != nil || size > 1<<10 {
+			return nil, ErrRecordFormat
+		}
+		name := make([]byte, size+2)
+		if _, err := io.ReadFull(rr.r, name); err != nil {
+			return nil, ErrRecordFormat
+		}
+		c := &counters[i]
+		c.Name, c.Units, c.Variability = string(name[:size]), Units(name[size]), Variability(name[size+1])
+		if constants {
+			if c.Value, err = binary.ReadVarint(rr.r); err != nil {
+				return nil, ErrRecordFormat
+			}
+		}
+	}
+	return counters, nil
+}
+
+// Header returns the header of the recording.
+func (rr *RecordReader) Header() RecordHeader {
+	return rr.header
+}
+
+// maxRecordBlock bounds the size of a block, about 10 bytes per value of a full block.
+const maxRecordBlock = 10 * RecordBlockSamples * (maxRecordCounters + 1)
+
+// Next reads the next sample into dst, which must hold one value per column, and
+// returns the time it was taken. It returns io.EOF after the last sample.
+func (rr *RecordReader) Next(dst []int64) (time.Time, error) {
+	if len(dst) != len(rr.header.Columns) {
+		return time.Time{}, fmt.Errorf("recording has %d columns, got room for %d values", len(rr.header.Columns), len(dst))
+	}
+	if rr.left == 0 {
+		if err := rr.readBlock(); err != nil {
+			return time.Time{}, err
+		}
+	}
+	rr.left--
+	ms, err := rr.columns[0].next()
+	if err != nil {
+		return time.Time{}, err
+	}
+	for i := range dst {
+		if dst[i], err = rr.columns[1+i].next(); err != nil {
+			return time.Time{}, err
+		}
+	}
+	return rr.header.Start.Add(time.Duration(ms) * time.Millisecond), nil
+}
+
+// readBlock reads the next block and points the column decoders into it.
+func (rr *RecordReader) readBlock() error {
+	n, err := binary.ReadUvarint(rr.r)
+	if err == io.EOF {
+		return io.EOF
+	}
+	if err != nil || n == 0 || n > RecordBlockSamples {
+		return ErrRecordFormat
+	}
+	sizes := make([]uint64, len(rr.columns))
+	total := uint64(0)
+	for i := range sizes {
+		size, err := binary.ReadUvarint(rr.r)
+		if err != nil {
+			return ErrRecordFormat
+		}
+		rr.columns[i].second, sizes[i] = size&1 == 1, size>>1
+		if total += sizes[i]; total > maxRecordBlock {
+			return ErrRecordFormat
+		}
+	}
+	if uint64(cap(rr.block)) < total {
+		rr.block = make([]byte, total)
+	}
+	block := rr.block[:total]
+	if _, err := io.ReadFull(rr.r, block); err != nil {
+		return ErrRecordFormat
+	}
+	for i := range rr.columns {
+		if rr.columns[i].zeros != 0 {
+			return ErrRecordFormat
+		}
+		rr.columns[i].buf, block = block[:sizes[i]], block[sizes[i]:]
+	}
+	rr.left = int(n)
+	return nil
+}
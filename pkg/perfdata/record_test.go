@@ -0,0 +1,191 @@
+package perfdata
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"io"
+	"math"
+	"math/rand"
+	"testing"
+	"time"
+)
+
+var testRecordHeader = RecordHeader{
+	Pid:   42,
+	Start: time.Unix(1700000000, 123000),
+	Constants: []RecordCounter{
+		{Name: "sun.os.hrt.frequency", Units: UnitsHertz, Variability: VariabilityConstant, Value: 1_000_000_000},
+	},
+	Columns: []RecordCounter{
+		{Name: "sun.os.hrt.ticks", Units: UnitsTicks, Variability: VariabilityMonotonic},
+		{Name: "sun.gc.generation.0.space.0.used", Units: UnitsBytes, Variability: VariabilityVariable},
+		{Name: "sun.gc.collector.0.invocations", Units: UnitsEvents, Variability: VariabilityMonotonic},
+	},
+}
+
+// TestRecorder tests that samples read back as recorded, across blocks and for extreme deltas.
+func TestRecorder(t *testing.T) {
+	var buf bytes.Buffer
+	rec, err := NewRecorder(&buf, testRecordHeader)
+	if err != nil {
+		t.Fatalf("NewRecorder failed: %v", err)
+	}
+	type sample struct {
+		t      time.Time
+		values []int64
+	}
+	var samples []sample
+	extremes := []int64{math.MinInt64, math.MaxInt64, 0, -1, 1 << 62, -(1 << 62)}
+	for i := 0; i < 2*RecordBlockSamples+17; i++ {
+		s := sample{
+			t:      testRecordHeader.Start.Add(time.Duration(i)*100*time.Millisecond + time.Duration(rand.Intn(1000))*time.Microsecond),
+			values: []int64{int64(i) * 100_000_000, int64(rand.Intn(1 << 30)), int64(i / 50)},
+		}
+		if i < len(extremes) {
+			s.values[1] = extremes[i]
+		}
+		samples = append(samples, s)
+		if err := rec.Record(s.t, s.values); err != nil {
+			t.Fatalf("Record failed: %v", err)
+		}
+	}
+	if err := rec.Flush(); err != nil {
+		t.Fatalf("Flush failed: %v", err)
+	}
+	if err := rec.Record(time.Now(), []int64{1}); err == nil {
+		t.Error("expected a sample of the wrong width to be rejected")
+	}
+
+	rr, err := NewRecordReader(&buf)
+	if err != nil {
+		t.Fatalf("NewRecordReader failed: %v", err)
+	}
+	h := rr.Header()
+	if h.Pid != 42 || !h.Start.Equal(testRecordHeader.Start) || len(h.Constants) != 1 || len(h.Columns) != 3 || h.Columns[1] != testRecordHeader.Columns[1] {
+		t.Errorf("expected header %+v, got %+v", testRecordHeader, h)
+	}
+	if v, column, ok := h.Lookup("sun.os.hrt.frequency"); !ok || column != -1 || v != 1_000_000_000 {
+		t.Errorf("expected the constant frequency, got %d %d %v", v, column, ok)
+	}
+	if _, column, ok := h.Lookup("sun.gc.collector.0.invocations"); !ok || column != 2 {
+		t.Errorf("expected column 2, got %d %v", column, ok)
+	}
+	values := make([]int64, 3)
+	for i, s := range samples {
+		got, err := rr.Next(values)
+		if err != nil {
+			t.Fatalf("sample %d: Next failed: %v", i, err)
+		}
+		if d := s.t.Sub(got); d < 0 || d >= time.Millisecond {
+			t.Fatalf("sample %d: expected time %v, got %v", i, s.t, got)
+		}
+		for j := range values {
+			if values[j] != s.values[j] {
+				t.Fatalf("sample %d: expected %v, got %v", i, s.values, values)
+			}
+		}
+	}
+	if _, err := rr.Next(values); err != io.EOF {
+		t.Errorf("expected io.EOF after the last sample, got %v", err)
+	}
+}
+
+// TestNewRecordHeader tests that constants are kept apart and the clock is derived from the sample times.
+func TestNewRecordHeader(t *testing.T) {
+	pd, err := Parse(BuildMock(binary.LittleEndian,
+		MockCounter{Name: "sun.os.hrt.ticks", Long: 5_000_000_000, Units: UnitsTicks, Variability: VariabilityMonotonic},
+		MockCounter{Name: "sun.os.hrt.frequency", Long: 1_000_000_000, Units: UnitsHertz, Variability: VariabilityConstant},
+		MockCounter{Name: "sun.gc.collector.0.invocations", Long: 7, Units: UnitsEvents, Variability: VariabilityMonotonic},
+		MockCounter{Name: "java.property.java.vm.name", Text: "OpenJDK", Variability: VariabilityConstant},
+	))
+	if err != nil {
+		t.Fatalf("Parse failed: %v", err)
+	}
+	start := time.Unix(1700000000, 0)
+	h, names := NewRecordHeader(pd, 42, start)
+	if len(names) != 1 || names[0] != "sun.gc.collector.0.invocations" || len(h.Columns) != 1 || len(h.Constants) != 2 {
+		t.Fatalf("expected the invocations as the only column, got %+v %v", h, names)
+	}
+	if ticks, ok := h.Ticks(start.Add(2500 * time.Millisecond)); !ok || ticks != 7_500_000_000 {
+		t.Errorf("expected ticks 7500000000, got %d %v", ticks, ok)
+	}
+	if _, ok := testRecordHeader.Ticks(start); ok {
+		t.Error("expected the ticks of a recorded clock not to be derived")
+	}
+}
+
+// TestRecorder_Size tests that a busy JVM sampled every 100ms records in a few MB a day.
+func TestRecorder_Size(t *testing.T) {
+	var buf bytes.Buffer
+	h := RecordHeader{Start: time.Unix(0, 0)}
+	// The clock is derived from the sample times, see NewRecordHeader.
+	for _, name := range []string{"eden.used", "eden.capacity", "old.used", "old.capacity", "young.count", "young.time", "full.count", "full.time"} {
+		h.Columns = append(h.Columns, RecordCounter{Name: name})
+	}
+	for i := 0; i < 200; i++ {
+		h.Columns = append(h.Columns, RecordCounter{Name: "idle"})
+	}
+	rec, _ := NewRecorder(&buf, h)
+	values := make([]int64, len(h.Columns))
+	const hour = 36000
+	eden, old, young := int64(0), int64(1<<28), int64(0)
+	for i := 0; i < hour; i++ {
+		// Allocating 10-20MB/s with a young GC every 5s and a jittering clock.
+		eden += int64(1<<20 + rand.Intn(1<<20))
+		if eden > 64<<20 {
+			eden, old, young = 0, old+int64(rand.Intn(1<<20)), young+1
+		}
+		copy(values, []int64{eden, 64 << 20, old, 1 << 30, young, young * 3_000_000, 0, 0})
+		rec.Record(h.Start.Add(time.Duration(i)*100*time.Millisecond+time.Duration(rand.Intn(2000))*time.Microsecond), values)
+	}
+	rec.Flush()
+	perDay := buf.Len() * 24
+	t.Logf("%d bytes per hour, %.1f MB per day", buf.Len(), float64(perDay)/(1<<20))
+	if perDay > 5<<20 {
+		t.Errorf("expected less than 5MB per day, got %d bytes", perDay)
+	}
+}
+
+// TestNewRecordReader_Errors tests that other and truncated data is rejected.
+func TestNewRecordReader_Errors(t *testing.T) {
+	var buf bytes.Buffer
+	rec, _ := NewRecorder(&buf, testRecordHeader)
+	rec.Record(testRecordHeader.Start, []int64{1, 2, 3})
+	rec.Flush()
+	data := buf.Bytes()
+
+	if _, err := NewRecordReader(bytes.NewReader([]byte("not a recording"))); !errors.Is(err, ErrRecordFormat) {
+		t.Errorf("expected ErrRecordFormat, got %v", err)
+	}
+	rr, err := NewRecordReader(bytes.NewReader(data[:len(data)-1]))
+	if err != nil {
+		t.Fatalf("expected the header to be read, got %v", err)
+	}
+	if _, err := rr.Next(make([]int64, 3)); !errors.Is(err, ErrRecordFormat) {
+		t.Errorf("expected ErrRecordFormat for a truncated block, got %v", err)
+	}
+}
+
+// FuzzRecordReader checks that arbitrary data never makes the reader panic.
+func FuzzRecordReader(f *testing.F) {
+	var buf bytes.Buffer
+	rec, _ := NewRecorder(&buf, testRecordHeader)
+	for i := int64(0); i < 10; i++ {
+		rec.Record(testRecordHeader.Start.Add(time.Duration(i)*time.Second), []int64{i, i * i, 0})
+	}
+	rec.Flush()
+	f.Add(buf.Bytes())
+	f.Fuzz(func(t *testing.T, data []byte) {
+		rr, err := NewRecordReader(bytes.NewReader(data))
+		if err != nil {
+			return
+		}
+		values := make([]int64, len(rr.Header().Columns))
+		for i := 0; i < 10*RecordBlockSamples; i++ {
+			if _, err := rr.Next(values); err != nil {
+				return
+			}
+		}
+	})
+}
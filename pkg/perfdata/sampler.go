@@ -0,0 +1,114 @@
+package perfdata
+
+import "sync/atomic"
+
+// Sampler reads a fixed set of long counters whose offsets were resolved once.
+type Sampler struct {
+	counters []Counter
+	present  []bool
+}
+
+// NewSampler resolves the named long counters of pd. Counters that do not exist
+// or are not longs are reported as absent by Has and always sample as 0.
+func NewSampler(pd *PerfData, names []string) *Sampler {
+	s := &Sampler{
+		counters: make([]Counter, len(names)),
+		present:  make([]bool, len(names)),
+	}
+	for i, name := range names {
+		if c, ok := pd.Lookup(name); ok && c.IsLong() {
+			s.counters[i] = c
+			s.present[i] = true
+		}
+	}
+	return s
+}
+
+// Len returns the number of counters sampled.
+func (s *Sampler) Len() int {
+	return len(s.counters)
+}
+
+// Has reports whether the i-th counter exists in the perfdata file.
+func (s *Sampler) Has(i int) bool {
+	return s.present[i]
+}
+
+// Sample writes the current counter values into dst, which must hold Len values.
+func (s *Sampler) Sample(dst []int64) {
+	for i := range s.counters {
+		if s.present[i] {
+			dst[i] = s.counters[i].Long()
+		} else {
+			dst[i] = 0
+		}
+	}
+}
+
+// Ring is a preallocated single-producer, single-consumer ring of samples.
+// The producer never blocks or allocates; a consumer that falls more than
+// Cap samples behind loses the overwritten ones.
+type Ring struct {
+	width  int
+	times  []int64
+	values []int64
+	head   atomic.Uint64
+}
+
+// NewRing allocates a ring holding capacity samples of width values each.
+func NewRing(capacity, width int) *Ring {
+	if capacity < 1 {
+		capacity = 1
+	}
+	return &Ring{
+		width:  width,
+		times:  make([]int64, capacity),
+		values: make([]int64, capacity*width),
+	}
+}
+
+// Cap returns the number of samples the ring can hold.
+func (r *Ring) Cap() int {
+	return len(r.times)
+}
+
+// Head returns the sequence number of the next sample to be recorded.
+func (r *Ring) Head() uint64 {
+	return r.head.Load()
+}
+
+// Record samples s into the next slot, stamped with t.
+func (r *Ring) Record(t int64, s *Sampler) {
+	seq := r.head.Load()
+	slot := int(seq % uint64(len(r.times)))
+	values := r.values[slot*r.width : (slot+1)*r.width]
+	for i := range values {
+		v := int64(0)
+		if s.present[i] {
+			v = s.counters[i].Long()
+		}
+		atomic.StoreInt64(&values[i], v)
+	}
+	atomic.StoreInt64(&r.times[slot], t)
+	r.head.Store(seq + 1)
+}
+
+// Read copies the sample with sequence number seq into dst and returns its time.
+// It returns false if the sample has not been recorded yet or was overwritten.
+func (r *Ring) Read(seq uint64, dst []int64) (int64, bool) {
+	capacity := uint64(len(r.times))
+	if seq >= r.head.Load() {
+		return 0, false
+	}
+	slot := int(seq % capacity)
+	values := r.values[slot*r.width : (slot+1)*r.width]
+	for i := range values {
+		dst[i] = atomic.LoadInt64(&values[i])
+	}
+	t := atomic.LoadInt64(&r.times[slot])
+	// The producer starts overwriting this slot once head reaches seq+capacity.
+	if r.head.Load() >= seq+capacity {
+		return 0, false
+	}
+	return t, true
+}
@@ -0,0 +1,68 @@
+package perfdata
+
+import (
+	"encoding/binary"
+	"testing"
+)
+
+// TestSampler tests resolving present and absent counters.
+func TestSampler(t *testing.T) {
+	pd, err := Parse(BuildMock(binary.LittleEndian, testCounters...))
+	if err != nil {
+		t.Fatalf("Parse failed: %v", err)
+	}
+	s := NewSampler(pd, []string{"sun.gc.collector.0.invocations", "sun.gc.none", "sun.rt.javaCommand"})
+	if !s.Has(0) || s.Has(1) || s.Has(2) {
+		t.Errorf("unexpected presence: %v %v %v", s.Has(0), s.Has(1), s.Has(2))
+	}
+	dst := make([]int64, s.Len())
+	s.Sample(dst)
+	if dst[0] != 12 || dst[1] != 0 || dst[2] != 0 {
+		t.Errorf("unexpected sample: %v", dst)
+	}
+}
+
+// TestRing tests recording, reading and overwriting samples.
+func TestRing(t *testing.T) {
+	pd, err := Parse(BuildMock(binary.LittleEndian, testCounters...))
+	if err != nil {
+		t.Fatalf("Parse failed: %v", err)
+	}
+	s := NewSampler(pd, []string{"sun.gc.collector.0.invocations", "sun.gc.collector.1.invocations"})
+	r := NewRing(4, s.Len())
+	dst := make([]int64, s.Len())
+	if _, ok := r.Read(0, dst); ok {
+		t.Errorf("expected no sample before recording")
+	}
+	for i := 0; i < 6; i++ {
+		r.Record(int64(i), s)
+	}
+	if r.Head() != 6 {
+		t.Errorf("expected head 6, got %d", r.Head())
+	}
+	if _, ok := r.Read(1, dst); ok {
+		t.Errorf("expected sample 1 to be overwritten")
+	}
+	ts, ok := r.Read(5, dst)
+	if !ok || ts != 5 || dst[0] != 12 || dst[1] != 3 {
+		t.Errorf("unexpected sample 5: %d %v %v", ts, ok, dst)
+	}
+}
+
+// TestRing_NoAllocs tests that the sampling path does not allocate.
+func TestRing_NoAllocs(t *testing.T) {
+	pd, err := Parse(BuildMock(binary.LittleEndian, testCounters...))
+	if err != nil {
+		t.Fatalf("Parse failed: %v", err)
+	}
+	s := NewSampler(pd, []string{"sun.gc.collector.0.invocations", "sun.gc.collector.1.invocations"})
+	r := NewRing(16, s.Len())
+	dst := make([]int64, s.Len())
+	allocs := testing.AllocsPerRun(1000, func() {
+		r.Record(1, s)
+		r.Read(r.Head()-1, dst)
+	})
+	if allocs != 0 {
+		t.Errorf("expected no allocations, got %v", allocs)
+	}
+}
@@ -0,0 +1,45 @@
+package pkg
+
+import (
+	"sync/atomic"
+	"testing"
+)
+
+// TestParallelFor tests that every index is visited exactly once.
+func TestParallelFor(t *testing.T) {
+	for _, workers := range []int{0, 1, 4, 100} {
+		results := make([]int, 50)
+		ParallelFor(len(results), workers, func(i int) {
+			results[i] += i + 1
+		})
+		for i, v := range results {
+			if v != i+1 {
+				t.Fatalf("workers %d: index %d visited with result %d", workers, i, v)
+			}
+		}
+	}
+	ParallelFor(0, 4, func(i int) {
+		t.Errorf("fn should not be called for n=0")
+	})
+}
+
+// TestParallelFor_Bounded tests that no more than workers calls run at once.
+func TestParallelFor_Bounded(t *testing.T) {
+	var running, peak atomic.Int32
+	ParallelFor(64, 3, func(i int) {
+		n := running.Add(1)
+		for {
+			p := peak.Load()
+			if n <= p || peak.CompareAndSwap(p, n) {
+				break
+			}
+		}
+		for j := 0; j < 1000; j++ {
+			_ = j
+		}
+		running.Add(-1)
+	})
+	if peak.Load() > 3 {
+		t.Errorf("expected at most 3 concurrent calls, got %d", peak.Load())
+	}
+}
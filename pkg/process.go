@@ -0,0 +1,157 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// ErrProcessExited is returned for a process that is gone, or whose handle is closed.
+var ErrProcessExited = errors.New("process has exited")
+
+// Process is a handle on one process. On Linux 5.3 and later it holds a pidfd,
+// which keeps referring to the process it was opened for, so a signal cannot reach
+// another process that reused the pid and the exit can be waited for, see
+// ProcessWatcher. Elsewhere it falls back to the pid.
+type Process struct {
+	Pid int32
+
+	mu     sync.Mutex
+	fd     int // pidfd, -1 without one
+	closed bool
+}
+
+// OpenProcess opens a handle on the process with the given pid.
+func OpenProcess(pid int32) (*Process, error) {
+	if pid <= 0 {
+		return nil, fmt.Errorf("invalid pid %v", pid)
+	}
+	fd, err := openPidfd(pid)
+	if err == syscall.ESRCH {
+		return nil, ErrProcessExited
+	}
+	if err != nil {
+		fd = -1
+		if exist, _ := PidExists(pid); !exist {
+			return nil, ErrProcessExited
+		}
+	}
+	return &Process{Pid: pid, fd: fd}, nil
+}
+
+// Signal sends sig to the process.
+func (p *Process) Signal(sig syscall.Signal) error {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed {
+		return ErrProcessExited
+	}
+	var err error
+	if p.fd >= 0 {
+		err = pidfdSendSignal(p.fd, sig)
+	} else {
+		err = syscall.Kill(int(p.Pid), sig)
+	}
+	if err == syscall.ESRCH {
+		return ErrProcessExited
+	}
+	return err
+}
+
+// Exited reports whether the process has exited, without waiting.
+func (p *Process) Exited() bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed {
+		return true
+	}
+	if p.fd >= 0 {
+		return pidfdExited(p.fd)
+	}
+	exist, err := PidExists(p.Pid)
+	return err == nil && !exist
+}
+
+// Close releases the handle. Signal fails once it is closed.
+func (p *Process) Close() error {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed {
+		return nil
+	}
+	p.closed = true
+	if p.fd >= 0 {
+		return syscall.Close(p.fd)
+	}
+	return nil
+}
+
+// ProcessWatcher reports the exit of the processes it watches as events: their
+// pidfds are registered with epoll, so no process is probed. It needs pidfds, see
+// NewProcessWatcher.
+type ProcessWatcher struct {
+	mu      sync.Mutex
+	watched map[int32]*Process
+	poller  *processPoller
+}
+
+// NewProcessWatcher returns a watcher, or errors.ErrUnsupported where processes
+// have no pidfd and their exits must be polled for.
+func NewProcessWatcher() (*ProcessWatcher, error) {
+	poller, err := newProcessPoller()
+	if err != nil {
+		return nil, err
+	}
+	return &ProcessWatcher{watched: map[int32]*Process{}, poller: poller}, nil
+}
+
+// Watch starts watching p, which must stay open while it is watched. Processes
+// opened without a pidfd cannot be watched.
+func (w *ProcessWatcher) Watch(p *Process) error {
+	p.mu.Lock()
+	fd := p.fd
+	p.mu.Unlock()
+	if fd < 0 {
+		return errors.ErrUnsupported
+	}
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if err := w.poller.add(fd, p.Pid); err != nil {
+		return err
+	}
+	w.watched[p.Pid] = p
+	return nil
+}
+
+// Unwatch stops watching the process pid.
+func (w *ProcessWatcher) Unwatch(pid int32) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if p := w.watched[pid]; p != nil {
+		p.mu.Lock()
+		if p.fd >= 0 && !p.closed {
+			w.poller.remove(p.fd)
+		}
+		p.mu.Unlock()
+		delete(w.watched, pid)
+	}
+}
+
+// Wait appends to dst the pids of watched processes that exited, waiting up to
+// timeout for the first one, or until the watcher is closed if timeout is 0. The
+// processes reported are no longer watched.
+func (w *ProcessWatcher) Wait(dst []int32, timeout time.Duration) ([]int32, error) {
+	start := len(dst)
+	dst, err := w.poller.wait(dst, timeout)
+	for _, pid := range dst[start:] {
+		w.Unwatch(pid)
+	}
+	return dst, err
+}
+
+// Close stops watching; a Wait in progress returns an error.
+func (w *ProcessWatcher) Close() error {
+	return w.poller.close()
+}
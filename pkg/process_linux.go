@@ -0,0 +1,99 @@
+package pkg
+
+import (
+	"errors"
+	"os"
+	"syscall"
+	"time"
+
+	"golang.org/x/sys/unix"
+)
+
+// openPidfd opens a pidfd of the process, available since Linux 5.3. It is close-on-exec.
+func openPidfd(pid int32) (int, error) {
+	return unix.PidfdOpen(int(pid), 0)
+}
+
+func pidfdSendSignal(fd int, sig syscall.Signal) error {
+	return unix.PidfdSendSignal(fd, sig, nil, 0)
+}
+
+// pidfdExited reports whether the pidfd is readable, which it becomes once the process exits.
+func pidfdExited(fd int) bool {
+	fds := []unix.PollFd{{Fd: int32(fd), Events: unix.POLLIN}}
+	n, err := unix.Poll(fds, 0)
+	return err == nil && n == 1 && fds[0].Revents&unix.POLLIN != 0
+}
+
+// processPoller is an epoll instance of pidfds. The epoll fd is itself registered
+// with the runtime poller, so waiting parks the goroutine instead of a thread and
+// honors deadlines and Close.
+type processPoller struct {
+	epfd   int
+	f      *os.File
+	events []syscall.EpollEvent
+}
+
+func newProcessPoller() (*processPoller, error) {
+	// Probe for pidfd support with our own process.
+	fd, err := openPidfd(int32(os.Getpid()))
+	if err != nil {
+		return nil, errors.ErrUnsupported
+	}
+	syscall.Close(fd)
+	epfd, err := syscall.EpollCreate1(syscall.EPOLL_CLOEXEC)
+	if err != nil {
+		return nil, err
+	}
+	if err := syscall.SetNonblock(epfd, true); err != nil {
+		syscall.Close(epfd)
+		return nil, err
+	}
+	return &processPoller{epfd: epfd, f: os.NewFile(uintptr(epfd), "epoll"), events: make([]syscall.EpollEvent, 64)}, nil
+}
+
+func (p *processPoller) add(fd int, pid int32) error {
+	return syscall.EpollCtl(p.epfd, syscall.EPOLL_CTL_ADD, fd, &syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: pid})
+}
+
+func (p *processPoller) remove(fd int) {
+	syscall.EpollCtl(p.epfd, syscall.EPOLL_CTL_DEL, fd, nil)
+}
+
+func (p *processPoller) wait(dst []int32, timeout time.Duration) ([]int32, error) {
+	var deadline time.Time
+	if timeout > 0 {
+		deadline = time.Now().Add(timeout)
+	}
+	if err := p.f.SetReadDeadline(deadline); err != nil {
+		return dst, err
+	}
+	rc, err := p.f.SyscallConn()
+	if err != nil {
+		return dst, err
+	}
+	var n int
+	var werr error
+	err = rc.Read(func(fd uintptr) bool {
+		n, werr = syscall.EpollWait(int(fd), p.events, 0)
+		// Nothing ready yet, park until the epoll fd is readable.
+		return werr != syscall.EINTR && (werr != nil || n > 0)
+	})
+	if errors.Is(err, os.ErrDeadlineExceeded) {
+		return dst, nil
+	}
+	if err != nil {
+		return dst, err
+	}
+	if werr != nil {
+		return dst, werr
+	}
+	for _, e := range p.events[:n] {
+		dst = append(dst, e.Fd)
+	}
+	return dst, nil
+}
+
+func (p *processPoller) close() error {
+	return p.f.Close()
+}
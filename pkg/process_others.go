@@ -0,0 +1,43 @@
+//go:build !linux
+
+package pkg
+
+import (
+	"errors"
+	"syscall"
+	"time"
+)
+
+// openPidfd fails, so processes are referred to by pid.
+func openPidfd(pid int32) (int, error) {
+	return -1, errors.ErrUnsupported
+}
+
+func pidfdSendSignal(fd int, sig syscall.Signal) error {
+	return errors.ErrUnsupported
+}
+
+func pidfdExited(fd int) bool {
+	return false
+}
+
+// processPoller is not supported, exits are polled for instead.
+type processPoller struct{}
+
+func newProcessPoller() (*processPoller, error) {
+	return nil, errors.ErrUnsupported
+}
+
+func (p *processPoller) add(fd int, pid int32) error {
+	return errors.ErrUnsupported
+}
+
+func (p *processPoller) remove(fd int) {}
+
+func (p *processPoller) wait(dst []int32, timeout time.Duration) ([]int32, error) {
+	return dst, errors.ErrUnsupported
+}
+
+func (p *processPoller) close() error {
+	return nil
+}
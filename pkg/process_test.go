@@ -0,0 +1,114 @@
+package pkg
+
+import (
+	"errors"
+	"os/exec"
+	"syscall"
+	"testing"
+	"time"
+)
+
+// startSleep starts a child process for the tests to watch.
+func startSleep(t *testing.T) *exec.Cmd {
+	cmd := exec.Command("sleep", "30")
+	if err := cmd.Start(); err != nil {
+		t.Skipf("cannot start sleep: %v", err)
+	}
+	t.Cleanup(func() {
+		cmd.Process.Kill()
+		cmd.Wait()
+	})
+	return cmd
+}
+
+// TestProcess tests signalling a process through its handle, and after it exited.
+func TestProcess(t *testing.T) {
+	cmd := startSleep(t)
+	p, err := OpenProcess(int32(cmd.Process.Pid))
+	if err != nil {
+		t.Fatalf("OpenProcess failed: %v", err)
+	}
+	defer p.Close()
+	if p.Exited() {
+		t.Error("expected the process to be alive")
+	}
+	if err := p.Signal(syscall.SIGKILL); err != nil {
+		t.Fatalf("Signal failed: %v", err)
+	}
+	cmd.Wait()
+	if !p.Exited() {
+		t.Error("expected the process to have exited")
+	}
+	if err := p.Signal(syscall.SIGQUIT); !errors.Is(err, ErrProcessExited) {
+		t.Errorf("expected ErrProcessExited after the exit, got %v", err)
+	}
+	p.Close()
+	if err := p.Signal(syscall.SIGQUIT); !errors.Is(err, ErrProcessExited) {
+		t.Errorf("expected ErrProcessExited once closed, got %v", err)
+	}
+
+	if _, err := OpenProcess(int32(cmd.Process.Pid)); !errors.Is(err, ErrProcessExited) {
+		t.Errorf("expected ErrProcessExited for a reaped process, got %v", err)
+	}
+	if _, err := OpenProcess(0); err == nil {
+		t.Error("expected an error for pid 0")
+	}
+}
+
+// TestProcessWatcher tests that the exit of a watched process is reported, and that
+// unwatched ones are not.
+func TestProcessWatcher(t *testing.T) {
+	w, err := NewProcessWatcher()
+	if errors.Is(err, errors.ErrUnsupported) {
+		t.Skip("pidfds are not supported")
+	}
+	if err != nil {
+		t.Fatalf("NewProcessWatcher failed: %v", err)
+	}
+	defer w.Close()
+
+	exiting, unwatched := startSleep(t), startSleep(t)
+	var procs []*Process
+	for _, cmd := range []*exec.Cmd{exiting, unwatched} {
+		p, err := OpenProcess(int32(cmd.Process.Pid))
+		if err != nil {
+			t.Fatalf("OpenProcess failed: %v", err)
+		}
+		defer p.Close()
+		if err := w.Watch(p); err != nil {
+			t.Fatalf("Watch failed: %v", err)
+		}
+		procs = append(procs, p)
+	}
+	w.Unwatch(procs[1].Pid)
+
+	if pids, err := w.Wait(nil, 20*time.Millisecond); err != nil || len(pids) != 0 {
+		t.Errorf("expected no exits yet, got %v, %v", pids, err)
+	}
+	exiting.Process.Kill()
+	unwatched.Process.Kill()
+	pids, err := w.Wait(nil, 5*time.Second)
+	if err != nil || len(pids) != 1 || pids[0] != procs[0].Pid {
+		t.Errorf("expected the exit of %v, got %v, %v", procs[0].Pid, pids, err)
+	}
+	if pids, _ := w.Wait(nil, 20*time.Millisecond); len(pids) != 0 {
+		t.Errorf("expected a reported process to no longer be watched, got %v", pids)
+	}
+
+	// Close makes a Wait in progress return.
+	done := make(chan error, 1)
+	go func() {
+		_, err := w.Wait(nil, 0)
+		done <- err
+	}()
+	time.Sleep(20 * time.Millisecond)
+	w.Close()
+	select {
+	case err := <-done:
+		if err == nil {
+			t.Error("expected Wait to fail once the watcher is closed")
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("expected Close to end the Wait")
+	}
+}
@@ -0,0 +1,110 @@
+package pkg
+
+import (
+	"errors"
+	"math/rand"
+	"os"
+	"path"
+	"path/filepath"
+	"strconv"
+	"strings"
+)
+
+// ErrEscapesRoot is returned by the methods of Root for a name with a ".." component.
+var ErrEscapesRoot = errors.New("path escapes from parent")
+
+// Root gives access to the files below a directory without following symlinks,
+// so a directory that another user can write to, such as the /tmp of a container
+// reached through /proc/<pid>/root, cannot redirect us to a file elsewhere on
+// the host. Every component of a name must be a real directory or file: a
+// symlink anywhere in it fails with ELOOP or ENOTDIR, as openat2 does with
+// RESOLVE_IN_ROOT|RESOLVE_NO_SYMLINKS.
+//
+// Names are relative to the root and slash separated; "." is the root itself.
+type Root struct {
+	name string
+	fd   int // directory fd on Linux, -1 elsewhere
+}
+
+// OpenRoot opens dir, which is trusted, to resolve names below it.
+func OpenRoot(dir string) (*Root, error) {
+	return openRoot(dir)
+}
+
+// Name returns the directory the root was opened with.
+func (r *Root) Name() string {
+	return r.name
+}
+
+// Join returns the path of name as seen from outside the root.
+func (r *Root) Join(name string) string {
+	return filepath.Join(r.name, name)
+}
+
+// Close releases the root.
+func (r *Root) Close() error {
+	return r.close()
+}
+
+// OpenFile opens name like os.OpenFile, except that a symlink is never followed.
+func (r *Root) OpenFile(name string, flag int, perm os.FileMode) (*os.File, error) {
+	return r.openFile(name, flag, perm)
+}
+
+// Lstat returns the file info of name without following a final symlink.
+func (r *Root) Lstat(name string) (os.FileInfo, error) {
+	return r.lstat(name)
+}
+
+// Mkdir creates the directory name with permission bits perm, before the umask.
+func (r *Root) Mkdir(name string, perm os.FileMode) error {
+	return r.mkdir(name, perm)
+}
+
+// Remove removes the file name, which must not be a directory.
+func (r *Root) Remove(name string) error {
+	return r.remove(name)
+}
+
+// Rename renames oldname to newname, both below the root.
+func (r *Root) Rename(oldname, newname string) error {
+	return r.rename(oldname, newname)
+}
+
+// Link creates name as a hard link to oldpath, a path outside the root that is
+// resolved as usual.
+func (r *Root) Link(oldpath, name string) error {
+	return r.link(oldpath, name)
+}
+
+// CreateTemp creates a new file in dir below the root, opened for reading and
+// writing, with a name starting with prefix, and returns it with its name.
+func (r *Root) CreateTemp(dir, prefix string) (*os.File, string, error) {
+	for try := 0; ; try++ {
+		name := path.Join(dir, prefix+strconv.FormatUint(uint64(rand.Uint32()), 10))
+		f, err := r.OpenFile(name, os.O_RDWR|os.O_CREATE|os.O_EXCL, 0600)
+		if os.IsExist(err) && try < 10000 {
+			continue
+		}
+		return f, name, err
+	}
+}
+
+// splitRootName splits name into its components, refusing "..". The root itself
+// has the single component ".".
+func splitRootName(name string) ([]string, error) {
+	var parts []string
+	for _, part := range strings.Split(filepath.ToSlash(name), "/") {
+		switch part {
+		case "", ".":
+			continue
+		case "..":
+			return nil, ErrEscapesRoot
+		}
+		parts = append(parts, part)
+	}
+	if len(parts) == 0 {
+		return []string{"."}, nil
+	}
+	return parts, nil
+}
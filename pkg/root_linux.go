@@ -0,0 +1,128 @@
+package pkg
+
+import (
+	"os"
+	"syscall"
+
+	"golang.org/x/sys/unix"
+)
+
+func openRoot(dir string) (*Root, error) {
+	fd, err := syscall.Open(dir, unix.O_PATH|syscall.O_DIRECTORY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return nil, &os.PathError{Op: "open", Path: dir, Err: err}
+	}
+	return &Root{name: dir, fd: fd}, nil
+}
+
+func (r *Root) close() error {
+	return syscall.Close(r.fd)
+}
+
+// parent opens the directory name is in, one component at a time with O_NOFOLLOW,
+// and returns it with the base name. The fd must be closed unless it is r.fd.
+// openat2 would do this in a single call, but only since Linux 5.6 and it is
+// often filtered by container runtimes.
+func (r *Root) parent(name string) (int, string, error) {
+	parts, err := splitRootName(name)
+	if err != nil {
+		return -1, "", err
+	}
+	fd := r.fd
+	for _, part := range parts[:len(parts)-1] {
+		next, err := syscall.Openat(fd, part, unix.O_PATH|syscall.O_DIRECTORY|syscall.O_NOFOLLOW|syscall.O_CLOEXEC, 0)
+		if fd != r.fd {
+			syscall.Close(fd)
+		}
+		if err != nil {
+			return -1, "", err
+		}
+		fd = next
+	}
+	return fd, parts[len(parts)-1], nil
+}
+
+func (r *Root) closeParent(fd int) {
+	if fd != r.fd {
+		syscall.Close(fd)
+	}
+}
+
+func (r *Root) openFile(name string, flag int, perm os.FileMode) (*os.File, error) {
+	dir, base, err := r.parent(name)
+	if err != nil {
+		return nil, &os.PathError{Op: "open", Path: r.Join(name), Err: err}
+	}
+	defer r.closeParent(dir)
+	fd, err := syscall.Openat(dir, base, flag|syscall.O_NOFOLLOW|syscall.O_CLOEXEC, uint32(perm.Perm()))
+	if err != nil {
+		return nil, &os.PathError{Op: "open", Path: r.Join(name), Err: err}
+	}
+	return os.NewFile(uintptr(fd), r.Join(name)), nil
+}
+
+// lstat opens name with O_PATH|O_NOFOLLOW, which opens a symlink itself rather
+// than failing on it, and returns the info of whatever it got.
+func (r *Root) lstat(name string) (os.FileInfo, error) {
+	f, err := r.openFile(name, unix.O_PATH, 0)
+	if err != nil {
+		err.(*os.PathError).Op = "lstat"
+		return nil, err
+	}
+	defer f.Close()
+	return f.Stat()
+}
+
+func (r *Root) mkdir(name string, perm os.FileMode) error {
+	dir, base, err := r.parent(name)
+	if err == nil {
+		err = syscall.Mkdirat(dir, base, uint32(perm.Perm()))
+		r.closeParent(dir)
+	}
+	if err != nil {
+		return &os.PathError{Op: "mkdir", Path: r.Join(name), Err: err}
+	}
+	return nil
+}
+
+func (r *Root) remove(name string) error {
+	dir, base, err := r.parent(name)
+	if err == nil {
+		err = syscall.Unlinkat(dir, base)
+		r.closeParent(dir)
+	}
+	if err != nil {
+		return &os.PathError{Op: "remove", Path: r.Join(name), Err: err}
+	}
+	return nil
+}
+
+func (r *Root) rename(oldname, newname string) error {
+	oldDir, oldBase, err := r.parent(oldname)
+	if err != nil {
+		return &os.LinkError{Op: "rename", Old: r.Join(oldname), New: r.Join(newname), Err: err}
+	}
+	defer r.closeParent(oldDir)
+	newDir, newBase, err := r.parent(newname)
+	if err == nil {
+		err = syscall.Renameat(oldDir, oldBase, newDir, newBase)
+		r.closeParent(newDir)
+	}
+	if err != nil {
+		return &os.LinkError{Op: "rename", Old: r.Join(oldname), New: r.Join(newname), Err: err}
+	}
+	return nil
+}
+
+// link uses linkat(2) without flags, so a symlink at oldpath is linked itself.
+func (r *Root) link(oldpath, name string) error {
+	dir, base, err := r.parent(name)
+	if err == nil {
+		err = unix.Linkat(unix.AT_FDCWD, oldpath, dir, base, 0)
+		r.closeParent(dir)
+	}
+	if err != nil {
+		return &os.LinkError{Op: "link", Old: oldpath, New: r.Join(name), Err: err}
+	}
+	return nil
+}
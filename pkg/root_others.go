@@ -0,0 +1,100 @@
+//go:build !linux
+
+package pkg
+
+import (
+	"os"
+	"path/filepath"
+	"syscall"
+)
+
+// Without containers to reach into, names are resolved as paths: every directory
+// on the way is checked not to be a symlink, and the final component is opened
+// with O_NOFOLLOW.
+
+func openRoot(dir string) (*Root, error) {
+	fi, err := os.Stat(dir)
+	if err != nil {
+		return nil, err
+	}
+	if !fi.IsDir() {
+		return nil, &os.PathError{Op: "open", Path: dir, Err: syscall.ENOTDIR}
+	}
+	return &Root{name: dir, fd: -1}, nil
+}
+
+func (r *Root) close() error {
+	return nil
+}
+
+// resolve returns the path of name after checking the directories it is in.
+func (r *Root) resolve(op, name string) (string, error) {
+	parts, err := splitRootName(name)
+	if err != nil {
+		return "", &os.PathError{Op: op, Path: r.Join(name), Err: err}
+	}
+	path := r.name
+	for _, part := range parts[:len(parts)-1] {
+		path = filepath.Join(path, part)
+		fi, err := os.Lstat(path)
+		if err != nil {
+			return "", err
+		}
+		if !fi.IsDir() {
+			return "", &os.PathError{Op: op, Path: r.Join(name), Err: syscall.ENOTDIR}
+		}
+	}
+	return filepath.Join(path, parts[len(parts)-1]), nil
+}
+
+func (r *Root) openFile(name string, flag int, perm os.FileMode) (*os.File, error) {
+	path, err := r.resolve("open", name)
+	if err != nil {
+		return nil, err
+	}
+	return os.OpenFile(path, flag|syscall.O_NOFOLLOW, perm)
+}
+
+func (r *Root) lstat(name string) (os.FileInfo, error) {
+	path, err := r.resolve("lstat", name)
+	if err != nil {
+		return nil, err
+	}
+	return os.Lstat(path)
+}
+
+func (r *Root) mkdir(name string, perm os.FileMode) error {
+	path, err := r.resolve("mkdir", name)
+	if err != nil {
+		return err
+	}
+	return os.Mkdir(path, perm)
+}
+
+func (r *Root) remove(name string) error {
+	path, err := r.resolve("remove", name)
+	if err != nil {
+		return err
+	}
+	return syscall.Unlink(path)
+}
+
+func (r *Root) rename(oldname, newname string) error {
+	oldpath, err := r.resolve("rename", oldname)
+	if err != nil {
+		return err
+	}
+	newpath, err := r.resolve("rename", newname)
+	if err != nil {
+		return err
+	}
+	return os.Rename(oldpath, newpath)
+}
+
+func (r *Root) link(oldpath, name string) error {
+	path, err := r.resolve("link", name)
+	if err != nil {
+		return err
+	}
+	return os.Link(oldpath, path)
+}
@@ -0,0 +1,64 @@
+package pkg
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// TestRoot tests that files are reached below the root, but never through a symlink.
+func TestRoot(t *testing.T) {
+	dir, outside := t.TempDir(), t.TempDir()
+	os.Mkdir(filepath.Join(dir, "tmp"), 0755)
+	os.WriteFile(filepath.Join(outside, "secret"), []byte("secret"), 0600)
+	os.Symlink(outside, filepath.Join(dir, "tmp", "link"))
+	os.Symlink(filepath.Join(outside, "secret"), filepath.Join(dir, "tmp", "file"))
+
+	r, err := OpenRoot(dir)
+	if err != nil {
+		t.Fatalf("OpenRoot failed: %v", err)
+	}
+	defer r.Close()
+
+	f, err := r.OpenFile("tmp/a", os.O_WRONLY|os.O_CREATE|os.O_EXCL, 0600)
+	if err != nil {
+		t.Fatalf("OpenFile failed: %v", err)
+	}
+	f.WriteString("a")
+	f.Close()
+	if err := r.Mkdir("tmp/d", 0700); err != nil {
+		t.Fatalf("Mkdir failed: %v", err)
+	}
+	if err := r.Rename("tmp/a", "tmp/d/b"); err != nil {
+		t.Fatalf("Rename failed: %v", err)
+	}
+	if err := r.Link(filepath.Join(dir, "tmp", "d", "b"), "tmp/c"); err != nil {
+		t.Fatalf("Link failed: %v", err)
+	}
+	if fi, err := r.Lstat("tmp/c"); err != nil || fi.Size() != 1 || !fi.Mode().IsRegular() {
+		t.Errorf("expected the linked file, got %v %v", fi, err)
+	}
+	if err := r.Remove("tmp/c"); err != nil {
+		t.Errorf("Remove failed: %v", err)
+	}
+	if fi, err := r.Lstat("tmp/file"); err != nil || fi.Mode()&os.ModeSymlink == 0 {
+		t.Errorf("expected Lstat to report the symlink itself, got %v %v", fi, err)
+	}
+
+	for _, name := range []string{"tmp/file", "tmp/link/secret", "../" + filepath.Base(outside) + "/secret", "tmp/../../secret"} {
+		if f, err := r.OpenFile(name, os.O_RDONLY, 0); err == nil {
+			f.Close()
+			t.Errorf("expected %s to be refused", name)
+		}
+	}
+	if f, err := r.OpenFile("tmp/link/new", os.O_WRONLY|os.O_CREATE, 0600); err == nil {
+		f.Close()
+		t.Error("expected a file not to be created through a symlink")
+	}
+	if err := r.Mkdir("tmp/link/d", 0700); err == nil {
+		t.Error("expected a directory not to be created through a symlink")
+	}
+	if entries, _ := os.ReadDir(outside); len(entries) != 1 {
+		t.Errorf("expected nothing to be created outside the root, got %v", entries)
+	}
+}
@@ -0,0 +1,72 @@
+package pkg
+
+import (
+	"context"
+	"fmt"
+	"math/rand"
+	"os"
+	"path/filepath"
+	"strconv"
+	"syscall"
+	"time"
+)
+
+// HostSemaphore bounds how many holders run at once across every process of the host.
+// Each slot is a lock file in Dir held with flock(2), so the slots of a process that
+// dies are released by the kernel. Holders asking for fewer slots share the lower ones,
+// so at most the largest Slots asked for are ever held at once.
+//
+// Anyone who can open a slot can hold it forever, so Dir must be a directory
+// private to the current user, 0700 and owned by them; Acquire refuses others.
+type HostSemaphore struct {
+	Dir   string
+	Slots int
+}
+
+// hostSemaphorePoll is how often Acquire tries again while every slot is taken.
+const hostSemaphorePoll = 5 * time.Millisecond
+
+// Acquire takes a free slot, waiting until one is released or ctx is done.
+// The returned function releases the slot.
+func (s HostSemaphore) Acquire(ctx context.Context) (func(), error) {
+	if err := s.checkDir(); err != nil {
+		return nil, err
+	}
+	slots := max(s.Slots, 1)
+	first := rand.Intn(slots)
+	for {
+		for i := 0; i < slots; i++ {
+			path := filepath.Join(s.Dir, strconv.Itoa((first+i)%slots))
+			f, err := os.OpenFile(path, os.O_RDONLY|os.O_CREATE|syscall.O_NOFOLLOW, 0600)
+			if err != nil {
+				return nil, err
+			}
+			if err := syscall.Flock(int(f.Fd()), syscall.LOCK_EX|syscall.LOCK_NB); err == nil {
+				return func() { f.Close() }, nil
+			}
+			f.Close()
+		}
+		select {
+		case <-ctx.Done():
+			return nil, ctx.Err()
+		case <-time.After(hostSemaphorePoll):
+		}
+	}
+}
+
+// checkDir creates Dir unless it exists, then checks that it is a private
+// directory of the current user rather than, say, a symlink planted in /tmp.
+func (s HostSemaphore) checkDir() error {
+	if err := os.Mkdir(s.Dir, 0700); err != nil && !os.IsExist(err) {
+		return err
+	}
+	fi, err := os.Lstat(s.Dir)
+	if err != nil {
+		return err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !fi.IsDir() || fi.Mode().Perm() != 0700 || !ok || int(st.Uid) != os.Geteuid() {
+		return fmt.Errorf("%s is not a private directory of the current user", s.Dir)
+	}
+	return nil
+}
@@ -0,0 +1,68 @@
+package pkg
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// TestHostSemaphore tests that slots are exclusive until released, also across holders asking for fewer slots.
+func TestHostSemaphore(t *testing.T) {
+	sem := HostSemaphore{Dir: filepath.Join(t.TempDir(), "slots"), Slots: 2}
+	ctx := context.Background()
+	release1, err := sem.Acquire(ctx)
+	if err != nil {
+		t.Fatalf("Acquire failed: %v", err)
+	}
+	release2, err := sem.Acquire(ctx)
+	if err != nil {
+		t.Fatalf("Acquire failed: %v", err)
+	}
+
+	timeout, cancel := context.WithTimeout(ctx, 20*time.Millisecond)
+	defer cancel()
+	if _, err := sem.Acquire(timeout); err != context.DeadlineExceeded {
+		t.Errorf("expected every slot to be taken, got %v", err)
+	}
+	narrow := HostSemaphore{Dir: sem.Dir, Slots: 1}
+	done := make(chan error)
+	go func() {
+		release, err := narrow.Acquire(ctx)
+		if err == nil {
+			release()
+		}
+		done <- err
+	}()
+	release2()
+	release1()
+	select {
+	case err := <-done:
+		if err != nil {
+			t.Errorf("Acquire failed: %v", err)
+		}
+	case <-time.After(time.Second):
+		t.Error("expected a released slot to be acquired")
+	}
+}
+
+// TestHostSemaphore_Dir tests that only a private directory of ours holds the slots.
+func TestHostSemaphore_Dir(t *testing.T) {
+	dir := t.TempDir()
+	shared := filepath.Join(dir, "shared")
+	os.Mkdir(shared, 0777)
+	os.Chmod(shared, 0777)
+	link := filepath.Join(dir, "link")
+	private := filepath.Join(dir, "private")
+	os.Mkdir(private, 0700)
+	os.Symlink(private, link)
+	for _, d := range []string{shared, link} {
+		if _, err := (HostSemaphore{Dir: d, Slots: 1}).Acquire(context.Background()); err == nil {
+			t.Errorf("expected %s to be refused", d)
+		}
+	}
+	if entries, _ := os.ReadDir(private); len(entries) != 0 {
+		t.Errorf("expected no slot to be created through the symlink, got %v", entries)
+	}
+}
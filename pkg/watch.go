@@ -0,0 +1,152 @@
+package pkg
+
+import (
+	"errors"
+	"os"
+	"time"
+)
+
+// ErrWaitTimeout is returned by WaitForFile when the file does not appear in time.
+var ErrWaitTimeout = errors.New("timed out waiting for file")
+
+const (
+	minWaitBackoff = time.Millisecond
+	maxWaitBackoff = 100 * time.Millisecond
+)
+
+// WaitForFile blocks until path exists or timeout elapses.
+// On Linux the parent directory is watched with inotify so the wait ends as soon as
+// the file is created; elsewhere, or if inotify is unavailable, it polls with an
+// exponential backoff starting at 1ms.
+func WaitForFile(path string, timeout time.Duration) error {
+	return waitForFile(path, time.Now().Add(timeout))
+}
+
+// pollForFile stats path with an exponential backoff until it exists or deadline passes.
+func pollForFile(path string, deadline time.Time) error {
+	backoff := minWaitBackoff
+	for {
+		if _, err := os.Stat(path); err == nil {
+			return nil
+		}
+		now := time.Now()
+		if !now.Before(deadline) {
+			return ErrWaitTimeout
+		}
+		time.Sleep(min(backoff, deadline.Sub(now)))
+		backoff = min(backoff*2, maxWaitBackoff)
+	}
+}
+
+// ErrWatchOverflow is returned by DirWatcher.Next when events were lost and the
+// directory has to be listed again.
+var ErrWatchOverflow = errors.New("directory watch overflowed")
+
+// DirEvent is the creation or removal of an entry of a watched directory.
+type DirEvent struct {
+	Name    string // base name of the entry
+	Removed bool
+}
+
+// DirWatcher reports entries created in or removed from a single directory.
+// On Linux it is backed by inotify; elsewhere, or if inotify is unavailable, the
+// directory is listed once per Next call and compared with the previous listing.
+type DirWatcher struct {
+	dir  string
+	wake chan struct{} // see Wake
+
+	f      *os.File // inotify instance, nil when polling
+	events []byte
+
+	names map[string]struct{} // previous listing when polling
+}
+
+// WatchDir starts watching the entries of dir, which must exist.
+func WatchDir(dir string) (*DirWatcher, error) {
+	if _, err := os.Stat(dir); err != nil {
+		return nil, err
+	}
+	if w, err := newInotifyWatcher(dir); err == nil {
+		return w, nil
+	}
+	w := &DirWatcher{dir: dir, wake: make(chan struct{}, 1)}
+	names, err := w.list()
+	if err != nil {
+		return nil, err
+	}
+	w.names = names
+	return w, nil
+}
+
+// Next appends to dst the events that happen within timeout and returns as soon
+// as there are any. It returns dst unchanged when the timeout elapses first.
+func (w *DirWatcher) Next(dst []DirEvent, timeout time.Duration) ([]DirEvent, error) {
+	if w.f != nil {
+		return w.nextInotify(dst, timeout)
+	}
+	timer := time.NewTimer(timeout)
+	select {
+	case <-timer.C:
+	case <-w.wake:
+		timer.Stop()
+	}
+	names, err := w.list()
+	if err != nil {
+		return dst, err
+	}
+	for name := range names {
+		if _, ok := w.names[name]; !ok {
+			dst = append(dst, DirEvent{Name: name})
+		}
+	}
+	for name := range w.names {
+		if _, ok := names[name]; !ok {
+			dst = append(dst, DirEvent{Name: name, Removed: true})
+		}
+	}
+	w.names = names
+	return dst, nil
+}
+
+// Wake makes a Next in progress, or else the next one, return early. It may be
+// called from any goroutine, e.g. to handle events of another source.
+func (w *DirWatcher) Wake() {
+	select {
+	case w.wake <- struct{}{}:
+	default:
+	}
+	if w.f != nil {
+		w.f.SetReadDeadline(time.Now())
+	}
+}
+
+// woken consumes a pending Wake.
+func (w *DirWatcher) woken() bool {
+	select {
+	case <-w.wake:
+		return true
+	default:
+		return false
+	}
+}
+
+// Close stops watching.
+func (w *DirWatcher) Close() error {
+	if w.f != nil {
+		return w.f.Close()
+	}
+	return nil
+}
+
+// list returns the names of the entries of the watched directory.
+func (w *DirWatcher) list() (map[string]struct{}, error) {
+	entries, err := os.ReadDir(w.dir)
+	if err != nil {
+		return nil, err
+	}
+	names := make(map[string]struct{}, len(entries))
+	for _, e := range entries {
+		names[e.Name()] = struct{}{}
+	}
+	return names, nil
+}
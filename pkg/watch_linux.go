@@ -0,0 +1,107 @@
+package pkg
+
+import (
+	"bytes"
+	"errors"
+	"os"
+	"path/filepath"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// waitForFile watches the parent directory of path with inotify.
+// The backoff still bounds each wait, so a missed event only delays detection.
+func waitForFile(path string, deadline time.Time) error {
+	fd, err := syscall.InotifyInit1(syscall.IN_CLOEXEC | syscall.IN_NONBLOCK)
+	if err != nil {
+		return pollForFile(path, deadline)
+	}
+	// A non-blocking fd is registered with the runtime poller, which gives us read deadlines.
+	f := os.NewFile(uintptr(fd), "inotify")
+	defer f.Close()
+	if _, err := syscall.InotifyAddWatch(fd, filepath.Dir(path), syscall.IN_CREATE|syscall.IN_MOVED_TO); err != nil {
+		return pollForFile(path, deadline)
+	}
+
+	events := make([]byte, 4096)
+	backoff := minWaitBackoff
+	for {
+		// Stat after the watch is in place so a file created in between is not missed.
+		if _, err := os.Stat(path); err == nil {
+			return nil
+		}
+		now := time.Now()
+		if !now.Before(deadline) {
+			return ErrWaitTimeout
+		}
+		if err := f.SetReadDeadline(now.Add(min(backoff, deadline.Sub(now)))); err != nil {
+			return pollForFile(path, deadline)
+		}
+		backoff = min(backoff*2, maxWaitBackoff)
+		if _, err := f.Read(events); err != nil && !errors.Is(err, os.ErrDeadlineExceeded) {
+			return pollForFile(path, deadline)
+		}
+	}
+}
+
+// dirWatchMask selects the inotify events reported by DirWatcher.
+const dirWatchMask = syscall.IN_CREATE | syscall.IN_MOVED_TO | syscall.IN_DELETE | syscall.IN_MOVED_FROM | syscall.IN_DELETE_SELF
+
+// newInotifyWatcher returns a DirWatcher backed by an inotify watch on dir.
+func newInotifyWatcher(dir string) (*DirWatcher, error) {
+	fd, err := syscall.InotifyInit1(syscall.IN_CLOEXEC | syscall.IN_NONBLOCK)
+	if err != nil {
+		return nil, err
+	}
+	f := os.NewFile(uintptr(fd), "inotify")
+	if _, err := syscall.InotifyAddWatch(fd, dir, dirWatchMask); err != nil {
+		f.Close()
+		return nil, err
+	}
+	return &DirWatcher{dir: dir, wake: make(chan struct{}, 1), f: f, events: make([]byte, 64*1024)}, nil
+}
+
+// nextInotify waits up to timeout for inotify events and decodes them into dst.
+func (w *DirWatcher) nextInotify(dst []DirEvent, timeout time.Duration) ([]DirEvent, error) {
+	if w.woken() {
+		return dst, nil
+	}
+	if err := w.f.SetReadDeadline(time.Now().Add(timeout)); err != nil {
+		return dst, err
+	}
+	// A Wake between the check and the deadline would be overwritten by it.
+	if w.woken() {
+		return dst, nil
+	}
+	n, err := w.f.Read(w.events)
+	if errors.Is(err, os.ErrDeadlineExceeded) {
+		return dst, nil
+	}
+	if err != nil {
+		return dst, err
+	}
+	for off := 0; off+syscall.SizeofInotifyEvent <= n; {
+		ev := (*syscall.InotifyEvent)(unsafe.Pointer(&w.events[off]))
+		nameStart := off + syscall.SizeofInotifyEvent
+		off = nameStart + int(ev.Len)
+		if ev.Mask&syscall.IN_Q_OVERFLOW != 0 {
+			return dst, ErrWatchOverflow
+		}
+		if ev.Mask&(syscall.IN_DELETE_SELF|syscall.IN_IGNORED) != 0 {
+			return dst, os.ErrNotExist
+		}
+		if ev.Len == 0 || off > n {
+			continue
+		}
+		name := w.events[nameStart:off]
+		if i := bytes.IndexByte(name, 0); i >= 0 {
+			name = name[:i]
+		}
+		dst = append(dst, DirEvent{
+			Name:    string(name),
+			Removed: ev.Mask&(syscall.IN_DELETE|syscall.IN_MOVED_FROM) != 0,
+		})
+	}
+	return dst, nil
+}
@@ -0,0 +1,22 @@
+//go:build !linux
+
+package pkg
+
+import (
+	"errors"
+	"time"
+)
+
+// waitForFile polls for path, as there is no inotify to watch with.
+func waitForFile(path string, deadline time.Time) error {
+	return pollForFile(path, deadline)
+}
+
+// newInotifyWatcher fails, so DirWatcher falls back to listing the directory.
+func newInotifyWatcher(dir string) (*DirWatcher, error) {
+	return nil, errors.ErrUnsupported
+}
+
+func (w *DirWatcher) nextInotify(dst []DirEvent, timeout time.Duration) ([]DirEvent, error) {
+	return dst, errors.ErrUnsupported
+}
@@ -0,0 +1,127 @@
+package pkg
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// TestWaitForFile tests that WaitForFile returns promptly once the file is created.
+func TestWaitForFile(t *testing.T) {
+	path := filepath.Join(t.TempDir(), ".java_pid1")
+	go func() {
+		time.Sleep(20 * time.Millisecond)
+		os.WriteFile(path+".tmp", nil, 0644)
+		os.Rename(path+".tmp", path)
+	}()
+	start := time.Now()
+	if err := WaitForFile(path, 5*time.Second); err != nil {
+		t.Fatalf("WaitForFile failed: %v", err)
+	}
+	if elapsed := time.Since(start); elapsed > time.Second {
+		t.Errorf("expected WaitForFile to return promptly, took %v", elapsed)
+	}
+
+	// Already existing file returns immediately.
+	if err := WaitForFile(path, 0); err != nil {
+		t.Errorf("expected existing file to be found, got %v", err)
+	}
+}
+
+// TestWaitForFile_Timeout tests that WaitForFile gives up after the timeout.
+func TestWaitForFile_Timeout(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "never")
+	start := time.Now()
+	if err := WaitForFile(path, 50*time.Millisecond); err != ErrWaitTimeout {
+		t.Errorf("expected ErrWaitTimeout, got %v", err)
+	}
+	if elapsed := time.Since(start); elapsed < 50*time.Millisecond {
+		t.Errorf("expected to wait for the timeout, returned after %v", elapsed)
+	}
+	if err := pollForFile(path, time.Now().Add(20*time.Millisecond)); err != ErrWaitTimeout {
+		t.Errorf("expected ErrWaitTimeout from polling, got %v", err)
+	}
+}
+
+// collectDirEvents calls Next until want events arrived or a second passed.
+func collectDirEvents(t *testing.T, w *DirWatcher, want int) []DirEvent {
+	t.Helper()
+	var events []DirEvent
+	deadline := time.Now().Add(time.Second)
+	for len(events) < want && time.Now().Before(deadline) {
+		var err error
+		if events, err = w.Next(events, 20*time.Millisecond); err != nil {
+			t.Fatalf("Next failed: %v", err)
+		}
+	}
+	return events
+}
+
+// TestDirWatcher tests that created and removed entries are reported, by inotify and by polling.
+func TestDirWatcher(t *testing.T) {
+	for _, polling := range []bool{false, true} {
+		dir := t.TempDir()
+		w, err := WatchDir(dir)
+		if err != nil {
+			t.Fatalf("WatchDir failed: %v", err)
+		}
+		if polling {
+			w.Close()
+			w = &DirWatcher{dir: dir, names: map[string]struct{}{}}
+		}
+
+		path := filepath.Join(dir, "1234")
+		os.WriteFile(path, nil, 0644)
+		events := collectDirEvents(t, w, 1)
+		if len(events) != 1 || events[0] != (DirEvent{Name: "1234"}) {
+			t.Errorf("polling=%v: expected creation of 1234, got %v", polling, events)
+		}
+		os.Remove(path)
+		events = collectDirEvents(t, w, 1)
+		if len(events) != 1 || events[0] != (DirEvent{Name: "1234", Removed: true}) {
+			t.Errorf("polling=%v: expected removal of 1234, got %v", polling, events)
+		}
+		w.Close()
+	}
+}
+
+// TestWatchDir_Missing tests that a missing directory cannot be watched.
+func TestWatchDir_Missing(t *testing.T) {
+	if _, err := WatchDir(filepath.Join(t.TempDir(), "missing")); err == nil {
+		t.Error("expected an error for a missing directory")
+	}
+}
+
+// TestDirWatcher_Wake tests that Wake makes Next return early, by inotify and by polling.
+func TestDirWatcher_Wake(t *testing.T) {
+	for _, polling := range []bool{false, true} {
+		dir := t.TempDir()
+		w, err := WatchDir(dir)
+		if err != nil {
+			t.Fatalf("WatchDir failed: %v", err)
+		}
+		if polling {
+			w.Close()
+			w = &DirWatcher{dir: dir, wake: make(chan struct{}, 1), names: map[string]struct{}{}}
+		}
+
+		// A Wake before Next is not lost.
+		w.Wake()
+		start := time.Now()
+		if events, err := w.Next(nil, 5*time.Second); err != nil || len(events) != 0 {
+			t.Errorf("polling=%v: expected no events, got %v, %v", polling, events, err)
+		}
+		go func() {
+			time.Sleep(20 * time.Millisecond)
+			w.Wake()
+		}()
+		if _, err := w.Next(nil, 5*time.Second); err != nil {
+			t.Errorf("polling=%v: Next failed: %v", polling, err)
+		}
+		if elapsed := time.Since(start); elapsed > time.Second {
+			t.Errorf("polling=%v: expected Next to return once woken, took %v", polling, elapsed)
+		}
+		w.Close()
+	}
+}